@@ -33,7 +33,6 @@ ade_WIZARD_CSRC = \
 	bertos/drv/pca9555.c \
 	bertos/mware/hex.c \
 	bertos/mware/parser.c \
-	bertos/struct/hashtable.c \
 	bertos/verstag.c \
 	#
 
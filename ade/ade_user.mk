@@ -9,21 +9,40 @@ ade_PROGRAMMER_PORT = usb
 
 # Files included by the user.
 ade_USER_CSRC = \
+	$(ade_SRC_PATH)/at.c \
+	$(ade_SRC_PATH)/channel.c \
 	$(ade_SRC_PATH)/command.c \
 	$(ade_SRC_PATH)/console.c \
 	$(ade_SRC_PATH)/eeprom.c \
+	$(ade_SRC_PATH)/energy.c \
 	$(ade_SRC_PATH)/gsm.c \
+	$(ade_SRC_PATH)/journal.c \
+	$(ade_SRC_PATH)/line.c \
 	$(ade_SRC_PATH)/control.c \
 	$(ade_SRC_PATH)/main.c \
+	$(ade_SRC_PATH)/perf.c \
+	$(ade_SRC_PATH)/presence.c \
+	$(ade_SRC_PATH)/sampler.c \
+	$(ade_SRC_PATH)/scheduler.c \
 	$(ade_SRC_PATH)/signals.c \
+	$(ade_SRC_PATH)/smsq.c \
+	$(ade_SRC_PATH)/smstok.c \
+	$(ade_SRC_PATH)/stack.c \
+	$(ade_SRC_PATH)/stats.c \
+	$(ade_SRC_PATH)/text.c \
+	bertos/algo/crc.c \
+	bertos/kern/proc.c \
+	bertos/kern/signal.c \
 	#
 
 # Files included by the user.
 ade_USER_PCSRC = \
+	bertos/mware/sprintf.c \
 	#
 
 # Files included by the user.
 ade_USER_CPPASRC = \
+	bertos/cpu/avr/hw/switch_ctx_avr.S \
 	#
 
 # Files included by the user.
@@ -46,4 +65,69 @@ ade_USER_CPPAFLAGS = \
 ade_USER_CPPFLAGS = \
 	-fno-strict-aliasing \
 	-fwrapv \
+	-fstack-usage \
 	#
+
+# Report the RAM/flash footprint, and the size of the channels state store,
+# at each build
+all:: $(OUTDIR)/ade.elf
+	$(ade_PREFIX)size$(ade_SUFFIX) --mcu=$(ade_MCU) -C $<
+	$(ade_PREFIX)nm$(ade_SUFFIX) -S --size-sort $< | grep -w -e chData -e chFlags || true
+
+# The perfect hash table of the console/SMS commands is kept in the tree, so
+# that python3 is not required to build: regenerate it after changing the
+# commands, which ade_cmdhash_check verifies
+ade_CMDHASH = python3 $(ade_SRC_PATH)/tools/cmdhash.py $(ade_SRC_PATH)/command.c
+
+.PHONY: ade_cmdhash ade_cmdhash_check
+ade_cmdhash:
+	$(ade_CMDHASH) > $(ade_SRC_PATH)/cmd_hash.h.tmp
+	mv $(ade_SRC_PATH)/cmd_hash.h.tmp $(ade_SRC_PATH)/cmd_hash.h
+
+ade_cmdhash_check:
+	$Q $(ade_CMDHASH) | cmp -s - $(ade_SRC_PATH)/cmd_hash.h || { \
+		echo "$(ade_SRC_PATH)/cmd_hash.h is stale, run make ade_cmdhash"; \
+		exit 1; \
+	}
+
+# The worst-case stack depth of main, of the processes and of the interrupts,
+# from the frames reported by -fstack-usage, checked against the stacks of
+# the processes, failing if indirect calls are left unresolved
+ade_STACK_BUDGET = $(shell sed -n 's/^\#define CONFIG_CONTROL_$(1)_STACK *//p' \
+	$(ade_SRC_PATH)/cfg/cfg_control.h)
+
+# The targets of the indirect calls: the softint tasks of the synchronous
+# timers, the handlers of the AT responses and of the commands, the putc of
+# the formatted outputs, while the methods of the serial ports are called by
+# the inline KFile helpers from everywhere
+ade_STACK_TASKS = sms_task,smsq_task,presence_task,btn_task
+ade_STACK_URCS = _gsmURCCreg,_gsmURCCmti,_gsmURCRing
+ade_STACK_LINES = _gsmCSQLine,_gsmCREGLine,_gsmCMGRLine,_gsmCMGLLine
+ade_STACK_STREAMS = _gsmCMGRStream,_gsmCMGLStream
+ade_STACK_PUTCS = kfile_putc,__kputchar,__str_put_char,__null_put_char,__sn_put_char
+
+ade_STACK_ICALLS = \
+	-i event_hook_softint=$(ade_STACK_TASKS) \
+	-i synctimer_poll=event_hook_softint \
+	-i timer_poll=event_hook_signal,event_hook_softint \
+	-i '__vector_\d+'=event_hook_signal \
+	-i dispatchURC=$(ade_STACK_URCS) \
+	-i dispatch=$(ade_STACK_LINES) \
+	-i 'stream\w+'=$(ade_STACK_STREAMS) \
+	-i at_poll=$(ade_STACK_URCS),$(ade_STACK_LINES),$(ade_STACK_STREAMS) \
+	-i '_formatted_write(_P)?'=$(ade_STACK_PUTCS) \
+	-i command_parse=@$(ade_SRC_PATH)/cmd_hash.h \
+	-I '(ser|spimaster)_\w+|uart\d_\w+|tx_sending' \
+	#
+
+.PHONY: ade_stack
+ade_stack: $(OUTDIR)/ade.elf
+	python3 $(ade_SRC_PATH)/tools/stackusage.py \
+		-d $(ade_PREFIX)objdump$(ade_SUFFIX) \
+		-b gsm_proc=$(call ade_STACK_BUDGET,GSM) \
+		-b cmd_proc=$(call ade_STACK_BUDGET,CMD) \
+		$(ade_STACK_ICALLS) \
+		$< $$(find $(OBJDIR)/ade -name '*.su')
+
+# The host-side simulator, see ade/emul
+include $(ade_SRC_PATH)/emul/ade_emul.mk
@@ -0,0 +1,407 @@
+/**
+ *       @file  at.c
+ *      @brief  Asynchronous AT command engine
+ *
+ * This provides an event driven engine to exchange AT commands with a serial
+ * modem. Requests are queued and sent one at a time, response lines are
+ * matched against the request in flight while unsolicited result codes
+ * (URC) are dispatched to the registered handlers. The engine never blocks:
+ * received bytes are consumed as they are available and each request has
+ * its own timeout.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "at.h"
+
+#include "gsm.h"
+#include "perf.h"
+
+#include <cfg/compiler.h>
+#include <cfg/macros.h>
+#include <cpu/power.h>
+
+#include <string.h> // strncmp
+#include <avr/pgmspace.h> // strncmp_P
+
+/* Define logging settings (for cfg/log.h module). */
+#define LOG_LEVEL   GSM_LOG_LEVEL
+#define LOG_FORMAT  GSM_LOG_FORMAT
+#include <cfg/log.h>
+
+/* Define  debugging utility function */
+#if CONFIG_GSM_DEBUG
+# define atDebug(STR, ...)   LOG_INFO("AT: "STR, ## __VA_ARGS__);
+#else
+# define atDebug(STR, ...)
+#endif
+
+// The CTRL-Z terminator of a request payload
+#define AT_PAYLOAD_END "\x1a"
+// The ESC character which aborts a payload prompt
+#define AT_PAYLOAD_ABORT "\x1b"
+
+// The serial port connected to the modem
+static Serial *port;
+
+// The queue of requests to send
+static List reqs;
+
+// The request in flight, NULL if none
+static at_req_t *cur = NULL;
+
+#if CONFIG_PERF
+// The time the request in flight has been sent
+static tstamp_t sentAt;
+#endif
+
+// Set while the request in flight waits for the payload prompt
+static uint8_t prompt = 0;
+
+/**
+ * @brief The streaming of the lines following a prefixed one
+ *
+ * The lines are streamed till the final result code: the first bytes of
+ * each line are held back while they could be a final result, then they are
+ * streamed, preceded by a '\n' if they follow a streamed line.
+ */
+typedef enum at_stream_states {
+	AT_STREAM_OFF = 0,
+	// At the beginning of the first line, nothing streamed yet
+	AT_STREAM_ARMED,
+	// Streaming a line
+	AT_STREAM_LINE,
+	// At the beginning of a line following a streamed one
+	AT_STREAM_BREAK,
+} at_stream_states_t;
+static at_stream_states_t streaming = AT_STREAM_OFF;
+
+// The line being received
+static char line[AT_LINE_SIZE];
+static uint8_t len = 0;
+
+// The registered URC handlers
+static struct {
+	const char *prefix;
+	at_line_t handler;
+} urcs[AT_URC_MAX];
+static uint8_t urcCount = 0;
+
+static inline uint8_t startsWith(const char *str, const char *prefix) {
+	return (strncmp(str, prefix, strlen(prefix)) == 0);
+}
+
+// The verbose final results, the error codes being followed by their details
+static const char results[][11] PROGMEM = {
+	"OK", "ERROR", "+CMS ERROR", "+CME ERROR",
+};
+
+/**
+ * @brief Get the final result code of a response line
+ *
+ * Both numeric (ATV0) and verbose result codes are recognized.
+ *
+ * @return the result code, AT_PENDING if this is not a final result line
+ */
+static int8_t finalResult(const char *l) {
+	uint8_t size;
+
+	if (l[0] >= '0' && l[0] <= '9' && l[1] == '\0')
+		return l[0] - '0';
+
+	for (uint8_t i = 0; i < countof(results); ++i) {
+		size = strlen_P(results[i]);
+		if (strncmp_P(l, results[i], size))
+			continue;
+		if (l[size] && pgm_read8(results[i]) != '+')
+			continue;
+		return i ? ERROR : OK;
+	}
+
+	return AT_PENDING;
+}
+
+/**
+ * @brief Verify if the \a n bytes of \a l could begin an OK or ERROR line
+ *
+ * These are the final results of the requests with streamed lines.
+ */
+static uint8_t maybeResult(const char *l, uint8_t n) {
+	uint8_t size;
+
+	if (n == 1 && (l[0] == '0'+OK || l[0] == '0'+ERROR))
+		return 1;
+
+	for (uint8_t i = 0; i < countof(results); ++i) {
+		size = strlen_P(results[i]);
+		// The error codes are followed by their details
+		if (n > size && pgm_read8(results[i]) != '+')
+			continue;
+		if (!strncmp_P(l, results[i], MIN(n, size)))
+			return 1;
+	}
+
+	return 0;
+}
+
+//=====[ Requests Handling ]====================================================
+
+static void complete(int8_t result) {
+	if (cur->cmdPgm) {
+		atDebug("RES [%S] %d\n", (const wchar_t *)cur->cmd, result);
+	} else {
+		atDebug("RES [%s] %d\n", cur->cmd, result);
+	}
+	PERF_STOP(PERF_AT, sentAt);
+	if (result == NO_RESPONSE)
+		PERF_COUNT(PERF_AT_TIMEOUT);
+	cur->result = result;
+	cur = NULL;
+	prompt = 0;
+	streaming = AT_STREAM_OFF;
+}
+
+static void sendNext(void) {
+
+	if (cur || LIST_EMPTY(&reqs))
+		return;
+
+	cur = (at_req_t *)list_remHead(&reqs);
+	prompt = (cur->data != NULL);
+	cur->deadline = timer_clock() + ms_to_ticks(cur->timeout);
+	PERF_MARK(sentAt);
+
+	// Clear error flags
+	ser_setstatus(port, 0);
+
+	if (cur->cmdPgm) {
+		atDebug("TX [%S]\n", (const wchar_t *)cur->cmd);
+		for (const char *c = cur->cmd; pgm_read8(c); ++c)
+			kfile_putc(pgm_read8(c), &port->fd);
+	} else {
+		atDebug("TX [%s]\n", cur->cmd);
+		kfile_write(&port->fd, cur->cmd, strlen(cur->cmd));
+	}
+	kfile_write(&port->fd, "\r\n", 2);
+}
+
+static void sendPayload(void) {
+	atDebug("TX [%s]\n", cur->data);
+	prompt = 0;
+	kfile_write(&port->fd, cur->data, strlen(cur->data));
+	kfile_write(&port->fd, AT_PAYLOAD_END, 1);
+}
+
+/**
+ * @brief Queue a new request
+ *
+ * The request is sent as soon as the engine is idle, its completion could
+ * be checked by at_done().
+ * NOTE: the request must stay valid till completion.
+ */
+void at_submit(at_req_t *req) {
+	req->result = AT_PENDING;
+	ADDTAIL(&reqs, &req->link);
+	sendNext();
+}
+
+/**
+ * @brief Run a request till completion
+ *
+ * This must not be called by line or URC handlers.
+ *
+ * @return the final result code, NO_RESPONSE on timeout
+ */
+int8_t at_exec(at_req_t *req) {
+	at_submit(req);
+	while (!at_done(req)) {
+		at_poll();
+		WATCHDOG_RESET();
+		cpu_relax();
+	}
+	return req->result;
+}
+
+//=====[ Lines Dispatching ]====================================================
+
+/** @brief Register the handler of URCs starting with \a prefix */
+void at_urc(const char *prefix, at_line_t handler) {
+	ASSERT(urcCount < AT_URC_MAX);
+	urcs[urcCount].prefix = prefix;
+	urcs[urcCount].handler = handler;
+	urcCount++;
+}
+
+static uint8_t dispatchURC(const char *l) {
+	for (uint8_t i = 0; i < urcCount; ++i) {
+		if (!startsWith(l, urcs[i].prefix))
+			continue;
+		urcs[i].handler(NULL, l);
+		return 1;
+	}
+	return 0;
+}
+
+static void dispatch(const char *l) {
+	int8_t result;
+
+	atDebug("RX [%s]\n", l);
+
+	// Information responses expected by the request in flight
+	if (cur && cur->prefix && startsWith(l, cur->prefix)) {
+		if (cur->line)
+			cur->line(cur, l);
+		// The following line is streamed
+		if (cur->stream)
+			streaming = AT_STREAM_ARMED;
+		return;
+	}
+
+	// RING is notified as a numeric code as well
+	if (!strcmp(l, "2"))
+		l = "RING";
+	if (dispatchURC(l) || !strcmp(l, "RING"))
+		return;
+
+	if (!cur) {
+		LOG_WARN("AT unexpected [%s]\r\n", l);
+		return;
+	}
+
+	result = finalResult(l);
+	if (result != AT_PENDING) {
+		complete(result);
+		return;
+	}
+
+	if (cur->line)
+		cur->line(cur, l);
+}
+
+/** @brief Stream the bytes held back, which are not a final result */
+static void streamHeld(void) {
+	if (streaming == AT_STREAM_BREAK)
+		cur->stream(cur, '\n');
+	for (uint8_t i = 0; i < len; ++i)
+		cur->stream(cur, line[i]);
+	len = 0;
+}
+
+static void streamByte(char c) {
+	int8_t result;
+
+	if (c != '\r' && c != '\n') {
+		if (streaming == AT_STREAM_LINE) {
+			cur->stream(cur, c);
+			return;
+		}
+		// Hold back the beginning of a line, till it could be a final result
+		if (len < AT_LINE_SIZE-1)
+			line[len++] = c;
+		if (maybeResult(line, len))
+			return;
+		streamHeld();
+		streaming = AT_STREAM_LINE;
+		return;
+	}
+
+	if (streaming == AT_STREAM_LINE) {
+		streaming = AT_STREAM_BREAK;
+		return;
+	}
+
+	// Skip empty lines, e.g. the terminator of the prefixed line
+	if (!len)
+		return;
+
+	line[len] = '\0';
+	result = finalResult(line);
+	if (result != OK && result != ERROR) {
+		streamHeld();
+		streaming = AT_STREAM_BREAK;
+		return;
+	}
+
+	// The streaming completes before the request
+	len = 0;
+	streaming = AT_STREAM_OFF;
+	cur->stream(cur, '\0');
+	dispatch(line);
+}
+
+/**
+ * @brief Update the engine status
+ *
+ * This must be called periodically: it consumes the received bytes,
+ * dispatches the complete lines, checks the timeout of the request in
+ * flight and sends the next queued one.
+ */
+void at_poll(void) {
+	int c;
+
+	while ((c = ser_getchar_nowait(port)) != EOF) {
+
+		if (streaming != AT_STREAM_OFF) {
+			streamByte(c);
+			continue;
+		}
+
+		if (c == '\r' || c == '\n') {
+			// Skip empty lines
+			if (!len)
+				continue;
+			line[len] = '\0';
+			len = 0;
+			dispatch(line);
+			continue;
+		}
+
+		// The payload prompt is not followed by a line terminator
+		if (c == '>' && !len && prompt) {
+			sendPayload();
+			continue;
+		}
+
+		// Skip leading spaces, e.g. the one following the prompt
+		if (c == ' ' && !len)
+			continue;
+
+		// Longer lines are truncated
+		if (len < AT_LINE_SIZE-1)
+			line[len++] = c;
+	}
+
+	if (cur && (long)(timer_clock() - cur->deadline) >= 0) {
+		if (cur->cmdPgm)
+			LOG_WARN("AT timeout [%S]\r\n", (const wchar_t *)cur->cmd);
+		else
+			LOG_WARN("AT timeout [%s]\r\n", cur->cmd);
+		// Avoid next commands being taken as payload by a late prompt
+		if (cur->data)
+			kfile_write(&port->fd, AT_PAYLOAD_ABORT, 1);
+		complete(NO_RESPONSE);
+	}
+
+	sendNext();
+}
+
+void at_init(Serial *ser) {
+	ASSERT(ser);
+	port = ser;
+	LIST_INIT(&reqs);
+	cur = NULL;
+	prompt = 0;
+	streaming = AT_STREAM_OFF;
+	len = 0;
+}
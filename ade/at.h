@@ -0,0 +1,115 @@
+/**
+ *       @file  at.h
+ *      @brief  Asynchronous AT command engine
+ *
+ * This provides an event driven engine to exchange AT commands with a serial
+ * modem. Requests are queued and sent one at a time, response lines are
+ * matched against the request in flight while unsolicited result codes
+ * (URC) are dispatched to the registered handlers. The engine never blocks:
+ * received bytes are consumed as they are available and each request has
+ * its own timeout.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef ADE_AT_H_
+#define ADE_AT_H_
+
+#include <cfg/compiler.h>
+#include <cpu/pgm.h>
+#include <drv/ser.h>
+#include <drv/timer.h>
+#include <struct/list.h>
+
+// The maximum length of a response line, i.e. an SMS header (SMS texts are
+// streamed)
+#define AT_LINE_SIZE 72
+
+// The maximum number of URC handlers
+#define AT_URC_MAX 4
+
+// The default request timeout [ms]
+#define AT_TIMEOUT_MS 2000
+
+// The result of a request still in progress
+#define AT_PENDING -1
+
+struct at_req;
+
+/** The handler of information response lines and URCs */
+typedef void (*at_line_t)(struct at_req *req, const char *line);
+
+/** The handler of streamed response bytes, '\0' at end of line */
+typedef void (*at_stream_t)(struct at_req *req, char c);
+
+/** An AT command request */
+typedef struct at_req {
+	Node link;
+	/** The command line, without terminator */
+	const char *cmd;
+	/** The command line is in program memory */
+	uint8_t cmdPgm;
+	/** The prefix of information responses, to be matched before URCs */
+	const char *prefix;
+	/** The handler of information response lines (optional) */
+	at_line_t line;
+	/** The handler of the line following a prefixed one (optional), which
+	 * is streamed byte by byte instead of being buffered */
+	at_stream_t stream;
+	/** The payload to send at the '>' prompt (optional), e.g. SMS text */
+	const char *data;
+	/** User data for the line handler */
+	void *ctx;
+	/** The request timeout [ms] */
+	mtime_t timeout;
+	/** The response deadline (private) */
+	ticks_t deadline;
+	/** The final result code, AT_PENDING while in progress */
+	int8_t result;
+} at_req_t;
+
+/** Setup a request without information responses */
+#define AT_REQ_INIT(REQ, CMD, TIMEOUT) \
+	do { \
+		(REQ)->cmd = (CMD); \
+		(REQ)->cmdPgm = 0; \
+		(REQ)->prefix = NULL; \
+		(REQ)->line = NULL; \
+		(REQ)->stream = NULL; \
+		(REQ)->data = NULL; \
+		(REQ)->ctx = NULL; \
+		(REQ)->timeout = (TIMEOUT); \
+		(REQ)->result = AT_PENDING; \
+	} while (0)
+
+/** Setup a request of a constant command, kept in program memory */
+#define AT_REQ_INIT_P(REQ, CMD, TIMEOUT) \
+	do { \
+		AT_REQ_INIT((REQ), PSTR(CMD), (TIMEOUT)); \
+		(REQ)->cmdPgm = 1; \
+	} while (0)
+
+void at_init(Serial *port);
+void at_urc(const char *prefix, at_line_t handler);
+void at_submit(at_req_t *req);
+int8_t at_exec(at_req_t *req);
+void at_poll(void);
+
+// Verify if the specified request has been completed
+inline uint8_t at_done(const at_req_t *req);
+inline uint8_t at_done(const at_req_t *req) {
+	return (req->result != AT_PENDING);
+}
+
+#endif /* end of include guard: ADE_AT_H_ */
@@ -112,6 +112,154 @@
 #define CONFIG_CALIBRATION_WEEKS 16
 
 
+/**
+ * Channels scheduling policy
+ *
+ * $WIZ$ type = "enum"
+ * $WIZ$ value_list = "sched_policy"
+ */
+#define CONFIG_CONTROL_SCHED SCHED_EDF
+
+/**
+ * Maximum interval [s] between two samples of the same (not boosted) channel
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = "1"
+ * $WIZ$ max = "255"
+ */
+#define CONFIG_CONTROL_MAX_REVISIT 8
+
+/**
+ * The moving average window (power of 2) of the channels load statistics
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = "1"
+ * $WIZ$ max = "6"
+ */
+#define CONFIG_CONTROL_STATS_SHIFT 3
+
+/**
+ * Track the minimum and maximum load of each channel, reported by the
+ * channel status command. These require 8 bytes of RAM for each channel.
+ * The emulator build enables them.
+ *
+ * $WIZ$ type = "boolean"
+ */
+#ifndef CONFIG_CONTROL_STATS_PEAKS
+# define CONFIG_CONTROL_STATS_PEAKS 0
+#endif
+
+/**
+ * The load noise multiple, measured at calibration, below which load
+ * variations are not considered, neither to restart a calibration nor as a
+ * fault
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = "1"
+ * $WIZ$ max = "16"
+ */
+#define CONFIG_CONTROL_NOISE_FACTOR 4
+
+/**
+ * Stack size [bytes] of the GSM process, which polls the modem, checks the
+ * received SMS and delivers the queued ones. Its peak is ~300 bytes, i.e.
+ * an AT request with its streamed lines, the logs and the worst interrupt.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = "128"
+ * $WIZ$ max = "1024"
+ */
+#define CONFIG_CONTROL_GSM_STACK 384
+
+/**
+ * Stack size [bytes] of the console process, which runs the console and
+ * SMS commands. Its peak is ~240 bytes, i.e. a fault notification with the
+ * logs and the worst interrupt.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = "128"
+ * $WIZ$ max = "1024"
+ */
+#define CONFIG_CONTROL_CMD_STACK 320
+
+/**
+ * Seconds a configuration update is kept on RAM before being committed to
+ * EEPROM, thus coalescing bursts of updates into a single write.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = "0"
+ * $WIZ$ max = "255"
+ */
+#define CONFIG_EEPROM_COMMIT_DELAY 5
+
+/**
+ * Number of events kept on RAM by the journal (power of 2)
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = "2"
+ * $WIZ$ max = "32"
+ */
+#define CONFIG_JOURNAL_RAM_SIZE 4
+
+/**
+ * Number of events saved on EEPROM by the journal
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = "1"
+ * $WIZ$ max = "255"
+ */
+#define CONFIG_JOURNAL_EE_SIZE 48
+
+/**
+ * Seconds a journal event is kept on RAM before being saved to EEPROM,
+ * unless half of the journal RAM is already pending.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = "0"
+ * $WIZ$ max = "65535"
+ */
+#define CONFIG_JOURNAL_FLUSH_DELAY 60
+
+/**
+ * Enable the channels energy accumulation and load profiles.
+ * These require ~47 bytes of RAM for each channel with the default profiles,
+ * which do not fit the ATmega644P along with the GSM and console processes.
+ * The emulator build enables them.
+ *
+ * $WIZ$ type = "boolean"
+ */
+#ifndef CONFIG_ENERGY
+# define CONFIG_ENERGY 0
+#endif
+
+/**
+ * Number of hourly energy buckets kept for each channel
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = "2"
+ * $WIZ$ max = "168"
+ */
+#define CONFIG_ENERGY_HOURS 24
+
+/**
+ * Number of daily energy buckets kept for each channel
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = "2"
+ * $WIZ$ max = "62"
+ */
+#define CONFIG_ENERGY_DAYS 7
+
+/**
+ * The hourly energy quantum (power of 2) in LAENERGY/32 counts accumulated
+ * over a sample window
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = "0"
+ * $WIZ$ max = "20"
+ */
+#define CONFIG_ENERGY_SHIFT 16
+
 /**
  * Set to use P[W] insetad of I[A]
  *
@@ -119,6 +267,17 @@
  */
 #define CONFIG_MONITOR_POWER 0
 
+/**
+ * Enable the performance counters and latency histograms.
+ * These require ~300 bytes of RAM, thus they are meant for bench builds.
+ * The emulator build enables them.
+ *
+ * $WIZ$ type = "boolean"
+ */
+#ifndef CONFIG_PERF
+# define CONFIG_PERF 0
+#endif
+
 /**
  * Module logging level.
  *
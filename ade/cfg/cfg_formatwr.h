@@ -48,7 +48,7 @@
  * \sa PRINTF_NOFLOAT
  * \sa PRINTF_FULL
  */
-#define CONFIG_PRINTF PRINTF_FULL
+#define CONFIG_PRINTF PRINTF_NOFLOAT
 
 /**
  * Size of buffer to format "%" sequences in printf.
@@ -59,7 +59,7 @@
  * $WIZ$ type = "int"
  * $WIZ$ min = 4
  */
-#define CONFIG_FRMWRI_BUFSIZE  134
+#define CONFIG_FRMWRI_BUFSIZE  16
 
 #endif /* CFG_FORMATWR_H */
 
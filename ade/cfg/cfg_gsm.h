@@ -59,6 +59,51 @@
  */
 #define CONFIG_GSM_AUTOBAUD 1
 
+/**
+ * Number of outgoing SMS which could be queued for delivery.
+ * Each queued message requires ~180 bytes of RAM.
+ * The notifications wait for a free slot, while the command replies not
+ * fitting are dropped, and counted as such by the performance counters.
+ * At least CONFIG_GSM_SMS_SEGMENTS slots are required to queue a whole
+ * reply. With just that many, a reply segmented into more SMS is dropped
+ * while a notification is being delivered: one more slot would queue it,
+ * but it does not fit the RAM of the board.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = "1"
+ * $WIZ$ max = "8"
+ */
+#define CONFIG_GSM_SMSQ_SIZE 2
+
+/**
+ * Maximum number of SMS a message is segmented into, when it does not fit
+ * a single SMS. Each segment is queued as a distinct message.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = "1"
+ * $WIZ$ max = "9"
+ */
+#define CONFIG_GSM_SMS_SEGMENTS 2
+
+/**
+ * Number of send attempts to each destination before dropping a message.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = "1"
+ * $WIZ$ max = "255"
+ */
+#define CONFIG_GSM_SMSQ_RETRIES 5
+
+/**
+ * Initial delay [s] before a failed delivery is retried, this is doubled at
+ * each following failure.
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = "1"
+ * $WIZ$ max = "255"
+ */
+#define CONFIG_GSM_SMSQ_BACKOFF 30
+
 /**
  * Module logging level.
  *
@@ -113,7 +113,7 @@
  * $WIZ$ min = 2
  * $WIZ$ supports = "avr"
  */
-#define CONFIG_SPI_TXBUFSIZE    32
+#define CONFIG_SPI_TXBUFSIZE    8
 
 /**
  * Size of the inbound FIFO buffer for SPI port [bytes].
@@ -121,7 +121,7 @@
  * $WIZ$ min = 2
  * $WIZ$ supports = "avr"
  */
-#define CONFIG_SPI_RXBUFSIZE    32
+#define CONFIG_SPI_RXBUFSIZE    8
 
 /**
  * Size of the outbound FIFO buffer for SPI port 0 [bytes].
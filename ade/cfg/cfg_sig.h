@@ -52,6 +52,15 @@
  */
 #define CONFIG_SIG_TESTING 	0
 
+/**
+ * Number of signal edges queued by the interrupt handler (power of 2)
+ *
+ * $WIZ$ type = "int"
+ * $WIZ$ min = "2"
+ * $WIZ$ max = "128"
+ */
+#define CONFIG_SIG_QUEUE_SIZE 	8
+
 /**
  * Module logging level.
  *
@@ -42,6 +42,6 @@
  * Inter-process signals.
  * $WIZ$ type = "autoenabled"
  */
-#define CONFIG_KERN_SIGNALS 0
+#define CONFIG_KERN_SIGNALS 1
 
 #endif /*  CFG_SIGNAL_H */
@@ -73,14 +73,21 @@
 #define	WATCHDOG_ENABLE()  wdt_enable(WDTO_8S)
 #define	WATCHDOG_DISABLE() wdt_disable()
 
+#include "cfg/cfg_proc.h"
+
+#if CONFIG_KERN
+// Sleep the calling process, while the sampling one keeps quiet the dog
+# define DELAY(MS) timer_delay(MS)
+#else
 // A Watch-Dog aware delay routine, this is safe only on single-task
 // firmwares
-#define DELAY(MS)\
+# define DELAY(MS)\
 	do {\
 		WATCHDOG_DISABLE();\
 		timer_delay(MS);\
 		WATCHDOG_ENABLE();\
 	} while(0)
+#endif
 
 
 #endif /* CFG_TIMER_H */
@@ -0,0 +1,48 @@
+/**
+ *       @file  channel.c
+ *      @brief  Channels state store
+ *
+ * This provides the state of the monitored channels: the meter readings, the
+ * calibration data and the channel flags. Meter readings are stored on 24
+ * bits, the size of the ADE7753 RMS registers, while all the flags of a
+ * channel are kept together in a single byte. Bitmasks of the channels with a
+ * given set of flags are built on request.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "channel.h"
+
+/** The vector of channels data */
+chData_t chData[MAX_CHANNELS];
+
+/** The bitmask of the channels having each flag */
+uint16_t chFlags[CH_FLAGS];
+
+/**
+ * @brief Set the specified flags on the channels of \a mask
+ *
+ * The flags are cleared on all the other channels.
+ */
+void ch_setMask(uint8_t flags, uint16_t mask) {
+	for (uint8_t i = 0; flags; ++i, flags >>= 1) {
+		if (flags & BV8(0))
+			chFlags[i] = mask;
+	}
+}
+
+/** @brief Clear the specified flags on all the channels */
+void ch_clearAll(uint8_t flags) {
+	ch_setMask(flags, 0x0000);
+}
@@ -0,0 +1,159 @@
+/**
+ *       @file  channel.h
+ *      @brief  Channels state store
+ *
+ * This provides the state of the monitored channels: the meter readings, the
+ * calibration data and the channel flags. Meter readings are stored on 24
+ * bits, the size of the ADE7753 RMS registers. The flags are stored by flag
+ * rather than by channel: each one is a bitmask of the channels having it,
+ * thus the bitmask of the channels with a given set of flags is the AND of
+ * their masks. The flags of a channel are still passed around as a single
+ * byte of CH_* bits, and accessed only through the ch_* helpers.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef ADE_CHANNEL_H_
+#define ADE_CHANNEL_H_
+
+#include "stats.h"
+
+#include <cfg/compiler.h>
+#include <cfg/macros.h>
+
+// The maximum number of channels
+#define MAX_CHANNELS 16
+
+/**
+ * \name Channel flags
+ *
+ * The flags are stored as a bitmask of channels for each of them, thus the
+ * masks of the scheduler are built without scanning the channels.
+ * @{
+ */
+// The channel is monitored
+#define CH_ENABLED   BV8(0)
+// A fault of the channel activates the AUX output
+#define CH_CRITICAL  BV8(1)
+// The channel requires calibration
+#define CH_CALIB     BV8(2)
+// The last sample of the channel was a load loss
+#define CH_LOSSY     BV8(3)
+// The channel has been found faulty after all the checks
+#define CH_SPOILED   BV8(4)
+// The channel has been notified as faulted
+#define CH_FAULTED   BV8(5)
+// The channel monitoring is suspended, waiting for a new check
+#define CH_SUSPENDED BV8(6)
+// The channel is monitored on restored calibration data, being revalidated
+#define CH_RESTORED  BV8(7)
+/*@}*/
+
+// The number of channel flags
+#define CH_FLAGS 8
+
+// The maximum value of a packed meter reading
+#define CH_U24_MAX 0xFFFFFFUL
+
+/** A packed (24 bits) meter reading */
+typedef struct ch_u24 {
+	uint8_t b[3];
+} ch_u24_t;
+
+/** The CHs load value */
+typedef uint32_t chLoad_t;
+
+typedef struct chData {
+	uint8_t calSamples;
+	uint8_t lossyChecks;
+	uint8_t lossySamples;
+	ch_u24_t Irms;
+	ch_u24_t Vrms;
+	chLoad_t Prms;
+	chLoad_t Pmax;
+	/** The load noise measured at calibration */
+	chLoad_t noise;
+	/** The load statistics since the last (re)calibration */
+	stats_t stats;
+} chData_t;
+
+extern chData_t chData[MAX_CHANNELS];
+
+// The bitmask of the channels having each flag, i.e. BV8(n) at index n
+extern uint16_t chFlags[CH_FLAGS];
+
+void ch_setMask(uint8_t flags, uint16_t mask);
+void ch_clearAll(uint8_t flags);
+
+//=====[ Flags ]================================================================
+
+// Get the bitmask of the channels having all the specified flags
+inline uint16_t ch_mask(uint8_t flags);
+inline uint16_t ch_mask(uint8_t flags) {
+	uint16_t mask = 0xFFFF;
+
+	for (uint8_t i = 0; flags; ++i, flags >>= 1) {
+		if (flags & BV8(0))
+			mask &= chFlags[i];
+	}
+	return mask;
+}
+
+// Verify if the channel has all the specified flags
+inline uint8_t ch_is(uint8_t ch, uint8_t flags);
+inline uint8_t ch_is(uint8_t ch, uint8_t flags) {
+	return ((ch_mask(flags) & BV16(ch)) != 0);
+}
+
+// Set the specified flags of the channel
+inline void ch_mark(uint8_t ch, uint8_t flags);
+inline void ch_mark(uint8_t ch, uint8_t flags) {
+	for (uint8_t i = 0; flags; ++i, flags >>= 1) {
+		if (flags & BV8(0))
+			chFlags[i] |= BV16(ch);
+	}
+}
+
+// Clear the specified flags of the channel
+inline void ch_clear(uint8_t ch, uint8_t flags);
+inline void ch_clear(uint8_t ch, uint8_t flags) {
+	for (uint8_t i = 0; flags; ++i, flags >>= 1) {
+		if (flags & BV8(0))
+			chFlags[i] &= ~BV16(ch);
+	}
+}
+
+//=====[ Meter readings ]=======================================================
+
+inline uint32_t ch_u24Get(const ch_u24_t *v);
+inline uint32_t ch_u24Get(const ch_u24_t *v) {
+	return ((uint32_t)v->b[2] << 16) | ((uint16_t)v->b[1] << 8) | v->b[0];
+}
+
+// Store a reading, saturating values not fitting 24 bits
+inline void ch_u24Set(ch_u24_t *v, uint32_t x);
+inline void ch_u24Set(ch_u24_t *v, uint32_t x) {
+	if (x > CH_U24_MAX)
+		x = CH_U24_MAX;
+	v->b[0] = x;
+	v->b[1] = x >> 8;
+	v->b[2] = x >> 16;
+}
+
+#define ch_irms(CH)         ch_u24Get(&chData[CH].Irms)
+#define ch_vrms(CH)         ch_u24Get(&chData[CH].Vrms)
+#define ch_setIrms(CH, V)   ch_u24Set(&chData[CH].Irms, V)
+#define ch_setVrms(CH, V)   ch_u24Set(&chData[CH].Vrms, V)
+
+#endif /* end of include guard: ADE_CHANNEL_H_ */
@@ -39,14 +39,20 @@
 
 #include <mware/parser.h>
 
-#define REGISTER_FUNCTION parser_register_cmd
-
-#define REGISTER_CMD(NAME) REGISTER_FUNCTION(&cmd_ ## NAME ## _template)
+#include <avr/pgmspace.h>
 
+/*
+ * Templates, and their strings, are stored in program memory: the commands
+ * table is generated from the MAKE_CMD by ade/tools/cmdhash.py.
+ */
 #define MAKE_TEMPLATE(NAME, ARGS, RES, FLAGS)				\
-const struct CmdTemplate cmd_ ## NAME ## _template =			\
+static const char cmd_ ## NAME ## _name[] PROGMEM = #NAME;		\
+static const char cmd_ ## NAME ## _args[] PROGMEM = ARGS;		\
+static const char cmd_ ## NAME ## _res[] PROGMEM = RES;			\
+static const struct CmdTemplate cmd_ ## NAME ## _template PROGMEM =	\
 {									\
-	#NAME, ARGS, RES, cmd_ ## NAME, FLAGS				\
+	cmd_ ## NAME ## _name, cmd_ ## NAME ## _args,			\
+	cmd_ ## NAME ## _res, cmd_ ## NAME, FLAGS			\
 };
 
 #define MAKE_CMD(NAME, ARGS, RES, BODY, FLAGS)				\
@@ -0,0 +1,50 @@
+/*
+ * The perfect hash table of the commands of ade/command.c
+ *
+ * Generated by ade/tools/cmdhash.py, DO NOT EDIT.
+ */
+
+#ifndef CMD_HASH_H
+#define CMD_HASH_H
+
+#define CMD_HASH_SEED 0x3A75
+#define CMD_HASH_MASK 0x3F
+
+#define CMD_HASH_SLOTS \
+	CMD_SLOT(  0, pc) \
+	CMD_SLOT(  1, fl) \
+	CMD_SLOT(  5, rs) \
+	CMD_SLOT(  6, gsm_reset) \
+	CMD_SLOT(  8, perf_reset) \
+	CMD_SLOT(  9, rg) \
+	CMD_SLOT( 10, fc) \
+	CMD_SLOT( 12, ping) \
+	CMD_SLOT( 15, test_sms) \
+	CMD_SLOT( 16, aa) \
+	CMD_SLOT( 17, in) \
+	CMD_SLOT( 19, vs) \
+	CMD_SLOT( 23, ip) \
+	CMD_SLOT( 25, gsm_off) \
+	CMD_SLOT( 26, ag) \
+	CMD_SLOT( 27, perf) \
+	CMD_SLOT( 28, ii) \
+	CMD_SLOT( 30, ac) \
+	CMD_SLOT( 33, ve) \
+	CMD_SLOT( 35, vc) \
+	CMD_SLOT( 36, am) \
+	CMD_SLOT( 37, vi) \
+	CMD_SLOT( 39, vg) \
+	CMD_SLOT( 41, sleep) \
+	CMD_SLOT( 43, gsm_on) \
+	CMD_SLOT( 44, vp) \
+	CMD_SLOT( 46, vn) \
+	CMD_SLOT( 47, ver) \
+	CMD_SLOT( 48, sc) \
+	CMD_SLOT( 51, ra) \
+	CMD_SLOT( 52, help) \
+	CMD_SLOT( 53, rc) \
+	CMD_SLOT( 55, dm) \
+	CMD_SLOT( 63, rst) \
+	/* end of slots */
+
+#endif /* CMD_HASH_H */
@@ -2,10 +2,18 @@
 #include "command.h"
 #include "control.h"
 #include "eeprom.h"
+#include "energy.h"
 #include "gsm.h"
+#include "journal.h"
+#include "perf.h"
+#include "scheduler.h"
 #include "signals.h"
+#include "smsq.h"
+#include "stack.h"
+#include "text.h"
 
-#include "cmd_ctor.h"  // MAKE_CMD, REGISTER_CMD
+#include "cmd_ctor.h"  // MAKE_CMD
+#include "cmd_hash.h"  // CMD_HASH_SLOTS
 #include "verstag.h"
 
 #include <drv/timer.h>
@@ -14,15 +22,48 @@
 
 #include <stdlib.h>
 #include <string.h>
-#include <stdio.h> // sprintf
 
 // Define logging settingl (for cfg/log.h module).
 #define LOG_LEVEL   LOG_LVL_INFO
 #define LOG_FORMAT  LOG_FMT_TERSE
 #include <cfg/log.h>
 
-/** The buffer for command responces SMS formatting */
-char cmdBuff[CMD_BUFFER_SIZE];
+/** The size of a reply, which could be segmented into more SMS */
+#define CMD_REPLY_SIZE (SMSQ_TEXT_MAX+1)
+
+/** The reply of the commands, concatenated for all the commands of an SMS */
+static char replyBuff[CMD_REPLY_SIZE];
+static text_t reply = TEXT_INIT(replyBuff);
+
+/** @brief Start the reply of a command, returning its mark */
+static uint16_t replyStart(void) {
+	// Separate the replies of the commands of the same SMS
+	if (text_len(&reply))
+		text_char(&reply, '\n');
+	return text_len(&reply);
+}
+
+/** @brief Empty the reply, e.g. before parsing the commands of an SMS */
+void command_replyReset(void) {
+	text_reset(&reply);
+}
+
+/** @brief Get the reply of the commands parsed since the last reset */
+const char *command_reply(void) {
+	return reply.buf;
+}
+
+/**
+ * @brief Get the (emptied) reply buffer, to format other messages
+ *
+ * The console process formats its notifications there, once the reply of the
+ * last commands has been queued.
+ */
+char *command_replyBuffer(uint16_t *size) {
+	text_reset(&reply);
+	*size = sizeof(replyBuff);
+	return replyBuff;
+}
 
 /*
  * Commands.
@@ -70,6 +111,9 @@ MAKE_CMD(rst, "", "",
 	(void)args;
 
 	LOG_INFO("\n\nReset in 2[s]...\n\n");
+	journal_add(EV_RESET, 0);
+	journal_flush();
+	ee_flush();
 	wdt_enable(WDTO_2S);
 
 	/*
@@ -124,26 +168,26 @@ MAKE_CMD(ip, "ddddddd", "",
 //----- CMD: SHOW INTERNAL PARAMETERS
 MAKE_CMD(vp, "", "s",
 ({
-	snprintf(cmdBuff, CMD_BUFFER_SIZE,
-		"Parametri:\n"
-		"S: %hu\n"
-		"R: %hu\n"
-		"T: %u\n"
-		"F: %lu\n"
-		"C: %hu\n"
-		"D: %hu\n"
-		"W: %hu\n",
-		ee_getFaultSamples(),
-		ee_getFaultChecks(),
-		ee_getFaultCheckTime(),
-		ee_getFaultLevel()/1000,
-		ee_getFlCalibrationDiv(),
-		ee_getFlDetectionDiv(),
-		ee_getCalibrationWeeks()
-	);
-
-	LOG_INFO("\n\n%s\r\n\n", cmdBuff);
-	args[1].s = cmdBuff;
+	uint16_t mark = replyStart();
+
+	text_lit(&reply, "Parametri:\nS: ");
+	text_uint(&reply, ee_getFaultSamples(), 0, 0);
+	text_lit(&reply, "\nR: ");
+	text_uint(&reply, ee_getFaultChecks(), 0, 0);
+	text_lit(&reply, "\nT: ");
+	text_uint(&reply, ee_getFaultCheckTime(), 0, 0);
+	text_lit(&reply, "\nF: ");
+	text_uint(&reply, ee_getFaultLevel()/1000, 0, 0);
+	text_lit(&reply, "\nC: ");
+	text_uint(&reply, ee_getFlCalibrationDiv(), 0, 0);
+	text_lit(&reply, "\nD: ");
+	text_uint(&reply, ee_getFlDetectionDiv(), 0, 0);
+	text_lit(&reply, "\nW: ");
+	text_uint(&reply, ee_getCalibrationWeeks(), 0, 0);
+	text_char(&reply, '\n');
+
+	args[1].s = text_from(&reply, mark);
+	LOG_INFO("\n\n%s\r\n\n", args[1].s);
 
 	RC_OK;
 }), 0)
@@ -175,21 +219,22 @@ MAKE_CMD(in, "t", "",
 //----- CMD: SHOW NOTIFICATION FLAGS
 MAKE_CMD(vn, "", "s",
 ({
- 	char space[] = " ";
-	char on[] = "ON";
-	char off[] = "OFF";
+	uint16_t mark = replyStart();
 
-	snprintf(cmdBuff, CMD_BUFFER_SIZE,
-		"Notifiche:\n"
-		"  Avvio: %7s%s\n"
-		"  Calibrazione: %s\n",
-		space,
-		ee_onNotifyReboot() ? on : off,
-		ee_onNotifyCalibration() ? on : off
-	);
+	text_lit(&reply, "Notifiche:\n  Avvio:        ");
+	if (ee_onNotifyReboot())
+		text_lit(&reply, "ON");
+	else
+		text_lit(&reply, "OFF");
+	text_lit(&reply, "\n  Calibrazione: ");
+	if (ee_onNotifyCalibration())
+		text_lit(&reply, "ON");
+	else
+		text_lit(&reply, "OFF");
+	text_char(&reply, '\n');
 
-	LOG_INFO("\n\n%s\r\n\n", cmdBuff);
-	args[1].s = cmdBuff;
+	args[1].s = text_from(&reply, mark);
+	LOG_INFO("\n\n%s\r\n\n", args[1].s);
 
 	RC_OK;
 }), 0)
@@ -244,21 +289,23 @@ MAKE_CMD(rg, "d", "",
 MAKE_CMD(vg, "", "s",
 ({
 	char buff[MAX_SMS_NUM];
-	uint8_t len = 0;
+	uint16_t mark = replyStart();
 
-	sprintf(cmdBuff, "Destinatari SMS: ");
+	text_lit(&reply, "Destinatari SMS: ");
 	for (uint8_t i=1; i<=MAX_SMS_DEST; i++) {
 		ee_getSmsDest(i, buff, MAX_SMS_NUM);
 
-		len = strlen(cmdBuff);
-		sprintf(cmdBuff+len, "\n%d) %s;", i, buff);
+		text_char(&reply, '\n');
+		text_uint(&reply, i, 0, 0);
+		text_lit(&reply, ") ");
+		text_str(&reply, buff);
+		text_char(&reply, ';');
 
 		DELAY(5);
 	}
 
-	LOG_INFO("\n\n%s\r\n\n", cmdBuff);
-
-	args[1].s = cmdBuff;
+	args[1].s = text_from(&reply, mark);
+	LOG_INFO("\n\n%s\r\n\n", args[1].s);
 
 	RC_OK;
 }), 0)
@@ -278,12 +325,15 @@ MAKE_CMD(ii, "t", "",
 MAKE_CMD(vi, "", "s",
 ({
 	char buff[MAX_MSG_TEXT];
+	uint16_t mark = replyStart();
 
 	ee_getSmsText(buff, MAX_MSG_TEXT);
-	sprintf(cmdBuff, "Identificazione: %s ", buff);
-	LOG_INFO("\n\n=> %s\r\n\n", cmdBuff);
+	text_lit(&reply, "Identificazione: ");
+	text_str(&reply, buff);
+	text_char(&reply, ' ');
 
-	args[1].s = cmdBuff;
+	args[1].s = text_from(&reply, mark);
+	LOG_INFO("\n\n=> %s\r\n\n", args[1].s);
 	RC_OK;
 }), 0)
 ;
@@ -306,6 +356,13 @@ static uint8_t parseChannelNumber(char const *buff) {
 	return ch;
 }
 
+/** @brief Reply that the \a ch channel does not exist */
+static void replyNoChannel(uint8_t ch) {
+	text_lit(&reply, "\r\nCH[");
+	text_uint(&reply, ch, 2, '0');
+	text_lit(&reply, "] non esistente\r\n");
+}
+
 
 /**
  * @brief Return the channel mask corresponding to the input string
@@ -496,29 +553,132 @@ MAKE_CMD(fl, "", "",
 MAKE_CMD(sc, "s", "s",
 ({
 	uint8_t ch;
-	int len = 0;
+	uint16_t mark;
 
 	LOG_INFO("\n\n<= Stato canale [%s]\r\n\n", args[1].s);
 
 	ch = parseChannelNumber(args[1].s);
+	mark = replyStart();
 	if (ch == 0 || ch > MAX_CHANNELS) {
-		len += sprintf(cmdBuff+len, "\r\nCH[%02d] non esistente\r\n", ch);
-		args[1].s = cmdBuff;
-		RC_OK;
+		replyNoChannel(ch);
+		args[1].s = text_from(&reply, mark);
+		// The BODY value is returned just at its end
+		return RC_OK;
 	}
 
 	// Scale channel number to array index
 	ch -= 1;
-	len += sprintf(cmdBuff+len, "\r\nStato CH%s(%02d):",
-			isCritical(ch) ? " CRITICO" : "", ch+1);
-	len += sprintf(cmdBuff+len, "\r\nPcal: %08ld, Prms: %08ld",
-		chData[ch].Pmax, chData[ch].Prms);
-
+	text_lit(&reply, "\r\nStato CH");
+	if (isCritical(ch))
+		text_lit(&reply, " CRITICO");
+	text_char(&reply, '(');
+	text_uint(&reply, ch+1, 2, '0');
+	text_lit(&reply, "):\r\nPcal: ");
+	text_uint(&reply, chData[ch].Pmax, 8, '0');
+	text_lit(&reply, ", Prms: ");
+	text_uint(&reply, chData[ch].Prms, 8, '0');
+	text_lit(&reply, "\r\nPavg: ");
+	text_uint(&reply, chData[ch].stats.mean, 8, '0');
+	text_lit(&reply, ", Pdev: ");
+	text_uint(&reply, chData[ch].stats.dev, 8, '0');
+#if CONFIG_CONTROL_STATS_PEAKS
+	text_lit(&reply, "\r\nPmin: ");
+	text_uint(&reply, chData[ch].stats.min, 8, '0');
+	text_lit(&reply, ", Pmax: ");
+	text_uint(&reply, chData[ch].stats.max, 8, '0');
+#endif
+	text_lit(&reply, "\r\nTmax: ");
+	if (sched_maxRevisit(ch) == SCHED_REVISIT_MAX)
+		text_char(&reply, '>');
+	text_uint(&reply, sched_maxRevisit(ch), 0, 0);
+	text_lit(&reply, " [ms], Peso: ");
+	text_uint(&reply, sched_weight(ch), 0, 0);
+
+	args[1].s = text_from(&reply, mark);
 	LOG_INFO("\n\n##### Report Stato CH #######\n"
 			"%s\n"
 			"#############################\n\n",
-			cmdBuff);
-	args[1].s = cmdBuff;
+			args[1].s);
+
+	RC_OK;
+}), 0)
+;
+
+//----- CMD: SET CHANNEL WEIGHT
+MAKE_CMD(pc, "dd", "s",
+({
+	long ch = args[1].l;
+	long weight = args[2].l;
+	uint16_t mark;
+
+	LOG_INFO("\n\n<= Peso canale [%ld]: %ld\r\n\n", ch, weight);
+
+	mark = replyStart();
+	if (ch < 1 || ch > MAX_CHANNELS) {
+		replyNoChannel(ch);
+	} else if (weight < 1 || weight > 0xFF) {
+		text_lit(&reply, "\r\nPeso non valido (1-255)\r\n");
+	} else {
+		sched_setWeight(ch-1, weight);
+		// The worst revisit latencies tracked so far are the ones of the
+		// old weights
+		sched_resetStats();
+
+		text_lit(&reply, "\r\nPeso CH");
+		text_uint(&reply, ch, 2, '0');
+		text_lit(&reply, ": ");
+		text_uint(&reply, weight, 0, 0);
+		text_lit(&reply, ", Tmax azzerati\r\n");
+	}
+
+	args[1].s = text_from(&reply, mark);
+	RC_OK;
+}), 0)
+;
+
+//----- CMD: SHOW CHANNEL ENERGY
+MAKE_CMD(vc, "s", "s",
+({
+	uint8_t ch;
+	uint16_t mark;
+
+	LOG_INFO("\n\n<= Consumi canale [%s]\r\n\n", args[1].s);
+
+	ch = parseChannelNumber(args[1].s);
+	mark = replyStart();
+	if (ch == 0 || ch > MAX_CHANNELS) {
+		replyNoChannel(ch);
+		args[1].s = text_from(&reply, mark);
+		// The BODY value is returned just at its end
+		return RC_OK;
+	}
+
+	// Scale channel number to array index
+	ch -= 1;
+	text_lit(&reply, "Consumi CH(");
+	text_uint(&reply, ch+1, 2, '0');
+#if CONFIG_ENERGY
+	text_lit(&reply, "):\r\nOra: ");
+	text_uint(&reply, energy_current(ch), 0, 0);
+	text_lit(&reply, "\r\nOre:");
+	for (uint8_t h = 0; h < 6; ++h) {
+		text_char(&reply, ' ');
+		text_uint(&reply, energy_hour(ch, h), 0, 0);
+	}
+	text_lit(&reply, "\r\nGiorni:");
+	for (uint8_t d = 0; d < CONFIG_ENERGY_DAYS; ++d) {
+		text_char(&reply, ' ');
+		text_uint(&reply, energy_day(ch, d), 0, 0);
+	}
+#else
+	text_lit(&reply, "): non disponibili");
+#endif
+
+	args[1].s = text_from(&reply, mark);
+	LOG_INFO("\n\n##### Report Consumi CH ######\n"
+			"%s\n"
+			"#############################\n\n",
+			args[1].s);
 
 	RC_OK;
 }), 0)
@@ -528,89 +688,130 @@ MAKE_CMD(sc, "s", "s",
 MAKE_CMD(rs, "", "s",
 ({
 	uint8_t csq = gsmCSQ();
-	volatile uint16_t mask;
-	uint8_t pos = 0;
-	int len = 0;
+	uint16_t mask;
+	uint16_t mark = replyStart();
 
-	len += sprintf(cmdBuff+len, "STATO ");
+	text_lit(&reply, "STATO ");
 	if (controlCriticalFaulted()) {
-		len += sprintf(cmdBuff+len, "LAMP");
+		text_lit(&reply, "LAMP");
 	} else if (controlGetFaultedMask() ||
 				signal_status(SIGNAL_UNIT_IRQ)) {
-		len += sprintf(cmdBuff+len, "GUAS");
+		text_lit(&reply, "GUAS");
 	} else if (controlIsCalibrating()) {
-		len += sprintf(cmdBuff+len, "CAL");
+		text_lit(&reply, "CAL");
 	} else if (controlMonitoringEnabled()) {
-		len += sprintf(cmdBuff+len, "OK");
+		text_lit(&reply, "OK");
 	} else {
-		len += sprintf(cmdBuff+len, "DIS");
+		text_lit(&reply, "DIS");
 	}
 
-	len += sprintf(cmdBuff+len, "\r\nCF");
+	text_lit(&reply, "\r\nCF");
 	mask = controlGetFaultedMask();
 	if (!mask)
-		len += sprintf(cmdBuff+len, " Nessuno");
-	for (pos = 1; mask && pos <= 16; ++pos, mask>>=1) {
-		//LOG_INFO("CF: 0x%04X\n", mask);
-		if (mask & BV16(0)) {
-			len += sprintf(cmdBuff+len, " %d", pos);
-		}
-	}
+		text_lit(&reply, " Nessuno");
+	text_bits(&reply, mask);
 
-	len += sprintf(cmdBuff+len, "\r\nGSM %d (", csq);
+	text_lit(&reply, "\r\nGSM ");
+	text_uint(&reply, csq, 0, 0);
 	if (csq == 0 || csq == 99)
-		len += sprintf(cmdBuff+len, "Scarso)");
+		text_lit(&reply, " (Scarso)");
 	else if (csq<=4)
-		len += sprintf(cmdBuff+len, "Basso)");
+		text_lit(&reply, " (Basso)");
 	else if (csq<=16)
-		len += sprintf(cmdBuff+len, "Buono)");
+		text_lit(&reply, " (Buono)");
 	else
-		len += sprintf(cmdBuff+len, "Ottimo)");
+		text_lit(&reply, " (Ottimo)");
 
-
-	len += sprintf(cmdBuff+len, "\r\nCA");
+	text_lit(&reply, "\r\nCA");
 	mask = controlEnabled();
 	if (!mask)
-		len += sprintf(cmdBuff+len, " Nessuno");
-	for (pos = 1; mask && pos<=16; ++pos, mask>>=1) {
-		//LOG_INFO("CA: 0x%04X\n", mask);
-		if (mask & BV16(0)) {
-			len += sprintf(cmdBuff+len, " %d", pos);
-		}
-	}
+		text_lit(&reply, " Nessuno");
+	text_bits(&reply, mask);
 
-	len += sprintf(cmdBuff+len, "\r\nCC");
+	text_lit(&reply, "\r\nCC");
 	mask = controlCritical();
 	if (!mask)
-		len += sprintf(cmdBuff+len, " Nessuno");
-	for (pos = 1; mask && pos <= 16; ++pos, mask>>=1) {
-		//LOG_INFO("CC: 0x%04X\n", mask);
-		if (mask & BV16(0)) {
-			len += sprintf(cmdBuff+len, " %d", pos);
-		}
-	}
+		text_lit(&reply, " Nessuno");
+	text_bits(&reply, mask);
 
+	args[1].s = text_from(&reply, mark);
 	LOG_INFO("\n\n##### Report Stato RFN #####\n"
 			"%s\n"
 			"#############################\n\n",
-			cmdBuff);
-	args[1].s = cmdBuff;
+			args[1].s);
 
 	RC_OK;
 }), 0)
 ;
 
 
+//----- CMD: SHOW EVENTS JOURNAL
+MAKE_CMD(ve, "d", "s",
+({
+	uint8_t count = args[1].l;
+	uint16_t mark;
+
+	LOG_INFO("\n\n<= Eventi [%hu]\r\n\n", count);
+
+	// Up to the last events fitting the reply
+	mark = replyStart();
+	journal_format(&reply, count ? count : 0xFF);
+
+	args[1].s = text_from(&reply, mark);
+	LOG_INFO("\n\n%s\r\n\n", args[1].s);
+
+	RC_OK;
+}), 0)
+;
+
 /*******************************************************************************
  * System Management Commands
  ******************************************************************************/
 
+//----- CMD: SHOW PERFORMANCE COUNTERS
+MAKE_CMD(perf, "", "s",
+({
+	uint16_t mark = replyStart();
+
+	LOG_INFO("\n\n<= Contatori prestazioni\r\n\n");
+	// The histograms buckets are just logged
+	perf_dump();
+	perf_format(&reply);
+
+	args[1].s = text_from(&reply, mark);
+	RC_OK;
+}), 0)
+;
+
+//----- CMD: RESET PERFORMANCE COUNTERS
+MAKE_CMD(perf_reset, "", "",
+({
+	(void)args;
+	LOG_INFO("\n\n<= Azzeramento contatori prestazioni\r\n\n");
+	perf_reset();
+	RC_OK;
+}), 0)
+;
+
+//----- CMD: SHOW MINIMUM FREE STACK
+MAKE_CMD(vs, "", "s",
+({
+	uint16_t mark = replyStart();
+
+	stack_format(&reply);
+
+	args[1].s = text_from(&reply, mark);
+	LOG_INFO("\n\n=> %s\r\n\n", args[1].s);
+	RC_OK;
+}), 0)
+;
+
 //----- CMD: GSM Power On
 MAKE_CMD(gsm_on, "", "",
 ({
 	(void)args;
 	LOG_INFO("\n\n<= Accensione GSM\r\n\n");
-	gsmPowerOn();
+	controlGsmRequest(GSM_REQ_ON);
 	RC_OK;
 }), 0)
 ;
@@ -620,7 +821,7 @@ MAKE_CMD(gsm_off, "", "",
 ({
 	(void)args;
 	LOG_INFO("\n\n<= Spegnimento GSM\r\n\n");
-	gsmPowerOff();
+	controlGsmRequest(GSM_REQ_OFF);
 	RC_OK;
 }), 0)
 ;
@@ -630,62 +831,50 @@ MAKE_CMD(gsm_reset, "", "",
 ({
 	(void)args;
 	LOG_INFO("\n\n<= Reset GSM\r\n\n");
-	gsmReset();
+	controlGsmRequest(GSM_REQ_RESET);
 	RC_OK;
 }), 0)
 ;
 
-/* Register commands.  */
+/*
+ * The commands table, in program memory.
+ * The slots are generated from the MAKE_CMD above by the cmd_hash.h rule of
+ * ade_user.mk, thus commands are just to be defined here.
+ */
+#define CMD_SLOT(SLOT, NAME) [SLOT] = &cmd_ ## NAME ## _template,
+static const struct CmdTemplate * const cmdSlots[CMD_HASH_MASK+1] PROGMEM = {
+	CMD_HASH_SLOTS
+};
+
+static const struct CmdTable cmdTable = {
+	cmdSlots, CMD_HASH_SEED, CMD_HASH_MASK
+};
+
 void command_init(void) {
+	parser_init(&cmdTable);
+}
 
-//----- System commands
-	REGISTER_CMD(ver);
-	REGISTER_CMD(sleep);
-	REGISTER_CMD(ping);
-	REGISTER_CMD(help);
-
-//----- Configuration commands
-	REGISTER_CMD(ag);
-	REGISTER_CMD(rg);
-	REGISTER_CMD(vg);
-	REGISTER_CMD(ii);
-	REGISTER_CMD(vi);
-	REGISTER_CMD(aa);
-	REGISTER_CMD(ra);
-	REGISTER_CMD(ac);
-	REGISTER_CMD(rc);
-	REGISTER_CMD(ip);
-	REGISTER_CMD(vp);
-	REGISTER_CMD(in);
-	REGISTER_CMD(vn);
-
-//----- Control commands
-	REGISTER_CMD(fc);
-	REGISTER_CMD(am);
-	REGISTER_CMD(dm);
-	REGISTER_CMD(sc);
-	REGISTER_CMD(rs);
-	REGISTER_CMD(fl);
-	REGISTER_CMD(rst);
-
-//----- System Management commands
-	REGISTER_CMD(test_sms);
-	REGISTER_CMD(gsm_on);
-	REGISTER_CMD(gsm_off);
-	REGISTER_CMD(gsm_reset);
+// Print a string kept on flash
+static void printStr_P(KFile *fd, const char *str) {
+	for (char c; (c = pgm_read8(str)); ++str)
+		kfile_putc(c, fd);
 }
+#define printStr(FD, STR) printStr_P((FD), PSTR(STR))
 
 /**
  * Send a NAK asking the host to send the current message again.
  *
  * \a fd kfile handler for serial.
- * \a err  human-readable description of the error for debug purposes.
+ * \a err  human-readable description of the error for debug purposes,
+ *         kept on flash.
  */
 INLINE void NAK(KFile *fd, const char *err) {
 #ifdef _DEBUG
-	kfile_printf(fd, "\nNAK \"%s\"\r\n", err);
+	printStr(fd, "\nNAK \"");
+	printStr_P(fd, err);
+	printStr(fd, "\"\r\n");
 #else
-	kfile_printf(fd, "\nNAK\r\n");
+	printStr(fd, "\nNAK\r\n");
 #endif
 }
 
@@ -713,26 +902,30 @@ INLINE void NAK(KFile *fd, const char *err) {
 
 void command_parse(KFile *fd, const char *buf) {
 
-	const struct CmdTemplate *templ;
+	struct CmdTemplate templ;
 	parms args[PARSER_MAX_ARGS];
-
-	/* Command check.  */
-	templ = parser_get_cmd_template(buf);
-	if (!templ) {
-		kfile_print(fd, "\n-1 Invalid command.\r\n");
+	PERF_START(parseAt);
+
+	/* Command and args check, in a single pass.  TODO: Handle different
+	 * case. see doc/PROTOCOL .  */
+	switch (parser_parse_cmd(buf, &templ, args)) {
+	case PARSE_OK:
+		break;
+	case PARSE_INVALID_CMD:
+		PERF_COUNT(PERF_CMD_INVALID);
+		printStr(fd, "\n-1 Invalid command.\r\n");
 		return;
-	}
-
-	/* Args Check.  TODO: Handle different case. see doc/PROTOCOL .  */
-	if (!parser_get_cmd_arguments(buf, templ, args)) {
-		kfile_print(fd, "\n-2 Invalid arguments.\r\n");
+	default:
+		PERF_COUNT(PERF_CMD_INVALID);
+		printStr(fd, "\n-2 Invalid arguments.\r\n");
 		return;
 	}
 
 	/* Execute. */
-	if(!parser_execute_cmd(templ, args)) {
-		NAK(fd, "Error in executing command.");
+	if(!parser_execute_cmd(&templ, args)) {
+		NAK(fd, PSTR("Error in executing command."));
 	}
+	PERF_STOP(PERF_PARSE, parseAt);
 
 	//if (!command_reply(fd, templ, args)) {
 	//	NAK(fd, "Invalid return format.");
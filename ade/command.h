@@ -6,9 +6,11 @@
 
 void command_init(void);
 void command_parse(KFile *fd, const char *buf);
+void command_replyReset(void);
+const char *command_reply(void);
+char *command_replyBuffer(uint16_t *size);
 
-/** The buffer defined by the GSM module */
+/** The size of an SMS text, including the terminator */
 #define CMD_BUFFER_SIZE 161
-extern char cmdBuff[CMD_BUFFER_SIZE];
 
 #endif /* end of include guard: COMMANDS_H */
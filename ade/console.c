@@ -2,8 +2,6 @@
 #include "console.h"
 #include "command.h"
 
-#include <mware/parser.h>
-
 // Define logging settingl (for cfg/log.h module).
 #define LOG_LEVEL   LOG_LVL_INFO
 #define LOG_FORMAT  LOG_FMT_TERSE
@@ -17,15 +15,18 @@ void console_run(KFile *fd) {
 	kfile_gets(fd, linebuf, CONSOLE_BUFFER_SIZE);
 	kfile_clearerr(fd);
 
-	if (linebuf[0]!='\0' && linebuf[0]!='#')
-		command_parse(fd, linebuf);
+	if (linebuf[0]=='\0' || linebuf[0]=='#')
+		return;
+
+	// Console replies are just logged
+	command_replyReset();
+	command_parse(fd, linebuf);
 }
 
 
-/* Initialization: readline context, parser and register commands.  */
+/* Initialization: readline context and parser commands.  */
 void console_init(KFile *fd) {
 	(void)fd;
-	parser_init();
 	command_init();
 }
 
@@ -24,7 +24,18 @@
 #include "console.h"
 #include "command.h"
 #include "eeprom.h"
+#include "energy.h"
+#include "journal.h"
+#include "line.h"
+#include "perf.h"
+#include "power.h"
+#include "presence.h"
+#include "sampler.h"
+#include "scheduler.h"
 #include "signals.h"
+#include "smsq.h"
+#include "stack.h"
+#include "text.h"
 #include "gsm.h"
 
 #include "hw/hw_led.h"
@@ -32,16 +43,21 @@
 #include <cfg/compiler.h>
 #include <cfg/macros.h>
 
+#include <cpu/power.h>
+
 #include <drv/timer.h>
 #include <drv/meter_ade7753.h>
 #include <drv/pca9555.h>
+#include <kern/msg.h>
+#include <kern/proc.h>
+#include <kern/signal.h>
 #include <mware/event.h>
 
 #include <struct/list.h>
 
 #include <avr/wdt.h>
 
-#include <stdio.h> // sprintf
+#include <string.h> // strlen, memset
 
 /* Define logging settings (for cfg/log.h module). */
 #define LOG_LEVEL   CONTROL_LOG_LEVEL
@@ -56,22 +72,76 @@
 //#define GSM(x)
 
 static void sms_task(iptr_t timer);
-static void cmd_task(iptr_t timer);
-static void readMeter(uint8_t ch);
+static void cmd_task(void);
+static void updateChannel(const sample_t *smp);
 static uint8_t sampleChannel(void);
 static uint8_t needCalibration(uint8_t ch);
 static void calibrate(uint8_t ch);
+static inline void chRecalibrate(uint8_t ch);
 static void resetCalibrationCountdown(void);
 
-static void notifyAllBySMS(const char *msg);
+static int8_t notifyAllBySMS(const text_t *msg);
+static void notifyFlush(void);
+static void notifyWake(void);
+static void notifyPost(uint16_t chs, uint8_t flags);
 static uint8_t chLoadLoss(uint8_t ch);
 static void chSetSuspendCountdown(void);
 static void chSetSpoiled(uint8_t ch);
 static uint8_t chCheckFault(uint8_t ch);
 static void monitor(uint8_t ch);
 
-// The list of timer shcedulated tasks
+// The list of timer shcedulated tasks, run by the sampling process
 List timers_lst;
+// The list of timer shcedulated tasks, run by the GSM process
+static List gsm_timers_lst;
+
+#if (ARCH & ARCH_EMUL)
+// The host libraries are stack hungry, see KERN_MINSTACKSIZE
+# define GSM_STACK_SIZE KERN_MINSTACKSIZE
+# define CMD_STACK_SIZE KERN_MINSTACKSIZE
+#else
+# define GSM_STACK_SIZE CONFIG_CONTROL_GSM_STACK
+# define CMD_STACK_SIZE CONFIG_CONTROL_CMD_STACK
+#endif
+
+// The stacks of the GSM and console processes, the sampling one runs on the
+// main stack
+static PROC_DEFINE_STACK(gsm_stack, GSM_STACK_SIZE)
+static PROC_DEFINE_STACK(cmd_stack, CMD_STACK_SIZE)
+
+// The pattern of the process stacks bytes never used
+#define PROC_STACK_FILL 0xA5
+
+// The free stack [bytes] of a process below which it is reported
+#define PROC_STACK_LOW 32
+
+// Go on tracking the stack of the current process, to tune its size
+static void checkProcStack(uint8_t id) {
+	if (stack_scan(id) && stack_minFree(id) < PROC_STACK_LOW)
+		LOG_WARN("Stack low [%hu]: %u free\r\n",
+				id, (unsigned)stack_minFree(id));
+}
+
+// The console process signals: its periodic activities, the commands
+// posted to its port and the notifications to be queued
+#define SIG_CMD_TICK   SIG_USER0
+#define SIG_CMD_POST   SIG_USER1
+#define SIG_CMD_NOTIFY SIG_USER2
+// The GSM process signal: the commands it posted have been run
+#define SIG_SMS_DONE SIG_USER0
+
+/** The commands of an SMS, posted to the console process */
+typedef struct smsCmds {
+	Msg msg;
+	const char *from;
+	const char *cmds;
+	uint8_t count;
+} smsCmds_t;
+
+// The port of the console process, which runs all the commands
+static MsgPort cmd_port;
+// The console process, formatting the notifications
+static struct Process *cmd_process;
 
 // The serial port used for console commands
 extern Serial dbg_port;
@@ -121,105 +191,77 @@ static void updateCSQ(void) {
 	// TODO if not network attached: force network scanning and attaching
 }
 
-int8_t controlNotifyBySMS(const char *dest, const char *buff) { 
-	int8_t result;
-	uint8_t try;
-	uint8_t timeout;
+/**
+ * @brief Queue an SMS for the specified destination
+ *
+ * The message is delivered in background by the SMS queue task, which
+ * waits for network availability without blocking the control loop.
+ */
+int8_t controlNotifyBySMS(const char *dest, const char *buff) {
+	int8_t result = OK;
 
 	LOG_INFO("Notify by SMS\nDest: %s\nText: %s\r\n", dest, buff);
 
-	// Checking for Network availability
-	try = 0; timeout = 10;
-	result = gsmRegisterNetwork();
-	while (result != OK) {
-		LOG_WARN("Network not available\r\n");
-		if (try % timeout) {
-			LOG_WARN("Trying again in 60s\r\n");
-			DELAY(60000);
-		} else {
-			// Resetting modem once every (10*timeout) mins
-			gsmPowerOn();
-			timeout += 10;
-			if (timeout >= 250)
-				timeout = 10;
-		}
-		result = gsmRegisterNetwork();
-		try++;
-	}
-	
-	// Checking for signal quality
-	try = 0; timeout = 20;
-	result = gsmUpdateCSQ();
-	while (result != OK ||
-			gsmCSQ() == 99 || gsmCSQ() == 0) {
-		LOG_WARN("Low network signal [%d]\r\n", gsmCSQ());
-		if (try % timeout) {
-			LOG_WARN("Trying again in 60s\r\n");
-			DELAY(60000);
-		} else {
-			// Resetting modem once every (20*timeout) mins
-			gsmPowerOn();
-			timeout += 20;
-			if (timeout >= 240)
-				timeout = 20;
-		}
-		result = gsmRegisterNetwork();
-		try++;
-	}
-
-	// Trying to send the SMS
-	result = 0;
-	GSM(result = gsmSMSSend(dest, buff));
+	GSM(result = smsq_send(dest, buff));
 	return result;
 }
-void smsSplitAndParse(char const *from, char *sms) {
-	char *cmd = sms;
-	char *cmdEnd = sms;
 
-	// Reset response buffer
-	cmdBuff[0] = '\0';
-
-	while (*cmdEnd) {
-		
-		// Find command separator, or end of SMS
-		for ( ; (*cmdEnd && *cmdEnd != ';'); ++cmdEnd)
-			;// nop
-		
-		// 
-		if (*cmdEnd == ';') {
-			*cmdEnd = '\0';
-		}
+// Run the (tokenized) SMS commands and reply to the sender
+static void smsRunCommands(char const *from, const char *cmds, uint8_t count) {
 
-		// lowercase current command
-		for (char *p = cmd; *p != ' ' && *p; ++p) {
-			if (*p >= 'A' && *p <= 'Z')
-				*p += 'a'-'A';
-		}
+	// Reset response buffer
+	command_replyReset();
 
-		//DB2(LOG_INFO("CMD: %s\r\n", cmd));
+	for ( ; count; --count) {
+		//DB2(LOG_INFO("CMD: %s\r\n", cmds));
 
 		// Parse current command
-		command_parse(&dbg_port.fd, cmd);
+		command_parse(&dbg_port.fd, cmds);
 
 		// Go on with next command
-		*cmdEnd = ';';
-		for ( ; *cmdEnd; ++cmdEnd) {
-			if ((*cmdEnd != ';') && (*cmdEnd != ' '))
-				break;
-		}
-		cmd = cmdEnd;
-
+		cmds += strlen(cmds) + 1;
 	}
 
 	// If a non empty buffer has been setup: send it as response
-	if (cmdBuff[0] == '\0')
+	if (command_reply()[0] == '\0')
 		return;
 
-	controlNotifyBySMS(from, cmdBuff);
+	controlNotifyBySMS(from, command_reply());
+
+}
+
+void smsSplitAndParse(char const *from, char *sms) {
+	gsmSMSTok_t tok;
+
+	// Tokenize in place: commands are never longer than the original text
+	gsmSMSTokInit(&tok, sms, MIN(strlen(sms)+1, (size_t)0xFF));
+	for (char *p = sms; *p; ++p)
+		gsmSMSTokPut(&tok, *p);
+	gsmSMSTokEnd(&tok);
 
-	// Wait for SMS being delivered
-	DELAY(10000);
+	smsRunCommands(from, sms, tok.count);
+}
 
+/**
+ * @brief Run the (tokenized) SMS commands by the console process
+ *
+ * The commands share the reply buffer with the console ones, thus they are
+ * serialized by the console process. The SMS buffer is released once they
+ * have been run.
+ */
+static void smsPostCommands(char const *from, const char *cmds, uint8_t count) {
+	smsCmds_t req;
+	MsgPort done;
+
+	msg_initPort(&done, event_createSignal(proc_current(), SIG_SMS_DONE));
+	req.msg.replyPort = &done;
+	req.from = from;
+	req.cmds = cmds;
+	req.count = count;
+	msg_put(&cmd_port, &req.msg);
+
+	sig_wait(SIG_SMS_DONE);
+	msg_get(&done);
 }
 
 // The countdown to GSM restat
@@ -227,51 +269,149 @@ void smsSplitAndParse(char const *from, char *sms) {
 		(uint32_t)GSM_RESTART_HOURES * 3600 / SMS_CHECK_SEC)
 static uint32_t gsmRestartCountdown = GSM_RESTART_COUNTDOWN;
 
-// The task to process SMS events
+// Retrive, delete and process the first SMS stored by the modem, if any
+static void smsReceive(void) {
+	int16_t index;
+	int8_t valid;
+
+	index = gsmSMSFirst();
+	if (index <= 0)
+		return;
+
+	// Flush SMS buffer
+	gsmBufferCleanup(&msg);
+
+	// Retrive the SMS into memory, it is kept on errors to be retried
+	valid = gsmSMSByIndex(&msg, index);
+	if (valid < 0)
+		return;
+
+	// Delete it before processing, thus commands (e.g. reset) are executed
+	// just once. Not valid messages are just deleted, since they would be
+	// listed again.
+	if (gsmSMSDel(index) != OK || !valid)
+		return;
+
+	// Process SMS commands, already tokenized while received
+	smsPostCommands(msg.from, msg.text, msg.cmds);
+}
+
+// Process the SMS announced by the modem, if any, one at each call
+static void smsCheckAnnounced(void) {
+	if (!gsmSMSAnnounced())
+		return;
+
+	smsReceive();
+}
+
+// The task to check GSM status and (not announced) SMS
 static void sms_task(iptr_t timer) {
 	//Silence "args not used" warning.
 	(void)timer;
-	int8_t smsIndex = 0;
 
 	DB(LOG_INFO("\r\nChecking SMS...\r\n"));
 
 	// Update signal level
 	GSM(updateCSQ());
 
-	// Flush SMS buffer
-	GSM(gsmBufferCleanup(&msg));
-
-	// Retrive the first SMS into memory
-	GSM(smsIndex = gsmSMSByIndex(&msg, 1));
-	if (smsIndex==1) {
-		command_parse(&dbg_port.fd, msg.text);
-		DELAY(500);
-		GSM(gsmSMSDel(1));
-	}
-
-	// Process SMS commands
-	smsSplitAndParse(msg.from, msg.text);
+	// Fallback polling of SMS not announced, e.g. received while the modem
+	// was resetting
+	GSM(smsReceive());
 
 	// Restart GSM at each countdown
 	if (--gsmRestartCountdown == 0) {
 		LOG_INFO("\r\nRestarting GSM...");
+		journal_add(EV_GSM_RESTART, 0);
 		GSM(gsmPowerOff());
 		gsmRestartCountdown = GSM_RESTART_COUNTDOWN;
 	}
 
 	// Reschedule this timer
-	synctimer_add(&sms_tmr, &timers_lst);
+	synctimer_add(&sms_tmr, &gsm_timers_lst);
+}
+
+//=====[ SMS queue handling ]===================================================
+
+// The timer to schedule the outgoing SMS delivery task
+Timer smsq_tmr;
+
+// The task to deliver queued SMS
+static void smsq_task(iptr_t timer) {
+	//Silence "args not used" warning.
+	(void)timer;
+
+	GSM(smsq_poll());
+	// Queue the notifications waiting for the delivery of the previous ones
+	notifyWake();
+
+	// Reschedule this timer
+	synctimer_add(&smsq_tmr, &gsm_timers_lst);
+}
+
+//=====[ GSM process ]==========================================================
+
+// The modem operations requested by the other processes
+static uint8_t gsmRequests = 0;
+
+/**
+ * @brief Request a modem operation to the GSM process
+ *
+ * The modem is driven only by the GSM process, thus other processes could
+ * not interleave their AT commands with the ones it is waiting for.
+ */
+void controlGsmRequest(uint8_t req) {
+	gsmRequests |= req;
+}
+
+// Run the modem operations requested by the other processes
+static void gsmServeRequests(void) {
+	uint8_t req = gsmRequests;
+
+	gsmRequests = 0;
+	if (req & GSM_REQ_OFF)
+		gsmPowerOff();
+	if (req & GSM_REQ_ON)
+		gsmPowerOn();
+	if (req & GSM_REQ_RESET)
+		gsmReset();
+}
+
+/**
+ * @brief The GSM process
+ *
+ * This waits for the modem, e.g. while it is powering on or delivering an
+ * SMS, without stalling the channels sampling.
+ */
+static void gsm_proc(void) {
+
+	// Power on the modem, the channels being sampled meanwhile
+	GSM(gsmPowerOn());
+	GSM(gsmSMSConf(0));
+	GSM(gsmSMSDelRead());
+	GSM(updateCSQ());
+
+	for (;;) {
+		GSM(gsmServeRequests());
+
+		// Schedule timer activities (SMS checking and delivery)
+		synctimer_poll(&gsm_timers_lst);
+
+		// Process modem notifications and announced SMS
+		GSM(gsmPoll());
+		GSM(smsCheckAnnounced());
+
+		checkProcStack(STACK_GSM);
+		timer_delay(GSM_POLL_MS);
+	}
 }
 
 //=====[ Console handling ]=====================================================
 
-// The timer to schedule Console handling task
+// The timer to tick the console process activities
 Timer cmd_tmr;
 // The evento to handle Console events
 Event cmd_evt;
 
-// Forward declaration
-extern uint16_t chSuspended;
 static uint16_t chResumeCountdown = 0;
 
 // The countdown to GSM restat
@@ -279,6 +419,13 @@ static uint16_t chResumeCountdown = 0;
 		(uint32_t)WEEKS * 604800 / CMD_CHECK_SEC)
 static uint32_t recalibrationCountdown;
 
+#if CONFIG_ENERGY
+// The time of the next energy profiles hour roll-up: a deadline, since the
+// console ticks are rescheduled once their activities are done
+#define ENERGY_HOUR_MS 3600000L
+static ticks_t energyRollAt;
+#endif
+
 static void resetCalibrationCountdown(void) {
 	uint8_t weeks = ee_getCalibrationWeeks();
 	// Try avoid misconfigured recaliations
@@ -287,11 +434,8 @@ static void resetCalibrationCountdown(void) {
 	recalibrationCountdown = CLB_COUNTDOWN(weeks);
 }
 
-// The task to process Console events
-static void cmd_task(iptr_t timer) {
-//static void cmd_task(struct Event *evt) {
-	//Silence "args not used" warning.
-	(void)timer;
+// The periodic activities of the console process
+static void cmd_task(void) {
 
 	//kprintf("Parse CMD\n");
 	//console_run((KFile*)(evt->Ev.Int.user_data));
@@ -299,10 +443,24 @@ static void cmd_task(iptr_t timer) {
 
 	// Reset suspended CHs mask
 	if (!chResumeCountdown)
-		chSuspended = 0x0000;
+		ch_clearAll(CH_SUSPENDED);
 	else
 		chResumeCountdown--;
 
+	// Commit configuration updates to EEPROM
+	ee_commit();
+
+	// Spill journal events to EEPROM
+	journal_poll();
+
+#if CONFIG_ENERGY
+	// Close the hour of the energy profiles
+	while ((long)(timer_clock() - energyRollAt) >= 0) {
+		energyRollAt += ms_to_ticks(ENERGY_HOUR_MS);
+		energy_rollHour();
+	}
+#endif
+
 	// Check for periodic re-calibration
 	recalibrationCountdown--;
 	if (!recalibrationCountdown) {
@@ -311,10 +469,70 @@ static void cmd_task(iptr_t timer) {
 		controlCalibration();
 	}
 
-	// Reschedule this timer
-	synctimer_add(&cmd_tmr, &timers_lst);
+	checkProcStack(STACK_CMD);
+}
+
+/**
+ * @brief The console process
+ *
+ * This runs the console and the SMS commands, which could wait (e.g. for
+ * the console output to flush) without stalling the channels sampling.
+ */
+static void cmd_proc(void) {
+	smsCmds_t *req;
+	sigmask_t sigs;
+
+	timer_setDelay(&cmd_tmr, ms_to_ticks(CMD_CHECK_SEC*1000));
+	timer_setSignal(&cmd_tmr, proc_current(), SIG_CMD_TICK);
+	timer_add(&cmd_tmr);
+
+	for (;;) {
+		sigs = sig_wait(SIG_CMD_TICK | SIG_CMD_POST | SIG_CMD_NOTIFY);
+
+		// Run the commands of the received SMS
+		if (sigs & SIG_CMD_POST) {
+			while ((req = (smsCmds_t *)msg_get(&cmd_port))) {
+				smsRunCommands(req->from, req->cmds, req->count);
+				msg_reply(&req->msg);
+			}
+		}
+
+		if (sigs & SIG_CMD_TICK) {
+			cmd_task();
+			timer_add(&cmd_tmr);
+		}
+
+		// Queue the notifications, once the commands have been replied
+		if (sigs & SIG_CMD_NOTIFY)
+			notifyFlush();
+	}
 }
 
+//=====[ Channels presence handling ]===========================================
+
+// The timer to schedule the channels presence tracking task
+Timer pre_tmr;
+
+// The task to track the powered-on channels
+static void presence_task(iptr_t timer) {
+	presence_chg_t chg;
+	//Silence "args not used" warning.
+	(void)timer;
+
+	if (presence_poll(&chg)) {
+		LOG_INFO("Active CHs [0x%04X] (on 0x%04X, off 0x%04X)\r\n",
+				presence_active(), chg.on, chg.off);
+
+		// Newly powered-on channels could have a different load
+		for (uint8_t ch = 0; chg.on; ++ch, chg.on >>= 1) {
+			if (chg.on & 0x1)
+				chRecalibrate(ch);
+		}
+	}
+
+	// Reschedule this timer
+	synctimer_add(&pre_tmr, &timers_lst);
+}
 
 //=====[ Button handling ]=====================================================
 
@@ -325,6 +543,9 @@ static void reset_board(void) {
 	// Shutdons all LEDs to notify reset
 	LED_NOTIFY_OFF();
 	LOG_INFO("Forced reset...\r\n");
+	journal_add(EV_RESET, 0);
+	journal_flush();
+	ee_flush();
 	wdt_enable(WDTO_2S);
 	while(1);
 }
@@ -347,6 +568,7 @@ static void btn_task(iptr_t timer) {
 			// Button pressed fot t > BTN_CHECK_SEC+BTN_RESET_SEC
 			reset_board();
 		}
+		WATCHDOG_RESET();
 		DELAY(100);
 	}
 
@@ -360,52 +582,16 @@ static void btn_task(iptr_t timer) {
 
 //=====[ Channels Data ]========================================================
 
-#define isEnabled(CH)         (chEnabled & BV16(CH))
-#define chUncalibrated(CH)    (chCalib & BV16(CH))
-#define chMarkUncalibrated(CH)(chCalib |= BV16(CH))
-#define chMarkCalibrated(CH)  (chCalib &= ~BV16(CH))
-#define CalibrationDone()     (!(chCalib & chEnabled))
-#define chGetMoreSamples(CH)  (chData[CH].calSamples)
-#define chMrkSample(CH)       (chData[CH].calSamples--)
-#define chRstSample(CH)        chData[CH].calSamples = ee_getFaultSamples()
-
-#define chSetIrms(CH, IRMS)   (chData[CH].Irms = IRMS)
-#define chSetImax(CH, IMAX)   (chData[CH].Imax = IMAX)
-#define chSetVrms(CH, VRMS)   (chData[CH].Vrms = VRMS)
-
-#define chSetVmax(CH, VMAX)   (chData[CH].Vmax = VMAX)
-#define chSetPrms(CH, PRMS)   (chData[CH].Prms = PRMS)
-#define chSetPmax(CH, PMAX)   (chData[CH].Pmax = PMAX)
-
-#define chGetIrms(CH)          chData[CH].Irms
-#define chGetVrms(CH)          chData[CH].Vrms
-#define chGetPrms(CH)          chData[CH].Prms
-
-#define chGetImax(CH)          chData[CH].Imax
-#define chGetVmax(CH)          chData[CH].Vmax
-#define chGetPmax(CH)          chData[CH].Pmax
-
-#define chSetAE(CH, AE)       (chData[CH].ae = AE)
-#define chIncLossy(CH)         chData[CH].lossySamples++
-#define chGetLossy(CH)         chData[CH].lossySamples
-#define chRstLossy(CH)         chData[CH].lossySamples = 0
-#define chLossy(CH)           (chData[CH].lossySamples)
-
-#define chIncChecks(CH)        chData[CH].lossyChecks++
-#define chGetChecks(CH)        chData[CH].lossyChecks
-#define chRstChecks(CH)        chData[CH].lossyChecks = 0
-#define chChecks(CH)          (chData[CH].lossyChecks)
-
-#define chMarkLossy(CH)       (chLossy |= BV16(CH))
-#define chMarkSpoiled(CH)     (chSpoiled |= BV16(CH))
-#define chMarkFaulted(CH)     (chFaulted |= BV16(CH))
-#define chMarkGood(CH)        (chLossy &= ~BV16(CH))
-#define chSuspend(CH)         (chSuspended |= BV16(CH))
-
-/** The minimum load loss to notify a FAULT */
-const double loadFault = ADE_PRMS_LOAD_FAULT/2;
-/** The minimum load variation for calibration  */
-const double minLoadVariation = ADE_PRMS_LOAD_FAULT/2;
+#define calibrationDone()    (!ch_mask(CH_ENABLED|CH_CALIB))
+
+// The number of stable samples required to complete a calibration, enough
+// for the moving mean to converge after a load step
+#define CAL_STABLE_SAMPLES (3*STATS_WINDOW)
+
+static inline void resetCalSamples(uint8_t ch) {
+	chData[ch].calSamples =
+		MIN(ee_getFaultSamples(), (uint8_t)CAL_STABLE_SAMPLES);
+}
 
 /** @brief The RFN running modes */
 typedef enum running_modes {
@@ -414,213 +600,146 @@ typedef enum running_modes {
 	MONITORING,
 } running_modes_t;
 
-/** The mask of channels to be monitored */
-uint16_t chEnabled = 0x0000;
-//#define ee_getEnabledChMask(V) ((uint16_t)0xFF00)
-//#warning MASKING ee_getEnabledChMask FORCING ENABLED CHANNELS (0xFF00)
-
-/** The mask of critical channels (which activiate AUX) */
-uint16_t chCritical = 0x0000;
-
-/** The mask of channels with fault samples */
-static uint16_t chLossy = 0x0000;
-
-/** The mask of channels in spoiled state */
-uint16_t chSpoiled = 0x0000;
-
-/** The mask of channels in fault state */
-uint16_t chFaulted = 0x0000;
-
-/** The mask of suspended channels */
-uint16_t chSuspended = 0x0000;
-
 /** @brief The current running mode */
 static running_modes_t rmode = CALIBRATION;
 
-/** @brief The mask of channels in calibration mode */
-uint16_t chCalib = 0xFFFF;
-
-/** The vector of channels data */
-chData_t chData[MAX_CHANNELS];
-
 /** Control flasg */
 uint8_t controlFlags = CF_MONITORING;
 
 //=====[ Channel Selection ]====================================================
 
-uint8_t chSelectionMap[] = {
-	0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01,
-	0x00, 0x0F, 0x0E, 0x0D, 0x0C, 0x0B, 0x0A, 0x09
-};
-
-/** @brief Get the bitmaks of powered-on channels */ 
-static inline uint16_t getActiveChannels(void) {
-	static uint16_t acm = 0x0000; // Active Channels Maks
-
-	// TODO put here the code to get powered on channels
-	// NOTE: this code is on the critical path, maybe we should exploit the
-	// I2C interrupt to handle updates just once required...
-	if (signal_pending(SIGNAL_PLAT_I2C)) {
-		pca9555_in(&i2c_bus, &pe, &acm);
-		acm = ~acm;
-		DB2(LOG_INFO("Active Channels: 0x%04X\r\n", acm));
-	}
-
-	return acm;
-}
-
-static inline void switchAnalogMux(uint8_t ch) {
-	// Set an invalid channel to force actual initialization at first call
-	static uint8_t prevAmuxCh = 0xFF;
-	uint8_t chSel;
-
-	// Avoid unnecessary switch if channel has not changed
-	if (ch == prevAmuxCh)
-		return;
-
-	prevAmuxCh = ch;
-	chSel  = (0xF0 & PORTA);
-	chSel |= chSelectionMap[ch];
-	PORTA  = chSel;
-
-	DB2(LOG_INFO("Switch Ch: %d => 0x%02X\r\n",
-				ch, chSelectionMap[ch]));
-
-	// Read one sample to trow away fauly ready from previous channel
-	readMeter(ch);
-
-}
-
-static inline void resetMeter(void) {
-
-	// Reset the meter
-	meter_ade7753_reset();
-
-	// Wait for a line cycle start
-	signal_wait(SIGNAL_ADE_ZX);
-
-	// Wait for a valid measure
-	DELAY(ADE_LINE_CYCLES_PERIOD
-			*ADE_LINE_CYCLES_SAMPLE_COUNT);
-}
+// The value returned by sampleChannel when no channels are active
+#define CH_NONE MAX_CHANNELS
+// The value returned by sampleChannel while a sample is being acquired
+#define CH_BUSY (MAX_CHANNELS+1)
 
 static inline void setPower(uint8_t ch) {
 #if CONFIG_MONITOR_POWER
 	// Compute RMS Power from V and I
-	chSetPrms(ch, (((double)chGetIrms(ch)*chGetVrms(ch))/100000));
+	chData[ch].Prms = power_rms(ch_irms(ch), ch_vrms(ch));
 #else
 #warning Monitoring RMS Current (Irms) only
 	// Compute RMS Power from V and I
 	// 230V => Vrms~=1M 
-	chSetPrms(ch, ((double)chGetIrms(ch)*10));
+	chData[ch].Prms = power_irms(ch_irms(ch));
 #endif
 }
 
-static void readMeter(uint8_t ch) {
-	static uint8_t prevAdeCh = 0xFF;
-
-	if (ch != prevAdeCh) {
-		prevAdeCh = ch;
-		resetMeter();
-	}
+/** @brief Update channel data with a completed sample */
+static void updateChannel(const sample_t *smp) {
+	uint8_t ch = smp->ch;
 
 	// TODO get Power value
-	chSetIrms(ch, meter_ade7753_Irms());
-	chSetVrms(ch, meter_ade7753_Vrms());
+	ch_setIrms(ch, smp->Irms);
+	ch_setVrms(ch, smp->Vrms);
 
 #if ADE_IRMS_OFFSET
 	// Fix Offset on Irms
-	if (chGetIrms(ch)<ADE_IRMS_OFFSET)
-		chSetIrms(ch) = 0;
+	if (ch_irms(ch)<ADE_IRMS_OFFSET)
+		ch_setIrms(ch, 0);
 	else
-		chSetIrms(ch) = chGetIrms(ch)-ADE_IRMS_OFFSET;
+		ch_setIrms(ch, ch_irms(ch)-ADE_IRMS_OFFSET);
 #endif
 
 	// Update the Power RMS value for this channel
 	setPower(ch);
+	stats_update(&chData[ch].stats, chData[ch].Prms);
+
+	// Account the energy of the accumulation
+	energy_update(ch, smp->Lae, timer_clock());
 
 #if CONFIG_CONTROL_TESTING
 	kprintf("CH: %02hd, Irms: %08ld, Vrms: %08ld, Prms: %4ld (%08ld)\r\n",
-			ch+1, chGetIrms(ch), chGetVrms(ch),
-			chGetPrms(ch)/ADE_PWR_RATIO, chGetPrms(ch));
+			ch+1, ch_irms(ch), ch_vrms(ch),
+			chData[ch].Prms/ADE_PWR_RATIO, chData[ch].Prms);
 	return;
 #endif
 
 
 #if CONFIG_CONTROL_DEBUG
 	DB(LOG_INFO("CH[%02hd] %c%c: Irms %08ld, Vrms %08ld => Prms %4ldW (%10ld)\r\n",
-				ch+1, chUncalibrated(ch) ? 'C' : 'M',
-				chLossy(ch) ? 'L' : 'S',
-				chGetIrms(ch), chGetVrms(ch),
-				chGetPrms(ch)/ADE_PWR_RATIO,
-				chGetPrms(ch)));
+				ch+1, ch_is(ch, CH_CALIB) ? 'C' : 'M',
+				chData[ch].lossySamples ? 'L' : 'S',
+				ch_irms(ch), ch_vrms(ch),
+				chData[ch].Prms/ADE_PWR_RATIO,
+				chData[ch].Prms));
 #else
 	DB(LOG_INFO("CH[%02hd] %c: %4ld [W]\r\n",
-				ch+1, chUncalibrated(ch) ? 'C' : 'M',
-				chGetPrms(ch)/ADE_PWR_RATIO));
+				ch+1, ch_is(ch, CH_CALIB) ? 'C' : 'M',
+				chData[ch].Prms/ADE_PWR_RATIO));
 #endif
 
 }
 
 static uint8_t curCh = MAX_CHANNELS-1;
-/** @brief Get a Power measure and return the measured channel */
-static uint8_t sampleChannel(void) {
-	uint16_t activeChs;
+/**
+ * @brief Select the next channel to sample
+ *
+ * @return 0 if there are not active channels, 1 otherwise
+ */
+static uint8_t selectChannel(void) {
+	sched_masks_t masks;
 
 	// Get powered on (and enabled) channels
-	activeChs = (getActiveChannels() & chEnabled & ~chSuspended);
-	if (!activeChs)
-		return MAX_CHANNELS;
-
-	// If some _active_ channels are in fault mode: focus just on them only
-	// This allows to reduce FAULTS DETECTION time perhaps also avoiding channel
-	// switching
-	if (chLossy &&
-			(activeChs & chLossy)) {
-		LOG_INFO("Lossy CHs [0x%02X]\r\n", chLossy);
-		activeChs &= chLossy;
-		// Remain on current channel if it is _active_ and _faulty_
-		if (activeChs & BV16(curCh))
-			goto sample;
-		// Switch to the next _active_ abd _faulty_ channel
-		goto select;
-	}
+	masks.active = (presence_active() & ch_mask(CH_ENABLED) &
+			~ch_mask(CH_SUSPENDED));
+	if (!masks.active)
+		return 0;
 
-	// If some _active_ channels are in calibration mode: focus just on them only
-	// This allows to reduce CALIBRATION time perhaps also avoiding channel
-	// switching
-	if (!CalibrationDone() &&
-			(activeChs & chCalib)) {
-		DB2(LOG_INFO("Uncalibrated CHs [0x%02X]\r\n", chCalib));
-		activeChs &= chCalib;
-		// Remain on current channel if it is _active_ and _uncalibrated_
-		if (activeChs & BV16(curCh))
-			goto sample;
-		// Switch to the next _active_ abd _uncalibrated_ channel
-		goto select;
+	masks.lossy = ch_mask(CH_LOSSY);
+	if (masks.active & masks.lossy)
+		LOG_INFO("Lossy CHs [0x%02X]\r\n", masks.lossy);
+
+	masks.calib = 0;
+	if (!calibrationDone()) {
+		masks.calib = ch_mask(CH_ENABLED|CH_CALIB);
+		DB2(LOG_INFO("Uncalibrated CHs [0x%02X]\r\n", masks.calib));
 	}
 
-select:
+	masks.critical = ch_mask(CH_CRITICAL);
 
-	// Select next active channel (max one single scan)
-	// TODO optimize selection considering the board schematic
-	for (uint8_t i = 0; i<MAX_CHANNELS; i++) {
-		curCh++;
-		if (curCh>15)
-			curCh=0;
-		if (BV16(curCh) & activeChs)
-			break;
-	}
+	curCh = sched_next(&masks, curCh);
 
-	// Switch the analog MUX
-	switchAnalogMux(curCh);
+	return 1;
+}
 
-sample:
+/**
+ * @brief Get a Power measure and return the measured channel
+ *
+ * This never blocks and it is pipelined: as soon as a sample is completed,
+ * the acquisition on the next channel is started, thus its settling time
+ * overlaps with the processing of the returned sample.
+ * CH_BUSY is returned while a sample is still being acquired.
+ */
+static uint8_t sampleChannel(void) {
+	uint8_t ch = CH_BUSY;
+	sample_t smp;
+
+	// Collect completed samples, if any
+	sampler_poll();
+	if (sampler_get(&smp) &&
+			// Discard samples of channels disabled in the meantime
+			ch_is(smp.ch, CH_ENABLED)) {
+		updateChannel(&smp);
+		sched_visited(smp.ch);
+		ch = smp.ch;
+	}
+
+	// Wait for the acquisition in progress
+	if (sampler_busy())
+		return ch;
 
-	// Read power from ADE7753 meter
-	readMeter(curCh);
+	// Start the acquisition on the next channel (switching the analog MUX if
+	// required)
+	if (selectChannel()) {
+		sampler_start(curCh);
+		return ch;
+	}
 
-	return curCh;
+	sampler_stop();
+	if (ch == CH_BUSY)
+		return CH_NONE;
+	return ch;
 }
 
 //=====[ Channel Calibration ]==================================================
@@ -629,7 +748,7 @@ sample:
 static inline uint8_t needCalibration(uint8_t ch) {
 
 	// Avoid loading of (disabled) channels
-	if (!isEnabled(ch))
+	if (!ch_is(ch, CH_ENABLED))
 		return 0;
 
 	// Abort if we are not on calibration mode
@@ -637,7 +756,7 @@ static inline uint8_t needCalibration(uint8_t ch) {
 		return 0;
 
 	// Check if this channel must be calibrated
-	if (chUncalibrated(ch))
+	if (ch_is(ch, CH_CALIB))
 		return 1;
 
 	// By default we assume calibration as completed
@@ -646,43 +765,82 @@ static inline uint8_t needCalibration(uint8_t ch) {
 
 static inline void chRecalibrate(uint8_t ch) {
 	// Avoid loading of (disabled) channels
-	if (!isEnabled(ch))
+	if (!ch_is(ch, CH_ENABLED))
 		return;
 	// Set required calibration points
-	chSetImax(ch, 0);
-	chSetVmax(ch, 0);
-	chSetPmax(ch, 0);
-	chSetIrms(ch, 0);
-	chSetVrms(ch, 0);
-	chSetPrms(ch, 0);
-	chMarkGood(ch);
-	chRstChecks(ch);
-	chRstLossy(ch);
-	chRstSample(ch);
-	chMarkUncalibrated(ch);
+	chData[ch].Pmax = 0;
+	ch_setIrms(ch, 0);
+	ch_setVrms(ch, 0);
+	chData[ch].Prms = 0;
+	ch_clear(ch, CH_LOSSY);
+	chData[ch].lossyChecks = 0;
+	chData[ch].lossySamples = 0;
+	resetCalSamples(ch);
+	ch_mark(ch, CH_CALIB);
+	ch_clear(ch, CH_RESTORED);
+	stats_reset(&chData[ch].stats);
+	chData[ch].noise = 0;
 }
 
 /** @brief Setup the (initial) calibration data for the specified channel */
 static void loadCalibrationData(uint8_t ch) {
-	// TODO we could save calibration data to EEPROM and recover them at each
-	// reboot... but right now we start with a dummy zero value.
-
 	// Avoid loading of (disabled) channels
-	if (!isEnabled(ch))
+	if (!ch_is(ch, CH_ENABLED))
 		return;
 
 	LOG_INFO("Loading calibration data CH[%02hd]\r\n", ch+1);
 	chRecalibrate(ch);
 }
 
+/** @brief Save the calibration data of the specified channel to EEPROM */
+static void saveCalibrationData(uint8_t ch) {
+	ee_cal_t cal;
+
+	// The current and voltage levels are kept on EEPROM only
+	cal.Pmax = chData[ch].Pmax;
+	cal.Imax = ch_irms(ch);
+	cal.Vmax = ch_vrms(ch);
+	cal.noise = chData[ch].noise;
+	cal.stamp = ticks_to_ms(timer_clock()) / 1000;
+
+	ee_setCalibration(ch, &cal);
+}
+
+/**
+ * @brief Restore the calibration data of the specified channel from EEPROM
+ *
+ * A channel with a valid snapshot is monitored straight away, while its
+ * calibration data are revalidated in background.
+ *
+ * @return 1 if the channel has been restored, 0 otherwise
+ */
+static uint8_t restoreCalibrationData(uint8_t ch) {
+	ee_cal_t cal;
+
+	if (!ch_is(ch, CH_ENABLED))
+		return 0;
+
+	if (ee_getCalibration(ch, &cal) != 0)
+		return 0;
+
+	LOG_INFO("Restoring calibration data CH[%02hd], %c(cal)=%08ld @%lus\r\n",
+			ch+1, CONFIG_MONITOR_POWER ? 'P' : 'I',
+			cal.Pmax, cal.stamp);
+
+	chData[ch].Pmax = cal.Pmax;
+	chData[ch].noise = cal.noise;
+	ch_clear(ch, CH_CALIB);
+	ch_mark(ch, CH_RESTORED);
+
+	return 1;
+}
+
 void controlSetEnabled(uint16_t mask) {
-	uint16_t chNew = (mask & (chEnabled ^ mask));
+	uint16_t chNew = (mask & ~ch_mask(CH_ENABLED));
 	
 	LOG_INFO("New ENABLED Channels 0x%04X\r\n", chNew);
 
-	chCalib &= mask; // Remove disabled CHs
-	chCalib |= chNew; // Newly enabled channels
-	chEnabled = mask;
+	ch_setMask(CH_ENABLED, mask);
 
 	// Load calibration data for new channels
 	for (uint8_t pos = 0; chNew && pos < 16; ++pos, chNew>>=1) {
@@ -697,63 +855,114 @@ void controlSetEnabled(uint16_t mask) {
 void controlCalibration(void) {
 
 	LOG_WARN("Forcing re-calibration\r\n\n");
+	journal_add(EV_CALIB, 0);
 
 	// Reset spoiled channels mask
 	controlFlags &= ~CF_SPOILED;
-	chSpoiled = 0x0000;
+	ch_clearAll(CH_SPOILED);
 
 	// Reset faulted channels mask
 	controlFlags &= ~CF_FAULTED;
-	chFaulted = 0x0000;
+	ch_clearAll(CH_FAULTED);
 
 	// Reset suspended channels mask
-	chSuspended = 0x0000;
+	ch_clearAll(CH_SUSPENDED);
+
+	// Drop calibration snapshots, new ones are saved on completion
+	ee_invalidateCalibrations();
 
 	for (uint8_t ch=0; ch<16; ch++) {
 		chRecalibrate(ch);
 	}
 }
 
-/** @brief Defines the calibration policy for each channel */
+/**
+ * @brief Get the noise band of the specified channel
+ *
+ * Load variations within this band are considered noise: it is a multiple of
+ * the measured load noise, but not lower than the calibration level.
+ */
+static inline chLoad_t chNoiseBand(chLoad_t noise) {
+	return stats_band(noise, ee_getCalibrationLevel());
+}
+
+/**
+ * @brief Defines the calibration policy for each channel
+ *
+ * The calibrated load is the moving mean of the channel load. The
+ * calibration completes after CAL_STABLE_SAMPLES samples without load steps,
+ * i.e. variations exceeding the noise band, which restart the mean from the
+ * new load. Since the noise band follows the measured noise, noisy channels
+ * do not restart their calibration forever.
+ */
 static void calibrate(uint8_t ch) {
+	stats_t *st = &chData[ch].stats;
 	chLoad_t var;
 
-	if (!chGetMoreSamples(ch) &&
-			chUncalibrated(ch)) {
-		// Mark channel as calibrated
-		DB(LOG_INFO("CH[%02hd] Calibration DONE, %c(cal,rms)=(%08ld,%08ld)\r\n",
-				ch+1, CONFIG_MONITOR_POWER ? 'P' : 'I',
-				chGetPmax(ch), chGetPrms(ch)));
-		chMarkCalibrated(ch);
+	// Track the load mean
+	chData[ch].Pmax = st->mean;
+
+	DB2(LOG_INFO("CH[%02hd] %c(cal,rms,dev)=(%08ld, %08ld, %08ld)...\r\n",
+			ch+1, CONFIG_MONITOR_POWER ? 'P' : 'I',
+			chData[ch].Pmax, chData[ch].Prms, st->dev));
+
+	// Restart calibration on load steps
+	if (chData[ch].Prms >= st->mean)
+		var = chData[ch].Prms-st->mean;
+	else
+		var = st->mean-chData[ch].Prms;
+	if (var > chNoiseBand(st->dev)) {
+		DB(LOG_INFO("CH[%02hd] Calibrating...\r\n", ch+1));
+		stats_restart(&chData[ch].stats, chData[ch].Prms);
+		chData[ch].Pmax = chData[ch].Prms;
+		resetCalSamples(ch);
 		return;
 	}
 
-	DB2(LOG_INFO("CH[%02hd] %c(cal,rms)=(%08ld, %08ld)...\r\n",
+	// Decrease calibration samples required
+	if (chData[ch].calSamples)
+		chData[ch].calSamples--;
+	if (chData[ch].calSamples || !stats_ready(st))
+		return;
+
+	// Mark channel as calibrated
+	DB(LOG_INFO("CH[%02hd] Calibration DONE, %c(cal,rms,dev)=(%08ld,%08ld,%08ld)\r\n",
 			ch+1, CONFIG_MONITOR_POWER ? 'P' : 'I',
-			chGetPmax(ch), chGetPrms(ch)));
+			chData[ch].Pmax, chData[ch].Prms, st->dev));
+	chData[ch].noise = st->dev;
+	ch_clear(ch, CH_CALIB);
+	journal_add(EV_CALIB_DONE, ch+1);
+	saveCalibrationData(ch);
+}
 
-	// Decrease calibration samples required
-	chMrkSample(ch);
+/**
+ * @brief Revalidate the restored calibration data of the specified channel
+ *
+ * The channel is already monitored on its restored load, which is only
+ * raised to follow load increases: load losses must still be detected.
+ * After the required calibration samples the data, and the noise measured
+ * meanwhile, are saved back.
+ */
+static void revalidate(uint8_t ch) {
+	const stats_t *st = &chData[ch].stats;
 
-	// Update load measure (by half of the variation)
-	if (chGetPmax(ch) >= chGetPrms(ch)) {
-		var = chGetPmax(ch)-chGetPrms(ch);
-		chGetPmax(ch) -= (var/2);
-	} else {
-		var = chGetPrms(ch)-chGetPmax(ch);
-		chGetPmax(ch) += (var/2);
-	}
+	if (!stats_ready(st))
+		return;
 
-	// Mark calibration if measure is too noise
-	if (var > (ee_getFaultLevel()/ee_getFlCalibrationDiv())) {
-		DB(LOG_INFO("CH[%02hd] Calibrating...\r\n", ch+1));
-		chData[ch].calSamples = ee_getFaultSamples();
-	}
+	if (st->mean > chData[ch].Pmax)
+		chData[ch].Pmax = st->mean;
 
-	// Keep track of others RMS values
-	chSetImax(ch, chGetIrms(ch));
-	chSetVmax(ch, chGetVrms(ch));
+	if (chData[ch].calSamples) {
+		chData[ch].calSamples--;
+		return;
+	}
 
+	DB(LOG_INFO("CH[%02hd] Revalidation DONE, %c(cal,rms,dev)=(%08ld,%08ld,%08ld)\r\n",
+			ch+1, CONFIG_MONITOR_POWER ? 'P' : 'I',
+			chData[ch].Pmax, chData[ch].Prms, st->dev));
+	ch_clear(ch, CH_RESTORED);
+	chData[ch].noise = MAX(chData[ch].noise, st->dev);
+	saveCalibrationData(ch);
 }
 
 //=====[ Channel Monitoring ]===================================================
@@ -763,107 +972,133 @@ static uint8_t chLoadLoss(uint8_t ch) {
 
 	// TODO we should consider increasing values, maybe to adapt the
 	// calibration to drift values, or new loads
-	if (chGetPrms(ch) >= chGetPmax(ch)) {
-		chMarkGood(ch);
-		chRstChecks(ch);
-		chRstLossy(ch);
+	if (chData[ch].Prms >= chData[ch].Pmax) {
+		ch_clear(ch, CH_LOSSY);
+		chData[ch].lossyChecks = 0;
+		chData[ch].lossySamples = 0;
 		return 0;
 	}
 
 	// Computing LOAD loss
-	loadLoss = chGetPmax(ch)-chGetPrms(ch);
-	if (loadLoss < (ee_getFaultLevel()/ee_getFlDetectionDiv())) {
-		chMarkGood(ch);
-		chRstChecks(ch);
-		chRstLossy(ch);
+	loadLoss = chData[ch].Pmax-chData[ch].Prms;
+	if (loadLoss < ee_getDetectionLevel() ||
+			loadLoss <= chNoiseBand(chData[ch].noise)) {
+		ch_clear(ch, CH_LOSSY);
+		chData[ch].lossyChecks = 0;
+		chData[ch].lossySamples = 0;
 		return 0;
 	}
 
 	// Faults detection
-	chMarkLossy(ch);
-	chIncLossy(ch);
+	ch_mark(ch, CH_LOSSY);
+	chData[ch].lossySamples++;
 
 	// Notify on FAULTS count overflows
-	if (chGetLossy(ch) >= ee_getFaultSamples())
+	if (chData[ch].lossySamples >= ee_getFaultSamples())
 		return 1;
 	
 	return 0;
 }
 
-static void notifyAllBySMS(const char *msg) {
-	char dst[MAX_SMS_NUM];
-
-	LOG_INFO("\r\nSMS:\r\n%s\r\n\n", msg);
-
-	for (uint8_t idx = 1; idx <= MAX_SMS_DEST; ++idx) {
-		ee_getSmsDest(idx, dst, MAX_SMS_NUM);
+// The longest notification: the identification text followed by the fault
+// of a critical channel, with its levels
+#if CONFIG_REPORT_FAULT_LEVELS
+# define NOTIFY_LEVELS_LEN \
+	(1 + 3*(sizeof("P: 4294967295 => 4294967295\r\n")-1))
+#else
+# define NOTIFY_LEVELS_LEN 0
+#endif
+#define NOTIFY_BUFFER_SIZE (MAX_MSG_TEXT + NOTIFY_LEVELS_LEN + \
+	sizeof("\r\nAnomalia: CH CRITICO(16)\r\nSemaforo: in LAMPEGGIO\r\n"))
+
+// The notifications are formatted into the commands reply buffer, and sent
+// as (segmented) SMS
+STATIC_ASSERT(NOTIFY_BUFFER_SIZE <= SMSQ_TEXT_MAX+1);
+
+// The notifications still to be queued, i.e. the faulted channels and the
+// other events
+static uint16_t notifyChs = 0;
+static uint8_t notifyFlags = 0;
+#define NOTIFY_UNIT_FAULT BV8(0)
+#define NOTIFY_CALIBRATED BV8(1)
+
+/** @brief Start a notification by the identification text */
+static void notifyStart(text_t *msg) {
+	char *buf;
+	uint16_t size;
+
+	buf = command_replyBuffer(&size);
+	text_init(msg, buf, size);
+	text_commit(msg, ee_getSmsText(text_end(msg), MAX_MSG_TEXT));
+}
 
-		// Jump disabled destination numbers
-		if (dst[0] != '+')
-			continue;
+static int8_t notifyAllBySMS(const text_t *msg) {
+	int8_t result = OK;
 
-		controlNotifyBySMS(dst, msg);
-	}
+	if (msg->truncated)
+		LOG_WARN("Notification truncated\r\n");
 
-	LOG_INFO("\n\n");
+	// Queue the message for all enabled destination numbers
+	GSM(result = smsq_broadcast(msg->buf));
+	if (result != OK)
+		return result;
 
-	// Wait for SMS being delivered
-	DELAY(10000);
+	LOG_INFO("\r\nSMS:\r\n%s\r\n\n", msg->buf);
+	return OK;
+}
 
+#if CONFIG_REPORT_FAULT_LEVELS
+/** @brief Append a fault level line, e.g. "P: 1000 => 10" */
+static void notifyLevel(text_t *msg, char name, uint32_t max, uint32_t rms) {
+	text_char(msg, name);
+	text_lit(msg, ": ");
+	text_uint(msg, max, 8, ' ');
+	text_lit(msg, " => ");
+	text_uint(msg, rms, 8, ' ');
+	text_lit(msg, "\r\n");
 }
+#endif
 
-static void notifyChFault(uint8_t ch) {
-	char *msg = cmdBuff;
-	uint8_t len = 0;
+static int8_t notifyChFault(uint8_t ch) {
+	text_t msg;
+#if CONFIG_REPORT_FAULT_LEVELS
+	ee_cal_t cal;
+#endif
 
 	// Format SMS message
-	len = ee_getSmsText(msg, MAX_MSG_TEXT);
-
-	len += snprintf(msg+len,
-			CMD_BUFFER_SIZE-len,
-			"\r\nAnomalia: CH%s(%hd)\r\nSemaforo: ",
-			isCritical(ch) ? " CRITICO" : "",
-			ch+1);
+	notifyStart(&msg);
+
+	text_lit(&msg, "\r\nAnomalia: CH");
+	if (isCritical(ch))
+		text_lit(&msg, " CRITICO");
+	text_char(&msg, '(');
+	text_uint(&msg, ch+1, 0, 0);
+	text_lit(&msg, ")\r\nSemaforo: ");
 	if (controlCriticalFaulted()) {
-		len += snprintf(cmdBuff+len,
-				CMD_BUFFER_SIZE-len,
-				"in LAMPEGGIO");
+		text_lit(&msg, "in LAMPEGGIO");
 	} else if (controlGetFaultedMask()) {
-		len += snprintf(cmdBuff+len,
-				CMD_BUFFER_SIZE-len,
-				"GUASTO");
+		text_lit(&msg, "GUASTO");
 	} else {
 		// This should never happens
-		len += snprintf(cmdBuff+len,
-				CMD_BUFFER_SIZE-len,
-				"RFN FAULT?");
+		text_lit(&msg, "RFN FAULT?");
 	}
 
 #if CONFIG_REPORT_FAULT_LEVELS
 #warning Reporting FAULTS LEVELS enabled
-	if (len+27 < CMD_BUFFER_SIZE) {
-		len += snprintf(msg+len,
-				CMD_BUFFER_SIZE-len,
-				"\r\n"
-				"P: %8ld => %8ld\r\n",
-				chData[ch].Pmax, chData[ch].Prms);
-	}
-	if (len+25 < CMD_BUFFER_SIZE) {
-		len += snprintf(msg+len,
-				CMD_BUFFER_SIZE-len,
-				"I: %8ld => %8ld\r\n",
-				chData[ch].Imax, chData[ch].Irms);
-	}
-	if (len+25 < CMD_BUFFER_SIZE) {
-		len += snprintf(msg+len,
-				CMD_BUFFER_SIZE-len,
-				"V: %8ld => %8ld\r\n",
-				chData[ch].Vmax, chData[ch].Vrms);
+	// The levels of a deferred notification could have been reset by the
+	// channel recalibration in the meantime
+	if (chData[ch].Pmax) {
+		text_lit(&msg, "\r\n");
+		notifyLevel(&msg, 'P', chData[ch].Pmax, chData[ch].Prms);
+		if (ee_getCalibration(ch, &cal) == 0) {
+			notifyLevel(&msg, 'I', cal.Imax, ch_irms(ch));
+			notifyLevel(&msg, 'V', cal.Vmax, ch_vrms(ch));
+		}
 	}
 #endif
 
 	// Send message by SMS to all enabled destination
-	notifyAllBySMS(msg);
+	return notifyAllBySMS(&msg);
 
 }
 
@@ -884,27 +1119,28 @@ static void chSetSuspendCountdown(void) {
 
 static void chSetSpoiled(uint8_t ch) {
 	// Suspend the channel until the next CHECK
-	chSuspend(ch);
+	ch_mark(ch, CH_SUSPENDED);
 	// Schedule channel resume resume
 	chSetSuspendCountdown();
 	// Mark the channel as spoiled
-	chMarkSpoiled(ch);
+	ch_mark(ch, CH_SPOILED);
+	journal_add(EV_SPOILED, ch+1);
 }
 
 static uint8_t chCheckFault(uint8_t ch) {
 
 	// Increas the fault CHECKS count
-	chIncChecks(ch);
+	chData[ch].lossyChecks++;
 
 	// Notify on CHECKS count overflows 
-	if (chGetChecks(ch) >= ee_getFaultChecks())
+	if (chData[ch].lossyChecks >= ee_getFaultChecks())
 		return 1;
 
 	// Mark this channel as spoiled
 	chSetSpoiled(ch);
 
 	// Reset Samples count for next check
-	chRstLossy(ch);
+	chData[ch].lossySamples = 0;
 
 	// Notify the channel is not yet in FAULT
 	return 0;
@@ -920,44 +1156,44 @@ static void monitor(uint8_t ch) {
 		return;
 
 	// Mark the channel as FAULTED
-	chMarkFaulted(ch);
+	ch_mark(ch, CH_FAULTED);
+	journal_add(EV_FAULTED, ch+1);
 
 	// Notify if a CRITICAL channel is faulted
-	LOG_INFO("Crit: 0x%04X, ch: %d\r\n", chCritical, ch);
-	if (chCritical & BV16(ch)) { //isCritical(ch)) {
+	LOG_INFO("Crit: 0x%04X, ch: %d\r\n", ch_mask(CH_CRITICAL), ch);
+	if (isCritical(ch)) {
 		controlNotifyFaulted();
 	}
 
 	// Fault detected
 	rmode = FAULT;
 	kprintf("\nWARN: Load loss on CH[%02hd] (%08ld => %08ld)\r\n",
-		ch+1, chGetPmax(ch), chGetPrms(ch));
+		ch+1, chData[ch].Pmax, chData[ch].Prms);
 
 	// Send SMS notification
-	notifyChFault(ch);
+	notifyPost(BV16(ch), 0);
 
 	// Mark channel for recalibration
 	chRecalibrate(ch);
 
 }
 
-static void notifyFault(void) {
-	char *msg = cmdBuff;
-	uint8_t len;
+static int8_t notifyFault(void) {
+	text_t msg;
 
 	// Format SMS message
-	len = ee_getSmsText(msg, MAX_MSG_TEXT);
-	sprintf(msg+len, "\r\nGuasto centralina RCT\r\n");
+	notifyStart(&msg);
+	text_lit(&msg, "\r\nGuasto centralina RCT\r\n");
 
 	// Send message by SMS to all enabled destination
-	notifyAllBySMS(msg);
+	return notifyAllBySMS(&msg);
 
 }
 
-static void buttonHandler(void) {
+static void buttonHandler(uint8_t level) {
 
 	// Button pressed
-	if (!signal_status(SIGNAL_PLAT_BUTTON)) {
+	if (!level) {
 		// Schedule timer task
 		synctimer_add(&btn_tmr, &timers_lst);
 		return;
@@ -969,68 +1205,121 @@ static void buttonHandler(void) {
 }
 
 static void checkSignals(void) {
-	// Check for UNIT IRQ
-	if (signal_pending(SIGNAL_UNIT_IRQ) &&
-			signal_status(SIGNAL_UNIT_IRQ)) {
-		// Notify only on transitionn to LOW value
-		notifyFault();
-	}
-	// Checking for BUTTON
-	if (signal_pending(SIGNAL_PLAT_BUTTON)) {
-		DB2(LOG_INFO("USR BUTTON [%d]\r\n\n",
-					signal_status(SIGNAL_PLAT_BUTTON)));
-		buttonHandler();
+	signal_evt_t evt;
+	uint8_t count;
+
+	while (signal_next(&evt)) {
+		switch (evt.sig) {
+		case SIGNAL_UNIT_IRQ:
+			// Just the transitions to HIGH value are queued
+			notifyPost(0, NOTIFY_UNIT_FAULT);
+			break;
+		case SIGNAL_PLAT_BUTTON:
+			DB2(LOG_INFO("USR BUTTON [%d]\r\n\n", evt.level));
+			buttonHandler(evt.level);
+			break;
+		case SIGNAL_ADE_ZX:
+			line_zx(evt.at);
+			break;
+		}
 	}
-}
 
-static void notifyCalibrationCompleted(void) {
-	char *msg = cmdBuff;
-	uint8_t len;
+	// Account the edges lost since the queue was full
+	for (count = signal_overruns(); count; --count)
+		PERF_COUNT(PERF_SIG_OVERRUN);
+}
 
-	if (!ee_onNotifyCalibration())
-		return;
+static int8_t notifyCalibrationCompleted(void) {
+	text_t msg;
 
 	// Format SMS message
-	len = ee_getSmsText(msg, MAX_MSG_TEXT);
-	len += sprintf(msg+len, "\nCalibrazione completata\nSemaforo ");
+	notifyStart(&msg);
+	text_lit(&msg, "\nCalibrazione completata\nSemaforo ");
 	if (controlCriticalSpoiled()) {
-		len += sprintf(cmdBuff+len, "in LAMPEGGIO");
+		text_lit(&msg, "in LAMPEGGIO");
 	} else if (controlGetSpoiledMask()) {
-		len += sprintf(cmdBuff+len, "GUASTO");
+		text_lit(&msg, "GUASTO");
 	} else if (controlMonitoringEnabled()) {
-		len += sprintf(cmdBuff+len, "in MONITORAGGIO");
+		text_lit(&msg, "in MONITORAGGIO");
 	} else {
-		len += sprintf(cmdBuff+len, "NON monitorato");
+		text_lit(&msg, "NON monitorato");
 	}
 
 	// Send message by SMS to all enabled destination
-	notifyAllBySMS(msg);
+	return notifyAllBySMS(&msg);
+
+}
+
+/**
+ * @brief Queue the pending notifications, as long as the SMS queue has room
+ *
+ * This runs on the console process, woken on each new notification and
+ * after each SMS queue update, thus the notifications are never lost while
+ * the queue is full: they just wait for the delivery of the previous
+ * messages. The texts are formatted when queued, thus a deferred
+ * notification reports the state of that time.
+ */
+static void notifyFlush(void) {
+	uint8_t ch;
+
+	if ((notifyFlags & NOTIFY_UNIT_FAULT) && notifyFault() != OK)
+		return;
+	notifyFlags &= ~NOTIFY_UNIT_FAULT;
+
+	for (ch = 0; notifyChs; ++ch) {
+		if (!(notifyChs & BV16(ch)))
+			continue;
+		if (notifyChFault(ch) != OK)
+			return;
+		notifyChs &= ~BV16(ch);
+	}
+
+	if ((notifyFlags & NOTIFY_CALIBRATED) &&
+			notifyCalibrationCompleted() != OK)
+		return;
+	notifyFlags &= ~NOTIFY_CALIBRATED;
+}
+
+/** @brief Notify the faults of the \a chs channels and the \a flags events */
+static void notifyPost(uint16_t chs, uint8_t flags) {
+	notifyChs |= chs;
+	notifyFlags |= flags;
 
+	notifyWake();
+}
+
+/** @brief Wake the console process up, if notifications are pending */
+static void notifyWake(void) {
+	if (notifyChs || notifyFlags)
+		sig_send(cmd_process, SIG_CMD_NOTIFY);
 }
 
 #if CONFIG_CONTROL_TESTING 
 # warning CONTROL TESTING ENABLED
 void NORETURN chsTesting(void) {
+	signal_evt_t evt;
+	sample_t smp;
 
 	LOG_INFO(".:: CHs Testing\r\n");
 
 	// Enabling all channels
-	chEnabled = 0xFFFF;
+	ch_setMask(CH_ENABLED, 0xFFFF);
 	// Starting from CH[0]
 	curCh = 0;
 
 	while(1) {
 
 		// Read power from ADE7753 meter
-		readMeter(curCh);
+		sampler_read(curCh, &smp);
+		updateChannel(&smp);
 
 		// Switch channel on Button push
-		if (signal_pending(SIGNAL_PLAT_BUTTON) &&
-				signal_status(SIGNAL_PLAT_BUTTON)) {
+		while (signal_next(&evt)) {
+			if (evt.sig != SIGNAL_PLAT_BUTTON || !evt.level)
+				continue;
 			curCh++;
 			if (curCh>15)
 				curCh=0;
-			switchAnalogMux(curCh);
 		}
 	}
 
@@ -1042,17 +1331,24 @@ void controlSetup(void) {
 
 	// Init list of synchronous timers
 	LIST_INIT(&timers_lst);
+	LIST_INIT(&gsm_timers_lst);
 
 	// Schedule SMS handling task
-	GSM(gsmSMSDelRead());
 	timer_setDelay(&sms_tmr, ms_to_ticks(SMS_CHECK_SEC*1000));
 	timer_setSoftint(&sms_tmr, sms_task, (iptr_t)&sms_tmr);
-	synctimer_add(&sms_tmr, &timers_lst);
+	synctimer_add(&sms_tmr, &gsm_timers_lst);
 
-	// Schedule Console handling task
-	timer_setDelay(&cmd_tmr, ms_to_ticks(CMD_CHECK_SEC*1000));
-	timer_setSoftint(&cmd_tmr, cmd_task, (iptr_t)&cmd_tmr);
-	synctimer_add(&cmd_tmr, &timers_lst);
+	// Schedule outgoing SMS delivery task
+	smsq_init();
+	timer_setDelay(&smsq_tmr, ms_to_ticks(SMSQ_POLL_MS));
+	timer_setSoftint(&smsq_tmr, smsq_task, (iptr_t)&smsq_tmr);
+	synctimer_add(&smsq_tmr, &gsm_timers_lst);
+
+	// Schedule channels presence tracking task
+	presence_init(&i2c_bus, &pe);
+	timer_setDelay(&pre_tmr, ms_to_ticks(PRESENCE_POLL_MS));
+	timer_setSoftint(&pre_tmr, presence_task, (iptr_t)&pre_tmr);
+	synctimer_add(&pre_tmr, &timers_lst);
 
 	// Setup Button handling task
 	timer_setDelay(&btn_tmr, ms_to_ticks(BTN_CHECK_SEC*1000));
@@ -1066,20 +1362,19 @@ void controlSetup(void) {
 	meter_ade7753_dumpConf();
 
 	// Get bitmask of enabled channels
-	chEnabled = ee_getEnabledChMask();
+	ch_setMask(CH_ENABLED, ee_getEnabledChMask());
 
 	// Get bitmask of enabled channels
-	chCritical = ee_getCriticalChMask();
+	ch_setMask(CH_CRITICAL, ee_getCriticalChMask());
 
 	// Enabling calibration only for enabled channels
-	chCalib = chEnabled;
+	ch_setMask(CH_CALIB, ee_getEnabledChMask());
 
-	// Setup channels calibration data
-	for (uint8_t ch=0; ch<16; ch++)
+	// Setup channels calibration data, resuming from saved snapshots
+	for (uint8_t ch=0; ch<16; ch++) {
 		loadCalibrationData(ch);
-
-	// Update signal level
-	GSM(updateCSQ());
+		restoreCalibrationData(ch);
+	}
 
 	// Setup Re-Calibration Weeks
 	resetCalibrationCountdown();
@@ -1087,9 +1382,25 @@ void controlSetup(void) {
 	// Enabling the watchdog for the control loop
 	WATCHDOG_ENABLE();
 
-	// Initi the analog MUX to current channel
-	switchAnalogMux(curCh);
+	// Initi the sampling engine and the channels scheduler
+	sampler_init();
+	line_init();
+	sched_init();
+	energy_init();
+#if CONFIG_ENERGY
+	energyRollAt = timer_clock() + ms_to_ticks(ENERGY_HOUR_MS);
+#endif
+
+	// Start the console and GSM processes, this one goes on sampling.
+	// Their stacks are filled to be tracked, the kernel monitor being off.
+	memset(cmd_stack, PROC_STACK_FILL, sizeof(cmd_stack));
+	memset(gsm_stack, PROC_STACK_FILL, sizeof(gsm_stack));
+	cmd_process = proc_new(cmd_proc, NULL, sizeof(cmd_stack), cmd_stack);
+	msg_initPort(&cmd_port, event_createSignal(cmd_process, SIG_CMD_POST));
+	proc_new(gsm_proc, NULL, sizeof(gsm_stack), gsm_stack);
 
+	stack_add(STACK_CMD, cmd_stack, sizeof(cmd_stack), PROC_STACK_FILL);
+	stack_add(STACK_GSM, gsm_stack, sizeof(gsm_stack), PROC_STACK_FILL);
 
 }
 
@@ -1103,12 +1414,12 @@ void controlLoop(void) {
 	WATCHDOG_RESET();
 
 	// Set device status led
-	if (CalibrationDone())
+	if (calibrationDone())
 		LED_ON();
 	else
 		LED_SWITCH();
 
-	// Schedule timer activities (SMS and Console checking)
+	// Schedule timer activities (channels presence and button checking)
 	synctimer_poll(&timers_lst);
 
 	// Checking for pending signals to serve
@@ -1116,17 +1427,22 @@ void controlLoop(void) {
 
 	// Select Channel to sample and get P measure
 	ch = sampleChannel();
-	if (ch==MAX_CHANNELS) {
+	if (ch==CH_BUSY) {
+		// Sample not yet available, meanwhile serve other activities
+		cpu_relax();
+		return;
+	}
+	if (ch==CH_NONE) {
 		// No channels enabled... avoid calibration/monitoring
-		if (chCalib) {
+		if (ch_mask(CH_CALIB)) {
 			DB(LOG_INFO("Idle (%s, Fault: 0x%04X, Cal: 0x%04X) %c\r",
 						controlMonitoringEnabled() ? "Mon" : "Dis",
-						chSpoiled,
-						chCalib, progress[i++%4]));
+						ch_mask(CH_SPOILED),
+						ch_mask(CH_CALIB), progress[i++%4]));
 		} else {
 			DB(LOG_INFO("Idle (%s, Fault: 0x%04X) %c\r",
 						controlMonitoringEnabled() ? "Mon" : "Dis",
-						chSpoiled,
+						ch_mask(CH_SPOILED),
 						progress[i++%4]));
 		}
 		DELAY(500);
@@ -1139,16 +1455,21 @@ void controlLoop(void) {
 		
 		// Check if all channels has been calibrated
 		// So that we can notify calibration completion (just one time)
-		if (!CalibrationDone())
+		if (!calibrationDone())
 			return;
 
 		// Notify calibration completion
 		LOG_INFO("\n\nCALIBRATION COMPLETED\r\n\n");
 		LED_ON();
-		notifyCalibrationCompleted();
+		if (ee_onNotifyCalibration())
+			notifyPost(0, NOTIFY_CALIBRATED);
 		return;
 	}
 
+	// Revalidate restored calibration data
+	if (ch_is(ch, CH_RESTORED))
+		revalidate(ch);
+
 	// Monitor the current channel
 	if (controlMonitoringEnabled())
 		monitor(ch);
@@ -24,12 +24,15 @@
 
 #include "console.h"
 
+#include "channel.h"
+
 #include "cfg/cfg_control.h"
 
 #include <io/kfile.h>
 
-// The time interval [s] for received SMS handling
-#define SMS_CHECK_SEC	30
+// The time interval [s] for received SMS fallback polling, new SMS are
+// otherwise handled as soon as announced by the modem
+#define SMS_CHECK_SEC	300
 
 // The time interval [h] for GSM restart
 #define GSM_RESTART_HOURES	24
@@ -37,6 +40,9 @@
 // The time interval [s] for console handling
 #define CMD_CHECK_SEC	 1
 
+// The time interval [ms] for modem notifications polling, by the GSM process
+#define GSM_POLL_MS	 10
+
 // The time interval [s] for console handling
 #define CH_SUSPEND_SEC	 60
 
@@ -46,13 +52,21 @@
 // The time interval [s] for reset button handling
 #define BTN_RESET_SEC	 5
 
-// Line cycle period [ms]
+// Nominal line cycle period [ms], the actual one is tracked by line.h
 // Power line @50Hz => 1 cycles = 20ms
 #define ADE_LINE_CYCLES_PERIOD 20
 
 // The number of line cycles to wait before getting a sample
 #define ADE_LINE_CYCLES_SAMPLE_COUNT 16
 
+// The settling time [line cycles] of the analog MUX (and meter front-end)
+// after a channel switch, before a valid accumulation could be started
+#define ADE_AMUX_SETTLE_CYCLES 2
+
+// The time [us] an accumulation is armed before the line zero-crossing it
+// should start from
+#define ADE_ARM_LEAD_US 1000
+
 // The Irms offset
 #define ADE_IRMS_OFFSET 0
 
@@ -65,32 +79,12 @@
 #define ADE_IRMS_LOAD_FAULT 3000l
 
 // The P LOAD FAULT level
-#define ADE_PRMS_LOAD_FAULT 160000.0
+#define ADE_PRMS_LOAD_FAULT 160000l
 
 // The Load FAULT sensitivity factor (power of 2)
 #define ADE_LOAD_CALIBRATION_FACTOR 1
 
 
-// The maximum number of channels
-#define MAX_CHANNELS 16
-
-/** The CHs load value */
-typedef uint32_t chLoad_t;
-
-typedef struct chData {
-	uint32_t Irms;
-	uint32_t Vrms;
-	chLoad_t Prms;
-	uint32_t Imax;
-	uint32_t Vmax;
-	chLoad_t Pmax;
-	uint8_t calSamples;
-	uint8_t lossyChecks;
-	uint8_t lossySamples;
-} chData_t;
-
-extern chData_t chData[MAX_CHANNELS];
-
 
 
 
@@ -116,10 +110,9 @@ inline uint8_t controlMonitoringEnabled(void) {
 	return (controlFlags & CF_MONITORING);
 }
 
-extern uint16_t chSpoiled;
 inline uint16_t controlGetSpoiledMask(void);
 inline uint16_t controlGetSpoiledMask(void) {
-	return chSpoiled;
+	return ch_mask(CH_SPOILED);
 }
 
 inline uint8_t controlCriticalSpoiled(void);
@@ -127,10 +120,9 @@ inline uint8_t controlCriticalSpoiled(void) {
 	return (controlFlags & CF_SPOILED);
 }
 
-extern uint16_t chFaulted;
 inline uint16_t controlGetFaultedMask(void);
 inline uint16_t controlGetFaultedMask(void) {
-	return chFaulted;
+	return ch_mask(CH_FAULTED);
 }
 
 inline uint8_t controlCriticalFaulted(void);
@@ -140,33 +132,30 @@ inline uint8_t controlCriticalFaulted(void) {
 
 void controlSetEnabled(uint16_t mask);
 
-extern uint16_t chEnabled;
 inline uint16_t controlEnabled(void);
 inline uint16_t controlEnabled(void) {
-	return chEnabled;
+	return ch_mask(CH_ENABLED);
 }
 
-extern uint16_t chCalib;
 inline uint8_t controlIsCalibrating(void);
 inline uint8_t controlIsCalibrating(void) {
-	if (chCalib & chEnabled)
+	if (ch_mask(CH_ENABLED|CH_CALIB))
 		return 1;
 	return 0;
 }
 
 
-extern uint16_t chCritical;
 inline void controlSetCritical(uint16_t mask);
 inline void controlSetCritical(uint16_t mask) {
-	chCritical = mask;
+	ch_setMask(CH_CRITICAL, mask);
 }
 inline uint16_t controlCritical(void);
 inline uint16_t controlCritical(void) {
-	return chCritical;
+	return ch_mask(CH_CRITICAL);
 }
 inline uint8_t isCritical(uint8_t ch);
 inline uint8_t isCritical(uint8_t ch) {
-	if (chCritical & BV16(ch))
+	if (ch_is(ch, CH_CRITICAL))
 		return 1;
 	return 0;
 }
@@ -178,6 +167,12 @@ void smsSplitAndParse(char const *from, char *sms);
 
 int8_t controlNotifyBySMS(const char *dest, const char *buff);
 
+// The modem operations requested to the GSM process, which owns the modem
+#define GSM_REQ_ON 			0x01
+#define GSM_REQ_OFF 		0x02
+#define GSM_REQ_RESET 		0x04
+void controlGsmRequest(uint8_t req);
+
 #if CONFIG_CONTROL_TESTING 
 void NORETURN chsTesting(void);
 #else
@@ -5,8 +5,12 @@
 
 #include <avr/eeprom.h>
 
+#include <algo/crc.h>
+#include <cfg/macros.h>
 #include <drv/timer.h>
 
+#include <stddef.h> // offsetof
+
 /* Define logging settings (for cfg/log.h module). */
 #define LOG_LEVEL   LOG_LVL_INFO
 #define LOG_FORMAT  LOG_FMT_TERSE
@@ -22,64 +26,131 @@ eeprom_conf_t EEMEM eeconf = {
 	.sms_mesg =
 			"Impianto RCT non configurato\0DEADBEEFDEADBEEFDEADB"
 			"EEFDEADBEEFDEADBEEFDEADBEEFDEADBEEFDEADBEEFDEADBE\0",
-	.enabledChannelsMask = 0x0000,
-	.criticalChannelsMask = 0x0000,
+	.p = {
+		.enabledChannelsMask = 0x0000,
+		.criticalChannelsMask = 0x0000,
 
-	.faultSamples = CONFIG_FAULT_SAMPLES,
-	.faultChecks = CONFIG_FAULT_CHECKS,
-	.faultCheckTime = CONFIG_FAULT_CHECK_TIME,
+		.faultSamples = CONFIG_FAULT_SAMPLES,
+		.faultChecks = CONFIG_FAULT_CHECKS,
+		.faultCheckTime = CONFIG_FAULT_CHECK_TIME,
 
-	.faultLevel = (uint32_t)1000 * CONFIG_FAULT_LEVEL,
-	.flCalibrationDiv = 8,
-	.flDetectionDiv = 2,
+		.faultLevel = (uint32_t)1000 * CONFIG_FAULT_LEVEL,
+		.flCalibrationDiv = 8,
+		.flDetectionDiv = 2,
 
-	.calibWeeks = CONFIG_CALIBRATION_WEEKS,
+		.calibWeeks = CONFIG_CALIBRATION_WEEKS,
 
-	.notifyFlags = BV8(EE_NOTIFY_CALIBRATION),
+		.notifyFlags = BV8(EE_NOTIFY_CALIBRATION),
+	},
 };
 
-// The on RAM configuration (for run-time use)
-runtime_conf_t rt_conf;
+// The on EEPROM channels calibration snapshots
+ee_cal_t EEMEM eecal[EE_CAL_CHANNELS][EE_CAL_SLOTS];
+
+// The current calibration epoch, snapshots of other epochs are stale
+uint8_t EEMEM eecalEpoch = 0;
+
+// The on RAM copy of the calibration epoch
+static uint8_t calEpoch;
+
+// The number of on EEPROM configuration images
+#define EE_IMG_SLOTS 2
+
+/**
+ * An on EEPROM configuration image
+ *
+ * Images are written alternatively on EE_IMG_SLOTS slots, the valid one with
+ * the higher sequence number being the current configuration. Thus, a power
+ * loss while committing never corrupts the previous configuration.
+ */
+typedef struct eeprom_image {
+	uint8_t seq;
+	eeprom_conf_t conf;
+	/** The CRC16 of the sequence number and the configuration */
+	uint16_t crc;
+} eeprom_image_t;
+
+// The on EEPROM configuration images, eeconf being the factory defaults (and
+// the configuration of previous firmware versions). Slots are programmed as
+// not valid, since the CRC16 of an all zeros image is zero.
+eeprom_image_t EEMEM eeimg[EE_IMG_SLOTS] = {
+	[0 ... EE_IMG_SLOTS-1] = { .crc = 0xFFFF },
+};
+
+// The slot and sequence number of the last committed image
+static uint8_t imgSlot = EE_IMG_SLOTS-1;
+static uint8_t imgSeq = 0;
+
+// The on RAM configuration parameters (for run-time use)
+static eeprom_params_t rt_conf;
 
 // Pointer to on RAM configuration (for optimized access)
-runtime_conf_t *pConf = &rt_conf;
-
-//static int8_t ee_setBytes(uint8_t *eep, const uint8_t *buf, uint8_t size) {
-//	uint8_t i;
-//	for (i=0; i<size; i++) {
-//		eeprom_update_byte(eep, (*buf));
-//		buf++; eep++;
-//	}
-//	return i;
-//}
-//
-//static int8_t ee_getBytes(const uint8_t *eep, uint8_t *buf, uint8_t size) {
-//	uint8_t i;
-//	for (i=0; i<size; i++) {
-//		(*buf) = eeprom_read_byte(eep);
-//		buf++; eep++;
-//	}
-//	return i;
-//}
-
-static int8_t ee_setString(uint8_t *eep, const char *str, uint8_t size) {
+eeprom_params_t *pConf = &rt_conf;
+
+// The on EEPROM configuration the strings are read from, the slot of the next
+// image once a string update has been staged there
+static eeprom_conf_t *eeStrings = &eeconf;
+
+// The size of the strings leading the configuration
+#define EE_STRINGS_SIZE offsetof(eeprom_conf_t, p)
+
+// Set when the on RAM configuration must be committed
+static uint8_t confDirty = 0;
+// The time of the last configuration update
+static ticks_t confDirtyAt;
+
+// The fault levels scaled by their dividers, updated with the configuration
+static uint32_t calibrationLevel;
+static uint32_t detectionLevel;
+
+#define ee_update(FIELD, VALUE) \
+	do { \
+		if (pConf->FIELD != (VALUE)) { \
+			pConf->FIELD = (VALUE); \
+			ee_touch(); \
+		} \
+	} while (0)
+
+static inline void ee_touch(void) {
+	confDirty = 1;
+	confDirtyAt = timer_clock();
+}
+
+static void ee_updateLevels(void) {
+	// Zero dividers are taken as 1
+	calibrationLevel = pConf->faultLevel / MAX(pConf->flCalibrationDiv, (uint8_t)1);
+	detectionLevel = pConf->faultLevel / MAX(pConf->flDetectionDiv, (uint8_t)1);
+}
+
+static uint8_t *ee_imgStage(void);
+
+/**
+ * @brief Stage a string update, committed with the configuration parameters
+ *
+ * The string is written, up to its terminator, on the slot of the next image,
+ * thus replacing the previous image. The current image is left untouched
+ * until the commit, which validates the staged strings.
+ */
+static int8_t ee_setString(uint8_t off, const char *str, uint8_t size) {
+	uint8_t *dst = ee_imgStage() + off;
 	uint8_t i;
+
 	for (i=0; i<size; i++) {
-		eeprom_update_byte(eep, (uint8_t)(*str));
-		if (*str=='\0')
+		eeprom_update_byte(dst + i, str[i]);
+		if (str[i]=='\0')
 			break;
-		str++; eep++;
 	}
+	ee_touch();
 	return i;
 }
 
-static int8_t ee_getString(const uint8_t *eep, char *str, uint8_t size) {
+static int8_t ee_getString(const char *src, char *str, uint8_t size) {
 	uint8_t i;
 	for (i=0; i<size; i++) {
-		(*str) = eeprom_read_byte(eep);
+		(*str) = eeprom_read_byte((const uint8_t *)src);
 		if (*str=='\0')
 			break;
-		str++; eep++;
+		str++; src++;
 	}
 	return i;
 }
@@ -92,8 +163,7 @@ int8_t ee_getSmsDest(uint8_t pos, char *num, uint8_t count) {
 	if (count>MAX_SMS_NUM)
 		count=MAX_SMS_NUM;
 
-	return  ee_getString((const uint8_t*)eeconf.sms_dest[pos-1],
-							num, count);
+	return  ee_getString(eeStrings->sms_dest[pos-1], num, count);
 
 }
 
@@ -103,8 +173,8 @@ int8_t ee_setSmsDest(uint8_t pos, const char *num) {
 	if (pos > MAX_SMS_DEST)
 		return -1;
 
-	return ee_setString((uint8_t*)eeconf.sms_dest[pos-1],
-							num, MAX_SMS_NUM);
+	return ee_setString(offsetof(eeprom_conf_t, sms_dest) +
+			(pos-1)*MAX_SMS_NUM, num, MAX_SMS_NUM);
 
 }
 
@@ -115,37 +185,30 @@ int8_t ee_getSmsText(char *buf, uint8_t count) {
 	if (count>MAX_MSG_TEXT)
 		count=MAX_MSG_TEXT;
 
-	return  ee_getString((const uint8_t*)eeconf.sms_mesg,
-							buf, count);
+	return  ee_getString(eeStrings->sms_mesg, buf, count);
 }
 
 int8_t ee_setSmsText(const char *buf) {
 
-	return ee_setString((uint8_t*)eeconf.sms_mesg,
-							buf, MAX_MSG_TEXT);
+	return ee_setString(offsetof(eeprom_conf_t, sms_mesg),
+			buf, MAX_MSG_TEXT);
 
 }
 
 void ee_setEnabledChMask(uint16_t chMask) {
-	eeprom_update_word(
-			(uint16_t*)&eeconf.enabledChannelsMask,
-			chMask);
+	ee_update(enabledChannelsMask, chMask);
 }
 
 int16_t ee_getEnabledChMask(void) {
-	return eeprom_read_word(
-			(uint16_t*)&eeconf.enabledChannelsMask);
+	return pConf->enabledChannelsMask;
 }
 
 void ee_setCriticalChMask(uint16_t chMask) {
-	eeprom_update_word(
-			(uint16_t*)&eeconf.criticalChannelsMask,
-			chMask);
+	ee_update(criticalChannelsMask, chMask);
 }
 
 int16_t ee_getCriticalChMask(void) {
-	return eeprom_read_word(
-			(uint16_t*)&eeconf.criticalChannelsMask);
+	return pConf->criticalChannelsMask;
 }
 
 
@@ -159,10 +222,7 @@ uint8_t  ee_getFaultSamples(void) {
 }
 
 void     ee_setFaultSamples(uint8_t fSamples) {
-	eeprom_update_byte(
-			(uint8_t*)&eeconf.faultSamples,
-			fSamples);
-	pConf->faultSamples = fSamples;
+	ee_update(faultSamples, fSamples);
 }
 
 
@@ -171,10 +231,7 @@ uint8_t  ee_getFaultChecks(void) {
 }
 
 void     ee_setFaultChecks(uint8_t fChecks) {
-	eeprom_update_byte(
-			(uint8_t*)&eeconf.faultChecks,
-			fChecks);
-	pConf->faultChecks = fChecks;
+	ee_update(faultChecks, fChecks);
 }
 
 
@@ -183,10 +240,7 @@ uint16_t ee_getFaultCheckTime(void) {
 }
 
 void     ee_setFaultCheckTime(uint16_t fCheckTime) {
-	eeprom_update_word(
-			(uint16_t*)&eeconf.faultCheckTime,
-			fCheckTime);
-	pConf->faultCheckTime = fCheckTime;
+	ee_update(faultCheckTime, fCheckTime);
 }
 
 
@@ -195,10 +249,8 @@ uint32_t ee_getFaultLevel(void) {
 }
 
 void     ee_setFaultLevel(uint32_t fLevel) {
-	eeprom_update_dword(
-			(uint32_t*)&eeconf.faultLevel,
-			fLevel);
-	pConf->faultLevel = fLevel;
+	ee_update(faultLevel, fLevel);
+	ee_updateLevels();
 }
 
 uint8_t ee_getFlCalibrationDiv(void) {
@@ -206,10 +258,8 @@ uint8_t ee_getFlCalibrationDiv(void) {
 }
 
 void ee_setFlCalibrationDiv(uint8_t cdiv) {
-	eeprom_update_byte(
-			(uint8_t*)&eeconf.flCalibrationDiv,
-			cdiv);
-	pConf->flCalibrationDiv = cdiv;
+	ee_update(flCalibrationDiv, cdiv);
+	ee_updateLevels();
 }
 
 uint8_t ee_getFlDetectionDiv(void) {
@@ -217,10 +267,18 @@ uint8_t ee_getFlDetectionDiv(void) {
 }
 
 void ee_setFlDetectionDiv(uint8_t ddiv) {
-	eeprom_update_byte(
-			(uint8_t*)&eeconf.flDetectionDiv,
-			ddiv);
-	pConf->flDetectionDiv = ddiv;
+	ee_update(flDetectionDiv, ddiv);
+	ee_updateLevels();
+}
+
+/** @brief Get the load variation which restarts a calibration */
+uint32_t ee_getCalibrationLevel(void) {
+	return calibrationLevel;
+}
+
+/** @brief Get the load loss which marks a sample as lossy */
+uint32_t ee_getDetectionLevel(void) {
+	return detectionLevel;
 }
 
 uint8_t  ee_getCalibrationWeeks(void) {
@@ -228,10 +286,7 @@ uint8_t  ee_getCalibrationWeeks(void) {
 }
 
 void     ee_setCalibrationWeeks(uint8_t cWeeks) {
-	eeprom_update_byte(
-			(uint8_t*)&eeconf.calibWeeks,
-			cWeeks);
-	pConf->calibWeeks = cWeeks;
+	ee_update(calibWeeks, cWeeks);
 }
 
 
@@ -240,24 +295,246 @@ uint8_t  ee_getNotifyFlags(void) {
 }
 
 void     ee_setNotifyFlags(uint8_t mask) {
-	eeprom_update_byte(
-			(uint8_t*)&eeconf.notifyFlags,
-			mask);
-	pConf->notifyFlags = mask;
+	ee_update(notifyFlags, mask);
+}
+
+//=====[ Configuration Images ]=================================================
+
+/**
+ * @brief Verify the on EEPROM image in the specified slot
+ *
+ * The CRC is computed while reading, thus not requiring an image buffer.
+ *
+ * @return 1 if the image is valid, 0 otherwise
+ */
+static uint8_t ee_imgValid(uint8_t slot) {
+	const uint8_t *eep = (const uint8_t *)&eeimg[slot].conf;
+	uint16_t crc;
+
+	crc = updcrc16(eeprom_read_byte(&eeimg[slot].seq), CRC16_INIT_VAL);
+	for (uint16_t i = 0; i < sizeof(eeprom_conf_t); ++i)
+		crc = updcrc16(eeprom_read_byte(eep++), crc);
+
+	return (crc == eeprom_read_word(&eeimg[slot].crc));
+}
+
+/** @brief Load the most recent valid image, 0 if there are not */
+static uint8_t ee_imgLoad(void) {
+	uint8_t valid = 0;
+	uint8_t seq;
+
+	for (uint8_t slot = 0; slot < EE_IMG_SLOTS; ++slot) {
+		if (!ee_imgValid(slot))
+			continue;
+		seq = eeprom_read_byte(&eeimg[slot].seq);
+		// Sequence numbers wrap around
+		if (valid && (int8_t)(seq - imgSeq) <= 0)
+			continue;
+		imgSlot = slot;
+		imgSeq = seq;
+		valid = 1;
+	}
+
+	if (!valid)
+		return 0;
+
+	eeprom_read_block(pConf, &eeimg[imgSlot].conf.p, sizeof(eeprom_params_t));
+	eeStrings = &eeimg[imgSlot].conf;
+	return 1;
+}
+
+/**
+ * @brief Get the strings of the next image, copying the current ones there
+ *
+ * The copy is done by the first string update since the last commit, the
+ * slot of the next image is no more valid from then on.
+ */
+static uint8_t *ee_imgStage(void) {
+	eeprom_conf_t *next = &eeimg[(imgSlot + 1) % EE_IMG_SLOTS].conf;
+	const uint8_t *src = (const uint8_t *)eeStrings;
+	uint8_t *dst = (uint8_t *)next;
+
+	if (eeStrings == next)
+		return dst;
+
+	for (uint8_t i = 0; i < EE_STRINGS_SIZE; ++i)
+		eeprom_update_byte(dst + i, eeprom_read_byte(src + i));
+	eeStrings = next;
+	return dst;
+}
+
+/**
+ * @brief Write a new image, with the on RAM configuration parameters
+ *
+ * The image is written on the slot following the last committed one, only
+ * the bytes changed since that slot has been written are actually updated.
+ * The strings are copied from the current image, or are already there if
+ * some update has been staged.
+ */
+static void ee_imgWrite(void) {
+	const uint8_t *src = (const uint8_t *)ee_imgStage();
+	uint16_t crc;
+
+	imgSlot = (imgSlot + 1) % EE_IMG_SLOTS;
+	imgSeq++;
+
+	crc = crc16(CRC16_INIT_VAL, &imgSeq, 1);
+	eeprom_update_byte(&eeimg[imgSlot].seq, imgSeq);
+
+	for (uint8_t i = 0; i < EE_STRINGS_SIZE; ++i)
+		crc = updcrc16(eeprom_read_byte(src + i), crc);
+
+	crc = crc16(crc, pConf, sizeof(eeprom_params_t));
+	eeprom_update_block(pConf, &eeimg[imgSlot].conf.p, sizeof(eeprom_params_t));
+	eeprom_update_word(&eeimg[imgSlot].crc, crc);
+
+	confDirty = 0;
+
+	LOG_INFO("EEPROM Conf committed [%hu@%hu]\r\n", imgSeq, imgSlot);
+}
+
+/** @brief Commit the on RAM configuration, if updated */
+void ee_flush(void) {
+	if (!confDirty)
+		return;
+	ee_imgWrite();
+}
+
+/**
+ * @brief Commit the on RAM configuration once updates are settled
+ *
+ * This should be called periodically, the configuration is committed
+ * CONFIG_EEPROM_COMMIT_DELAY seconds after its last update.
+ */
+void ee_commit(void) {
+	if (!confDirty)
+		return;
+	if (timer_clock() - confDirtyAt <
+			ms_to_ticks((mtime_t)CONFIG_EEPROM_COMMIT_DELAY*1000))
+		return;
+	ee_flush();
+}
+
+//=====[ Calibration Snapshots ]================================================
+
+static inline uint16_t ee_calCRC(const ee_cal_t *cal) {
+	return crc16(CRC16_INIT_VAL, cal, offsetof(ee_cal_t, crc));
+}
+
+static uint8_t ee_calValid(const ee_cal_t *cal) {
+	if (cal->version != EE_CAL_VERSION)
+		return 0;
+	if (cal->epoch != calEpoch)
+		return 0;
+	return (cal->crc == ee_calCRC(cal));
+}
+
+/**
+ * @brief Get the slot of the most recent valid snapshot of a channel
+ *
+ * @return the slot index, -1 if there are not valid snapshots
+ */
+static int8_t ee_calLatest(uint8_t ch, ee_cal_t *cal) {
+	int8_t latest = -1;
+	uint8_t seq = 0;
+
+	for (uint8_t slot = 0; slot < EE_CAL_SLOTS; ++slot) {
+		eeprom_read_block(cal, &eecal[ch][slot], sizeof(ee_cal_t));
+		if (!ee_calValid(cal))
+			continue;
+		// Sequence numbers wrap around
+		if (latest < 0 || (int8_t)(cal->seq - seq) > 0) {
+			latest = slot;
+			seq = cal->seq;
+		}
+	}
+
+	return latest;
+}
+
+/**
+ * @brief Get the calibration snapshot of the specified channel
+ *
+ * @return 0 if a valid snapshot has been found, -1 otherwise
+ */
+int8_t ee_getCalibration(uint8_t ch, ee_cal_t *cal) {
+	int8_t slot;
+
+	if (ch >= EE_CAL_CHANNELS)
+		return -1;
+
+	slot = ee_calLatest(ch, cal);
+	if (slot < 0)
+		return -1;
+
+	eeprom_read_block(cal, &eecal[ch][slot], sizeof(ee_cal_t));
+	return 0;
+}
+
+/**
+ * @brief Save a new calibration snapshot for the specified channel
+ *
+ * Only the calibration values of \a cal must be set, the record header and
+ * CRC are updated here. The snapshot is written on the slot following the
+ * most recent one, thus spreading writes and always keeping a valid copy
+ * even if power is lost while writing.
+ */
+void ee_setCalibration(uint8_t ch, ee_cal_t *cal) {
+	ee_cal_t last;
+	int8_t slot;
+
+	if (ch >= EE_CAL_CHANNELS)
+		return;
+
+	slot = ee_calLatest(ch, &last);
+	if (slot < 0) {
+		slot = 0;
+		cal->seq = 0;
+	} else {
+		slot = (slot + 1) % EE_CAL_SLOTS;
+		cal->seq = last.seq + 1;
+	}
+
+	cal->version = EE_CAL_VERSION;
+	cal->epoch = calEpoch;
+	cal->crc = ee_calCRC(cal);
+
+	eeprom_update_block(cal, &eecal[ch][slot], sizeof(ee_cal_t));
+}
+
+/** @brief Invalidate the calibration snapshots of all channels */
+void ee_invalidateCalibrations(void) {
+	calEpoch++;
+	eeprom_update_byte(&eecalEpoch, calEpoch);
 }
 
 
 void ee_loadConf(void) {
 	uint8_t i;
-	char buff[MAX_MSG_TEXT];
+	char buff[MAX_SMS_NUM];
 	char space[] = " ";
+	char c;
+
+	// Load the configuration image, or the factory defaults
+	if (!ee_imgLoad()) {
+		eeprom_read_block(pConf, &eeconf.p, sizeof(eeprom_params_t));
+		ee_touch();
+	}
+	ee_updateLevels();
 
-	LOG_INFO("EEPROM Conf:\r\n");
+	LOG_INFO("EEPROM Conf [%hu%s]:\r\n", imgSeq,
+			confDirty ? ", defaults" : "");
 	DELAY(5);
 
-	// Dump SMS message
-	ee_getSmsText(buff, MAX_MSG_TEXT);
-	LOG_INFO(" SMS Text: %s\r\n", buff);
+	// Dump SMS message, straight from EEPROM
+	LOG_INFO(" SMS Text: ");
+	for (i = 0; i < MAX_MSG_TEXT; i++) {
+		c = eeprom_read_byte((const uint8_t *)&eeStrings->sms_mesg[i]);
+		if (c == '\0')
+			break;
+		kprintf("%c", c);
+	}
+	kprintf("\r\n");
 	DELAY(5);
 
 	// Dump SMS destinations
@@ -267,65 +544,50 @@ void ee_loadConf(void) {
 		DELAY(5);
 	}
 
-	pConf->enabledChannelsMask = eeprom_read_word(
-			(uint16_t*)&eeconf.enabledChannelsMask);
 	LOG_INFO(" Enabled CHs:  %9s0x%04X\r\n",
 			space, pConf->enabledChannelsMask);
 	DELAY(5);
 
-	pConf->criticalChannelsMask = eeprom_read_word(
-			(uint16_t*)&eeconf.criticalChannelsMask);
 	LOG_INFO(" Critical CHs: %9s0x%04X\r\n",
 			space, pConf->criticalChannelsMask);
 	DELAY(5);
 
-	pConf->faultSamples = eeprom_read_byte(
-			(uint8_t*)&eeconf.faultSamples);
 	LOG_INFO(" Fault samples: %14hu\r\n",
 			pConf->faultSamples);
 	DELAY(5);
 
-	pConf->faultChecks = eeprom_read_byte(
-			(uint8_t*)&eeconf.faultChecks);
 	LOG_INFO(" Fault checks: %15hu\r\n",
 			pConf->faultChecks);
 	DELAY(5);
 
-	pConf->faultCheckTime = eeprom_read_word(
-			(uint16_t*)&eeconf.faultCheckTime);
 	LOG_INFO(" Fault check time: %11u [s]\r\n",
 			pConf->faultCheckTime);
 	DELAY(5);
 
-	pConf->faultLevel = eeprom_read_dword(
-			(uint32_t*)&eeconf.faultLevel);
 	LOG_INFO(" Fault level: %16lu\r\n",
 			pConf->faultLevel);
 	DELAY(5);
 
-	pConf->flCalibrationDiv = eeprom_read_byte(
-			(uint8_t*)&eeconf.flCalibrationDiv);
 	LOG_INFO(" Fault level CDIV: %11hu\r\n",
 			pConf->flCalibrationDiv);
 	DELAY(5);
 
-	pConf->flDetectionDiv = eeprom_read_byte(
-			(uint8_t*)&eeconf.flDetectionDiv);
 	LOG_INFO(" Fault level DDIV: %11hu\r\n",
 			pConf->flDetectionDiv);
 	DELAY(5);
 
-	pConf->calibWeeks = eeprom_read_byte(
-			(uint8_t*)&eeconf.calibWeeks);
 	LOG_INFO(" Calibration weeks: %10hu\r\n",
 			pConf->calibWeeks);
 	DELAY(5);
 
-	pConf->notifyFlags = eeprom_read_byte(
-			(uint8_t*)&eeconf.notifyFlags);
 	LOG_INFO(" Notification flags: %5s0x%02X\r\n",
 			space, pConf->notifyFlags);
 	DELAY(5);
 
+	calEpoch = eeprom_read_byte(&eecalEpoch);
+	LOG_INFO(" Calibration epoch: %10hu\r\n",
+			calEpoch);
+	DELAY(5);
+
 }
 
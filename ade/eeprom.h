@@ -12,10 +12,8 @@
 
 #define EMPTY_NUMBER "-\0"
 
-typedef struct eeprom_conf {
-	char sms_dest[MAX_SMS_DEST][MAX_SMS_NUM];
-	char sms_mesg[MAX_MSG_TEXT];
-
+/** The configuration parameters, cached on RAM */
+typedef struct eeprom_params {
 	/** A bitmask of ENABLED input channel which should be monitored */
 	uint16_t enabledChannelsMask;
 	/** A bitmask of CRITICAL input channel which should generate
@@ -44,41 +42,54 @@ typedef struct eeprom_conf {
 #define EE_NOTIFY_CALIBRATION 	1
 	uint8_t notifyFlags;
 
-} eeprom_conf_t;
-
+} eeprom_params_t;
 
 /**
- * The Set of EEPROM data mirrored on RAM at run-time
+ * The configuration, the SMS strings being read and written straight on
+ * EEPROM since they are not accessed by the sampling paths. String updates
+ * are staged on the slot of the next image, and committed by ee_commit()
+ * together with the parameters.
  */
-typedef struct runtime_conf {
-
-	/** A bitmask of ENABLED input channel which should be monitored */
-	uint16_t enabledChannelsMask;
-	/** A bitmask of CRITICAL input channel which should generate
-	 * an EXT alarm (by switching the Relé) */
-	uint16_t criticalChannelsMask;
-
-	/** Number of FAULT samples before alarm notification */
-	uint8_t faultSamples;
-	/** Number of suspension/recheck on faulty detection */
-	uint8_t faultChecks;
-	/** Number of seconds between faults checks */
-	uint16_t faultCheckTime;
-
-	/** Fault (Power) detection level */
-	uint32_t faultLevel;
-	/** Fault levelcalibration divider */
-	uint8_t flCalibrationDiv;
-	/** Fault level detection divider */
-	uint8_t flDetectionDiv;
+typedef struct eeprom_conf {
+	char sms_dest[MAX_SMS_DEST][MAX_SMS_NUM];
+	char sms_mesg[MAX_MSG_TEXT];
 
-	/** Weeks between recalibrations */
-	uint8_t calibWeeks;
+	eeprom_params_t p;
+} eeprom_conf_t;
 
-	/** Notification flags */
-	uint8_t notifyFlags;
+/** The version of the calibration records layout */
+#define EE_CAL_VERSION 2
+/** The number of calibration records slots for each channel */
+#define EE_CAL_SLOTS 2
+/** The number of channels with a calibration record */
+#define EE_CAL_CHANNELS 16
 
-} runtime_conf_t;
+/**
+ * A per-channel calibration snapshot
+ *
+ * Each channel has EE_CAL_SLOTS records which are written round-robin, the
+ * valid one with the higher sequence number being the current snapshot.
+ */
+typedef struct ee_cal {
+	/** The record layout version, EE_CAL_VERSION */
+	uint8_t version;
+	/** The calibration epoch this record belongs to */
+	uint8_t epoch;
+	/** The record sequence number */
+	uint8_t seq;
+
+	uint32_t Pmax;
+	uint32_t Imax;
+	uint32_t Vmax;
+	/** The load noise */
+	uint32_t noise;
+
+	/** The uptime [s] at calibration completion (no RTC available) */
+	uint32_t stamp;
+
+	/** The CRC16 of all the previous fields */
+	uint16_t crc;
+} ee_cal_t;
 
 int8_t  ee_getSmsDest(uint8_t pos, char *num, uint8_t count);
 int8_t  ee_setSmsDest(uint8_t pos, const char *num);
@@ -101,6 +112,8 @@ uint8_t  ee_getFlCalibrationDiv(void);
 void     ee_setFlCalibrationDiv(uint8_t);
 uint8_t  ee_getFlDetectionDiv(void);
 void     ee_setFlDetectionDiv(uint8_t);
+uint32_t ee_getCalibrationLevel(void);
+uint32_t ee_getDetectionLevel(void);
 
 uint8_t  ee_getCalibrationWeeks(void);
 void     ee_setCalibrationWeeks(uint8_t);
@@ -116,8 +129,15 @@ inline uint8_t  ee_onNotifyCalibration(void) {
 	return (ee_getNotifyFlags() & BV8(EE_NOTIFY_CALIBRATION));
 }
 
-extern runtime_conf_t *pConf;
+int8_t ee_getCalibration(uint8_t ch, ee_cal_t *cal);
+void   ee_setCalibration(uint8_t ch, ee_cal_t *cal);
+void   ee_invalidateCalibrations(void);
+
+/** The on RAM configuration parameters, committed to EEPROM by ee_commit() */
+extern eeprom_params_t *pConf;
 
 void ee_loadConf(void);
+void ee_commit(void);
+void ee_flush(void);
 
 #endif /* end of include guard: EEPROMS_H */
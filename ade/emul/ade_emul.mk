@@ -0,0 +1,124 @@
+#
+# Host-side simulator of the ade application.
+#
+# This builds the application for the ARCH_EMUL architecture, i.e. as an host
+# executable where the board peripherals (GPIOs, EEPROM, ADE7753, PCA9555 and
+# GSM modem) are simulated by the sources of this folder.
+#
+# Build with "make ade_emul", then run "images/ade_emul -h" for usage.
+#
+
+TRG += ade_emul
+
+ade_emul_HOSTED = 1
+ade_emul_DEBUG = 1
+
+ade_emul_SIM_PATH = $(ade_SRC_PATH)/emul
+
+# The application sources, and the BeRTOS modules not depending on the MCU
+ade_emul_CSRC = \
+	$(ade_USER_CSRC) \
+	$(filter-out bertos/cpu/% bertos/mware/sprintf.c,$(ade_WIZARD_CSRC)) \
+	bertos/emul/kfile_posix.c \
+	bertos/os/hptime.c \
+	$(ade_emul_SIM_PATH)/sim.c \
+	$(ade_emul_SIM_PATH)/sim_ade7753.c \
+	$(ade_emul_SIM_PATH)/sim_eeprom.c \
+	$(ade_emul_SIM_PATH)/sim_modem.c \
+	$(ade_emul_SIM_PATH)/sim_pca9555.c \
+	$(ade_emul_SIM_PATH)/sim_scenario.c \
+	$(ade_emul_SIM_PATH)/sim_ser.c \
+	#
+
+# The context switch of the host CPU
+ade_emul_CPPASRC = \
+	bertos/emul/switch_ctx_emul.S \
+	#
+
+# The simulated avr-libc headers take precedence on the host ones.
+# The inline functions of the application headers have no external
+# definition, thus they must be inlined as avr-gcc does, while tentative
+# definitions are merged as common symbols. The process stacks are aligned
+# just to cpu_stack_t, thus each function realigns its own frame as the
+# host ABI requires.
+# The features not fitting the MCU RAM are enabled, to be tested anyway.
+ade_emul_CPPFLAGS = \
+	-D'CPU_FREQ=(14745600UL)' \
+	-D'ARCH=(ARCH_DEFAULT|ARCH_EMUL)' \
+	-D'WIZ_AUTOGEN' \
+	-D'CONFIG_ENERGY=1' \
+	-D'CONFIG_PERF=1' \
+	-D'CONFIG_CONTROL_STATS_PEAKS=1' \
+	-I$(ade_emul_SIM_PATH) \
+	-I$(ade_HW_PATH) \
+	-I$(ade_SRC_PATH) \
+	-O2 \
+	-fcommon \
+	-mstackrealign \
+	$(ade_USER_CPPFLAGS) \
+	#
+
+.PHONY: ade_emul
+ade_emul: $(OUTDIR)/ade_emul
+
+# The host unit tests, each one linking just the modules under test
+ade_emul_TESTS = \
+	ade_power_test \
+	ade_smstok_test \
+	ade_sched_test \
+	ade_stats_test \
+	#
+
+TRG += $(ade_emul_TESTS)
+
+ade_power_test_HOSTED = 1
+ade_power_test_CSRC = \
+	$(ade_emul_SIM_PATH)/tests/power_test.c \
+	#
+ade_power_test_CPPFLAGS = $(ade_emul_CPPFLAGS)
+
+ade_smstok_test_HOSTED = 1
+ade_smstok_test_CSRC = \
+	$(ade_emul_SIM_PATH)/tests/smstok_test.c \
+	$(ade_SRC_PATH)/at.c \
+	$(ade_SRC_PATH)/smstok.c \
+	bertos/io/kfile.c \
+	#
+ade_smstok_test_CPPFLAGS = $(ade_emul_CPPFLAGS) -D_DEBUG
+
+ade_sched_test_HOSTED = 1
+ade_sched_test_CSRC = \
+	$(ade_emul_SIM_PATH)/tests/sched_test.c \
+	$(ade_SRC_PATH)/scheduler.c \
+	#
+ade_sched_test_CPPFLAGS = $(ade_emul_CPPFLAGS)
+
+ade_stats_test_HOSTED = 1
+ade_stats_test_CSRC = \
+	$(ade_emul_SIM_PATH)/tests/stats_test.c \
+	$(ade_SRC_PATH)/stats.c \
+	#
+ade_stats_test_CPPFLAGS = $(ade_emul_CPPFLAGS)
+
+# Verify the commands hash table is up to date, run the unit tests, then play
+# all the scenarios on the virtual clock, each one from a blank EEPROM,
+# keeping the logs of the failed ones
+ade_emul_SCENARIOS = $(sort $(wildcard $(ade_emul_SIM_PATH)/scenarios/*.sim))
+
+.PHONY: ade_check
+ade_check: ade_cmdhash_check $(OUTDIR)/ade_emul $(ade_emul_TESTS:%=$(OUTDIR)/%)
+	$Q for t in $(ade_emul_TESTS); do \
+		$(OUTDIR)/$$t || exit 1; \
+	done
+	$Q for s in $(ade_emul_SCENARIOS); do \
+		log=$(OUTDIR)/$$(basename $$s .sim).log; \
+		rm -f $(OUTDIR)/ade_check.eep; \
+		if ! $(OUTDIR)/ade_emul -v -q -e $(OUTDIR)/ade_check.eep \
+				-s $$s > $$log 2>&1; then \
+			echo "Scenario $$s FAILED, see $$log"; \
+			exit 1; \
+		fi; \
+		echo "Scenario $$s OK"; \
+		rm -f $$log; \
+	done; \
+	rm -f $(OUTDIR)/ade_check.eep
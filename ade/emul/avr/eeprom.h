@@ -0,0 +1,43 @@
+/**
+ *       @file  eeprom.h
+ *      @brief  Simulated AVR EEPROM
+ *
+ * EEMEM variables are collected into a dedicated section, which is the
+ * image of the simulated EEPROM: it is loaded at boot from a backing file,
+ * and each update is written through to that file (see sim_eeprom.c).
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef SIM_AVR_EEPROM_H_
+#define SIM_AVR_EEPROM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EEMEM __attribute__((section("sim_eeprom"), used))
+
+uint8_t eeprom_read_byte(const uint8_t *addr);
+uint16_t eeprom_read_word(const uint16_t *addr);
+void eeprom_read_block(void *dst, const void *src, size_t n);
+
+void eeprom_update_byte(uint8_t *addr, uint8_t value);
+void eeprom_update_word(uint16_t *addr, uint16_t value);
+void eeprom_update_block(const void *src, void *dst, size_t n);
+
+#define eeprom_write_byte  eeprom_update_byte
+#define eeprom_write_word  eeprom_update_word
+#define eeprom_write_block eeprom_update_block
+
+#endif /* end of include guard: SIM_AVR_EEPROM_H_ */
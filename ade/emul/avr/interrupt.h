@@ -0,0 +1,36 @@
+/**
+ *       @file  interrupt.h
+ *      @brief  Simulated AVR interrupt vectors
+ *
+ * Interrupt service routines are plain functions on the host-side simulator,
+ * which are called by the simulated peripherals from the timer interrupt
+ * context (i.e. with the SIGALRM signal blocked).
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef SIM_AVR_INTERRUPT_H_
+#define SIM_AVR_INTERRUPT_H_
+
+#include <avr/io.h>
+
+#include <cfg/os.h>
+
+// Interrupt handlers are declared as signal handlers on hosted builds
+#define ISR(vect) DECLARE_ISR(vect)
+
+// The pin change interrupt of PORTC
+void PCINT2_vect(int arg);
+
+#endif /* end of include guard: SIM_AVR_INTERRUPT_H_ */
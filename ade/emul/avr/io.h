@@ -0,0 +1,82 @@
+/**
+ *       @file  io.h
+ *      @brief  Simulated AVR I/O registers
+ *
+ * This replaces the avr-libc header on the host-side simulator: the I/O
+ * registers used by the application are plain variables, which are sampled
+ * and driven by the simulated board peripherals (see sim.h).
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef SIM_AVR_IO_H_
+#define SIM_AVR_IO_H_
+
+#include <stdint.h>
+
+extern volatile uint8_t PORTA, DDRA, PINA;
+extern volatile uint8_t PORTB, DDRB, PINB;
+extern volatile uint8_t PORTC, DDRC, PINC;
+extern volatile uint8_t PORTD, DDRD, PIND;
+
+// Pin change interrupts
+extern volatile uint8_t PCICR;
+extern volatile uint8_t PCMSK2;
+#define PCIE2 2
+
+// Reset reasons
+extern volatile uint8_t MCUSR;
+#define PORF  0
+#define EXTRF 1
+#define BORF  2
+#define WDRF  3
+#define JTRF  4
+
+#define PA0 0
+#define PA1 1
+#define PA2 2
+#define PA3 3
+#define PA4 4
+#define PA5 5
+#define PA6 6
+#define PA7 7
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PC6 6
+#define PC7 7
+
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+#endif /* end of include guard: SIM_AVR_IO_H_ */
@@ -0,0 +1,39 @@
+/**
+ *       @file  pgmspace.h
+ *      @brief  Simulated AVR program memory access
+ *
+ * There is a single address space on the host-side simulator.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef SIM_AVR_PGMSPACE_H_
+#define SIM_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef PROGMEM
+# define PROGMEM
+#endif
+
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+
+#define sprintf_P sprintf
+#define sscanf_P  sscanf
+#define strlen_P  strlen
+#define strncmp_P strncmp
+
+#endif /* end of include guard: SIM_AVR_PGMSPACE_H_ */
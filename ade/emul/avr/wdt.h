@@ -0,0 +1,43 @@
+/**
+ *       @file  wdt.h
+ *      @brief  Simulated AVR watchdog
+ *
+ * Once enabled, the watchdog resets the simulated board if it is not
+ * refreshed within the configured timeout, see sim_reset().
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef SIM_AVR_WDT_H_
+#define SIM_AVR_WDT_H_
+
+#include <stdint.h>
+
+// The timeout is (16ms << WDTO_x)
+#define WDTO_15MS  0
+#define WDTO_30MS  1
+#define WDTO_60MS  2
+#define WDTO_120MS 3
+#define WDTO_250MS 4
+#define WDTO_500MS 5
+#define WDTO_1S    6
+#define WDTO_2S    7
+#define WDTO_4S    8
+#define WDTO_8S    9
+
+void wdt_enable(uint8_t timeout);
+void wdt_disable(void);
+void wdt_reset(void);
+
+#endif /* end of include guard: SIM_AVR_WDT_H_ */
@@ -0,0 +1,35 @@
+/**
+ *       @file  i2c_x86.h
+ *      @brief  Simulated I2C bus
+ *
+ * The I2C bus of the host-side simulator, which connects the simulated
+ * PCA9555 port expander (see sim_pca9555.c).
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef SIM_DRV_I2C_X86_H_
+#define SIM_DRV_I2C_X86_H_
+
+/**
+ * \name I2C devices enum
+ */
+enum
+{
+	I2C0,
+
+	I2C_CNT  /**< Number of I2C buses */
+};
+
+#endif /* end of include guard: SIM_DRV_I2C_X86_H_ */
@@ -0,0 +1,346 @@
+/**
+ *       @file  sim.c
+ *      @brief  Host-side simulator of the ADE board
+ *
+ * This provides the simulator setup, the simulated MCU registers (GPIOs,
+ * pin change interrupts, reset reasons and watchdog) and the timer interrupt
+ * which clocks all the simulated peripherals. The timer runs in real time
+ * or, to play long scenarios, on a virtual clock which jumps to the next
+ * tick each time the firmware is idle (i.e. by cpu_relax()).
+ *
+ * A board reset (i.e. a watchdog timeout) is simulated by re-executing the
+ * simulator itself, passing the reset reasons and the current time: the
+ * EEPROM content is preserved by its backing file, while the scenario is
+ * resumed by replaying just the events setting the board inputs, keeping
+ * track of the expectations already met. The modem, which is not reset with
+ * the board, keeps its power state.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "sim.h"
+
+#include <avr/interrupt.h>
+#include <avr/io.h>
+#include <avr/wdt.h>
+
+#include <cfg/macros.h>
+#include <cpu/irq.h>
+#include <drv/timer.h>
+#include <emul/emul.h>
+
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+//=====[ MCU Registers ]========================================================
+
+volatile uint8_t PORTA, DDRA, PINA;
+volatile uint8_t PORTB, DDRB, PINB;
+// Input pins are pulled-up, i.e. all the interrupt lines are released
+volatile uint8_t PORTC, DDRC, PINC = 0xFF;
+volatile uint8_t PORTD, DDRD, PIND;
+
+volatile uint8_t PCICR;
+volatile uint8_t PCMSK2;
+
+volatile uint8_t MCUSR = BV8(PORF);
+
+void sim_pinc(uint8_t mask, uint8_t level) {
+	uint8_t changed;
+
+	ATOMIC(
+		changed = PINC;
+		if (level)
+			PINC |= mask;
+		else
+			PINC &= ~mask;
+		changed ^= PINC;
+		if ((changed & PCMSK2) && (PCICR & BV8(PCIE2)))
+			PCINT2_vect(0);
+	);
+}
+
+//=====[ Watchdog ]=============================================================
+
+// The watchdog timeout [ms], 0 if disabled
+static uint32_t wdtTimeout = 0;
+// The time of the last watchdog refresh
+static uint32_t wdtLast;
+
+void wdt_enable(uint8_t timeout) {
+	ATOMIC(
+		wdtTimeout = 16UL << timeout;
+		wdtLast = sim_now();
+	);
+}
+
+void wdt_disable(void) {
+	wdtTimeout = 0;
+}
+
+void wdt_reset(void) {
+	wdtLast = sim_now();
+}
+
+//=====[ Simulator Setup ]======================================================
+
+// The arguments to re-execute the simulator on resets
+static int simArgc;
+static char **simArgv;
+
+// The time [ms] elapsed before the last reset
+static uint32_t bootAt = 0;
+
+// Set to mute the simulator log
+static uint8_t quiet = 0;
+
+// Set to run on the virtual clock
+static uint8_t virtualTime = 0;
+
+uint32_t sim_now(void) {
+	return bootAt + ticks_to_ms(timer_clock_unlocked());
+}
+
+void sim_log(const char *fmt, ...) {
+	char buff[256];
+	uint32_t now = sim_now();
+	va_list ap;
+	int len;
+
+	if (quiet)
+		return;
+
+	// This could run in interrupt context, i.e. within a signal handler,
+	// thus the message is not buffered by stdio
+	len = snprintf(buff, sizeof(buff), "[sim %5lu.%03lu] ",
+			(unsigned long)now / 1000, (unsigned long)now % 1000);
+	va_start(ap, fmt);
+	len += vsnprintf(buff+len, sizeof(buff)-len, fmt, ap);
+	va_end(ap);
+	if (len >= (int)sizeof(buff)-1)
+		len = sizeof(buff)-2;
+	buff[len++] = '\n';
+
+	if (write(STDERR_FILENO, buff, len) < 0)
+		return;
+}
+
+static void usage(const char *name) {
+	fprintf(stderr,
+		"Usage: %s [-e EEPROM] [-s SCENARIO] [-v] [-q]\n"
+		"  -e EEPROM    the EEPROM backing file (default: ade_emul.eep)\n"
+		"  -s SCENARIO  the scenario to play (see ade/emul/scenarios)\n"
+		"  -v           run on a virtual clock, as fast as possible\n"
+		"  -q           do not log the simulator events\n"
+		"The console is bridged to stdin/stdout.\n",
+		name);
+}
+
+/**
+ * @brief Setup the simulated board
+ *
+ * This must be called first by main(), the scenario is started once the
+ * board timer is running, see sim_start().
+ */
+void sim_init(int *argc, char *argv[]) {
+	const char *eeprom = "ade_emul.eep";
+	const char *scenario = NULL;
+	uint32_t met = 0;
+	uint8_t modem = 0;
+	int opt;
+
+	simArgc = *argc;
+	simArgv = argv;
+
+	while ((opt = getopt(*argc, argv, "e:s:vqR:T:M:G:h")) != -1) {
+		switch (opt) {
+		case 'e':
+			eeprom = optarg;
+			break;
+		case 's':
+			scenario = optarg;
+			break;
+		case 'v':
+			virtualTime = 1;
+			break;
+		case 'q':
+			quiet = 1;
+			break;
+		// Internal options, to resume from a reset
+		case 'R':
+			MCUSR = strtoul(optarg, NULL, 0);
+			break;
+		case 'T':
+			bootAt = strtoul(optarg, NULL, 0);
+			break;
+		case 'M':
+			met = strtoul(optarg, NULL, 0);
+			break;
+		case 'G':
+			modem = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			exit(opt == 'h' ? 0 : 2);
+		}
+	}
+
+	sim_eepromInit(eeprom);
+
+	if (sim_scenarioLoad(scenario, bootAt, met) != 0)
+		exit(2);
+
+	if (modem)
+		sim_modemPower(1);
+
+	// Before the board timer is started
+	if (virtualTime)
+		timer_setVirtual();
+
+	// Do not buffer the console output
+	setvbuf(stdout, NULL, _IONBF, 0);
+}
+
+//=====[ Simulator Clock ]======================================================
+
+// The simulator clock, which is a timer interrupt
+static Timer simTimer;
+
+// The host time of the last timer tick
+static hptime_t tickAt;
+
+hptime_t sim_hpread(void) {
+	hptime_t hp = hptime_get() - tickAt;
+
+	// The counter of a real timer wraps at each tick
+	return MIN(hp, (hptime_t)(TIMER_HW_HPTICKS_PER_SEC / TIMER_TICKS_PER_SEC - 1));
+}
+
+/**
+ * @brief Let the virtual clock run, see cpu_relax()
+ *
+ * The firmware is idle when waiting for a timeout or an interrupt, thus
+ * the virtual time jumps to the next timer tick.
+ */
+void emul_idle(void) {
+	static uint8_t idle = 0;
+
+	// Timer interrupts must not nest
+	if (!virtualTime || idle)
+		return;
+
+	idle = 1;
+	timer_virtualIdle();
+	idle = 0;
+}
+
+static void sim_tick(UNUSED_ARG(void *, arg)) {
+	uint32_t now = sim_now();
+
+	tickAt = hptime_get();
+
+	sim_scenarioTick(now);
+	sim_adeTick(now);
+	sim_pcaTick(now);
+	sim_modemTick(now);
+	sim_serTick();
+
+	if (wdtTimeout && (now - wdtLast) >= wdtTimeout) {
+		sim_log("Watchdog timeout");
+		sim_reset(BV8(WDRF));
+	}
+
+	timer_add(&simTimer);
+}
+
+/**
+ * @brief Start clocking the simulated peripherals
+ *
+ * This is called as soon as the board timer has been initialized, i.e. by
+ * the first serial port being opened.
+ */
+void sim_start(void) {
+	static uint8_t started = 0;
+
+	if (started)
+		return;
+	started = 1;
+
+	timer_setSoftint(&simTimer, sim_tick, NULL);
+	timer_setDelay(&simTimer, 1);
+	timer_add(&simTimer);
+}
+
+/**
+ * @brief Reset the board
+ *
+ * The simulator is executed again, to restart from a clean memory.
+ */
+void sim_reset(uint8_t reason) {
+	static char optR[] = "-R", optT[] = "-T", optM[] = "-M", optG[] = "-G";
+	static char modem[][2] = { "0", "1" };
+	char mcusr[8], now[16], met[16];
+	char *args[simArgc + 9];
+	int n = 0;
+
+	sim_log("Reset [0x%02X]", reason);
+
+	snprintf(mcusr, sizeof(mcusr), "%u", reason);
+	snprintf(now, sizeof(now), "%lu", (unsigned long)sim_now());
+	snprintf(met, sizeof(met), "%lu", (unsigned long)sim_scenarioMet());
+
+	args[n++] = simArgv[0];
+	args[n++] = optR;
+	args[n++] = mcusr;
+	args[n++] = optT;
+	args[n++] = now;
+	args[n++] = optM;
+	args[n++] = met;
+	args[n++] = optG;
+	args[n++] = modem[sim_modemPowered()];
+	// Skip internal options of the previous run
+	for (int i = 1; i < simArgc; ++i) {
+		if (!strcmp(simArgv[i], optR) || !strcmp(simArgv[i], optT) ||
+				!strcmp(simArgv[i], optM) || !strcmp(simArgv[i], optG)) {
+			++i;
+			continue;
+		}
+		args[n++] = simArgv[i];
+	}
+	args[n] = NULL;
+
+	// Timers and the signals mask are preserved across exec, while this
+	// could run within the timer signal handler
+	static const struct itimerval off;
+	sigset_t alrm;
+	setitimer(ITIMER_REAL, &off, NULL);
+	sigemptyset(&alrm);
+	sigaddset(&alrm, SIGALRM);
+	sigprocmask(SIG_UNBLOCK, &alrm, NULL);
+
+	execv("/proc/self/exe", args);
+	sim_log("Reset failed");
+	_exit(2);
+}
+
+/** @brief Terminate the simulation */
+void sim_exit(int status) {
+	sim_log("Exit [%d]", status);
+	_exit(status);
+}
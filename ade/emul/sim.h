@@ -0,0 +1,98 @@
+/**
+ *       @file  sim.h
+ *      @brief  Host-side simulator of the ADE board
+ *
+ * This provides the simulated peripherals of the board, which allow to run
+ * the application as an host executable (ARCH_EMUL):
+ * - GPIOs and the pin change interrupts of PORTC
+ * - the EEPROM, backed by a file
+ * - the ADE7753 energy meter, on a fake SPI
+ * - the PCA9555 port expander reporting the channels presence, on a fake I2C
+ * - the GSM modem, answering AT commands on UART1
+ * - the console, bridging UART0 to stdin/stdout
+ *
+ * Peripherals are clocked by a timer interrupt, which also plays a scenario:
+ * a script of timed events such as load changes, network drops or incoming
+ * SMS (see sim_scenario.c).
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <cfg/compiler.h>
+#include <io/kfile.h>
+#include <os/hptime.h>
+
+// The number of simulated channels
+#define SIM_CHANNELS 16
+
+// The line voltage period [ms], at power-on
+#define SIM_LINE_PERIOD_MS 20
+
+void sim_init(int *argc, char *argv[]);
+void sim_start(void);
+void NORETURN sim_reset(uint8_t reason);
+void NORETURN sim_exit(int status);
+
+/** @brief Get the simulated time [ms] since the board power-on */
+uint32_t sim_now(void);
+
+/** @brief Get the high-precision time elapsed since the last timer tick */
+hptime_t sim_hpread(void);
+
+void sim_log(const char *fmt, ...) FORMAT(printf, 1, 2);
+
+/** @brief Drive the \a mask PORTC input pins, triggering PCINT2 on changes */
+void sim_pinc(uint8_t mask, uint8_t level);
+
+//----- EEPROM
+void sim_eepromInit(const char *path);
+
+//----- ADE7753 energy meter
+KFile *sim_adeSpi(void);
+void sim_adeLoad(uint8_t ch, uint32_t irms);
+void sim_adeVoltage(uint32_t vrms);
+void sim_adeFrequency(uint32_t mhz);
+uint32_t sim_adeSamples(uint8_t ch);
+void sim_adeTick(uint32_t now);
+
+//----- PCA9555 port expander
+void sim_pcaPresent(uint8_t ch, uint8_t present);
+void sim_pcaBounce(uint16_t chs, uint8_t count);
+void sim_pcaBus(uint8_t on);
+void sim_pcaTick(uint32_t now);
+
+//----- GSM modem
+void sim_modemPower(uint8_t on);
+uint8_t sim_modemPowered(void);
+void sim_modemNetwork(uint8_t on);
+void sim_modemSMS(const char *from, const char *text);
+void sim_modemPutc(char c);
+int sim_modemGetc(void);
+void sim_modemTick(uint32_t now);
+
+//----- Serial ports
+void sim_consoleInput(const char *text);
+void sim_serTick(void);
+
+//----- Scenario
+int sim_scenarioLoad(const char *path, uint32_t skip, uint32_t met);
+uint32_t sim_scenarioMet(void);
+void sim_scenarioTick(uint32_t now);
+void sim_scenarioSMS(const char *dest, const char *text);
+int sim_scenarioCheck(void);
+
+#endif /* end of include guard: SIM_H_ */
@@ -0,0 +1,366 @@
+/**
+ *       @file  sim_ade7753.c
+ *      @brief  Simulated ADE7753 energy meter
+ *
+ * This provides the meter on a fake SPI, i.e. a KFile decoding the serial
+ * protocol of the ADE7753: each transfer is an address byte, with the MSB
+ * set for writes, followed by the (register size) data bytes.
+ *
+ * The current input is the channel selected by the analog MUX (PA0..3),
+ * each channel having its own load, while the voltage input is the line
+ * voltage, common to all the channels. Line cycle energy accumulations are
+ * completed each LINECYC half line cycles, asserting the IRQ line (PC6,
+ * active low) when the CYCEND interrupt is enabled. Without line voltage
+ * there are no zero-crossings, thus accumulations never complete.
+ * The ZX output (PC7) is high during the positive half line cycles.
+ * The samples read, i.e. the LAENERGY reads, are counted for each channel.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "sim.h"
+
+#include <avr/io.h>
+
+#include <cfg/macros.h>
+#include <cpu/irq.h>
+#include <drv/meter_ade7753.h>
+
+#include <string.h>
+
+// The size [bytes] of each register, 0 for not existing ones
+static const uint8_t regSize[0x40] = {
+	[ADE7753_WAVEFORM]   = 3, [ADE7753_AENERGY]    = 3,
+	[ADE7753_RAENERGY]   = 3, [ADE7753_LAENERGY]   = 3,
+	[ADE7753_VAENERGY]   = 3, [ADE7753_RVAENERGY]  = 3,
+	[ADE7753_LVAENERGY]  = 3, [ADE7753_LVARENERGY] = 3,
+	[ADE7753_MODE]       = 2, [ADE7753_IRQEN]      = 2,
+	[ADE7753_STATUS]     = 2, [ADE7753_RSTSTATUS]  = 2,
+	[ADE7753_CH1OS]      = 1, [ADE7753_CH2OS]      = 1,
+	[ADE7753_GAIN]       = 1, [ADE7753_PHCAL]      = 1,
+	[ADE7753_APOS]       = 2, [ADE7753_WGAIN]      = 2,
+	[ADE7753_WDIV]       = 1, [ADE7753_CFNUM]      = 2,
+	[ADE7753_CFDEN]      = 2, [ADE7753_IRMS]       = 3,
+	[ADE7753_VRMS]       = 3, [ADE7753_IRMSOS]     = 2,
+	[ADE7753_VRMSOS]     = 2, [ADE7753_VAGAIN]     = 2,
+	[ADE7753_VADIV]      = 1, [ADE7753_LINECYC]    = 2,
+	[ADE7753_ZXTOUT]     = 2, [ADE7753_SAGCYC]     = 1,
+	[ADE7753_SAGLVL]     = 1, [ADE7753_IPKLVL]     = 1,
+	[ADE7753_VPKLVL]     = 1, [ADE7753_IPEAK]      = 3,
+	[ADE7753_RSTIPEAK]   = 3, [ADE7753_VPEAK]      = 3,
+	[ADE7753_RSTVPEAK]   = 3, [ADE7753_TEMP]       = 1,
+	[ADE7753_PERIOD]     = 2, [ADE7753_TMODE]      = 1,
+	[ADE7753_CHKSUM]     = 1, [ADE7753_DIEREV]     = 1,
+};
+
+#define ADE_MODE_DEFAULT   0x000C
+#define ADE_IRQEN_DEFAULT  0x0040
+#define ADE_DIEREV         0x02
+
+/** The meter state */
+static struct {
+	uint32_t regs[0x40];
+	// The IRMS of each channel load
+	uint32_t irms[SIM_CHANNELS];
+	// The line voltage VRMS
+	uint32_t vrms;
+	// The line period [us]
+	uint32_t period;
+	// The time [us] of the next zero-crossing, and the ZX output level
+	uint32_t zxAt;
+	uint8_t zx;
+	// The completion time [us] of the accumulation in progress, if any
+	uint32_t cycEnd;
+	uint8_t accumulating;
+	// The noise generator state
+	uint32_t seed;
+	// The samples read on each channel
+	uint32_t samples[SIM_CHANNELS];
+} ade = {
+	.vrms = 1000000,
+	.period = SIM_LINE_PERIOD_MS * 1000UL,
+	.zx = 1,
+	.seed = 1,
+};
+
+/** The SPI transfer in progress */
+static struct {
+	uint8_t addr;
+	uint8_t write;
+	// The data bytes still to transfer
+	uint8_t left;
+	uint8_t data[4];
+	uint8_t len;
+} xfer;
+
+//=====[ Meter Model ]==========================================================
+
+/** @brief Get the channel selected by the analog MUX */
+static uint8_t selectedChannel(void) {
+	uint8_t sel = PORTA & 0x0F;
+
+	// See the chSelectionMap of the sampler
+	if (sel >= 1 && sel <= 8)
+		return 8 - sel;
+	if (sel == 0)
+		return 8;
+	return 24 - sel;
+}
+
+/** @brief Add a +/-0.4% noise to a measure */
+static uint32_t noisy(uint32_t value) {
+	int32_t noise;
+
+	ade.seed = ade.seed * 1103515245UL + 12345;
+	noise = (int32_t)((ade.seed >> 16) & 0x1FF) - 0x100;
+	return value + (int32_t)(((int64_t)value * noise) >> 16);
+}
+
+static void updateIrq(void) {
+	uint16_t pending = ade.regs[ADE7753_STATUS] & ade.regs[ADE7753_IRQEN];
+
+	// The IRQ line is active low
+	sim_pinc(BV8(PC6), !pending);
+}
+
+static void meterReset(void) {
+	memset(ade.regs, 0, sizeof(ade.regs));
+	ade.regs[ADE7753_MODE] = ADE_MODE_DEFAULT;
+	ade.regs[ADE7753_IRQEN] = ADE_IRQEN_DEFAULT;
+	ade.regs[ADE7753_DIEREV] = ADE_DIEREV;
+	ade.regs[ADE7753_STATUS] = BV16(ADE7753_IRQ_RESET);
+	ade.accumulating = 0;
+	updateIrq();
+}
+
+/** @brief Get the accumulation time [us] of LINECYC half line cycles */
+static inline uint32_t cycleTime(void) {
+	return ade.regs[ADE7753_LINECYC] * (ade.period / 2);
+}
+
+static void startAccumulation(void) {
+	// Accumulations start at the next zero-crossing
+	ade.cycEnd = ade.zxAt + cycleTime();
+	ade.accumulating = 1;
+}
+
+/** @brief Latch the energy of a completed accumulation */
+static void endAccumulation(void) {
+	uint8_t ch = selectedChannel();
+	uint64_t lae;
+
+	lae = ((uint64_t)noisy(ade.irms[ch]) * ade.vrms) >> 26;
+	lae *= ade.regs[ADE7753_LINECYC];
+	// LAENERGY is a 24 bits two's complement register
+	ade.regs[ADE7753_LAENERGY] = MIN(lae, (uint64_t)0x7FFFFF);
+
+	ade.regs[ADE7753_STATUS] |= BV16(ADE7753_IRQ_CYCEND);
+	updateIrq();
+}
+
+/** @brief Update the meter, to be called periodically */
+void sim_adeTick(uint32_t now) {
+	uint32_t us = now * 1000UL;
+
+	ATOMIC(
+		// Without line voltage there are no zero-crossings
+		if (!ade.vrms)
+			ade.zxAt = us;
+		while ((int32_t)(us - ade.zxAt) >= 0 && ade.vrms) {
+			ade.zx ^= 1;
+			sim_pinc(BV8(PC7), ade.zx);
+			ade.zxAt += ade.period / 2;
+		}
+
+		if (ade.accumulating && ade.vrms &&
+				(int32_t)(us - ade.cycEnd) >= 0) {
+			endAccumulation();
+			// Accumulations are continuous in line cycle mode
+			ade.cycEnd += cycleTime();
+		}
+	);
+}
+
+void sim_adeLoad(uint8_t ch, uint32_t irms) {
+	ATOMIC(ade.irms[ch] = MIN(irms, (uint32_t)0xFFFFFF));
+}
+
+/** @brief Get the samples read on the specified channel since power-on */
+uint32_t sim_adeSamples(uint8_t ch) {
+	uint32_t samples;
+
+	ATOMIC(samples = ade.samples[ch]);
+	return samples;
+}
+
+/** @brief Set the line frequency [mHz] */
+void sim_adeFrequency(uint32_t mhz) {
+	ATOMIC(ade.period = 1000000000UL / mhz);
+}
+
+void sim_adeVoltage(uint32_t vrms) {
+	ATOMIC(
+		ade.vrms = MIN(vrms, (uint32_t)0xFFFFFF);
+		// Restart from the next zero-crossing
+		if (ade.accumulating)
+			startAccumulation();
+	);
+}
+
+//=====[ Registers Access ]=====================================================
+
+static uint32_t regRead(uint8_t addr) {
+	uint32_t value;
+
+	switch (addr) {
+	case ADE7753_IRMS:
+		return ade.vrms ? noisy(ade.irms[selectedChannel()]) : 0;
+	case ADE7753_VRMS:
+		return noisy(ade.vrms);
+	case ADE7753_LAENERGY:
+		ade.samples[selectedChannel()]++;
+		break;
+	case ADE7753_RSTSTATUS:
+		value = ade.regs[ADE7753_STATUS];
+		ade.regs[ADE7753_STATUS] = 0;
+		updateIrq();
+		return value;
+	case ADE7753_PERIOD:
+		// The line period, in 2.2us units
+		return ade.vrms ? (ade.period * 1000UL) / ADE7753_PERIOD_LSB_NS : 0;
+	}
+
+	return ade.regs[addr];
+}
+
+static void regWrite(uint8_t addr, uint32_t value) {
+
+	switch (addr) {
+	case ADE7753_MODE:
+		if (value & BV16(ADE7753_SWRST)) {
+			meterReset();
+			return;
+		}
+		ade.regs[addr] = value;
+		if (!(value & BV16(ADE7753_CYCMODE)))
+			ade.accumulating = 0;
+		else if (!ade.accumulating)
+			startAccumulation();
+		return;
+	case ADE7753_IRQEN:
+		ade.regs[addr] = value;
+		updateIrq();
+		return;
+	case ADE7753_LINECYC:
+		ade.regs[addr] = value;
+		// Restart any accumulation in progress
+		if (ade.accumulating)
+			startAccumulation();
+		return;
+	}
+
+	// Read-only registers
+	if (addr <= ADE7753_LVARENERGY || addr == ADE7753_IRMS ||
+			addr == ADE7753_VRMS || addr >= ADE7753_IPEAK)
+		return;
+
+	ade.regs[addr] = value;
+}
+
+//=====[ Fake SPI ]=============================================================
+
+/** @brief Begin a transfer by its address byte */
+static void xferBegin(uint8_t cmd) {
+	uint32_t value;
+
+	xfer.addr = cmd & 0x3F;
+	xfer.write = cmd & 0x80;
+	xfer.left = regSize[xfer.addr];
+	xfer.len = 0;
+
+	if (xfer.write || !xfer.left)
+		return;
+
+	// Registers are shifted out MSB first
+	value = regRead(xfer.addr);
+	for (uint8_t i = xfer.left; i; --i) {
+		xfer.data[i-1] = value & 0xFF;
+		value >>= 8;
+	}
+}
+
+static void xferEnd(void) {
+	uint32_t value = 0;
+
+	for (uint8_t i = 0; i < xfer.len; ++i)
+		value = (value << 8) | xfer.data[i];
+	regWrite(xfer.addr, value);
+}
+
+static size_t spi_write(UNUSED_ARG(struct KFile *, fd),
+		const void *_buf, size_t size) {
+	const uint8_t *buf = (const uint8_t *)_buf;
+
+	ATOMIC(
+		for (size_t i = 0; i < size; ++i) {
+			if (!xfer.left) {
+				xferBegin(buf[i]);
+				continue;
+			}
+			// Bytes shifted in by reads are ignored
+			if (!xfer.write)
+				continue;
+			xfer.data[xfer.len++] = buf[i];
+			if (!--xfer.left)
+				xferEnd();
+		}
+	);
+
+	return size;
+}
+
+static size_t spi_read(UNUSED_ARG(struct KFile *, fd),
+		void *_buf, size_t size) {
+	uint8_t *buf = (uint8_t *)_buf;
+
+	ATOMIC(
+		for (size_t i = 0; i < size; ++i) {
+			if (!xfer.left || xfer.write) {
+				buf[i] = 0x00;
+				continue;
+			}
+			buf[i] = xfer.data[xfer.len++];
+			xfer.left--;
+		}
+	);
+
+	return size;
+}
+
+static int spi_flush(UNUSED_ARG(struct KFile *, fd)) {
+	return 0;
+}
+
+static KFile spi;
+
+/** @brief Get the SPI port of the meter */
+KFile *sim_adeSpi(void) {
+	kfile_init(&spi);
+	spi.read = spi_read;
+	spi.write = spi_write;
+	spi.flush = spi_flush;
+
+	meterReset();
+	return &spi;
+}
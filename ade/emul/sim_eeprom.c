@@ -0,0 +1,126 @@
+/**
+ *       @file  sim_eeprom.c
+ *      @brief  Simulated EEPROM
+ *
+ * The EEMEM variables are linked into the "sim_eeprom" section, which is the
+ * EEPROM image: at boot it is loaded from the backing file, if its size
+ * matches, otherwise the file is initialized with the image defaults, just
+ * like a freshly programmed device. Updates are written through to the file,
+ * which thus keeps the EEPROM content across resets and runs.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "sim.h"
+
+#include <avr/eeprom.h>
+
+#include <cfg/debug.h>
+#include <emul/kfile_posix.h>
+
+#include <stdio.h> // fileno
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h> // ftruncate
+
+// The EEPROM image boundaries, provided by the linker
+extern uint8_t __start_sim_eeprom[];
+extern uint8_t __stop_sim_eeprom[];
+
+#define EE_BASE __start_sim_eeprom
+#define EE_SIZE ((size_t)(__stop_sim_eeprom - __start_sim_eeprom))
+
+// The backing file
+static KFilePosix eeFile;
+
+static void eeSave(const void *addr, size_t n) {
+	kfile_off_t off = (const uint8_t *)addr - EE_BASE;
+
+	kfile_seek(&eeFile.fd, off, KSM_SEEK_SET);
+	kfile_write(&eeFile.fd, addr, n);
+	kfile_flush(&eeFile.fd);
+}
+
+void sim_eepromInit(const char *path) {
+	uint8_t *image;
+	size_t size = 0;
+
+	if (kfile_posix_init(&eeFile, path, "r+b")) {
+		image = malloc(EE_SIZE);
+		size = kfile_read(&eeFile.fd, image, EE_SIZE);
+		// The image layout changes with the firmware
+		if (size == EE_SIZE && kfile_read(&eeFile.fd, image, 1) == 0) {
+			memcpy(EE_BASE, image, EE_SIZE);
+			sim_log("EEPROM loaded [%s, %zu bytes]", path, size);
+		} else {
+			size = 0;
+		}
+		free(image);
+	} else if (!kfile_posix_init(&eeFile, path, "w+b")) {
+		sim_log("EEPROM file [%s] not available", path);
+		exit(2);
+	}
+
+	if (size)
+		return;
+
+	// Program the defaults
+	if (ftruncate(fileno(eeFile.fp), 0) != 0)
+		sim_log("EEPROM file [%s] not truncated", path);
+	eeSave(EE_BASE, EE_SIZE);
+	sim_log("EEPROM programmed [%s, %zu bytes]", path, EE_SIZE);
+}
+
+static inline void eeCheck(const void *addr, size_t n) {
+	ASSERT((const uint8_t *)addr >= EE_BASE);
+	ASSERT((const uint8_t *)addr + n <= EE_BASE + EE_SIZE);
+	(void)addr;
+	(void)n;
+}
+
+uint8_t eeprom_read_byte(const uint8_t *addr) {
+	eeCheck(addr, 1);
+	return *addr;
+}
+
+uint16_t eeprom_read_word(const uint16_t *addr) {
+	uint16_t value;
+
+	eeCheck(addr, 2);
+	memcpy(&value, addr, 2);
+	return value;
+}
+
+void eeprom_read_block(void *dst, const void *src, size_t n) {
+	eeCheck(src, n);
+	memcpy(dst, src, n);
+}
+
+void eeprom_update_block(const void *src, void *dst, size_t n) {
+	eeCheck(dst, n);
+
+	// Just the changed bytes are actually written
+	if (!memcmp(dst, src, n))
+		return;
+	memcpy(dst, src, n);
+	eeSave(dst, n);
+}
+
+void eeprom_update_byte(uint8_t *addr, uint8_t value) {
+	eeprom_update_block(&value, addr, 1);
+}
+
+void eeprom_update_word(uint16_t *addr, uint16_t value) {
+	eeprom_update_block(&value, addr, 2);
+}
@@ -0,0 +1,517 @@
+/**
+ *       @file  sim_modem.c
+ *      @brief  Simulated SIM900 GSM modem
+ *
+ * This provides the GSM modem on the UART1, with the subset of the AT
+ * command set used by the firmware: echo and verbose modes, network
+ * registration and signal quality, SMS text mode reading, deleting and
+ * sending. Received SMS are stored into the SIM slots and announced by
+ * +CMTI, once the new message indications have been enabled.
+ *
+ * The modem is driven by the POWER (PD5) and RESET (PD6) lines, both active
+ * low when driven, and reports its state on the STATUS (PD4) line.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "sim.h"
+
+#include <avr/io.h>
+
+#include <cfg/macros.h>
+#include <cpu/irq.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The number of SIM slots, i.e. the SMS indexes 1..20
+#define MODEM_SLOTS 20
+// The number of SMS waiting for the network
+#define MODEM_INBOX 16
+
+// The time [ms] the POWER key must be hold to toggle the power
+#define MODEM_PWRKEY_MS 1000
+
+#define MODEM_CTRLZ 0x1A
+#define MODEM_ESC   0x1B
+
+/** An SMS stored into the SIM */
+typedef struct sim_sms {
+	uint8_t used;
+	uint8_t read;
+	char from[16];
+	char time[24];
+	char text[161];
+} sim_sms_t;
+
+/** The modem state */
+static struct {
+	uint8_t power;
+	// The network is available
+	uint8_t network;
+	// The command settings, which are lost on power-off
+	uint8_t echo;
+	uint8_t verbose;
+	uint8_t cnmi;
+	uint8_t creg;
+	// The command line being received
+	char cmd[64];
+	uint8_t len;
+	// The SMS being sent, once the prompt has been issued
+	uint8_t payload;
+	char dest[16];
+	char text[161];
+	uint8_t textLen;
+	// The SMS message reference
+	uint8_t mr;
+	// The time the POWER key has been pressed, 0 if released
+	uint32_t pwrKeyAt;
+	uint8_t resetKey;
+} modem = {
+	.network = 1,
+};
+
+static sim_sms_t slots[MODEM_SLOTS];
+
+// The SMS waiting for the network
+static sim_sms_t inbox[MODEM_INBOX];
+
+// The bytes to transmit
+static char out[1024];
+static uint16_t outHead = 0;
+static uint16_t outTail = 0;
+
+//=====[ Output ]===============================================================
+
+static void emitRaw(const char *str) {
+	uint16_t next;
+
+	for ( ; *str; ++str) {
+		next = (outTail + 1) % sizeof(out);
+		// Overflowing bytes are lost, as on a real UART
+		if (next == outHead)
+			return;
+		out[outTail] = *str;
+		outTail = next;
+	}
+}
+
+/** @brief Emit an information response or an URC */
+static void emitInfo(const char *fmt, ...) FORMAT(printf, 1, 2);
+static void emitInfo(const char *fmt, ...) {
+	char buff[200];
+	va_list ap;
+
+	va_start(ap, fmt);
+	vsnprintf(buff, sizeof(buff), fmt, ap);
+	va_end(ap);
+
+	if (modem.verbose)
+		emitRaw("\r\n");
+	emitRaw(buff);
+	emitRaw("\r\n");
+}
+
+/** @brief Emit a final result code */
+static void emitResult(uint8_t code) {
+	static const char *verbose[] = {
+		[0] = "OK",
+		[4] = "ERROR",
+	};
+
+	if (!modem.verbose) {
+		char numeric[] = "0\r";
+		numeric[0] += code;
+		emitRaw(numeric);
+		return;
+	}
+	emitRaw("\r\n");
+	emitRaw(verbose[code]);
+	emitRaw("\r\n");
+}
+
+#define RESULT_OK    0
+#define RESULT_ERROR 4
+
+int sim_modemGetc(void) {
+	int c = -1;
+
+	ATOMIC(
+		if (outHead != outTail) {
+			c = (uint8_t)out[outHead];
+			outHead = (outHead + 1) % sizeof(out);
+		}
+	);
+
+	return c;
+}
+
+//=====[ Power and Network ]====================================================
+
+static void modemReset(void) {
+	modem.echo = 1;
+	modem.verbose = 1;
+	modem.cnmi = 0;
+	modem.creg = 0;
+	modem.len = 0;
+	modem.payload = 0;
+	outHead = outTail = 0;
+}
+
+/** @brief Switch the modem power, which is kept across board resets */
+void sim_modemPower(uint8_t on) {
+	modem.power = on;
+	modemReset();
+
+	// The STATUS line
+	if (on)
+		PIND |= BV8(PD4);
+	else
+		PIND &= ~BV8(PD4);
+
+	sim_log("Modem %s", on ? "ON" : "OFF");
+}
+
+uint8_t sim_modemPowered(void) {
+	return modem.power;
+}
+
+static inline uint8_t cregStat(void) {
+	// 1 registered, home network; 2 searching
+	return modem.network ? 1 : 2;
+}
+
+void sim_modemNetwork(uint8_t on) {
+	ATOMIC(
+		modem.network = on;
+		if (modem.power && modem.creg)
+			emitInfo("+CREG: %u", cregStat());
+	);
+	sim_log("Network %s", on ? "UP" : "DOWN");
+}
+
+/** @brief Store an SMS into a free SIM slot, returning its index */
+static uint8_t storeSMS(const sim_sms_t *sms) {
+	for (uint8_t i = 0; i < MODEM_SLOTS; ++i) {
+		if (slots[i].used)
+			continue;
+		slots[i] = *sms;
+		slots[i].used = 1;
+		slots[i].read = 0;
+		return i + 1;
+	}
+	return 0;
+}
+
+/** @brief Deliver the SMS waiting for the network */
+static void deliverSMS(void) {
+	uint8_t index;
+
+	if (!modem.power || !modem.network)
+		return;
+
+	for (uint8_t i = 0; i < MODEM_INBOX; ++i) {
+		if (!inbox[i].used)
+			continue;
+		index = storeSMS(&inbox[i]);
+		if (!index) {
+			sim_log("SMS from [%s] lost, SIM full", inbox[i].from);
+		} else if (modem.cnmi) {
+			emitInfo("+CMTI: \"SM\",%u", index);
+		}
+		inbox[i].used = 0;
+	}
+}
+
+void sim_modemSMS(const char *from, const char *text) {
+	uint32_t now = sim_now() / 1000;
+	sim_sms_t *sms = NULL;
+
+	ATOMIC(
+		for (uint8_t i = 0; i < MODEM_INBOX; ++i) {
+			if (inbox[i].used)
+				continue;
+			sms = &inbox[i];
+			break;
+		}
+		if (sms) {
+			snprintf(sms->from, sizeof(sms->from), "%s", from);
+			snprintf(sms->text, sizeof(sms->text), "%s", text);
+			snprintf(sms->time, sizeof(sms->time),
+					"26/10/16,%02lu:%02lu:%02lu+08",
+					(unsigned long)(now / 3600) % 24,
+					(unsigned long)(now / 60) % 60,
+					(unsigned long)now % 60);
+			sms->used = 1;
+		}
+	);
+
+	if (!sms) {
+		sim_log("SMS from [%s] lost, network busy", from);
+		return;
+	}
+	sim_log("SMS from [%s]: %s", from, text);
+}
+
+/** @brief Track the control lines, to be called periodically */
+void sim_modemTick(uint32_t now) {
+	uint8_t pwrKey, resetKey;
+
+	// The control lines are asserted by driving them low
+	pwrKey = (DDRD & BV8(PD5)) && !(PORTD & BV8(PD5));
+	resetKey = (DDRD & BV8(PD6)) && !(PORTD & BV8(PD6));
+
+	ATOMIC(
+		if (pwrKey && !modem.pwrKeyAt) {
+			modem.pwrKeyAt = now ? now : 1;
+		} else if (!pwrKey && modem.pwrKeyAt) {
+			if (now - modem.pwrKeyAt >= MODEM_PWRKEY_MS)
+				sim_modemPower(!modem.power);
+			modem.pwrKeyAt = 0;
+		}
+
+		// The modem restarts on the RESET line release
+		if (modem.resetKey && !resetKey && modem.power) {
+			modemReset();
+			sim_log("Modem RESET");
+		}
+		modem.resetKey = resetKey;
+
+		deliverSMS();
+	);
+}
+
+//=====[ Commands ]=============================================================
+
+static uint8_t cmdSMSRead(uint8_t index) {
+	sim_sms_t *sms;
+
+	if (!index || index > MODEM_SLOTS)
+		return RESULT_ERROR;
+
+	// Empty slots return just the result code
+	sms = &slots[index-1];
+	if (!sms->used)
+		return RESULT_OK;
+
+	emitInfo("+CMGR: \"%s\",\"%s\",\"\",\"%s\"",
+			sms->read ? "REC READ" : "REC UNREAD",
+			sms->from, sms->time);
+	emitRaw(sms->text);
+	emitRaw("\r\n");
+	sms->read = 1;
+
+	return RESULT_OK;
+}
+
+static uint8_t cmdSMSList(void) {
+	for (uint8_t i = 0; i < MODEM_SLOTS; ++i) {
+		if (!slots[i].used)
+			continue;
+		emitInfo("+CMGL: %u,\"%s\",\"%s\",\"\",\"%s\"",
+				i + 1,
+				slots[i].read ? "REC READ" : "REC UNREAD",
+				slots[i].from, slots[i].time);
+		emitRaw(slots[i].text);
+		emitRaw("\r\n");
+	}
+	return RESULT_OK;
+}
+
+static uint8_t cmdSMSDelete(const char *args) {
+	uint8_t index = atoi(args);
+	const char *p = strchr(args, ',');
+	uint8_t flag = p ? atoi(p+1) : 0;
+
+	if (flag == 0) {
+		if (!index || index > MODEM_SLOTS)
+			return RESULT_ERROR;
+		slots[index-1].used = 0;
+		return RESULT_OK;
+	}
+
+	// 1..3 delete the read messages, 4 all of them
+	for (uint8_t i = 0; i < MODEM_SLOTS; ++i) {
+		if (flag < 4 && !slots[i].read)
+			continue;
+		slots[i].used = 0;
+	}
+	return RESULT_OK;
+}
+
+static uint8_t cmdSMSSend(const char *args) {
+	const char *p;
+	uint8_t len;
+
+	// AT+CMGS="<number>"[,<type>]
+	if (*args++ != '"' || !(p = strchr(args, '"')))
+		return RESULT_ERROR;
+	len = MIN((size_t)(p - args), sizeof(modem.dest) - 1);
+	memcpy(modem.dest, args, len);
+	modem.dest[len] = '\0';
+
+	modem.payload = 1;
+	modem.textLen = 0;
+	emitRaw("\r\n> ");
+
+	// The result follows the payload
+	return 0xFF;
+}
+
+static void payloadEnd(void) {
+	modem.payload = 0;
+	modem.text[modem.textLen] = '\0';
+
+	if (!modem.network) {
+		emitInfo("+CMS ERROR: 331");
+		sim_log("SMS to [%s] failed, no network", modem.dest);
+		return;
+	}
+
+	emitInfo("+CMGS: %u", ++modem.mr);
+	emitResult(RESULT_OK);
+	sim_scenarioSMS(modem.dest, modem.text);
+}
+
+static void payloadPut(char c) {
+
+	switch (c) {
+	case MODEM_CTRLZ:
+		payloadEnd();
+		return;
+	case MODEM_ESC:
+		modem.payload = 0;
+		emitResult(RESULT_OK);
+		return;
+	case '\n':
+		// The terminator of the command line
+		if (!modem.textLen)
+			return;
+		break;
+	}
+
+	if (modem.textLen < sizeof(modem.text) - 1)
+		modem.text[modem.textLen++] = c;
+}
+
+static uint8_t cmdExtended(const char *cmd) {
+
+	if (!strcmp(cmd, "+CREG?")) {
+		emitInfo("+CREG: %u,%u", modem.creg, cregStat());
+		return RESULT_OK;
+	}
+	if (!strncmp(cmd, "+CREG=", 6)) {
+		modem.creg = atoi(cmd+6);
+		return RESULT_OK;
+	}
+	if (!strcmp(cmd, "+CSQ")) {
+		if (modem.network)
+			emitInfo("+CSQ: 18,0");
+		else
+			emitInfo("+CSQ: 99,99");
+		return RESULT_OK;
+	}
+	if (!strcmp(cmd, "+CPIN?")) {
+		emitInfo("+CPIN: READY");
+		return RESULT_OK;
+	}
+	if (!strncmp(cmd, "+CNMI=", 6)) {
+		// AT+CNMI=<mode>,<mt>,...
+		const char *p = strchr(cmd, ',');
+		modem.cnmi = p ? atoi(p+1) : 0;
+		return RESULT_OK;
+	}
+	if (!strcmp(cmd, "+CENG?")) {
+		emitInfo("+CENG: 1,1");
+		emitInfo("+CENG: 0,\"0017,47,00,222,01,37,5e6b,02,00,26a1,255\"");
+		for (uint8_t i = 1; i < 7; ++i)
+			emitInfo("+CENG: %u,\"0000,00,00,0000,000,00\"", i);
+		return RESULT_OK;
+	}
+	if (!strcmp(cmd, "+GSN")) {
+		emitInfo("861234567890123");
+		return RESULT_OK;
+	}
+	if (!strcmp(cmd, "+CIMI")) {
+		emitInfo("222011234567890");
+		return RESULT_OK;
+	}
+	if (!strcmp(cmd, "+CCID")) {
+		emitInfo("8939011234567890123");
+		return RESULT_OK;
+	}
+	if (!strcmp(cmd, "+GMR")) {
+		emitInfo("Revision:1137B01SIM900M64_ST");
+		return RESULT_OK;
+	}
+	if (!strncmp(cmd, "+CMGR=", 6))
+		return cmdSMSRead(atoi(cmd+6));
+	if (!strncmp(cmd, "+CMGD=", 6))
+		return cmdSMSDelete(cmd+6);
+	if (!strncmp(cmd, "+CMGL", 5))
+		return cmdSMSList();
+	if (!strncmp(cmd, "+CMGS=", 6))
+		return cmdSMSSend(cmd+6);
+
+	// Other settings are just accepted
+	return RESULT_OK;
+}
+
+static void cmdRun(char *cmd) {
+	uint8_t result = RESULT_OK;
+
+	if (strncasecmp(cmd, "AT", 2)) {
+		// Not a command, e.g. the LF of a CR-LF terminator
+		if (*cmd)
+			emitResult(RESULT_ERROR);
+		return;
+	}
+	cmd += 2;
+
+	if (!strcmp(cmd, "E0"))
+		modem.echo = 0;
+	else if (!strcmp(cmd, "E1"))
+		modem.echo = 1;
+	else if (!strcmp(cmd, "V0"))
+		modem.verbose = 0;
+	else if (!strcmp(cmd, "V1"))
+		modem.verbose = 1;
+	else if (*cmd == '+')
+		result = cmdExtended(cmd);
+
+	if (result != 0xFF)
+		emitResult(result);
+}
+
+void sim_modemPutc(char c) {
+	ATOMIC(
+		if (!modem.power) {
+			// Not listening
+		} else if (modem.payload) {
+			payloadPut(c);
+		} else {
+			if (modem.echo)
+				emitRaw((char[]){ c, '\0' });
+			if (c == '\r') {
+				modem.cmd[modem.len] = '\0';
+				modem.len = 0;
+				cmdRun(modem.cmd);
+			} else if (c != '\n' && modem.len < sizeof(modem.cmd) - 1) {
+				modem.cmd[modem.len++] = c;
+			}
+		}
+	);
+}
@@ -0,0 +1,208 @@
+/**
+ *       @file  sim_pca9555.c
+ *      @brief  Simulated PCA9555 port expander
+ *
+ * This provides the I2C bus of the board, with the PCA9555 which reports
+ * the channels presence: the input of a powered-on channel is low.
+ * Changes of the inputs assert the INT line (PC2, active low), which is
+ * released once the input ports are read.
+ * Bouncing inputs are replayed by toggling them at growing intervals, as
+ * the contacts of a power-on switch would do.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "sim.h"
+
+#include <avr/io.h>
+
+#include <cfg/macros.h>
+#include <cpu/irq.h>
+#include <drv/i2c.h>
+#include <drv/pca9555.h>
+
+// The expander address pins, A2..A0
+#define PCA_ADDR 0
+
+// The time [ms] between two toggles of bouncing inputs, growing by this
+// amount at each toggle
+#define PCA_BOUNCE_MS 1
+
+/** The expander state */
+static struct {
+	// The registers, in pairs of port 0 and port 1
+	uint8_t regs[8];
+	// The inputs value at the last read
+	uint16_t latched;
+	// The register pointer
+	uint8_t ptr;
+	// Set when the register pointer is expected
+	uint8_t command;
+	// Set while the expander does not answer on the bus
+	uint8_t fault;
+} pca = {
+	// All the channels are powered-off
+	.regs = { 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0xFF, 0xFF },
+	.latched = 0xFFFF,
+};
+
+/** The bouncing inputs */
+static struct {
+	// The bitmask of the channels inputs bouncing
+	uint16_t chs;
+	// The number of toggles still to replay
+	uint8_t toggles;
+	// The time [ms] of the next toggle, and the interval to the following
+	uint32_t next;
+	uint16_t gap;
+} bounce;
+
+static inline uint16_t inputs(void) {
+	return pca.regs[0] | ((uint16_t)pca.regs[1] << 8);
+}
+
+/** @brief Update the INT line, active low */
+static void updateInt(void) {
+	sim_pinc(BV8(PC2), inputs() == pca.latched);
+}
+
+/** @brief Set the presence of a channel */
+void sim_pcaPresent(uint8_t ch, uint8_t present) {
+	ATOMIC(
+		if (present)
+			pca.regs[ch >> 3] &= ~BV8(ch & 0x7);
+		else
+			pca.regs[ch >> 3] |= BV8(ch & 0x7);
+		updateInt();
+	);
+}
+
+/** @brief Set the expander answering on the I2C bus, or failing */
+void sim_pcaBus(uint8_t on) {
+	pca.fault = !on;
+	sim_log("I2C %s", on ? "UP" : "DOWN");
+}
+
+/** @brief Toggle the inputs of the bouncing channels */
+static void toggle(void) {
+	ATOMIC(
+		pca.regs[0] ^= bounce.chs & 0xFF;
+		pca.regs[1] ^= bounce.chs >> 8;
+		updateInt();
+	);
+	--bounce.toggles;
+}
+
+/**
+ * @brief Bounce the presence of some channels
+ *
+ * @param chs the bitmask of the channels
+ * @param count the number of toggles of the channels presence, i.e. the
+ * presence is reverted by an odd count
+ */
+void sim_pcaBounce(uint16_t chs, uint8_t count) {
+
+	// Complete a previous bounce, e.g. when replayed after a reset
+	while (bounce.toggles)
+		toggle();
+
+	bounce.chs = chs;
+	bounce.toggles = count;
+	bounce.gap = PCA_BOUNCE_MS;
+	bounce.next = sim_now();
+}
+
+/** @brief Replay the bouncing inputs due by \a now */
+void sim_pcaTick(uint32_t now) {
+
+	while (bounce.toggles && (int32_t)(now - bounce.next) >= 0) {
+		toggle();
+		bounce.next += bounce.gap;
+		bounce.gap += PCA_BOUNCE_MS;
+	}
+}
+
+//=====[ Fake I2C ]=============================================================
+
+static void i2c_simStart(struct I2c *i2c, uint16_t slave_addr) {
+
+	if (pca.fault ||
+			(slave_addr & 0xFE) != (PCA9555ID | (PCA_ADDR << 1))) {
+		i2c->errors |= I2C_NO_ACK;
+		return;
+	}
+
+	// Writes begin with the register pointer
+	pca.command = !(I2C_TEST_START(i2c->flags) == I2C_START_R);
+}
+
+static void i2c_simPutc(UNUSED_ARG(struct I2c *, i2c), uint8_t data) {
+
+	if (pca.fault)
+		return;
+
+	ATOMIC(
+		if (pca.command) {
+			pca.ptr = data & 0x7;
+			pca.command = 0;
+		} else {
+			// Input ports are read-only
+			if (pca.ptr > 1)
+				pca.regs[pca.ptr] = data;
+			// Accesses toggle within a registers pair
+			pca.ptr ^= 0x1;
+		}
+	);
+}
+
+static uint8_t i2c_simGetc(UNUSED_ARG(struct I2c *, i2c)) {
+	uint8_t data;
+
+	// The bus lines are pulled-up
+	if (pca.fault)
+		return 0xFF;
+
+	ATOMIC(
+		data = pca.regs[pca.ptr];
+		if (pca.ptr < 2) {
+			pca.latched = inputs();
+			updateInt();
+		}
+		pca.ptr ^= 0x1;
+	);
+
+	return data;
+}
+
+static const I2cVT i2c_sim_vt = {
+	.start = i2c_simStart,
+	.getc = i2c_simGetc,
+	.putc = i2c_simPutc,
+	.write = i2c_genericWrite,
+	.read = i2c_genericRead,
+};
+
+void i2c_hw_init(I2c *i2c, int dev, UNUSED_ARG(uint32_t, clock)) {
+	ASSERT(dev == I2C0);
+	(void)dev;
+
+	i2c->hw = NULL;
+	i2c->vt = &i2c_sim_vt;
+	i2c->errors = 0;
+	i2c->xfer_size = 0;
+}
+
+void i2c_hw_bitbangInit(UNUSED_ARG(I2c *, i2c), UNUSED_ARG(int, dev)) {
+	ASSERT(0);
+}
@@ -0,0 +1,512 @@
+/**
+ *       @file  sim_scenario.c
+ *      @brief  Simulation scenarios
+ *
+ * A scenario is a text file of timed events, one per line:
+ *   <time[s]> <command> [arguments]
+ * where '#' starts a comment and the commands are:
+ *   load <chs> <irms>    set the IRMS of the channels load
+ *   volt <vrms>          set the line VRMS, 0 for a blackout
+ *   freq <hz>            set the line frequency, e.g. 49.8
+ *   plug <chs>           power-on the channels
+ *   unplug <chs>         power-off the channels
+ *   bounce <chs> <count> toggle the channels presence count times, at
+ *                        growing intervals of 1, 2, ... ms
+ *   net on|off           set the GSM network availability
+ *   i2c on|off           set the port expander answering on the I2C bus
+ *   sms <from> [text]    receive an SMS, where "\n" is a line break
+ *   console <text>       enter a console command
+ *   button               press the button
+ *   reset                press the reset button
+ *   rate [min]           report the channels sampled per second since the
+ *                        previous rate (or the board reset), terminating
+ *                        with a failure if lower than min, e.g. 2.5
+ *   quit                 terminate, failing if some expectations are unmet
+ * while the lines
+ *   expect <text>
+ * require an SMS containing the text to be sent before quitting.
+ * Channels <chs> are "all" or a comma separated list of 1-based channels
+ * numbers and ranges, e.g. "1,3-5".
+ *
+ * At power-on all the channels are unplugged, with a nominal load, and the
+ * network and the I2C bus are available.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "sim.h"
+
+#include <avr/io.h>
+
+#include <cfg/macros.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The maximum number of events and expectations
+#define SCENARIO_EVENTS  128
+#define SCENARIO_EXPECTS 16
+
+// The nominal load of a channel
+#define SCENARIO_IRMS 40000UL
+#define SCENARIO_VRMS 1000000UL
+
+// The time [ms] the button is kept pressed
+#define SCENARIO_BUTTON_MS 100
+
+typedef enum sim_evt_types {
+	EVT_LOAD = 0,
+	EVT_VOLT,
+	EVT_FREQ,
+	EVT_PLUG,
+	EVT_UNPLUG,
+	EVT_BOUNCE,
+	EVT_NET,
+	EVT_I2C,
+	// The events above set the board inputs, i.e. they are replayed when
+	// the scenario is resumed after a reset
+	EVT_STATE,
+	EVT_SMS = EVT_STATE,
+	EVT_CONSOLE,
+	EVT_BUTTON,
+	EVT_RESET,
+	EVT_RATE,
+	EVT_QUIT,
+} sim_evt_types_t;
+
+typedef struct sim_evt {
+	uint32_t at;
+	uint8_t type;
+	uint16_t chs;
+	uint32_t value;
+	// The SMS sender or the console text
+	char *from;
+	char *text;
+} sim_evt_t;
+
+static sim_evt_t events[SCENARIO_EVENTS];
+static uint8_t eventsCount = 0;
+static uint8_t next = 0;
+
+static char *expects[SCENARIO_EXPECTS];
+static uint8_t expectsCount = 0;
+// The bitmask of the expectations met
+static uint32_t expectsMet = 0;
+
+// The time the button has to be released, 0 if not pressed
+static uint32_t buttonUntil = 0;
+
+// The time, and the samples read on each channel, of the last rate report
+static uint32_t rateAt = 0;
+static uint32_t rateSamples[SIM_CHANNELS];
+
+//=====[ Parsing ]==============================================================
+
+/** @brief Parse a channels list, returning its bitmask, 0 on errors */
+static uint16_t parseChannels(const char *str) {
+	uint16_t mask = 0;
+	unsigned long first, last;
+	char *end;
+
+	if (!strcmp(str, "all"))
+		return 0xFFFF;
+
+	while (*str) {
+		first = strtoul(str, &end, 10);
+		last = first;
+		if (*end == '-')
+			last = strtoul(end+1, &end, 10);
+		if (end == str || !first || last < first || last > SIM_CHANNELS)
+			return 0;
+		for ( ; first <= last; ++first)
+			mask |= BV16(first-1);
+		if (*end == ',')
+			++end;
+		else if (*end)
+			return 0;
+		str = end;
+	}
+
+	return mask;
+}
+
+/** @brief Split the next word of \a str, NULL if none */
+static char *parseWord(char **str) {
+	char *word = *str + strspn(*str, " \t");
+	char *end;
+
+	if (!*word)
+		return NULL;
+	end = word + strcspn(word, " \t");
+	*str = end;
+	if (*end) {
+		*end = '\0';
+		*str = end + 1;
+	}
+	return word;
+}
+
+/** @brief Get the text till the end of \a str, NULL if empty */
+static char *parseText(char *str) {
+	str += strspn(str, " \t");
+	return *str ? strdup(str) : NULL;
+}
+
+/** @brief Replace the "\n" escapes of \a str by line breaks */
+static char *parseBreaks(char *str) {
+	char *dst = str;
+
+	if (!str)
+		return NULL;
+
+	for (const char *src = str; *src; ++src) {
+		if (src[0] == '\\' && src[1] == 'n') {
+			*dst++ = '\n';
+			++src;
+			continue;
+		}
+		*dst++ = *src;
+	}
+	*dst = '\0';
+
+	return str;
+}
+
+static int parseEvent(sim_evt_t *evt, char *args) {
+	char *cmd = parseWord(&args);
+	char *text = args + strspn(args, " \t");
+	char *arg = parseWord(&args);
+	char *rest = parseText(args);
+
+	if (!cmd)
+		return -1;
+
+	if (!strcmp(cmd, "load") && arg && rest) {
+		evt->type = EVT_LOAD;
+		evt->chs = parseChannels(arg);
+		evt->value = strtoul(rest, NULL, 0);
+		free(rest);
+		return evt->chs ? 0 : -1;
+	}
+	if (!strcmp(cmd, "volt") && arg) {
+		evt->type = EVT_VOLT;
+		evt->value = strtoul(arg, NULL, 0);
+		return 0;
+	}
+	if (!strcmp(cmd, "freq") && arg) {
+		evt->type = EVT_FREQ;
+		evt->value = strtod(arg, NULL) * 1000;
+		return (evt->value >= 10000 && evt->value <= 100000) ? 0 : -1;
+	}
+	if ((!strcmp(cmd, "plug") || !strcmp(cmd, "unplug")) && arg) {
+		evt->type = (cmd[0] == 'p') ? EVT_PLUG : EVT_UNPLUG;
+		evt->chs = parseChannels(arg);
+		return evt->chs ? 0 : -1;
+	}
+	if (!strcmp(cmd, "bounce") && arg && rest) {
+		evt->type = EVT_BOUNCE;
+		evt->chs = parseChannels(arg);
+		evt->value = strtoul(rest, NULL, 0);
+		free(rest);
+		return (evt->chs && evt->value && evt->value <= 255) ? 0 : -1;
+	}
+	if (!strcmp(cmd, "net") && arg) {
+		evt->type = EVT_NET;
+		evt->value = !strcmp(arg, "on");
+		return (evt->value || !strcmp(arg, "off")) ? 0 : -1;
+	}
+	if (!strcmp(cmd, "i2c") && arg) {
+		evt->type = EVT_I2C;
+		evt->value = !strcmp(arg, "on");
+		return (evt->value || !strcmp(arg, "off")) ? 0 : -1;
+	}
+	if (!strcmp(cmd, "sms") && arg) {
+		evt->type = EVT_SMS;
+		evt->from = strdup(arg);
+		evt->text = parseBreaks(rest);
+		return 0;
+	}
+	if (!strcmp(cmd, "console") && arg) {
+		// The whole text, which is split by parseWord()
+		if (rest)
+			arg[strlen(arg)] = ' ';
+		evt->type = EVT_CONSOLE;
+		evt->text = parseText(text);
+		return 0;
+	}
+	if (!strcmp(cmd, "button")) {
+		evt->type = EVT_BUTTON;
+		return 0;
+	}
+	if (!strcmp(cmd, "reset")) {
+		evt->type = EVT_RESET;
+		return 0;
+	}
+	if (!strcmp(cmd, "rate")) {
+		evt->type = EVT_RATE;
+		evt->value = arg ? strtod(arg, NULL) * 1000 : 0;
+		return 0;
+	}
+	if (!strcmp(cmd, "quit")) {
+		evt->type = EVT_QUIT;
+		return 0;
+	}
+
+	return -1;
+}
+
+static int parseLine(char *line, uint32_t *last) {
+	sim_evt_t *evt = &events[eventsCount];
+	char *p, *end;
+	double at;
+
+	// Strip comments and line terminators
+	p = strpbrk(line, "#\r\n");
+	if (p)
+		*p = '\0';
+	line += strspn(line, " \t");
+	if (!*line)
+		return 0;
+
+	// Expectations are not timed
+	if (!strncmp(line, "expect", 6) && (line[6] == ' ' || line[6] == '\t')) {
+		if (expectsCount >= SCENARIO_EXPECTS)
+			return -1;
+		expects[expectsCount] = parseText(line + 6);
+		return expects[expectsCount++] ? 0 : -1;
+	}
+
+	at = strtod(line, &end);
+	if (end == line || at < 0)
+		return -1;
+	if (*end == 's')
+		++end;
+
+	if (eventsCount >= SCENARIO_EVENTS)
+		return -1;
+	memset(evt, 0, sizeof(*evt));
+	evt->at = at * 1000;
+	if (evt->at < *last || parseEvent(evt, end) != 0)
+		return -1;
+	*last = evt->at;
+	eventsCount++;
+
+	return 0;
+}
+
+//=====[ Events ]===============================================================
+
+static void setChannels(uint16_t chs, uint8_t present) {
+	for (uint8_t ch = 0; ch < SIM_CHANNELS; ++ch) {
+		if (chs & BV16(ch))
+			sim_pcaPresent(ch, present);
+	}
+}
+
+/**
+ * @brief Report the channels sampled per second since the last report
+ *
+ * @param min the minimum rate [mch/s]
+ * @return 0 if the rate is not lower than \a min, 1 otherwise
+ */
+static int reportRate(uint32_t min) {
+	uint32_t now = sim_now();
+	uint32_t elapsed = now - rateAt;
+	uint32_t total = 0, worst = 0xFFFFFFFF;
+	uint32_t samples, rate;
+
+	for (uint8_t ch = 0; ch < SIM_CHANNELS; ++ch) {
+		samples = sim_adeSamples(ch) - rateSamples[ch];
+		rateSamples[ch] += samples;
+		total += samples;
+		worst = MIN(worst, samples);
+	}
+	rateAt = now;
+
+	if (!elapsed)
+		return 0;
+
+	// [mch/s]
+	rate = ((uint64_t)total * 1000000) / elapsed;
+	sim_log("Rate: %lu.%03lu [ch/s], %lu samples in %lu [ms], "
+			"at least %lu for each channel",
+			(unsigned long)rate / 1000, (unsigned long)rate % 1000,
+			(unsigned long)total, (unsigned long)elapsed,
+			(unsigned long)worst);
+
+	if (rate >= min)
+		return 0;
+	sim_log("Rate lower than %lu.%03lu [ch/s]",
+			(unsigned long)min / 1000, (unsigned long)min % 1000);
+	return 1;
+}
+
+static void play(const sim_evt_t *evt) {
+
+	switch (evt->type) {
+	case EVT_LOAD:
+		sim_log("Load [0x%04X]: %lu", evt->chs, (unsigned long)evt->value);
+		for (uint8_t ch = 0; ch < SIM_CHANNELS; ++ch) {
+			if (evt->chs & BV16(ch))
+				sim_adeLoad(ch, evt->value);
+		}
+		break;
+	case EVT_VOLT:
+		sim_log("Voltage: %lu", (unsigned long)evt->value);
+		sim_adeVoltage(evt->value);
+		break;
+	case EVT_FREQ:
+		sim_log("Frequency: %lu [mHz]", (unsigned long)evt->value);
+		sim_adeFrequency(evt->value);
+		break;
+	case EVT_PLUG:
+	case EVT_UNPLUG:
+		sim_log("%s [0x%04X]",
+				(evt->type == EVT_PLUG) ? "Plug" : "Unplug", evt->chs);
+		setChannels(evt->chs, evt->type == EVT_PLUG);
+		break;
+	case EVT_BOUNCE:
+		sim_log("Bounce [0x%04X]: %lu", evt->chs, (unsigned long)evt->value);
+		sim_pcaBounce(evt->chs, evt->value);
+		break;
+	case EVT_NET:
+		sim_modemNetwork(evt->value);
+		break;
+	case EVT_I2C:
+		sim_pcaBus(evt->value);
+		break;
+	case EVT_SMS:
+		sim_modemSMS(evt->from, evt->text ? evt->text : "");
+		break;
+	case EVT_CONSOLE:
+		sim_log("Console: %s", evt->text);
+		sim_consoleInput(evt->text);
+		break;
+	case EVT_BUTTON:
+		sim_log("Button pressed");
+		sim_pinc(BV8(PC3), 0);
+		buttonUntil = sim_now() + SCENARIO_BUTTON_MS;
+		break;
+	case EVT_RESET:
+		sim_reset(BV8(EXTRF));
+		break;
+	case EVT_RATE:
+		if (reportRate(evt->value))
+			sim_exit(1);
+		break;
+	case EVT_QUIT:
+		sim_exit(sim_scenarioCheck());
+	}
+}
+
+/** @brief Play the events due by \a now, to be called periodically */
+void sim_scenarioTick(uint32_t now) {
+
+	if (buttonUntil && (int32_t)(now - buttonUntil) >= 0) {
+		sim_pinc(BV8(PC3), 1);
+		buttonUntil = 0;
+	}
+
+	while (next < eventsCount && events[next].at <= now)
+		play(&events[next++]);
+}
+
+/**
+ * @brief Load a scenario
+ *
+ * @param path the scenario file, NULL for the default one
+ * @param skip the time [ms] to resume the scenario from, i.e. the events
+ * before are replayed just if they set the board inputs
+ * @param met the bitmask of the expectations met before resuming
+ * @return 0 on success, -1 on errors
+ */
+int sim_scenarioLoad(const char *path, uint32_t skip, uint32_t met) {
+	uint32_t last = 0;
+	char line[256];
+	uint16_t lineNo = 0;
+	FILE *fp;
+
+	// The default board inputs
+	for (uint8_t ch = 0; ch < SIM_CHANNELS; ++ch)
+		sim_adeLoad(ch, SCENARIO_IRMS);
+	sim_adeVoltage(SCENARIO_VRMS);
+
+	if (!path)
+		return 0;
+
+	fp = fopen(path, "r");
+	if (!fp) {
+		sim_log("Scenario [%s] not found", path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		++lineNo;
+		if (parseLine(line, &last) == 0)
+			continue;
+		sim_log("Scenario [%s:%u] not valid", path, lineNo);
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+
+	expectsMet = met;
+	// The samples are counted since the board reset
+	rateAt = skip;
+
+	// Resume the board inputs
+	for (next = 0; next < eventsCount && events[next].at <= skip; ++next) {
+		if (events[next].type < EVT_STATE)
+			play(&events[next]);
+	}
+
+	sim_log("Scenario [%s]: %u events, %u expectations",
+			path, eventsCount, expectsCount);
+
+	return 0;
+}
+
+/** @brief Get the bitmask of the expectations met so far */
+uint32_t sim_scenarioMet(void) {
+	return expectsMet;
+}
+
+/** @brief Notify an SMS sent by the board */
+void sim_scenarioSMS(const char *dest, const char *text) {
+	sim_log("SMS to [%s]: %s", dest, text);
+
+	for (uint8_t i = 0; i < expectsCount; ++i) {
+		if (expects[i] && strstr(text, expects[i]))
+			expectsMet |= BV32(i);
+	}
+}
+
+/**
+ * @brief Verify the scenario expectations
+ *
+ * @return 0 if all the expectations have been met, 1 otherwise
+ */
+int sim_scenarioCheck(void) {
+	int result = 0;
+
+	for (uint8_t i = 0; i < expectsCount; ++i) {
+		if (expectsMet & BV32(i))
+			continue;
+		sim_log("Expectation not met: %s", expects[i] ? expects[i] : "");
+		result = 1;
+	}
+
+	return result;
+}
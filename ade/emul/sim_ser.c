@@ -0,0 +1,211 @@
+/**
+ *       @file  sim_ser.c
+ *      @brief  Simulated serial ports
+ *
+ * The low-level serial driver of the simulated board, derived from the
+ * ser_posix one: UART0 is the console, bridged to stdin/stdout, UART1 is
+ * connected to the simulated GSM modem. Transmitted bytes are delivered
+ * immediately, while received ones are pushed into the RX FIFO by the
+ * simulator clock, i.e. in interrupt context as the real UARTs do.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "sim.h"
+
+#include "cfg/cfg_ser.h"
+
+#include <cfg/debug.h>
+#include <cfg/compiler.h>
+#include <cpu/irq.h>
+
+#include <drv/ser.h>
+#include <drv/ser_p.h>
+
+#include <struct/fifobuf.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+/* TX and RX buffers */
+static unsigned char uart0_txbuffer[CONFIG_UART0_TXBUFSIZE];
+static unsigned char uart0_rxbuffer[CONFIG_UART0_RXBUFSIZE];
+static unsigned char uart1_txbuffer[CONFIG_UART1_TXBUFSIZE];
+static unsigned char uart1_rxbuffer[CONFIG_UART1_RXBUFSIZE];
+
+/**
+ * Internal state structure
+ */
+struct SimSerial
+{
+	struct SerialHardware hw;
+	struct Serial *ser;
+};
+
+static struct SimSerial UARTDescs[SER_CNT];
+
+// The console input injected by the scenario
+static char consoleIn[256];
+static uint16_t consoleLen = 0;
+// Set once stdin has been closed
+static uint8_t stdinEOF = 0;
+
+/*
+ * Callbacks
+ */
+static void uart_init(struct SerialHardware *_hw, struct Serial *ser)
+{
+	struct SimSerial *hw = (struct SimSerial *)_hw;
+
+	hw->ser = ser;
+
+	if (hw == &UARTDescs[SER_UART0])
+		fcntl(STDIN_FILENO, F_SETFL,
+				fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+
+	// The board timer is running by now
+	sim_start();
+}
+
+static void uart_cleanup(struct SerialHardware *_hw)
+{
+	struct SimSerial *hw = (struct SimSerial *)_hw;
+
+	hw->ser = NULL;
+}
+
+static void uart_txStart(struct SerialHardware *_hw)
+{
+	struct SimSerial *hw = (struct SimSerial *)_hw;
+	char c;
+
+	while (!fifo_isempty_locked(&hw->ser->txfifo))
+	{
+		c = fifo_pop_locked(&hw->ser->txfifo);
+		if (hw == &UARTDescs[SER_UART1])
+			sim_modemPutc(c);
+		else if (write(STDOUT_FILENO, &c, 1) < 0)
+			break;
+	}
+}
+
+static bool uart_txSending(UNUSED_ARG(struct SerialHardware *, _hw))
+{
+	return false;
+}
+
+static void uart_setBaudrate(UNUSED_ARG(struct SerialHardware *, _hw),
+		UNUSED_ARG(unsigned long, rate))
+{
+}
+
+static void uart_setParity(UNUSED_ARG(struct SerialHardware *, _hw),
+		UNUSED_ARG(int, parity))
+{
+}
+
+/** @brief Inject a console input line */
+void sim_consoleInput(const char *text)
+{
+	uint16_t len = strlen(text);
+
+	ATOMIC(
+		if ((size_t)(consoleLen + len + 1) <= sizeof(consoleIn)) {
+			memcpy(consoleIn + consoleLen, text, len);
+			consoleLen += len;
+			consoleIn[consoleLen++] = '\r';
+		}
+	);
+}
+
+/** @brief Receive the pending input, to be called in interrupt context */
+void sim_serTick(void)
+{
+	struct Serial *ser;
+	uint16_t i = 0;
+	char c;
+	int n;
+
+	ser = UARTDescs[SER_UART0].ser;
+	if (ser) {
+		while (i < consoleLen && !fifo_isfull(&ser->rxfifo))
+			fifo_push(&ser->rxfifo, consoleIn[i++]);
+		memmove(consoleIn, consoleIn + i, consoleLen - i);
+		consoleLen -= i;
+
+		while (!stdinEOF && !fifo_isfull(&ser->rxfifo)) {
+			n = read(STDIN_FILENO, &c, 1);
+			if (n <= 0) {
+				stdinEOF = (n == 0);
+				break;
+			}
+			// The console expects terminal line endings
+			fifo_push(&ser->rxfifo, (c == '\n') ? '\r' : c);
+		}
+	}
+
+	ser = UARTDescs[SER_UART1].ser;
+	if (ser) {
+		while (!fifo_isfull(&ser->rxfifo)) {
+			n = sim_modemGetc();
+			if (n < 0)
+				break;
+			fifo_push(&ser->rxfifo, n);
+		}
+	}
+}
+
+/*
+ * High-level interface data structures.
+ */
+static const struct SerialHardwareVT uart_vtable =
+{
+	.init = uart_init,
+	.cleanup = uart_cleanup,
+	.setBaudrate = uart_setBaudrate,
+	.setParity = uart_setParity,
+	.txStart = uart_txStart,
+	.txSending = uart_txSending,
+};
+
+static struct SimSerial UARTDescs[SER_CNT] =
+{
+	{
+		.hw = {
+			.table = &uart_vtable,
+			.txbuffer = uart0_txbuffer,
+			.rxbuffer = uart0_rxbuffer,
+			.txbuffer_size = sizeof(uart0_txbuffer),
+			.rxbuffer_size = sizeof(uart0_rxbuffer),
+		},
+		.ser = NULL,
+	},
+	{
+		.hw = {
+			.table = &uart_vtable,
+			.txbuffer = uart1_txbuffer,
+			.rxbuffer = uart1_rxbuffer,
+			.txbuffer_size = sizeof(uart1_txbuffer),
+			.rxbuffer_size = sizeof(uart1_rxbuffer),
+		},
+		.ser = NULL,
+	},
+};
+
+struct SerialHardware *ser_hw_getdesc(int unit)
+{
+	ASSERT(unit < SER_CNT);
+	return &UARTDescs[unit].hw;
+}
@@ -0,0 +1,152 @@
+/**
+ *       @file  power_test.c
+ *      @brief  Bit-exactness test and benchmark of the power kernel
+ *
+ * The fixed-point power_rms() must match the double precision computation it
+ * replaced, i.e. the truncation of Irms*Vrms/100000, on all the 24 bits
+ * meter readings. The reciprocal division is checked exhaustively on its
+ * domain, the kernel on the corner readings and on random pairs, both
+ * uniform and log-scaled, since the real readings span a few decades.
+ * The time per computation of both the kernel and the double reference is
+ * then reported, as measured on the host.
+ *
+ * Usage: ade_power_test [pairs [seed]]
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "power.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// The computations timed by the benchmark
+#define BENCH_COUNT 10000000UL
+
+/** @brief The double precision reference, as computed by setPower() */
+static uint32_t refRms(uint32_t irms, uint32_t vrms) {
+	return (uint32_t)(((double)irms * vrms) / POWER_SCALE);
+}
+
+static uint32_t rand24(void) {
+	return (((uint32_t)rand() << 12) ^ (uint32_t)rand()) & POWER_RMS_MAX;
+}
+
+/** @brief Get a random reading, uniform on its number of bits */
+static uint32_t randScaled(void) {
+	return rand24() >> (rand() % 24);
+}
+
+static int checkRms(uint32_t irms, uint32_t vrms) {
+	uint32_t p = power_rms(irms, vrms);
+	uint32_t ref = refRms(irms, vrms);
+
+	if (p == ref)
+		return 0;
+
+	fprintf(stderr, "power_rms(%lu, %lu) = %lu, expected %lu\n",
+			(unsigned long)irms, (unsigned long)vrms,
+			(unsigned long)p, (unsigned long)ref);
+	return 1;
+}
+
+static int testDiv(void) {
+	for (uint32_t x = 0; x < (1UL << 28); ++x) {
+		if (power_div3125(x) == x / 3125)
+			continue;
+		fprintf(stderr, "power_div3125(%lu) = %lu\n", (unsigned long)x,
+				(unsigned long)power_div3125(x));
+		return 1;
+	}
+	printf("Reciprocal division: exact below 2^28\n");
+	return 0;
+}
+
+static int testRms(unsigned long pairs) {
+	static const uint32_t corners[] = {
+		0, 1, 2, 3124, 3125, 99999, 100000, 0xFFFF, 0x10000,
+		0x7FFFFF, 0x800000, POWER_RMS_MAX - 1, POWER_RMS_MAX,
+	};
+
+	for (uint8_t i = 0; i < sizeof(corners)/sizeof(corners[0]); ++i) {
+		for (uint8_t j = 0; j < sizeof(corners)/sizeof(corners[0]); ++j) {
+			if (checkRms(corners[i], corners[j]))
+				return 1;
+		}
+	}
+
+	// Readings beyond 24 bits are saturated
+	if (power_rms(0xFFFFFFFFUL, 0x1000000UL) !=
+			refRms(POWER_RMS_MAX, POWER_RMS_MAX)) {
+		fprintf(stderr, "power_rms() not saturated\n");
+		return 1;
+	}
+
+	for (unsigned long n = 0; n < pairs; ++n) {
+		if (checkRms(rand24(), rand24()) ||
+				checkRms(randScaled(), randScaled()))
+			return 1;
+	}
+
+	printf("RMS power: bit-exact on %lu random pairs\n", 2 * pairs);
+	return 0;
+}
+
+static double nsPerOp(const struct timespec *start) {
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return ((now.tv_sec - start->tv_sec) * 1e9 +
+			(now.tv_nsec - start->tv_nsec)) / BENCH_COUNT;
+}
+
+static void bench(void) {
+	static uint32_t in[256];
+	volatile uint32_t sink = 0;
+	struct timespec start;
+	double kernel, ref;
+
+	for (uint16_t i = 0; i < 256; ++i)
+		in[i] = randScaled();
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (unsigned long n = 0; n < BENCH_COUNT; ++n)
+		sink += power_rms(in[n & 0xFF], in[(n >> 8) & 0xFF]);
+	kernel = nsPerOp(&start);
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (unsigned long n = 0; n < BENCH_COUNT; ++n)
+		sink += refRms(in[n & 0xFF], in[(n >> 8) & 0xFF]);
+	ref = nsPerOp(&start);
+
+	(void)sink;
+	printf("Host time: %.2f ns the kernel, %.2f ns the double reference\n",
+			kernel, ref);
+}
+
+int main(int argc, char *argv[]) {
+	unsigned long pairs = (argc > 1) ? strtoul(argv[1], NULL, 0) : 10000000;
+	unsigned seed = (argc > 2) ? strtoul(argv[2], NULL, 0) : 1;
+
+	srand(seed);
+
+	if (testDiv() || testRms(pairs)) {
+		fprintf(stderr, "FAILED, seed %u\n", seed);
+		return 1;
+	}
+
+	bench();
+	return 0;
+}
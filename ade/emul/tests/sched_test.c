@@ -0,0 +1,277 @@
+/**
+ *       @file  sched_test.c
+ *      @brief  Trace simulator of the channels scheduler
+ *
+ * The scheduling policies are driven on a virtual clock by traces of the
+ * channels status, i.e. the active, lossy, uncalibrated and critical masks
+ * holding for a given time. Each sample takes the accumulation window, plus
+ * the AMUX settling time on a channel switch, at the nominal line period.
+ * The worst revisit latency of each channel is then reported, for both the
+ * round-robin and the EDF policies. On all the traces with the default
+ * weights, the EDF policy must revisit each not boosted channel within its
+ * period, but for the sample in progress when its deadline expires.
+ *
+ * A trace file has a phase for each line, "<seconds> <active> <lossy>
+ * <calib> <critical>" with the masks in hex, while "w <ch> <weight>" lines
+ * set the weight of a channel (1..16). Empty lines and '#' comments are
+ * skipped.
+ *
+ * Usage: ade_sched_test [trace]
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "scheduler.h"
+#include "channel.h"
+#include "control.h"
+#include "line.h"
+
+#include <drv/timer.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The maximum revisit interval of a not boosted channel [ms]
+#define MAX_REVISIT_MS ((uint32_t)CONFIG_CONTROL_MAX_REVISIT*1000)
+
+// The maximum number of phases of a trace
+#define TRACE_PHASES 32
+
+//=====[ Stubs ]================================================================
+
+volatile ticks_t _clock;
+uint16_t line_periodUs = LINE_PERIOD_NOMINAL_US;
+
+//=====[ Traces ]===============================================================
+
+/** A phase of a trace: the channels status, holding for some time */
+typedef struct phase {
+	uint16_t seconds;
+	sched_masks_t masks;
+} phase_t;
+
+typedef struct trace {
+	const char *name;
+	uint8_t weights[MAX_CHANNELS];
+	uint8_t count;
+	phase_t phases[TRACE_PHASES];
+	/** The EDF policy must revisit each channel within its period */
+	uint8_t bounded;
+} trace_t;
+
+static const trace_t builtin[] = {
+	{
+		.name = "steady",
+		.count = 1,
+		.phases = { { 120, { 0xFFFF, 0, 0, 0 } } },
+		.bounded = 1,
+	},
+	{
+		.name = "critical",
+		.count = 1,
+		.phases = { { 120, { 0xFFFF, 0, 0, 0x000F } } },
+		.bounded = 1,
+	},
+	{
+		.name = "weighted",
+		.weights = { 4, 2, 2 },
+		.count = 1,
+		.phases = { { 120, { 0xFFFF, 0, 0, 0 } } },
+	},
+	{
+		.name = "calibration",
+		.count = 2,
+		.phases = {
+			{ 60, { 0xFFFF, 0, 0xFFFF, 0 } },
+			{ 60, { 0xFFFF, 0, 0, 0 } },
+		},
+		.bounded = 1,
+	},
+	{
+		.name = "one lossy",
+		.count = 3,
+		.phases = {
+			{ 30, { 0xFFFF, 0, 0, 0 } },
+			{ 60, { 0xFFFF, 0x0001, 0, 0 } },
+			{ 30, { 0xFFFF, 0, 0, 0 } },
+		},
+		.bounded = 1,
+	},
+	{
+		.name = "four lossy",
+		.count = 1,
+		.phases = { { 120, { 0xFFFF, 0x000F, 0, 0 } } },
+		.bounded = 1,
+	},
+};
+
+/** @brief Load a trace file, @return 0 on success */
+static int loadTrace(const char *path, trace_t *t) {
+	char line[128];
+	unsigned long v[5];
+	unsigned lineno = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return 1;
+	}
+
+	memset(t, 0, sizeof(*t));
+	t->name = path;
+	while (fgets(line, sizeof(line), f)) {
+		char *p = line + strspn(line, " \t");
+
+		lineno++;
+		if (*p == '#' || *p == '\n' || *p == '\0')
+			continue;
+
+		if (*p == 'w') {
+			if (sscanf(p+1, "%lu %lu", &v[0], &v[1]) != 2 ||
+					v[0] < 1 || v[0] > MAX_CHANNELS ||
+					v[1] < 1 || v[1] > 0xFF)
+				goto error;
+			t->weights[v[0]-1] = v[1];
+			continue;
+		}
+
+		if (t->count == TRACE_PHASES ||
+				sscanf(p, "%lu %lx %lx %lx %lx",
+					&v[0], &v[1], &v[2], &v[3], &v[4]) != 5)
+			goto error;
+		t->phases[t->count].seconds = v[0];
+		t->phases[t->count].masks.active = v[1];
+		t->phases[t->count].masks.lossy = v[2];
+		t->phases[t->count].masks.calib = v[3];
+		t->phases[t->count].masks.critical = v[4];
+		t->count++;
+	}
+
+	fclose(f);
+	return 0;
+
+error:
+	fprintf(stderr, "%s:%u: invalid line\n", path, lineno);
+	fclose(f);
+	return 1;
+}
+
+//=====[ Simulation ]===========================================================
+
+/** @brief Get the time [ms] to collect a sample, switching from \a cur */
+static uint32_t sampleMs(uint8_t ch, uint8_t cur) {
+	uint32_t cycles = ADE_LINE_CYCLES_SAMPLE_COUNT;
+
+	if (ch != cur)
+		cycles += ADE_AMUX_SETTLE_CYCLES;
+	return (cycles * line_period()) / 1000;
+}
+
+/**
+ * @brief Play a trace with the specified policy
+ *
+ * @return the worst revisit latency [ms] of the not boosted channels
+ */
+static uint32_t play(const trace_t *t, const sched_policy_t *policy,
+		const char *name) {
+	uint8_t cur = MAX_CHANNELS-1;
+	uint32_t worst = 0;
+	uint32_t maxMs = 0;
+	uint32_t end;
+
+	sched_init();
+	sched_setPolicy(policy);
+	for (uint8_t ch = 0; ch < MAX_CHANNELS; ++ch) {
+		if (t->weights[ch])
+			sched_setWeight(ch, t->weights[ch]);
+	}
+
+	_clock = 0;
+	for (uint8_t i = 0; i < t->count; ++i) {
+		const sched_masks_t *m = &t->phases[i].masks;
+
+		end = _clock + ms_to_ticks((mtime_t)t->phases[i].seconds*1000);
+		while (m->active && (int32_t)(end - _clock) > 0) {
+			uint8_t ch = sched_next(m, cur);
+
+			_clock += ms_to_ticks(sampleMs(ch, cur));
+			sched_visited(ch);
+			cur = ch;
+		}
+	}
+
+	printf("  %-4s", name);
+	for (uint8_t ch = 0; ch < MAX_CHANNELS; ++ch) {
+		uint16_t ms = sched_maxRevisit(ch);
+
+		printf(" %5u", ms);
+		maxMs = MAX(maxMs, (uint32_t)ms);
+		// A not boosted channel, whatever the phase, with the default weight
+		if (t->weights[ch] > SCHED_WEIGHT_DEFAULT)
+			continue;
+		for (uint8_t i = 0; i < t->count; ++i) {
+			const sched_masks_t *m = &t->phases[i].masks;
+			if ((m->lossy | m->calib | m->critical) & BV16(ch))
+				goto boosted;
+		}
+		worst = MAX(worst, (uint32_t)ms);
+boosted:
+		;
+	}
+	printf(" | %5lu\n", (unsigned long)maxMs);
+
+	return worst;
+}
+
+static int run(const trace_t *t) {
+	uint32_t worst;
+
+	printf("Trace \"%s\", worst revisit per channel [ms]:\n", t->name);
+	printf("  %-4s", "CH");
+	for (uint8_t ch = 0; ch < MAX_CHANNELS; ++ch)
+		printf(" %5u", ch+1);
+	printf(" | %5s\n", "max");
+
+	play(t, &sched_rr, "RR");
+	worst = play(t, &sched_edf, "EDF");
+
+	if (t->bounded && worst > MAX_REVISIT_MS + sampleMs(0, 1)) {
+		fprintf(stderr, "EDF revisit %lu [ms] exceeds %lu [ms]\n",
+				(unsigned long)worst, (unsigned long)MAX_REVISIT_MS);
+		return 1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	static trace_t t;
+
+	if (argc > 1) {
+		if (loadTrace(argv[1], &t))
+			return 1;
+		return run(&t);
+	}
+
+	for (uint8_t i = 0; i < countof(builtin); ++i) {
+		if (run(&builtin[i])) {
+			fprintf(stderr, "FAILED, trace \"%s\"\n", builtin[i].name);
+			return 1;
+		}
+	}
+
+	return 0;
+}
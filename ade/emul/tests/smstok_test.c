@@ -0,0 +1,414 @@
+/**
+ *       @file  smstok_test.c
+ *      @brief  Fuzz test of the SMS reading
+ *
+ * Random SMS texts are returned by a fake modem to the AT+CMGR requests of
+ * the AT engine, which streams them to the commands tokenizer as done by
+ * gsmSMSByIndex(). The framing of the responses (verbose or numeric result
+ * codes, CRLF or LF line breaks, blank lines, URCs) and the bytes available
+ * at each poll are random as well. Each request must complete with its
+ * final result, while the tokenized commands must match the ones of a
+ * reference tokenizer, which is also checked alone against random bytes.
+ *
+ * Usage: ade_smstok_test [iterations [seed]]
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "at.h"
+#include "gsm.h"
+#include "perf.h"
+
+#include <avr/wdt.h>
+
+#include <cfg/debug.h>
+#include <drv/ser.h>
+#include <drv/timer.h>
+#include <emul/emul.h>
+#include <kern/proc.h>
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The size of the commands buffer, as the one of an SMS message
+#define TOK_SIZE sizeof(((gsmSMSMessage_t *)0)->text)
+
+// The maximum length of a random SMS text
+#define TEXT_MAX 200
+
+//=====[ Stubs ]================================================================
+
+volatile ticks_t _clock;
+
+void emul_idle(void) {}
+void proc_yield(void) {}
+void wdt_reset(void) {}
+
+#if CONFIG_PERF
+tstamp_t perf_start(void) { return 0; }
+void perf_count(uint8_t cnt) { (void)cnt; }
+void perf_record(uint8_t hist, tstamp_t start) { (void)hist; (void)start; }
+#endif
+
+void kputs(const char *str) { (void)str; }
+void kprintf(const char *fmt, ...) { (void)fmt; }
+
+NORETURN int __bassert(const char *cond, const char *file, int line) {
+	fprintf(stderr, "%s:%d: assertion failed: %s\n", file, line, cond);
+	abort();
+}
+
+NORETURN int __invalid_ptr(void *p, const char *name, const char *file, int line) {
+	fprintf(stderr, "%s:%d: invalid pointer %s=%p\n", file, line, name, p);
+	abort();
+}
+
+//=====[ Fake Modem ]===========================================================
+
+static Serial modem;
+
+// The response bytes, and how many of them are available to the next poll
+static char rx[2*TEXT_MAX + 256];
+static size_t rxLen, rxPos, rxAvail;
+
+int ser_getchar_nowait(struct Serial *port) {
+	(void)port;
+	if (rxPos == rxLen || !rxAvail)
+		return EOF;
+	rxAvail--;
+	return (unsigned char)rx[rxPos++];
+}
+
+static size_t modemWrite(struct KFile *fd, const void *buf, size_t size) {
+	(void)fd;
+	(void)buf;
+	return size;
+}
+
+static void rxPut(const char *str) {
+	size_t n = strlen(str);
+
+	ASSERT(rxLen + n <= sizeof(rx));
+	memcpy(rx + rxLen, str, n);
+	rxLen += n;
+}
+
+//=====[ Reference Tokenizer ]==================================================
+
+/** The commands of a text, stored as by the tokenizer */
+typedef struct ref_tok {
+	char buf[TOK_SIZE];
+	uint8_t len;
+	uint8_t count;
+} ref_tok_t;
+
+static uint8_t isSep(char c) {
+	return (c == ';' || c == '\r' || c == '\n');
+}
+
+static uint8_t isSpace(char c) {
+	return (c == ' ' || c == '\t');
+}
+
+/**
+ * The commands are split on separators, without their leading spaces and
+ * with the name (i.e. till the first space) lowercased. A "$...:" prefix
+ * is dropped from the beginning of the text, while the commands exceeding
+ * the buffer, with its terminator, are dropped.
+ */
+static void refTokenize(ref_tok_t *ref, const char *text, size_t n) {
+	size_t i = 0;
+	size_t len = 0;
+	size_t start;
+	uint8_t name;
+
+	memset(ref, 0, sizeof(*ref));
+
+	if (n && text[0] == '$') {
+		while (i < n && text[i] != ':')
+			i++;
+		i++;
+	}
+
+	while (i < n) {
+		while (i < n && (isSep(text[i]) || isSpace(text[i])))
+			i++;
+		if (i == n)
+			break;
+
+		start = len;
+		name = 1;
+		for ( ; i < n && !isSep(text[i]); i++) {
+			char c = text[i];
+			if (isSpace(c))
+				name = 0;
+			if (name && c >= 'A' && c <= 'Z')
+				c += 'a'-'A';
+			if (len < TOK_SIZE-1)
+				ref->buf[len] = c;
+			len++;
+		}
+
+		if (len > TOK_SIZE-1) {
+			len = start;
+			continue;
+		}
+		ref->buf[len++] = '\0';
+		ref->count++;
+	}
+
+	ref->len = len;
+}
+
+static int checkTok(const gsmSMSTok_t *tok, const ref_tok_t *ref,
+		const char *text, size_t n) {
+
+	if (tok->count == ref->count && tok->len == ref->len &&
+			!memcmp(tok->buf, ref->buf, ref->len))
+		return 0;
+
+	fprintf(stderr, "Tokens mismatch on [");
+	fwrite(text, 1, n, stderr);
+	fprintf(stderr, "]: %u commands, %u bytes, expected %u, %u bytes\n",
+			tok->count, tok->len, ref->count, ref->len);
+	return 1;
+}
+
+//=====[ Random Texts ]=========================================================
+
+static int randInt(int n) {
+	return rand() % n;
+}
+
+static char randChar(void) {
+	static const char chars[] =
+		";;;   \t$$::AZaz09OKERROR+CMS";
+
+	switch (randInt(8)) {
+	case 0:
+		return 1 + randInt(255);
+	case 1:
+		return "\r\n"[randInt(2)];
+	default:
+		return chars[randInt(sizeof(chars)-1)];
+	}
+}
+
+/** @brief Verify if a text line would be taken as a final result */
+static uint8_t isResultLine(const char *l, size_t n) {
+	static const char *results[] = {
+		"0", "4", "OK", "ERROR",
+	};
+
+	for (uint8_t i = 0; i < countof(results); ++i) {
+		if (n == strlen(results[i]) && !strncmp(l, results[i], n))
+			return 1;
+	}
+	return (n >= 10 && (!strncmp(l, "+CMS ERROR", 10) ||
+				!strncmp(l, "+CME ERROR", 10)));
+}
+
+/**
+ * @brief Get a random SMS text
+ *
+ * The lines of an SMS text could not be result codes, which the modem
+ * would not escape.
+ */
+static size_t randText(char *text) {
+	size_t n = randInt(TEXT_MAX+1);
+	size_t start = 0;
+
+	for (size_t i = 0; i < n; ++i) {
+		text[i] = randChar();
+		if (text[i] != '\r' && text[i] != '\n')
+			continue;
+		if (isResultLine(text + start, i - start))
+			text[start] = '#';
+		start = i + 1;
+	}
+	if (isResultLine(text + start, n - start))
+		text[start] = '#';
+
+	return n;
+}
+
+//=====[ Test Cases ]===========================================================
+
+/** @brief Tokenize random bytes, checking against the reference */
+static int testTokenizer(void) {
+	char text[TEXT_MAX];
+	char buf[TOK_SIZE + 1];
+	gsmSMSTok_t tok;
+	ref_tok_t ref;
+	size_t n;
+
+	n = randInt(TEXT_MAX+1);
+	for (size_t i = 0; i < n; ++i)
+		text[i] = randChar();
+
+	// The byte past the buffer must never be written
+	buf[TOK_SIZE] = 0x5A;
+	gsmSMSTokInit(&tok, buf, TOK_SIZE);
+	for (size_t i = 0; i < n; ++i)
+		gsmSMSTokPut(&tok, text[i]);
+	gsmSMSTokEnd(&tok);
+	refTokenize(&ref, text, n);
+
+	if (buf[TOK_SIZE] != 0x5A) {
+		fprintf(stderr, "Tokenizer buffer overflow\n");
+		return 1;
+	}
+	return checkTok(&tok, &ref, text, n);
+}
+
+/** The context of a read request */
+typedef struct read_ctx {
+	gsmSMSTok_t tok;
+	char buf[TOK_SIZE];
+	uint8_t headers;
+	uint8_t ends;
+	uint8_t done;
+} read_ctx_t;
+
+static void readLine(at_req_t *req, const char *line) {
+	read_ctx_t *ctx = (read_ctx_t *)req->ctx;
+
+	if (!strncmp(line, "+CMGR:", 6))
+		ctx->headers++;
+}
+
+static void readStream(at_req_t *req, char c) {
+	read_ctx_t *ctx = (read_ctx_t *)req->ctx;
+
+	if (ctx->done) {
+		fprintf(stderr, "Streaming after the request completion\n");
+		exit(1);
+	}
+	if (c == '\0') {
+		gsmSMSTokEnd(&ctx->tok);
+		ctx->ends++;
+		return;
+	}
+	gsmSMSTokPut(&ctx->tok, c);
+}
+
+static uint8_t urcs;
+
+static void readURC(at_req_t *req, const char *line) {
+	(void)req;
+	(void)line;
+	urcs++;
+}
+
+/** @brief Read a random SMS, by the AT engine, from the fake modem */
+static int testRead(void) {
+	const char *brk = randInt(2) ? "\r\n" : "\n";
+	uint8_t verbose = randInt(2);
+	char text[TEXT_MAX];
+	read_ctx_t ctx;
+	ref_tok_t ref;
+	at_req_t req;
+	size_t n;
+	size_t skip;
+
+	n = randText(text);
+	rxLen = rxPos = 0;
+	urcs = 0;
+
+	// An SMS announced before the response
+	if (randInt(4) == 0)
+		rxPut("\r\n+CMTI: \"SM\",2\r\n");
+
+	if (verbose)
+		rxPut("\r\n");
+	rxPut("+CMGR: \"REC UNREAD\",\"+393331234567\",\"\",\"26/10/16,10:00:00+08\"");
+	rxPut("\r\n");
+	for (size_t i = 0; i < n; ++i) {
+		char c[2] = { text[i], '\0' };
+		rxPut((c[0] == '\n') ? brk : c);
+	}
+	rxPut("\r\n");
+	rxPut(verbose ? "\r\nOK\r\n" : "0\r");
+
+	memset(&ctx, 0, sizeof(ctx));
+	gsmSMSTokInit(&ctx.tok, ctx.buf, sizeof(ctx.buf));
+	AT_REQ_INIT(&req, "AT+CMGR=1", AT_TIMEOUT_MS);
+	req.prefix = "+CMGR:";
+	req.line = readLine;
+	req.stream = readStream;
+	req.ctx = &ctx;
+
+	at_submit(&req);
+	while (!at_done(&req)) {
+		if (rxPos == rxLen) {
+			fprintf(stderr, "Request not completed\n");
+			goto failed;
+		}
+		rxAvail = 1 + randInt(16);
+		at_poll();
+	}
+	ctx.done = 1;
+
+	// The line break following the final result
+	rxAvail = rxLen - rxPos;
+	at_poll();
+
+	if (req.result != OK || rxPos != rxLen) {
+		fprintf(stderr, "Request completed by %d, %zu bytes left\n",
+				req.result, rxLen - rxPos);
+		goto failed;
+	}
+	if (ctx.headers != 1 || ctx.ends != 1) {
+		fprintf(stderr, "%u headers, %u stream ends\n",
+				ctx.headers, ctx.ends);
+		goto failed;
+	}
+
+	// Leading line breaks are not streamed
+	for (skip = 0; skip < n && (text[skip] == '\r' || text[skip] == '\n');
+			skip++)
+		;
+	refTokenize(&ref, text + skip, n - skip);
+	if (!checkTok(&ctx.tok, &ref, text, n))
+		return 0;
+
+failed:
+	fprintf(stderr, "Response [");
+	fwrite(rx, 1, rxLen, stderr);
+	fprintf(stderr, "]\n");
+	return 1;
+}
+
+int main(int argc, char *argv[]) {
+	unsigned long iterations = (argc > 1) ? strtoul(argv[1], NULL, 0) : 20000;
+	unsigned seed = (argc > 2) ? strtoul(argv[2], NULL, 0) : 1;
+
+	srand(seed);
+
+	modem.fd.write = modemWrite;
+	at_init(&modem);
+	at_urc("+CMTI:", readURC);
+
+	for (unsigned long i = 0; i < iterations; ++i) {
+		if (testTokenizer() || testRead()) {
+			fprintf(stderr, "FAILED at iteration %lu, seed %u\n", i, seed);
+			return 1;
+		}
+	}
+
+	printf("SMS reading: %lu random texts OK\n", iterations);
+	return 0;
+}
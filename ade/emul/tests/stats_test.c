@@ -0,0 +1,255 @@
+/**
+ *       @file  stats_test.c
+ *      @brief  Replay of load traces through the channel calibration
+ *
+ * A trace of the power readings of a channel is replayed through the
+ * calibration policy, as calibrate() drives the load statistics, and through
+ * the original one, which moved the calibrated load by half of each
+ * variation and restarted whenever it exceeded the calibration level. The
+ * samples required to complete each calibration are reported, together with
+ * the calibrated load and the measured noise.
+ *
+ * The built-in traces are synthetic, clean and noisy, steady and with a load
+ * step while calibrating: each one must be calibrated within its length, on
+ * the load after the step, within the noise band. A captured trace has a
+ * power reading for each line, empty lines and '#' comments are skipped.
+ *
+ * Usage: ade_stats_test [trace]
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "stats.h"
+#include "control.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// The default configuration, as ee_loadDefaults() sets it
+#define FAULT_SAMPLES     CONFIG_FAULT_SAMPLES
+#define CALIBRATION_LEVEL (((uint32_t)1000 * CONFIG_FAULT_LEVEL) / 8)
+
+// The stable samples required to complete a calibration, as control.c
+#define CAL_STABLE_SAMPLES (3*STATS_WINDOW)
+
+// The samples of the built-in traces
+#define TRACE_LEN 256
+
+// The longest captured trace
+#define TRACE_MAX 4096
+
+// The power reading of a load [W]
+#define WATT(W) ((uint32_t)(W) * ADE_PWR_RATIO)
+
+/** A synthetic trace: a load, with uniform noise, stepping to another one */
+typedef struct synth {
+	const char *name;
+	uint32_t load;
+	uint32_t noise;
+	uint16_t step;
+	uint32_t stepLoad;
+} synth_t;
+
+static const synth_t builtin[] = {
+	{ "clean",        WATT(100), WATT(100)/500, 0,  0 },
+	{ "noisy",        WATT(100), WATT(100)/20,  0,  0 },
+	{ "clean step",   WATT(100), WATT(100)/500, 12, WATT(60) },
+	{ "noisy step",   WATT(100), WATT(100)/20,  12, WATT(40) },
+	{ "very noisy",   WATT(100), WATT(100)/10,  0,  0 },
+};
+
+/** The outcome of a calibration */
+typedef struct result {
+	/** The samples to complete, 0 if not completed */
+	uint16_t samples;
+	uint32_t load;
+	uint32_t noise;
+} result_t;
+
+static uint32_t trace[TRACE_MAX];
+
+//=====[ Calibration Policies ]=================================================
+
+/** @brief Replay the calibration policy of calibrate() */
+static void calibrate(const uint32_t *x, uint16_t len, result_t *r) {
+	uint8_t calSamples = MIN(FAULT_SAMPLES, CAL_STABLE_SAMPLES);
+	stats_t st;
+	uint32_t var;
+
+	stats_reset(&st);
+	memset(r, 0, sizeof(*r));
+	for (uint16_t i = 0; i < len; ++i) {
+		stats_update(&st, x[i]);
+		r->load = st.mean;
+
+		var = (x[i] >= st.mean) ? (x[i] - st.mean) : (st.mean - x[i]);
+		if (var > stats_band(st.dev, CALIBRATION_LEVEL)) {
+			stats_restart(&st, x[i]);
+			calSamples = MIN(FAULT_SAMPLES, CAL_STABLE_SAMPLES);
+			continue;
+		}
+
+		if (calSamples)
+			calSamples--;
+		if (calSamples || !stats_ready(&st))
+			continue;
+
+		r->samples = i+1;
+		r->noise = st.dev;
+		return;
+	}
+}
+
+/** @brief Replay the original calibration policy */
+static void calibrateLegacy(const uint32_t *x, uint16_t len, result_t *r) {
+	uint8_t calSamples = FAULT_SAMPLES;
+	uint32_t var;
+
+	memset(r, 0, sizeof(*r));
+	for (uint16_t i = 0; i < len; ++i) {
+		// The completion was noticed on the next sample
+		if (!calSamples) {
+			r->samples = i+1;
+			return;
+		}
+		calSamples--;
+
+		if (r->load >= x[i]) {
+			var = r->load - x[i];
+			r->load -= var/2;
+		} else {
+			var = x[i] - r->load;
+			r->load += var/2;
+		}
+
+		if (var > CALIBRATION_LEVEL)
+			calSamples = FAULT_SAMPLES;
+	}
+}
+
+//=====[ Traces ]===============================================================
+
+static void synthesize(const synth_t *s, uint32_t *x) {
+	uint32_t load;
+
+	srand(1);
+	for (uint16_t i = 0; i < TRACE_LEN; ++i) {
+		load = (s->step && i >= s->step) ? s->stepLoad : s->load;
+		x[i] = load - s->noise + (rand() % (2*s->noise + 1));
+	}
+}
+
+/** @brief Load a captured trace, @return the samples, 0 on errors */
+static uint16_t loadTrace(const char *path, uint32_t *x) {
+	char line[64];
+	unsigned long v;
+	unsigned lineno = 0;
+	uint16_t len = 0;
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return 0;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		char *p = line + strspn(line, " \t");
+
+		lineno++;
+		if (*p == '#' || *p == '\n' || *p == '\0')
+			continue;
+		if (len == TRACE_MAX || sscanf(p, "%lu", &v) != 1) {
+			fprintf(stderr, "%s:%u: invalid line\n", path, lineno);
+			fclose(f);
+			return 0;
+		}
+		x[len++] = v;
+	}
+
+	fclose(f);
+	if (!len)
+		fprintf(stderr, "%s: empty trace\n", path);
+	return len;
+}
+
+//=====[ Replay ]===============================================================
+
+static void report(const char *policy, const result_t *r, uint8_t noise) {
+	printf("  %-7s", policy);
+	if (!r->samples) {
+		printf(" %7s\n", "never");
+		return;
+	}
+	printf(" %7u %10lu", r->samples, (unsigned long)r->load);
+	if (noise)
+		printf(" %10lu\n", (unsigned long)r->noise);
+	else
+		printf(" %10s\n", "-");
+}
+
+static void replay(const char *name, const uint32_t *x, uint16_t len,
+		result_t *r) {
+	result_t legacy;
+
+	printf("Trace \"%s\", %u samples:\n", name, len);
+	printf("  %-7s %7s %10s %10s\n", "", "samples", "load", "noise");
+
+	calibrateLegacy(x, len, &legacy);
+	report("legacy", &legacy, 0);
+	calibrate(x, len, r);
+	report("stats", r, 1);
+}
+
+/** @brief Verify a calibration of a built-in trace */
+static int check(const synth_t *s, const result_t *r) {
+	uint32_t load = s->step ? s->stepLoad : s->load;
+	uint32_t var = (r->load >= load) ? (r->load - load) : (load - r->load);
+
+	if (!r->samples) {
+		fprintf(stderr, "Calibration not completed\n");
+		return 1;
+	}
+	if (var > stats_band(r->noise, CALIBRATION_LEVEL)) {
+		fprintf(stderr, "Calibrated load %lu, expected %lu\n",
+				(unsigned long)r->load, (unsigned long)load);
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char *argv[]) {
+	result_t r;
+	uint16_t len;
+
+	if (argc > 1) {
+		len = loadTrace(argv[1], trace);
+		if (!len)
+			return 1;
+		replay(argv[1], trace, len, &r);
+		return 0;
+	}
+
+	for (uint8_t i = 0; i < countof(builtin); ++i) {
+		synthesize(&builtin[i], trace);
+		replay(builtin[i].name, trace, TRACE_LEN, &r);
+		if (check(&builtin[i], &r)) {
+			fprintf(stderr, "FAILED, trace \"%s\"\n", builtin[i].name);
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,271 @@
+/**
+ *       @file  energy.c
+ *      @brief  Channels energy accumulation and load profiles
+ *
+ * This provides the energy consumed by each channel, integrated from the
+ * line cycle energy accumulations (LAENERGY) collected by the sampling
+ * engine, and rolled up into hourly and daily load profiles.
+ *
+ * Channels are sampled one at a time, thus the energy of each accumulation
+ * is held until the next sample of the same channel. Profiles are stored as
+ * the most recent bucket plus the (companded) 8 bits deltas among consecutive
+ * buckets: steps wider than a delta are tracked over the following buckets.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "energy.h"
+
+#include "control.h"
+#include "line.h"
+
+#include <cfg/macros.h>
+#include <drv/timer.h>
+
+#include <string.h> // memset
+
+#if CONFIG_ENERGY
+
+// The duration [ms] of an accumulation, at the current line frequency
+#define ENERGY_WINDOW_MS \
+	(((uint32_t)ADE_LINE_CYCLES_SAMPLE_COUNT*line_period()) / 1000)
+
+// The LAENERGY scaling, keeping a full hour of full scale accumulations
+// within 32 bits
+#define ENERGY_LAE_SHIFT 5
+
+// The hourly quanta for each daily quantum
+#define ENERGY_DAY_SHIFT 5
+
+// The maximum time [ms] a sample is held, e.g. the first sample of a newly
+// enabled channel accounts just for its own accumulation
+#define ENERGY_MAX_GAP_MS 60000
+
+/** The energy data of a channel */
+typedef struct chEnergy {
+	/** The energy of the current hour [LAENERGY/32 * windows] */
+	uint32_t acc;
+	/** The energy of the current day [hourly quanta] */
+	uint32_t today;
+	/** The time of the last sample */
+	ticks_t lastAt;
+	/** The time [ms] not yet accounted to a whole window */
+	uint16_t remMs;
+	/** The hourly profile: last bucket and deltas */
+	energy_t hLast;
+	int8_t hDelta[CONFIG_ENERGY_HOURS-1];
+	/** The daily profile: last bucket and deltas */
+	energy_t dLast;
+	int8_t dDelta[CONFIG_ENERGY_DAYS-1];
+} chEnergy_t;
+
+static chEnergy_t chEnergy[MAX_CHANNELS];
+
+/** The position of a profile, the same for all the channels */
+typedef struct profile {
+	/** The delta slot of the next bucket */
+	uint8_t head;
+	/** The number of valid buckets */
+	uint8_t count;
+} profile_t;
+
+static profile_t hours;
+static profile_t days;
+
+// The hours accounted to the current day
+static uint8_t dayHours;
+
+void energy_init(void) {
+	memset(chEnergy, 0, sizeof(chEnergy));
+	memset(&hours, 0, sizeof(hours));
+	memset(&days, 0, sizeof(days));
+	dayHours = 0;
+}
+
+/**
+ * @brief Account a sample of the specified channel
+ *
+ * @param lae the LAENERGY value of the sample
+ * @param now the time of the sample
+ */
+void energy_update(uint8_t ch, int32_t lae, ticks_t now) {
+	chEnergy_t *e = &chEnergy[ch];
+	uint32_t dt, windows, add;
+
+	// Hold the sample energy since the previous sample
+	if (now - e->lastAt > ms_to_ticks(ENERGY_MAX_GAP_MS))
+		dt = ENERGY_WINDOW_MS;
+	else
+		dt = ticks_to_ms(now - e->lastAt);
+	e->lastAt = now;
+
+	dt += e->remMs;
+	windows = dt / ENERGY_WINDOW_MS;
+	e->remMs = dt - (windows * ENERGY_WINDOW_MS);
+
+	if (lae < 0)
+		lae = -lae;
+	add = ((uint32_t)lae >> ENERGY_LAE_SHIFT) * windows;
+
+	// Saturate on overflows
+	if (e->acc + add < e->acc)
+		e->acc = 0xFFFFFFFF;
+	else
+		e->acc += add;
+}
+
+//=====[ Profiles ]=============================================================
+
+static inline energy_t sat16(uint32_t x) {
+	return (x > 0xFFFF) ? 0xFFFF : (energy_t)x;
+}
+
+// The widest delta encoded by a bucket: 127^2
+#define ENERGY_DELTA_MAX 16129
+
+/** @brief Get the integer square root of \a x, rounded to the nearest */
+static uint8_t isqrt16(uint16_t x) {
+	uint16_t r = 0;
+
+	for (uint16_t bit = BV16(14); bit; bit >>= 2) {
+		if (x >= r + bit) {
+			x -= r + bit;
+			r = (r >> 1) + bit;
+		} else {
+			r >>= 1;
+		}
+	}
+
+	// Here x is the remainder, round up if above r+0.25
+	if (x > r)
+		r++;
+	return r;
+}
+
+static inline int16_t deltaDecode(int8_t c) {
+	int16_t m = c;
+	return (m < 0) ? -(m * m) : (m * m);
+}
+
+/**
+ * @brief Push a new bucket into the profile of a channel
+ *
+ * Deltas are companded on 8 bits as c*|c|, the encoding error being
+ * recovered by the following delta since \a last is kept as decoded.
+ */
+static void profilePush(const profile_t *p,
+		energy_t *last, int8_t *delta, energy_t v) {
+	int32_t d, next;
+	int8_t c;
+
+	if (!p->count) {
+		*last = v;
+		return;
+	}
+
+	d = (int32_t)v - *last;
+	// The rounded root fits 7 bits, since the delta is clamped to 127^2
+	c = isqrt16(MIN(ABS(d), (int32_t)ENERGY_DELTA_MAX));
+	if (d < 0)
+		c = -c;
+
+	// Rounding up should never go beyond the bucket range
+	next = (int32_t)*last + deltaDecode(c);
+	if (next < 0 || next > 0xFFFF)
+		c += (c < 0) ? 1 : -1;
+
+	delta[p->head] = c;
+	*last += deltaDecode(c);
+}
+
+/** @brief Move the profile to the next bucket, once pushed on all channels */
+static void profileNext(profile_t *p, uint8_t slots) {
+	if (p->count)
+		p->head = (p->head + 1) % slots;
+	if (p->count <= slots)
+		p->count++;
+}
+
+/** @brief Get a bucket, \a ago buckets before the last one */
+static energy_t profileGet(const profile_t *p, uint8_t slots,
+		energy_t last, const int8_t *delta, uint8_t ago) {
+	uint8_t pos = p->head;
+
+	if (ago >= p->count)
+		return 0;
+
+	while (ago--) {
+		pos = (pos + slots - 1) % slots;
+		last -= deltaDecode(delta[pos]);
+	}
+
+	return last;
+}
+
+/**
+ * @brief Close the current hour of all the channels
+ *
+ * This must be called once per hour, each 24 hours the current day is closed
+ * too. The energy below an hourly quantum is carried to the next hour.
+ */
+void energy_rollHour(void) {
+	uint8_t closeDay;
+	chEnergy_t *e;
+	energy_t v;
+
+	closeDay = (++dayHours == 24);
+	if (closeDay)
+		dayHours = 0;
+
+	for (uint8_t ch = 0; ch < MAX_CHANNELS; ++ch) {
+		e = &chEnergy[ch];
+
+		v = sat16(e->acc >> CONFIG_ENERGY_SHIFT);
+		e->acc &= BV32(CONFIG_ENERGY_SHIFT)-1;
+		profilePush(&hours, &e->hLast, e->hDelta, v);
+		e->today += v;
+
+		if (!closeDay)
+			continue;
+
+		v = sat16(e->today >> ENERGY_DAY_SHIFT);
+		e->today = 0;
+		profilePush(&days, &e->dLast, e->dDelta, v);
+	}
+
+	profileNext(&hours, CONFIG_ENERGY_HOURS-1);
+	if (closeDay)
+		profileNext(&days, CONFIG_ENERGY_DAYS-1);
+}
+
+/** @brief Get the energy of the current hour [hourly quanta] */
+uint32_t energy_current(uint8_t ch) {
+	return chEnergy[ch].acc >> CONFIG_ENERGY_SHIFT;
+}
+
+/** @brief Get the energy of an hour, 0 being the last closed one */
+energy_t energy_hour(uint8_t ch, uint8_t ago) {
+	const chEnergy_t *e = &chEnergy[ch];
+	return profileGet(&hours, CONFIG_ENERGY_HOURS-1,
+			e->hLast, e->hDelta, ago);
+}
+
+/** @brief Get the energy of a day, 0 being the last closed one */
+energy_t energy_day(uint8_t ch, uint8_t ago) {
+	const chEnergy_t *e = &chEnergy[ch];
+	return profileGet(&days, CONFIG_ENERGY_DAYS-1,
+			e->dLast, e->dDelta, ago);
+}
+
+#endif /* CONFIG_ENERGY */
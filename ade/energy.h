@@ -0,0 +1,59 @@
+/**
+ *       @file  energy.h
+ *      @brief  Channels energy accumulation and load profiles
+ *
+ * This provides the energy consumed by each channel, integrated from the
+ * line cycle energy accumulations (LAENERGY) collected by the sampling
+ * engine, and rolled up into hourly and daily load profiles.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef ADE_ENERGY_H_
+#define ADE_ENERGY_H_
+
+#include "channel.h"
+
+#include "cfg/cfg_control.h"
+
+#include <cfg/compiler.h>
+
+/**
+ * The energy of a profile bucket
+ *
+ * Hourly buckets are in quanta of (1 << CONFIG_ENERGY_SHIFT) accumulation
+ * units, i.e. LAENERGY/32 counts integrated over a sample window, daily
+ * buckets are in quanta of 32 hourly quanta.
+ */
+typedef uint16_t energy_t;
+
+#if CONFIG_ENERGY
+
+void energy_init(void);
+void energy_update(uint8_t ch, int32_t lae, ticks_t now);
+void energy_rollHour(void);
+
+uint32_t energy_current(uint8_t ch);
+energy_t energy_hour(uint8_t ch, uint8_t ago);
+energy_t energy_day(uint8_t ch, uint8_t ago);
+
+#else
+
+# define energy_init() do {} while (0)
+# define energy_update(CH, LAE, NOW) do {} while (0)
+# define energy_rollHour() do {} while (0)
+
+#endif
+
+#endif /* end of include guard: ADE_ENERGY_H_ */
@@ -22,12 +22,16 @@
 
 #include "gsm.h"
 
+#include "at.h"
+
 #include "hw/hw_gsm.h"
 #include "hw/hw_led.h"
 
 #include <cfg/compiler.h>
+#include <cfg/macros.h>
 
 #include <stdio.h> 			// sprintf
+#include <stdlib.h> 		// atoi
 #include <string.h> 		// strstr
 #include <avr/pgmspace.h>
 
@@ -47,6 +51,7 @@
 
 gsmConf_t gsmConf = {
 	.creg_stat = UNKNOW,
+#if 0
 	.creg_try = DEFAULT_CREG_TRY,
 	.creg_wait = DEFAULT_CREG_WAIT,
 	.apn = DEFAULT_APN,
@@ -57,14 +62,21 @@ gsmConf_t gsmConf = {
 	.sip = DEFAULT_SERVER_IP,
 	.sport = DEFAULT_SERVER_PORT,
 	.sms_server = DEFAULT_SMS_SERVER,
+#endif
 };
 
 Serial *gsm;
 
+// The timeout [ms] for SMS read and delete commands
+#define GSM_SMS_TIMEOUT_MS 5000
+// The timeout [ms] for SMS send, as specified by the SIM900 manual
+#define GSM_CMGS_TIMEOUT_MS 60000
+
 static int8_t _gsmRead(char *resp, uint8_t size);
 static int8_t _gsmReadResult(void);
-static int8_t _gsmWrite(const char *cmd, size_t count);
-static int8_t _gsmWriteLine(const char *cmd);
+static int8_t _gsmWriteLine_P(const char *cmd);
+// Write a constant command line, kept in program memory
+#define _gsmWriteLine(CMD) _gsmWriteLine_P(PSTR(CMD))
 
 #if CONFIG_GSM_DEBUG
 static void _gsmPrintResult(uint8_t result)
@@ -113,12 +125,31 @@ static void _gsmPrintResult(uint8_t result)
 
 /*----- GSM Control Interface -----*/
 
+static void _gsmURCCreg(at_req_t *req, const char *line);
+static void _gsmURCCmti(at_req_t *req, const char *line);
+static void _gsmURCRing(at_req_t *req, const char *line);
+
 void gsmInit(Serial *port) {
 	// Saving UART port device
 	ASSERT(port);
 	gsm = port;
 	LOG_INFO("GSM: Init\n");
 	gsm_init();
+
+	// Setup the AT command engine
+	at_init(port);
+	at_urc("+CREG:", _gsmURCCreg);
+	at_urc("+CMTI:", _gsmURCCmti);
+	at_urc("RING", _gsmURCRing);
+}
+
+/**
+ * @brief Process unsolicited modem notifications and queued AT commands
+ *
+ * This never blocks and should be called periodically.
+ */
+void gsmPoll(void) {
+	at_poll();
 }
 
 void gsmReset(void)
@@ -221,7 +252,11 @@ int8_t gsmPowerOn(void)
 		return result;
 
 	result = gsmConfigure();
-	return result;
+	if (result != OK)
+		return result;
+
+	// Restore SMS settings, which are lost on modem reset
+	return gsmSMSConf(0);
 }
 
 void gsmPowerOff(void)
@@ -234,6 +269,8 @@ void gsmPowerOff(void)
 
 /*----- GSM ConfigurationInterface -----*/
 
+#if 0
+// The modem identity and the cell informations are not kept, to save RAM
 int8_t gsmGetNetworkParameters(void)
 {
 	int8_t resp;
@@ -301,32 +338,42 @@ int8_t gsmGetNetworkParameters(void)
 #endif
 	return resp;
 }
+#endif
+
+static void _gsmCSQLine(at_req_t *req, const char *line) {
+	(void)req;
+
+	sscanf_P(line, PSTR("+CSQ: %hu,%hu"),
+			(short unsigned int*)&gsmConf.rssi,
+			(short unsigned int*)&gsmConf.ber);
+}
 
 // Update the "Signal Quality Report"
 uint8_t gsmUpdateCSQ(void)
 {
+	at_req_t req;
 	int8_t resp;
-	char buff[16];
 
-	_gsmWriteLine("AT+CSQ");
-	_gsmRead(buff, 16);
-	resp = _gsmReadResult();
+	gsmConf.rssi = 99;
+	gsmConf.ber = 99;
+
+	AT_REQ_INIT_P(&req, "AT+CSQ", AT_TIMEOUT_MS);
+	req.prefix = "+CSQ:";
+	req.line = _gsmCSQLine;
+	resp = at_exec(&req);
 	if (resp != OK) {
 		gsmConf.rssi = 99;
 		gsmConf.ber = 99;
 		return resp;
 	}
 
-	sscanf(buff, "+CSQ: %hu,%hu",
-			(short unsigned int*)&gsmConf.rssi,
-			(short unsigned int*)&gsmConf.ber);
-
 	gsmDebug("CSQ [%hu]\r\n", gsmConf.rssi);
 	
 	return resp;
 
 }
 
+#if 0
 void gsmUpdateConf(void)
 {
 	int8_t resp;
@@ -365,16 +412,17 @@ void gsmUpdateConf(void)
 	gsmUpdateCSQ();
 
 }
+#endif
 /*----- GSM Private methods -----*/
 
-static int8_t _gsmWrite(const char *cmd, size_t count)
+static int8_t _gsmWriteLine_P(const char *cmd)
 {
 	size_t i;
 
 	// NOTE: debugging should no be mixed to modem command and response to
 	// avoid timeing issues and discrepancy between debug and release
 	// versions
-	gsmDebug("TX [%s]\n", cmd);
+	gsmDebug("TX [%S]\n", (const wchar_t *)cmd);
 
 	// Purge any buffered data before sending a new command
 	ser_purge(gsm);
@@ -383,31 +431,8 @@ static int8_t _gsmWrite(const char *cmd, size_t count)
 
 	// Sending the AT command
 	WATCHDOG_RESET();
-	for (i=0; cmd[i]!='\0' && count; i++, count--) {
-		kfile_putc(cmd[i], &(gsm->fd));
-		WATCHDOG_RESET();
-	}
-	return i;
-}
-
-static int8_t _gsmWriteLine(const char *cmd)
-{
-	size_t i;
-
-	// NOTE: debugging should no be mixed to modem command and response to
-	// avoid timeing issues and discrepancy between debug and release
-	// versions
-	gsmDebug("TX [%s]\n", cmd);
-
-	// Purge any buffered data before sending a new command
-	ser_purge(gsm);
-	// Clear error flags
-	ser_setstatus(gsm, 0);
-
-	// Sending the AT command
-	WATCHDOG_RESET();
-	for (i=0; cmd[i]!='\0'; i++) {
-		kfile_putc(cmd[i], &(gsm->fd));
+	for (i=0; pgm_read8(cmd+i)!='\0'; i++) {
+		kfile_putc(pgm_read8(cmd+i), &(gsm->fd));
 		WATCHDOG_RESET();
 	}
 	kfile_write(&(gsm->fd), "\r\n", 2);
@@ -468,23 +493,27 @@ static int8_t _gsmReadResult()
 
 /*----- GSM Interface -----*/
 
+static void _gsmCREGLine(at_req_t *req, const char *line) {
+	(void)req;
+
+	sscanf_P(line, PSTR("+CREG: %hhu,%hhu"),
+			&gsmConf.creg_n,
+			&gsmConf.creg_stat);
+}
+
 uint8_t gsmUpdateCREG(void)
 {
-	int8_t resp;
-	char buff[16];
+	at_req_t req;
 
-	_gsmWriteLine("AT+CREG?");
-	resp = _gsmRead(buff, 16);
-	if (resp == -1) {
+	AT_REQ_INIT_P(&req, "AT+CREG?", AT_TIMEOUT_MS);
+	req.prefix = "+CREG:";
+	req.line = _gsmCREGLine;
+	if (at_exec(&req) != OK) {
 		gsmConf.creg_n = 0;
 		gsmConf.creg_stat = UNKNOW;
 		return ERROR;
 	}
 
-	sscanf(buff, "+CREG: %hhu,%hhu",
-			&gsmConf.creg_n,
-			&gsmConf.creg_stat);
-
 	return OK;
 
 }
@@ -531,10 +560,45 @@ int8_t gsmRegisterNetwork(void)
 }
 
 
+/*----- GSM Unsolicited Result Codes -----*/
+
+static void _gsmURCCreg(at_req_t *req, const char *line) {
+	(void)req;
+
+	// Network registration changes: +CREG: <stat>
+	sscanf_P(line, PSTR("+CREG: %hhu"), &gsmConf.creg_stat);
+	gsmDebug("CREG [%hhu]\r\n", gsmConf.creg_stat);
+}
+
+// Set when some SMS has been announced by +CMTI, till none is stored
+static uint8_t smsAnnounced = 0;
+
+static void _gsmURCCmti(at_req_t *req, const char *line) {
+	const char *p;
+	(void)req;
+
+	// New message indication: +CMTI: <mem>,<index>
+	p = strchr(line, ',');
+	if (!p)
+		return;
+
+	LOG_INFO("GSM: New SMS, P: %d\n", atoi(p+1));
+	smsAnnounced = 1;
+}
+
+static void _gsmURCRing(at_req_t *req, const char *line) {
+	(void)req;
+	(void)line;
+
+	LOG_INFO("GSM: RING\n");
+}
+
+
 /*----- GSM SMS Interface -----*/
 
 int8_t gsmSMSConf(uint8_t load)
 {
+	at_req_t req;
 	char buff[16];
 	int8_t resp;
 
@@ -550,13 +614,24 @@ int8_t gsmSMSConf(uint8_t load)
 	}
 
 	// Set text mode
-	_gsmWriteLine("AT+CMGF=1");
-	resp = _gsmRead(buff, 16);
-	if (resp==-1) {
+	AT_REQ_INIT_P(&req, "AT+CMGF=1", AT_TIMEOUT_MS);
+	if (at_exec(&req) != OK) {
 		gsmDebug("Fail, set Text Mode\n");
 		return ERROR;
 	}
 
+	// Set New SMS Message Indications
+	// - Buffer unsolicited result codes while the TA-TE link is reserved
+	// - Indicate SMS-DELIVER stored in memory by +CMTI: <mem>,<index>
+	// - No CBM indications are routed to the TE
+	// - No SMS-STATUS-REPORTs are routed to the TE
+	// - Flush TA buffer of unsolicited result codes
+	AT_REQ_INIT_P(&req, "AT+CNMI=2,1,0,0,0", AT_TIMEOUT_MS);
+	if (at_exec(&req) != OK) {
+		gsmDebug("Fail, set Indications\n");
+		return ERROR;
+	}
+
 #warning DISABLED SOME SMS CONFIGURATION SETTING
 return OK;
 
@@ -568,19 +643,6 @@ return OK;
 		return ERROR;
 	}
 
-	// Set New SMS Message Indications
-	// - Forward unsolicited result codes directly to the TE
-	// - (Polling mode): No SMS-DELIVER indications are routed to the TE
-	// - No CBM indications are routed to the TE
-	// - No SMS-STATUS-REPORTs are routed to the TE
-	// - Celar TA buffer of unsolicited result codes
-	_gsmWriteLine("AT+CNMI=3,0,0,0,1");
-	resp = _gsmRead(buff, 16);
-	if (resp==-1) {
-		gsmDebug("Fail, set Indications\n");
-		return ERROR;
-	}
-
 /*
 	// Preferred SMS Message Storage
 	_gsmWriteLine("AT+CPMS=1",1000);
@@ -605,7 +667,7 @@ return OK;
 }
 int8_t gsmSMSSend(const char *number, const char *message)
 {
-	int8_t resp, i;
+	at_req_t req;
 	char buff[32];
 
 	gsmDebug("Sending SMS\n");
@@ -615,170 +677,177 @@ int8_t gsmSMSSend(const char *number, const char *message)
 #else
 #warning CHECK for message max length!!!
 #endif
-	// Sending destination number
-	sprintf(buff, "AT+CMGS=\"%s\", 145", number);
-	_gsmWriteLine(buff);
-	DELAY(1000);
-	//_gsmWrite("AT+CMGS=\"", 9);
-	//_gsmWrite(number, strlen(number));
-	//_gsmWriteLine("\", 145");
-
-	// Wait for modem message prompt
-	//_gsmRead(buff, 32);
-	for (i=0; i<15; i++) {
-		(*buff) = kfile_getc(&(gsm->fd));
-		if ((*buff) == EOF)
-			return -1;
-		if ((*buff) == '>')
-			break;
+	// Sending destination number, the message is sent at the modem prompt
+	// and the result is returned once the message has been sent
+	sprintf_P(buff, PSTR("AT+CMGS=\"%s\", 145"), number);
+	AT_REQ_INIT(&req, buff, GSM_CMGS_TIMEOUT_MS);
+	req.prefix = "+CMGS:";
+	req.data = message;
+
+	return at_exec(&req);
+}
+
+gsmSMSMessage_t msg;
+
+
+// Get the text following the N-th '"' of the specified line
+static const char *_gsmQuoted(const char *line, uint8_t n) {
+	while (n && *line) {
+		if (*line++ == '"')
+			n--;
 	}
-	if (i == 15)
-		return -1;
+	return line;
+}
 
-	// Sending message
-	_gsmWriteLine(message);
-	DELAY(1000);
+// Copy a quoted field, till the next '"'
+static void _gsmQuotedCopy(char *dst, const char *src, uint8_t size) {
+	uint8_t i;
 
-	// Sending terminator
-	_gsmWriteLine("\x1a");
+	for (i = 0; i < size-1 && src[i] && src[i] != '"'; i++)
+		dst[i] = src[i];
+	dst[i] = '\0';
+}
 
-	// Waiting send confirmation
-	_gsmRead(buff, 32);
-	resp = _gsmReadResult();
+/*----- SMS Reading -----*/
 
-	return resp;
+/* The context of an SMS read request */
+typedef struct gsmCMGRCtx {
+	gsmSMSMessage_t *msg;
+	gsmSMSTok_t tok;
+} gsmCMGRCtx_t;
+
+static void _gsmCMGRLine(at_req_t *req, const char *line) {
+	gsmCMGRCtx_t *ctx = (gsmCMGRCtx_t *)req->ctx;
+	gsmSMSMessage_t *msg = ctx->msg;
+
+	//***** Message header, record format:
+	// +CMGR: <TYPE>,<NUMBER>,<ALPHA>,<TIMESTAMP>
+	// e.g.
+	// +CMGR: "REC READ","+393357963938","","10/12/14,22:59:15+04"
+	// the following text lines are then streamed to the tokenizer.
+	if (strncmp(line, "+CMGR:", 6))
+		return;
+
+	// The sender number follows the third '"'
+	_gsmQuotedCopy(msg->from, _gsmQuoted(line, 3), sizeof(msg->from));
+	// The timestamp follows the seventh '"'
+	_gsmQuotedCopy(msg->time, _gsmQuoted(line, 7), sizeof(msg->time));
 }
 
-gsmSMSMessage_t msg;
+static void _gsmCMGRStream(at_req_t *req, char c) {
+	gsmCMGRCtx_t *ctx = (gsmCMGRCtx_t *)req->ctx;
 
+	if (c == '\0') {
+		gsmSMSTokEnd(&ctx->tok);
+		return;
+	}
+	gsmSMSTokPut(&ctx->tok, c);
+}
 
 /**
  * @return 1 if a valid message has been retrived, 0 on no valid message, -1
  * on parsing error.
  */
 int8_t gsmSMSByIndex(gsmSMSMessage_t * msg, uint8_t index) {
-	char c;
-	uint8_t i;
+	gsmCMGRCtx_t ctx;
+	at_req_t req;
 	char buff[13];
-	char *text;
 
-	// SMS indexes are 1..10
-	if (!index || index>10)
+	if (!index)
 		return 0;
 
+	gsmBufferCleanup(msg);
+	ctx.msg = msg;
+	gsmSMSTokInit(&ctx.tok, msg->text, sizeof(msg->text));
+
 	// Get the SMS message by the specified index
-	sprintf(buff, "AT+CMGR=%d", index);
-	_gsmWriteLine(buff);
 	// Example responce:
 	// +CMGR: "REC READ","+393357963938","","10/12/14,22:59:15+04"<0D><0A>
 	// $NUM+393473153808$NUM+3355763944$RES$MSG:PiazzaleLargo e Lungo, Milano, Italy$12345<0D>
 	// <0D><0A>
 	// <0D><0A>
 	// 0<0D>
+	// while, if this message index is empty, it is returned just "0<0D>"
+	sprintf_P(buff, PSTR("AT+CMGR=%d"), index);
+	AT_REQ_INIT(&req, buff, GSM_SMS_TIMEOUT_MS);
+	req.prefix = "+CMGR:";
+	req.line = _gsmCMGRLine;
+	req.stream = _gsmCMGRStream;
+	req.ctx = &ctx;
+	if (at_exec(&req) != OK) {
+		gsmDebug("Parse FAILED\n");
+		return -1;
+	}
 
-	//***** Reading message Type, record format:
-	// +CMGR: <TYPE>
-	// wherem TYPE is:
-	// Type          Bytes  Description
-	// "REC UNREAD"     12  Received unread messages
-	// "REC READ"       10  Received read messages
-	// "STO UNSENT"     12  Stored unsent messages
-	// "STO SENT"       10  Stored sent messages
-	// Minimum unique substring: 6 Bytes
-	// Thus, to parse the actual type, we read:
-	//     "+CMGR: " + 6Bytes = 13Bytes
-
-
-	// Check if this message index is empty
-	// In this case it is returned just "0<0D>"
-	c = kfile_getc(&(gsm->fd));
-	if (c == EOF)
-		goto parse_error;
-	if (c == '0') {
-		msg->from[0] = 0;
-		msg->time[0] = 0;
-		msg->text[0] = 0;
+	if (!msg->from[0]) {
 		LOG_INFO("SMS, P: %d, EMPTY\n", index);
 		return 0;
 	}
+	msg->cmds = ctx.tok.count;
 
-	// Read the rest of the initial record identifier
-	if (!kfile_read(&(gsm->fd), buff, 12))
-		goto parse_error;
-
-	// TODO: Parse message type
-	//
-
-	//***** Sender number
-	// Scanning for second '"', than parse the sender number
-	for (i=2; i; ) {
-		c = kfile_getc(&(gsm->fd));
-		if (c == EOF)
-			goto parse_error;
-		if (c=='"')
-			i--;
-	}
-	// Save the sender number, till next '"'
-	for (i=0; i<15; i++) {
-		c = kfile_getc(&(gsm->fd));
-		if (c == EOF)
-			goto parse_error;
-		if (c=='"')
-			break;
-		msg->from[i] = c;
-	}
-	msg->from[i] = '\0';
-
-	//***** Timestamp parsing
-	// Scanning for three '"', than parse the timestamp
-	for (i=3; i; ) {
-		c = kfile_getc(&(gsm->fd));
-		if (c == EOF)
-			goto parse_error;
-		if (c=='"')
-			i--;
-	}
-	// Save the timestamp (20 Bytes + terminator)
-	if (!kfile_read(&(gsm->fd), msg->time, 20))
-		goto parse_error;
-	msg->time[20] = '\0';
-	// Discard remaining chars till line termination ["<0D><0A>]
-	if (!kfile_read(&(gsm->fd), buff, 3))
-		goto parse_error;
-
-	//***** Message parsing
-	text = msg->text;
-	(*text) = kfile_getc(&(gsm->fd));
-	if ((*text) == EOF)
-		goto parse_error;
-
-	if ((*text) == '$') {
-		// Scanning for first ':', than parse the message
-		for (i=0; i<64; i++) {
-			c = kfile_getc(&(gsm->fd));
-			if (c == EOF)
-				goto parse_error;
-			if (c==':')
-				break;
-		}
-		// Save the message
-		if (_gsmRead(text, 160) == -1)
-			goto parse_error;
-	} else {
-		// We are already at the beginning of the message,
-		// save the remainder of the text
-		if (_gsmRead(text+1, 159) == -1)
-			goto parse_error;
-	}
-
-	LOG_INFO("SMS, P: %d, T: %s, N: %s, M: %s\n",
-			index, msg->time, msg->from, msg->text);
+	LOG_INFO("SMS, P: %d, T: %s, N: %s, C: %d\n",
+			index, msg->time, msg->from, msg->cmds);
 
 	return 1;
+}
 
-parse_error:
-	gsmDebug("Parse FAILED\n");
-	return -1;
+/**
+ * @brief Verify if some SMS announced by the modem could be still stored
+ *
+ * The announced SMS are considered as retrived only once gsmSMSFirst() does
+ * not find any stored SMS.
+ */
+uint8_t gsmSMSAnnounced(void) {
+	return smsAnnounced;
+}
+
+/*----- SMS Listing -----*/
+
+static void _gsmCMGLLine(at_req_t *req, const char *line) {
+	uint8_t *first = (uint8_t *)req->ctx;
+
+	// +CMGL: <INDEX>,<TYPE>,<NUMBER>,<ALPHA>,<TIMESTAMP>
+	// just the first header is dispatched, the following lines are streamed
+	if (!*first)
+		*first = atoi(line + 6);
+}
+
+static void _gsmCMGLStream(at_req_t *req, char c) {
+	// The texts, and the following messages, are skipped
+	(void)req;
+	(void)c;
+}
+
+/**
+ * @brief Get the index of the first SMS stored by the modem
+ *
+ * All the stored SMS are listed, whatever the size of the modem storage, and
+ * their status is not changed. The announced SMS are considered as retrived
+ * if none is stored, unless further ones are announced meanwhile.
+ *
+ * @return the index of the first SMS listed, 0 if none is stored, -1 on
+ * errors.
+ */
+int16_t gsmSMSFirst(void) {
+	at_req_t req;
+	uint8_t first = 0;
+
+	smsAnnounced = 0;
+
+	AT_REQ_INIT_P(&req, "AT+CMGL=\"ALL\",1", GSM_SMS_TIMEOUT_MS);
+	req.prefix = "+CMGL:";
+	req.line = _gsmCMGLLine;
+	req.stream = _gsmCMGLStream;
+	req.ctx = &first;
+	if (at_exec(&req) != OK) {
+		LOG_ERR("Fails, list SMS\n");
+		smsAnnounced = 1;
+		return -1;
+	}
+
+	if (first)
+		smsAnnounced = 1;
+	return first;
 }
 
 inline int8_t gsmSMSLast(gsmSMSMessage_t * msg) {
@@ -787,15 +856,16 @@ inline int8_t gsmSMSLast(gsmSMSMessage_t * msg) {
 
 int8_t gsmSMSDel(uint8_t index)
 {
+	at_req_t req;
 	char buff[16];
 
 	// Delete selected message
-	if (!index || index>10)
+	if (!index)
 		return OK;
 
-	sprintf(buff, "AT+CMGD=%d,0", index);
-	_gsmWriteLine(buff);
-	if (_gsmRead(buff, 16) == -1) {
+	sprintf_P(buff, PSTR("AT+CMGD=%d,0"), index);
+	AT_REQ_INIT(&req, buff, GSM_SMS_TIMEOUT_MS);
+	if (at_exec(&req) != OK) {
 		LOG_ERR("Fails, delete SMS %d\n", index);
 		return ERROR;
 	}
@@ -806,10 +876,10 @@ int8_t gsmSMSDel(uint8_t index)
 
 int8_t gsmSMSDelRead(void)
 {
-	char buff[16];
+	at_req_t req;
 
-	_gsmWriteLine("AT+CMGD=1,3");
-	if (_gsmRead(buff, 16) == -1) {
+	AT_REQ_INIT_P(&req, "AT+CMGD=1,3", GSM_SMS_TIMEOUT_MS);
+	if (at_exec(&req) != OK) {
 		LOG_ERR("Fails, delete readed SMS\n");
 		return ERROR;
 	}
@@ -36,6 +36,9 @@ typedef struct gsmCell {
 
 /* The GSM configuration and status */
 typedef struct gsmConf {
+#if 0
+	/* The modem identity and the cell informations, read just by the
+	 * (unused) gsmUpdateConf(): these would take more than 100 bytes of RAM */
 	/* Serial Number Identification(IMEI) */
 	char gsn[16];
 	/* International Mobile Subscriber Identity */
@@ -44,12 +47,13 @@ typedef struct gsmConf {
 	char ccid[24];
 	/* Revision Identification Of Software Release */
 	char gmr[32];
-	/* Received signal strength indication */
-	uint8_t rssi;
 	/* Valid network informations */
 	uint8_t validCellInfo:1;
 	/* Network cell infos */
 	gsmCell_t cell;
+#endif
+	/* Received signal strength indication */
+	uint8_t rssi;
 #define DEFAULT_MIN_SAFE_RSSI 1
 	/* Channel bit error rate */
 	uint8_t ber;
@@ -58,6 +62,9 @@ typedef struct gsmConf {
 	uint8_t creg_n;
 	/* Network registration status */
 	uint8_t creg_stat;
+#if 0
+	/* The GPRS connection settings, used just by the (disabled) GPRS
+	 * support: these would take more than 100 bytes of RAM */
 #define DEFAULT_CREG_TRY 5
 	uint8_t creg_try;
 #define DEFAULT_CREG_WAIT 5000
@@ -84,6 +91,7 @@ typedef struct gsmConf {
 	char sms_server[16];
 //#define DEFAULT_SMS_SERVER "+393357963944"
 #define DEFAULT_SMS_SERVER "+393473153808"
+#endif
 } gsmConf_t;
 
 extern gsmConf_t gsmConf;
@@ -137,18 +145,39 @@ typedef enum gsmSMSStatus {
 typedef struct gsmSMSMessage {
 	char from[16];
 	char time[21];
+	/* The commands of the message text, '\0' separated */
 	char text[161];
+	/* The number of commands */
+	uint8_t cmds;
 } gsmSMSMessage_t;
 
 inline void gsmBufferCleanup(gsmSMSMessage_t *msg);
 inline void gsmBufferCleanup(gsmSMSMessage_t *msg) {
-	if (msg->from[0]) {
-		memset(msg->from, 0, 16);
-		memset(msg->time, 0, 21);
-		memset(msg->text, 0, 161);
-	}
+	msg->from[0] = '\0';
+	msg->time[0] = '\0';
+	msg->text[0] = '\0';
+	msg->cmds = 0;
 }
 
+/* The SMS commands tokenizer */
+typedef struct gsmSMSTok {
+	/* The buffer of '\0' separated commands */
+	char *buf;
+	uint8_t size;
+	uint8_t len;
+	/* The start of the current command */
+	uint8_t mark;
+	/* The number of commands */
+	uint8_t count;
+	uint8_t state;
+	/* The current command does not fit the buffer */
+	uint8_t overflow;
+} gsmSMSTok_t;
+
+void gsmSMSTokInit(gsmSMSTok_t *tok, char *buf, uint8_t size);
+void gsmSMSTokPut(gsmSMSTok_t *tok, char c);
+void gsmSMSTokEnd(gsmSMSTok_t *tok);
+
 #if CONFIG_GSM_TESTING
 void gsmTesting(Serial *port);
 #else
@@ -157,6 +186,7 @@ void gsmTesting(Serial *port);
 
 /* GSM Control Interface */
 void gsmInit(Serial *port);
+void gsmPoll(void);
 void gsmReset(void);
 int8_t gsmPowerOn(void);
 void gsmPowerOff(void);
@@ -179,6 +209,8 @@ int8_t gsmSMSParse(char *buff, gsmSMSMessage_t * msg);
 int8_t gsmSMSLast(gsmSMSMessage_t * msg);
 
 int8_t gsmSMSByIndex(gsmSMSMessage_t * msg, uint8_t index);
+uint8_t gsmSMSAnnounced(void);
+int16_t gsmSMSFirst(void);
 int8_t gsmSMSDel(uint8_t index);
 int8_t gsmSMSDelRead(void);
 int8_t gsmSMSList(void);
@@ -0,0 +1,271 @@
+/**
+ *       @file  journal.c
+ *      @brief  Events journal
+ *
+ * This provides a journal of the relevant device events (resets, calibrations,
+ * faults and GSM restarts). Events are fixed size records, appended to a RAM
+ * ring and spilled in background to a circular EEPROM region, thus the
+ * history survives lost SMS notifications as well as device resets.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "journal.h"
+
+#include "cfg/cfg_control.h"
+
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+
+#include <cfg/macros.h>
+#include <cpu/irq.h>
+#include <drv/timer.h>
+
+
+/* Define logging settings (for cfg/log.h module). */
+#define LOG_LEVEL   CONTROL_LOG_LEVEL
+#define LOG_FORMAT  CONTROL_LOG_FORMAT
+#include <cfg/log.h>
+
+#define RAM_MASK (CONFIG_JOURNAL_RAM_SIZE-1)
+STATIC_ASSERT(!(CONFIG_JOURNAL_RAM_SIZE & RAM_MASK));
+
+// The on EEPROM events records, written round-robin
+journal_ev_t EEMEM eejournal[CONFIG_JOURNAL_EE_SIZE];
+
+// The RAM ring of the most recent events
+static journal_ev_t ring[CONFIG_JOURNAL_RAM_SIZE];
+// The ring slot of the next event
+static uint8_t rHead = 0;
+// The number of events in the ring
+static uint8_t rCount = 0;
+// The number of events in the ring not yet saved on EEPROM
+static volatile uint8_t rPending = 0;
+
+// The EEPROM slot of the next saved event
+static uint8_t eHead = 0;
+// The number of valid events on EEPROM
+static uint8_t eCount = 0;
+
+// The sequence number of the next event
+static uint16_t nextSeq = 0;
+
+// The short names of the events, in journal_events_t order
+static const char evNames[EV_COUNT][6] PROGMEM = {
+	"-", "BOOT", "RST", "CAL", "CALOK", "SPOIL", "GUAS", "GSM",
+};
+
+static inline uint32_t uptime(void) {
+	return ticks_to_ms(timer_clock()) / 1000;
+}
+
+static inline uint8_t evValid(const journal_ev_t *ev) {
+	return (ev->type != EV_NONE && ev->type < EV_COUNT);
+}
+
+/**
+ * @brief Recover the journal position from the EEPROM records
+ *
+ * The most recent valid record is the one with the higher sequence number,
+ * the next events are saved starting from the following slot.
+ */
+void journal_init(void) {
+	journal_ev_t ev;
+	uint8_t latest = 0;
+
+	for (uint8_t slot = 0; slot < CONFIG_JOURNAL_EE_SIZE; ++slot) {
+		eeprom_read_block(&ev, &eejournal[slot], sizeof(journal_ev_t));
+		if (!evValid(&ev))
+			continue;
+		// Sequence numbers wrap around
+		if (!eCount || (int16_t)(ev.seq - nextSeq) >= 0) {
+			latest = slot;
+			nextSeq = ev.seq + 1;
+		}
+		eCount++;
+	}
+
+	if (eCount)
+		eHead = (latest + 1) % CONFIG_JOURNAL_EE_SIZE;
+
+	LOG_INFO("Journal [%hu events, next %u]\r\n", eCount, nextSeq);
+}
+
+/**
+ * @brief Append an event to the journal
+ *
+ * This is O(1) and could be called from interrupt context too. When the ring
+ * is full of events not yet saved, the oldest one is lost.
+ */
+void journal_add(uint8_t type, uint8_t arg) {
+	uint32_t stamp = uptime();
+	journal_ev_t *ev;
+
+	ATOMIC(
+		ev = &ring[rHead];
+		ev->seq = nextSeq++;
+		ev->type = type;
+		ev->arg = arg;
+		ev->stamp = stamp;
+		rHead = (rHead + 1) & RAM_MASK;
+		if (rCount < CONFIG_JOURNAL_RAM_SIZE)
+			rCount++;
+		if (rPending < CONFIG_JOURNAL_RAM_SIZE)
+			rPending++;
+	);
+}
+
+/**
+ * @brief Get a journal event
+ *
+ * @param idx the event index, 0 being the most recent one
+ * @return 0 if the event is available, -1 otherwise
+ */
+int8_t journal_get(uint8_t idx, journal_ev_t *ev) {
+	uint8_t found = 0;
+	uint8_t pending;
+
+	ATOMIC(
+		pending = rPending;
+		if (idx < rCount) {
+			*ev = ring[(rHead - 1 - idx) & RAM_MASK];
+			found = 1;
+		}
+	);
+	if (found)
+		return 0;
+
+	// Older events are read from EEPROM, which has all the saved ones
+	idx -= pending;
+	if (idx >= eCount)
+		return -1;
+
+	idx = (eHead + CONFIG_JOURNAL_EE_SIZE - 1 - idx) % CONFIG_JOURNAL_EE_SIZE;
+	eeprom_read_block(ev, &eejournal[idx], sizeof(journal_ev_t));
+	return 0;
+}
+
+/** @brief Save the oldest pending event, 0 if there are not */
+static uint8_t journal_save(void) {
+	uint8_t pending;
+	journal_ev_t ev;
+
+	ATOMIC(
+		pending = rPending;
+		if (pending)
+			ev = ring[(rHead - pending) & RAM_MASK];
+	);
+	if (!pending)
+		return 0;
+
+	eeprom_update_block(&ev, &eejournal[eHead], sizeof(journal_ev_t));
+	eHead = (eHead + 1) % CONFIG_JOURNAL_EE_SIZE;
+	if (eCount < CONFIG_JOURNAL_EE_SIZE)
+		eCount++;
+
+	// Events lost while saving have been dropped from pending already
+	ATOMIC(
+		if (rPending &&
+				ring[(rHead - rPending) & RAM_MASK].seq == ev.seq)
+			rPending--;
+	);
+
+	return 1;
+}
+
+/**
+ * @brief Spill pending events to EEPROM, in background
+ *
+ * This should be called periodically. Events are saved once half of the
+ * ring is pending or the oldest pending one is CONFIG_JOURNAL_FLUSH_DELAY
+ * seconds old; then, one event is saved at each call, thus bounding the
+ * EEPROM write time spent by the caller.
+ */
+void journal_poll(void) {
+	static uint8_t flushing = 0;
+	uint32_t oldest;
+
+	if (!rPending) {
+		flushing = 0;
+		return;
+	}
+
+	if (!flushing) {
+		ATOMIC(oldest = ring[(rHead - rPending) & RAM_MASK].stamp);
+		if (rPending < CONFIG_JOURNAL_RAM_SIZE/2 &&
+				uptime() - oldest < CONFIG_JOURNAL_FLUSH_DELAY)
+			return;
+		flushing = 1;
+	}
+
+	journal_save();
+}
+
+/** @brief Save all the pending events, e.g. before a reset */
+void journal_flush(void) {
+	while (journal_save())
+		;
+}
+
+// The size of a formatted event: "\nSEQ NAME ARG STAMP"
+#define JOURNAL_LINE_SIZE (1+5+1+5+1+3+1+10+1)
+
+static void formatEvent(text_t *t, const journal_ev_t *ev) {
+	text_char(t, '\n');
+	text_uint(t, ev->seq, 0, 0);
+	text_char(t, ' ');
+	text_str_P(t, evNames[ev->type]);
+	text_char(t, ' ');
+	text_uint(t, ev->arg, 0, 0);
+	text_char(t, ' ');
+	text_uint(t, ev->stamp, 0, 0);
+}
+
+/**
+ * @brief Append the most recent events, oldest first
+ *
+ * Events are formatted one for each line, up to \a count events or as much
+ * as they fit into the text.
+ *
+ * @return the number of formatted events
+ */
+uint8_t journal_format(text_t *t, uint8_t count) {
+	char line[JOURNAL_LINE_SIZE];
+	text_t lt = TEXT_INIT(line);
+	journal_ev_t ev;
+	uint8_t fit = 0;
+	uint16_t len;
+
+	len = sizeof("Eventi:")-1;
+
+	// Count the most recent events fitting the text
+	for ( ; fit < count; ++fit) {
+		if (journal_get(fit, &ev) != 0)
+			break;
+		text_reset(&lt);
+		formatEvent(&lt, &ev);
+		len += text_len(&lt);
+		if (len > text_room(t))
+			break;
+	}
+
+	// Then format them, oldest first
+	text_lit(t, "Eventi:");
+	for (uint8_t idx = fit; idx--; ) {
+		journal_get(idx, &ev);
+		formatEvent(t, &ev);
+	}
+
+	return fit;
+}
@@ -0,0 +1,72 @@
+/**
+ *       @file  journal.h
+ *      @brief  Events journal
+ *
+ * This provides a journal of the relevant device events (resets, calibrations,
+ * faults and GSM restarts). Events are fixed size records, appended to a RAM
+ * ring and spilled in background to a circular EEPROM region, thus the
+ * history survives lost SMS notifications as well as device resets.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef ADE_JOURNAL_H_
+#define ADE_JOURNAL_H_
+
+#include "text.h"
+
+#include <cfg/compiler.h>
+
+/** @brief The journal event types */
+typedef enum journal_events {
+	// Not valid record (0x00 and 0xFF being erased EEPROM)
+	EV_NONE = 0,
+	// Device boot, arg is the reset reasons (MCUSR)
+	EV_BOOT,
+	// Device reset forced by command or button
+	EV_RESET,
+	// Calibration of all the channels started
+	EV_CALIB,
+	// Calibration of a channel completed, arg is the channel
+	EV_CALIB_DONE,
+	// A channel has been found spoiled, arg is the channel
+	EV_SPOILED,
+	// A channel has been found faulted, arg is the channel
+	EV_FAULTED,
+	// The GSM modem has been restarted
+	EV_GSM_RESTART,
+
+	EV_COUNT,
+} journal_events_t;
+
+/** A journal record */
+typedef struct journal_ev {
+	/** The event sequence number */
+	uint16_t seq;
+	/** The event type */
+	uint8_t type;
+	/** The event argument */
+	uint8_t arg;
+	/** The uptime [s] of the event (no RTC available) */
+	uint32_t stamp;
+} journal_ev_t;
+
+void journal_init(void);
+void journal_add(uint8_t type, uint8_t arg);
+int8_t journal_get(uint8_t idx, journal_ev_t *ev);
+void journal_poll(void);
+void journal_flush(void);
+uint8_t journal_format(text_t *t, uint8_t count);
+
+#endif /* end of include guard: ADE_JOURNAL_H_ */
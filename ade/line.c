@@ -0,0 +1,115 @@
+/**
+ *       @file  line.c
+ *      @brief  Line cycle tracker
+ *
+ * The period is filtered by a moving average, thus a single bad reading of
+ * the meter is not relevant, but for steps of the line frequency, while
+ * missing zero-crossings (e.g. on blackouts) just disable the phase
+ * prediction.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "line.h"
+
+#include "signals.h"
+
+#include <cfg/macros.h>
+#include <drv/meter_ade7753.h>
+
+/* Define logging settings (for cfg/log.h module). */
+#define LOG_LEVEL   CONTROL_LOG_LEVEL
+#define LOG_FORMAT  CONTROL_LOG_FORMAT
+#include <cfg/log.h>
+
+// The filtered line period [us]
+uint16_t line_periodUs = LINE_PERIOD_NOMINAL_US;
+
+// The filter accumulator, i.e. the period scaled by LINE_FILTER_SHIFT
+static uint32_t periodAcc;
+
+// The time of the last rising zero-crossing, if valid
+static tstamp_t zxAt;
+static uint8_t zxValid = 0;
+
+static const meter_reg_t period_reg[] = {
+	{ ADE7753_PERIOD, 2 },
+};
+
+/** @brief Convert a PERIOD register value into [us], 0 if not valid */
+static uint16_t periodToUs(uint16_t reg) {
+	uint32_t us = ((uint32_t)reg * ADE7753_PERIOD_LSB_NS) / 1000;
+
+	if (us < LINE_PERIOD_MIN_US || us > LINE_PERIOD_MAX_US)
+		return 0;
+	return us;
+}
+
+/** @brief Setup the tracker, reading the current line period */
+void line_init(void) {
+	uint32_t reg;
+
+	meter_ade7753_readBurst(period_reg, 1, &reg);
+	if (periodToUs(reg))
+		line_periodUs = periodToUs(reg);
+	periodAcc = (uint32_t)line_periodUs << LINE_FILTER_SHIFT;
+	zxValid = 0;
+
+	LOG_INFO("Line period: %u [us]\r\n", line_periodUs);
+
+	// Track the line phase
+	signal_enable(SIGNAL_ADE_ZX);
+}
+
+/** @brief Update the line period with a PERIOD register value */
+void line_measure(uint16_t reg) {
+	uint16_t us = periodToUs(reg);
+
+	// Without line voltage the meter does not measure the period
+	if (!us)
+		return;
+
+	// Restart the filter on line frequency steps, e.g. a generator
+	if (ABS((int16_t)(us - line_periodUs)) > (line_periodUs >> LINE_STEP_SHIFT))
+		periodAcc = (uint32_t)us << LINE_FILTER_SHIFT;
+	else
+		periodAcc += us - (periodAcc >> LINE_FILTER_SHIFT);
+	line_periodUs = periodAcc >> LINE_FILTER_SHIFT;
+}
+
+/** @brief Update the line phase with the time of a rising zero-crossing */
+void line_zx(tstamp_t at) {
+	zxAt = at;
+	zxValid = 1;
+
+	// Just a zero-crossing is queued at a time
+	signal_enable(SIGNAL_ADE_ZX);
+}
+
+/**
+ * @brief Get the time of the first line zero-crossing (of either direction)
+ * after the \a after time
+ *
+ * @return the \a after time itself if the line phase is not known
+ */
+tstamp_t line_nextCrossing(tstamp_t after) {
+	uint16_t half = line_periodUs >> 1;
+	tstamp_t elapsed;
+
+	elapsed = after - zxAt;
+	if (!zxValid || elapsed > LINE_PHASE_VALID_US)
+		return after;
+
+	return zxAt + (elapsed / half + 1) * half;
+}
@@ -0,0 +1,56 @@
+/**
+ *       @file  line.h
+ *      @brief  Line cycle tracker
+ *
+ * This tracks the period of the power line, as measured by the meter at
+ * each sample, and its phase, as given by the timestamps of the rising
+ * zero-crossing edges. Accumulations are thus armed just before a line
+ * crossing, and their timings follow the actual line frequency.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef ADE_LINE_H_
+#define ADE_LINE_H_
+
+#include "control.h"
+#include "timestamp.h"
+
+#include <cfg/compiler.h>
+
+// The nominal line period [us], used till measured
+#define LINE_PERIOD_NOMINAL_US (1000U*ADE_LINE_CYCLES_PERIOD)
+// The valid line periods [us], i.e. 40Hz to 70Hz
+#define LINE_PERIOD_MIN_US 14286U
+#define LINE_PERIOD_MAX_US 25000U
+// The weight (power of 2) of the filtered period over a new measure
+#define LINE_FILTER_SHIFT 3
+// The period variation (power of 2 fraction) considered a frequency step
+#define LINE_STEP_SHIFT 4
+// The time [us] a zero-crossing is used to predict the following ones
+#define LINE_PHASE_VALID_US 1000000L
+
+extern uint16_t line_periodUs;
+
+void line_init(void);
+void line_measure(uint16_t reg);
+void line_zx(tstamp_t at);
+tstamp_t line_nextCrossing(tstamp_t after);
+
+/** @brief Get the (filtered) line period [us] */
+INLINE uint16_t line_period(void) {
+	return line_periodUs;
+}
+
+#endif /* end of include guard: ADE_LINE_H_ */
@@ -1,9 +1,13 @@
 
 #include "console.h"
 #include "eeprom.h"
+#include "journal.h"
+#include "perf.h"
 #include "control.h"
 #include "command.h"
 #include "signals.h"
+#include "stack.h"
+#include "text.h"
 
 #include "gsm.h"
 
@@ -21,10 +25,16 @@
 #include <drv/ser.h>
 #include <drv/timer.h>
 
+#include <kern/proc.h>
+
 #include <stdio.h>
 #include <verstag.h>
 
+#if (ARCH & ARCH_EMUL)
+# include "emul/sim.h"
+#else
 static Serial spi_port;
+#endif
 static Serial gsm_port;
 Serial dbg_port;
 
@@ -55,26 +65,37 @@ static void printResetReason(void) {
 static void notifyPowerOn(void);
 static void notifyPowerOn(void) {
 	char dst[MAX_SMS_NUM];
-	char *msg = cmdBuff;
-	uint8_t len;
+	text_t msg;
+	uint16_t size;
+	char *buff;
 
 	if (!ee_onNotifyReboot())
 		return;
 
-	// Format SMS message
-	len  = ee_getSmsText(msg, MAX_MSG_TEXT);
-	len += sprintf(msg+len, "\r\nAvvio RFN (0x%02X): ", rst_reason);
+	// Format SMS message, the console process has not run yet thus the
+	// reply buffer is free
+	buff = command_replyBuffer(&size);
+	text_init(&msg, buff, size);
+	text_commit(&msg, ee_getSmsText(text_end(&msg), MAX_MSG_TEXT));
+	text_lit(&msg, "\r\nAvvio RFN (0x");
+	text_hex(&msg, rst_reason, 2);
+	text_lit(&msg, "): ");
 	for (uint8_t i = 0; i < 5; i++) {
 		if (rst_reason & BV8(i))
-			len += sprintf(msg+len, "%c", rst_reasons[i]);
+			text_char(&msg, rst_reasons[i]);
 	}
 
 	// Send message by SMS to all enabled destination
 	ee_getSmsDest(1, dst, MAX_SMS_NUM);
-	controlNotifyBySMS(dst, msg);
+	controlNotifyBySMS(dst, msg.buf);
 }
 
 //=====[ Stack Usage Monitoring ]===============================================
+#if (ARCH & ARCH_EMUL)
+// The host stack is not bounded by the AVR data memory
+# define StackTrack() do {} while (0)
+# define CheckStack() do {} while (0)
+#else
 extern uint8_t _end; 
 extern uint8_t __stack;
 #define STACK_CANARY 0xC5
@@ -108,35 +129,17 @@ void StackPaint(void) {
 #endif 
 }
 
-// Get a count of available STACK memory
-uint16_t StackCount(void);
-uint16_t StackCount(void)  { 
-    const uint8_t *p = &_end; 
-    uint16_t       c = 0; 
-    while (*p == STACK_CANARY &&
-			p <= &__stack) { 
-        p++; c++; 
-    } 
-    return c; 
+// Track the main stack, painted from the end of the data up to its top
+static void StackTrack(void) {
+	stack_add(STACK_MAIN, &_end, &__stack - &_end + 1, STACK_CANARY);
 }
 
-// Keep track of MIN stach size
+// Keep track of the stack low-water mark, a few bytes at each call
 void CheckStack(void);
 void CheckStack(void) {
-	static uint16_t maxStack = 0x0000;
-	uint16_t freeStack = 0;
-
-	// Check for available STACK size
-	freeStack = StackCount();
-
-	// Update MAX free stack sizes
-	if (maxStack < freeStack) {
-		maxStack = freeStack;
-	}
-
-	//kprintf("Free stack (min/max): %d/%d\n", freeStack, maxStack);
 
-	if (freeStack != 0)
+	stack_scan(STACK_MAIN);
+	if (stack_minFree(STACK_MAIN) != 0)
 		return;
 
 	// Stack overflow has occurred
@@ -145,6 +148,7 @@ void CheckStack(void) {
 	while(1);
 	
 }
+#endif
 
 
 
@@ -165,17 +169,25 @@ static void init(void) {
 
 	kdbg_init();
 	timer_init();
+	proc_init();
 	signals_init();
 
 	IRQ_ENABLE;
 
 }
 
+#if (ARCH & ARCH_EMUL)
+int main(int argc, char *argv[]) {
+
+	sim_init(&argc, argv);
+#else
 int main(void) {
+#endif
 
 	init();
 	LED_ON();
 
+	StackTrack();
 	CheckStack();
 
 	kprintf("RFN (c) 2011 RCT\r\nBuildNr %d\r\n", vers_build_nr);
@@ -207,9 +219,13 @@ int main(void) {
 	LED_GSM_OFF();
 
 	/* Initialize ADE7753 SPI port and data structure */
+#if (ARCH & ARCH_EMUL)
+	meter_ade7753_init(sim_adeSpi());
+#else
 	spimaster_init(&spi_port, SER_SPI);
 	ser_setbaudrate(&spi_port, 500000L);
 	meter_ade7753_init((KFile *)&spi_port);
+#endif
 
 	/* Testing SIGNALS (if enabled by configuration) */
 	sigTesting();
@@ -223,12 +239,12 @@ int main(void) {
 	/* Dump EEPROM configuration */
 	ee_loadConf();
 
-#if 1
-	/* Power-on Modem */
+	/* Recover the events journal and log this boot */
+	journal_init();
+	journal_add(EV_BOOT, rst_reason);
+
+	/* Setup the Modem, which is powered on by the GSM process */
 	gsmInit(&gsm_port);
-	gsmPowerOn();
-	gsmSMSConf(0);
-#endif
 
 	/* Entering the main control loop */
 	controlSetup();
@@ -239,7 +255,9 @@ int main(void) {
 	/* Main control loop */
 	while(1) {
 		CheckStack();
+		PERF_START(scan);
 		controlLoop();
+		PERF_STOP(PERF_SCAN, scan);
 	}
 
 	return 0;
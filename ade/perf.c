@@ -0,0 +1,148 @@
+/**
+ *       @file  perf.c
+ *      @brief  Performance counters and latency histograms
+ *
+ * Latencies are recorded and dumped by the main loop only, i.e. these are
+ * not interrupt safe.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "perf.h"
+
+#include <cfg/macros.h>
+
+#include <string.h> // memset
+
+/* Define logging settings (for cfg/log.h module). */
+#define LOG_LEVEL   CONTROL_LOG_LEVEL
+#define LOG_FORMAT  CONTROL_LOG_FORMAT
+#include <cfg/log.h>
+
+#if CONFIG_PERF
+
+/** A latency histogram */
+typedef struct perf_hist {
+	/** The (scaled) number of latencies of each bucket */
+	uint16_t buckets[PERF_BUCKETS];
+	/** The number of latencies recorded */
+	uint32_t count;
+	/** The maximum latency recorded [us] */
+	tstamp_t max;
+} perf_hist_t;
+
+static perf_hist_t hists[PERF_HISTS];
+static uint16_t counters[PERF_COUNTERS];
+
+// The names of the histograms, in perf_hists_t order
+static const char *histNames[PERF_HISTS] = {
+	"Scan", "Sample", "AT", "Parse",
+};
+
+// The names of the counters, in perf_counters_t order
+static const char *cntNames[PERF_COUNTERS] = {
+	"Sample timeouts", "AT timeouts", "Invalid commands", "Dropped SMS",
+	"Signal overruns",
+};
+
+/** @brief Get the start timestamp of a latency [us] */
+tstamp_t perf_start(void) {
+	return timestamp_us();
+}
+
+/** @brief Count an event, saturating */
+void perf_count(uint8_t cnt) {
+	if (counters[cnt] != UINT16_MAX)
+		++counters[cnt];
+}
+
+/** @brief Get the bucket of a latency [us] */
+static inline uint8_t bucket(tstamp_t us) {
+	uint8_t b = 0;
+
+	us >>= PERF_MIN_SHIFT;
+	while (us && b < PERF_BUCKETS-1) {
+		us >>= 1;
+		++b;
+	}
+
+	return b;
+}
+
+/** @brief Record the latency elapsed since the \a start timestamp */
+void perf_record(uint8_t hist, tstamp_t start) {
+	tstamp_t us = timestamp_elapsed(start);
+	perf_hist_t *h = &hists[hist];
+	uint8_t b = bucket(us);
+
+	// Rescale the histogram, which keeps the latencies distribution
+	if (h->buckets[b] == UINT16_MAX) {
+		for (uint8_t i = 0; i < PERF_BUCKETS; ++i)
+			h->buckets[i] >>= 1;
+	}
+	++h->buckets[b];
+
+	++h->count;
+	if (us > h->max)
+		h->max = us;
+}
+
+/** @brief Dump the counters and the not empty buckets of the histograms */
+void perf_dump(void) {
+	perf_hist_t *h;
+
+	for (uint8_t i = 0; i < PERF_HISTS; ++i) {
+		h = &hists[i];
+		LOG_INFO("%s: %lu, max %lu [us]\r\n",
+				histNames[i], h->count, h->max);
+		for (uint8_t b = 0; b < PERF_BUCKETS; ++b) {
+			if (!h->buckets[b])
+				continue;
+			LOG_INFO(" %s%7lu: %5u\r\n",
+					(b < PERF_BUCKETS-1) ? "< " : ">=",
+					BV32(PERF_MIN_SHIFT + b - (b == PERF_BUCKETS-1)),
+					h->buckets[b]);
+		}
+	}
+
+	for (uint8_t i = 0; i < PERF_COUNTERS; ++i)
+		LOG_INFO("%s: %u\r\n", cntNames[i], counters[i]);
+}
+
+/** @brief Format the number and the maximum of the latencies, and the counters */
+void perf_format(text_t *t) {
+	text_lit(t, "Prestazioni [us]:");
+	for (uint8_t i = 0; i < PERF_HISTS; ++i) {
+		text_lit(t, "\r\n");
+		text_str(t, histNames[i]);
+		text_lit(t, ": ");
+		text_uint(t, hists[i].count, 0, 0);
+		text_lit(t, ", max ");
+		text_uint(t, hists[i].max, 0, 0);
+	}
+	for (uint8_t i = 0; i < PERF_COUNTERS; ++i) {
+		text_lit(t, "\r\n");
+		text_str(t, cntNames[i]);
+		text_lit(t, ": ");
+		text_uint(t, counters[i], 0, 0);
+	}
+}
+
+/** @brief Reset all the counters and histograms */
+void perf_reset(void) {
+	memset(hists, 0, sizeof(hists));
+	memset(counters, 0, sizeof(counters));
+}
+
+#endif /* CONFIG_PERF */
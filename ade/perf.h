@@ -0,0 +1,102 @@
+/**
+ *       @file  perf.h
+ *      @brief  Performance counters and latency histograms
+ *
+ * This provides a lightweight instrumentation of the firmware hot paths:
+ * named event counters and log2 bucketed histograms of the latencies
+ * measured by the high resolution timestamps. Buckets are 16 bits wide and
+ * all the buckets of a histogram are halved when one would overflow, thus
+ * the RAM cost is fixed while the recent distribution is preserved.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef ADE_PERF_H_
+#define ADE_PERF_H_
+
+#include "text.h"
+#include "timestamp.h"
+
+#include "cfg/cfg_control.h"
+
+#include <cfg/compiler.h>
+
+/** @brief The latency histograms */
+typedef enum perf_hists {
+	// An iteration of the control loop
+	PERF_SCAN = 0,
+	// The meter read of a sample
+	PERF_SAMPLE,
+	// An AT command, till its final result
+	PERF_AT,
+	// The parsing and execution of a console/SMS command
+	PERF_PARSE,
+
+	PERF_HISTS,
+} perf_hists_t;
+
+/** @brief The event counters */
+typedef enum perf_counters {
+	// Meter accumulations not completed in time
+	PERF_SMP_TIMEOUT = 0,
+	// AT commands without a final result
+	PERF_AT_TIMEOUT,
+	// Console/SMS commands not valid
+	PERF_CMD_INVALID,
+	// SMS dropped since the queue was full
+	PERF_SMS_DROPPED,
+	// Signal edges dropped since the queue was full
+	PERF_SIG_OVERRUN,
+
+	PERF_COUNTERS,
+} perf_counters_t;
+
+// The number of buckets of each histogram
+#define PERF_BUCKETS 16
+// The first bucket counts latencies below (1 << PERF_MIN_SHIFT) [us], each
+// other one the latencies up to twice the previous one, while the last one
+// is open ended
+#define PERF_MIN_SHIFT 5
+
+#if CONFIG_PERF
+
+tstamp_t perf_start(void);
+void perf_count(uint8_t cnt);
+void perf_record(uint8_t hist, tstamp_t start);
+void perf_dump(void);
+void perf_format(text_t *t);
+void perf_reset(void);
+
+/** @brief Start measuring a latency into the \a T timestamp */
+# define PERF_START(T) tstamp_t T = perf_start()
+/** @brief Start measuring a latency into the existing \a T timestamp */
+# define PERF_MARK(T) (T) = perf_start()
+/** @brief Record into the \a H histogram the latency started at \a T */
+# define PERF_STOP(H, T) perf_record(H, T)
+/** @brief Count an event of the \a C counter */
+# define PERF_COUNT(C) perf_count(C)
+
+#else
+
+# define PERF_START(T) do {} while (0)
+# define PERF_MARK(T) do {} while (0)
+# define PERF_STOP(H, T) do {} while (0)
+# define PERF_COUNT(C) do {} while (0)
+# define perf_dump() do {} while (0)
+# define perf_format(T) text_lit((T), "Prestazioni non disponibili")
+# define perf_reset() do {} while (0)
+
+#endif
+
+#endif /* end of include guard: ADE_PERF_H_ */
@@ -0,0 +1,120 @@
+/**
+ *       @file  power.h
+ *      @brief  Fixed-point power computation
+ *
+ * This provides the integer kernel to compute the channels load from the
+ * meter RMS readings. The AVR has no FPU, thus this avoids the soft-float
+ * routines on the sampling path: the result is bit-exact with respect to
+ * the previous double precision computation.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef ADE_POWER_H_
+#define ADE_POWER_H_
+
+#include <cfg/compiler.h>
+
+// The maximum value of the meter RMS registers (24 bits)
+#define POWER_RMS_MAX 0xFFFFFFUL
+
+// The Prms scaling factor: Prms = Irms * Vrms / POWER_SCALE
+#define POWER_SCALE 100000UL
+
+// The Prms scaling factor when only Irms is monitored
+#define POWER_IRMS_SCALE 10
+
+// POWER_SCALE is split into (1 << 5) * 3125, the division by 3125 is
+// computed by the multiplication for its Q40 reciprocal, ceil(2^40/3125),
+// which is exact for dividends lower than 2^28. The reciprocal is split in
+// two 16 bits digits.
+#define POWER_DIV_SHIFT 5
+#define POWER_DIV_Q40   351843721UL
+#define POWER_DIV_Q40_H ((uint16_t)(POWER_DIV_Q40 >> 16))
+#define POWER_DIV_Q40_L ((uint16_t)POWER_DIV_Q40)
+
+/**
+ * @brief Get the 32 bits product of two 16 bits digits
+ *
+ * On AVR this maps to the short __umulhisi3 helper, while the 64 bits
+ * products would go through the __muldi3 libcall.
+ */
+INLINE uint32_t power_mul16(uint16_t a, uint16_t b) {
+	return (uint32_t)a * b;
+}
+
+/**
+ * @brief Get X/3125 (exact for X < 2^28)
+ *
+ * The 57 bits product by the reciprocal is computed by 16 bits digits,
+ * keeping just the bits above the 16th: X is lower than 2^28, thus the
+ * middle terms sum up to less than 2^30.
+ */
+INLINE uint32_t power_div3125(uint32_t x) {
+	uint16_t x1 = x >> 16;
+	uint16_t x0 = x;
+	uint32_t mid;
+
+	mid = power_mul16(x1, POWER_DIV_Q40_L) +
+		power_mul16(x0, POWER_DIV_Q40_H) +
+		(power_mul16(x0, POWER_DIV_Q40_L) >> 16);
+
+	// (X * Q40) >> 40, i.e. ((X * Q40) >> 16) >> 24
+	return (power_mul16(x1, POWER_DIV_Q40_H) + (mid >> 16)) >> 8;
+}
+
+/**
+ * @brief Get the RMS power from the RMS current and voltage
+ *
+ * This computes Irms * Vrms / POWER_SCALE on 24 bits inputs by just 16 bits
+ * multiplications and shifts: the 48 bits product is kept as its upper 32
+ * bits and its lower 16 bits, once scaled by the power of two factor it is
+ * divided by 3125 in two 16 bits digits, both of them lower than 2^28.
+ */
+INLINE uint32_t power_rms(uint32_t irms, uint32_t vrms) {
+	uint16_t a1, a0, b1, b0;
+	uint32_t lo, hi, q, r;
+
+	if (irms > POWER_RMS_MAX)
+		irms = POWER_RMS_MAX;
+	if (vrms > POWER_RMS_MAX)
+		vrms = POWER_RMS_MAX;
+
+	a1 = irms >> 16; a0 = irms;
+	b1 = vrms >> 16; b0 = vrms;
+
+	// Irms * Vrms = (hi << 16) + (uint16_t)lo, the 8 bits high digits
+	// keep the middle terms lower than 2^26
+	lo = power_mul16(a0, b0);
+	hi = (power_mul16(a1, b1) << 16) + power_mul16(a1, b0) +
+		power_mul16(a0, b1) + (lo >> 16);
+
+	// High digit: the scaled product >> 16, i.e. hi >> 5 < 2^27
+	q = power_div3125(hi >> POWER_DIV_SHIFT);
+	r = (hi >> POWER_DIV_SHIFT) - power_mul16(q, 3125);
+
+	// Low digit: (r << 16) < 3125 * 2^16 < 2^28
+	lo = (uint16_t)((hi << (16 - POWER_DIV_SHIFT)) |
+			((uint16_t)lo >> POWER_DIV_SHIFT));
+	return (q << 16) + power_div3125((r << 16) | lo);
+}
+
+/** @brief Get the load from the RMS current only */
+INLINE uint32_t power_irms(uint32_t irms) {
+	if (irms > POWER_RMS_MAX)
+		irms = POWER_RMS_MAX;
+	return irms * POWER_IRMS_SCALE;
+}
+
+#endif /* end of include guard: ADE_POWER_H_ */
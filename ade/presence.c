@@ -0,0 +1,156 @@
+/**
+ *       @file  presence.c
+ *      @brief  Channels presence tracking
+ *
+ * The inputs are read only by the main loop, thus the active channels are
+ * updated without locking.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "presence.h"
+
+#include "signals.h"
+
+#include "cfg/cfg_control.h"
+
+#include <drv/timer.h>
+
+/* Define logging settings (for cfg/log.h module). */
+#define LOG_LEVEL   CONTROL_LOG_LEVEL
+#define LOG_FORMAT  CONTROL_LOG_FORMAT
+#include <cfg/log.h>
+
+presence_t activeChs;
+
+static I2c *bus;
+static Pca9555 *pe;
+
+// The last inputs read, not yet settled
+static uint16_t bouncing;
+// The number of consecutive reads of the bouncing inputs, 0 once settled
+static uint8_t stable;
+// Set while the inputs could not be read
+static uint8_t failing;
+
+// The reads attempted at power-on, before taking all channels as off
+#define PRESENCE_INIT_READS 100
+
+/**
+ * @brief Get the bitmask of the powered-on channels, i.e. low inputs
+ *
+ * @return 1 if the inputs have been read, 0 on I2C failures
+ */
+static uint8_t readInputs(uint16_t *chs) {
+	uint16_t inputs;
+
+	// Reading the inputs releases the INT line
+	if (!pca9555_in(bus, pe, &inputs)) {
+		if (!failing)
+			LOG_WARN("Presenza canali non disponibile\r\n");
+		failing = 1;
+		return 0;
+	}
+
+	failing = 0;
+	*chs = ~inputs;
+	return 1;
+}
+
+/**
+ * @brief Track the debounced \a chs powered-on channels
+ *
+ * @return 1 once the inputs are settled, 0 while they are bouncing
+ */
+static uint8_t debounce(uint16_t chs) {
+
+	if (!stable || chs != bouncing) {
+		bouncing = chs;
+		stable = 1;
+		return 0;
+	}
+
+	if (++stable < PRESENCE_STABLE_READS)
+		return 0;
+
+	stable = 0;
+	return 1;
+}
+
+/**
+ * @brief Setup the tracking, reading the initial active channels
+ *
+ * The inputs are read till settled, regardless of the INT line which could
+ * be already asserted at power-on. If they could not be read, all the
+ * channels are taken as off, till the next change is signalled.
+ */
+void presence_init(I2c *i2c, Pca9555 *pca) {
+	uint8_t reads = PRESENCE_INIT_READS;
+	uint16_t chs;
+
+	bus = i2c;
+	pe = pca;
+
+	stable = 0;
+	for ( ; reads; --reads) {
+		if (readInputs(&chs) && debounce(chs))
+			break;
+		timer_delay(PRESENCE_POLL_MS);
+	}
+	if (!reads) {
+		LOG_ERR("Presenza canali non rilevata\r\n");
+		bouncing = 0;
+	}
+	stable = 0;
+
+	activeChs.active = bouncing;
+
+	LOG_INFO("Active CHs [0x%04X]\r\n", activeChs.active);
+}
+
+/**
+ * @brief Update the active channels, to be called each PRESENCE_POLL_MS
+ *
+ * The inputs are read just once their change has been signalled, and then
+ * till they are settled. Failed reads keep the active channels and are
+ * retried at the next poll, as a new change.
+ *
+ * @param chg the changes of the active channels, if updated
+ * @return 1 if the active channels have been updated, 0 otherwise
+ */
+uint8_t presence_poll(presence_chg_t *chg) {
+	uint16_t chs;
+
+	// A change signalled by the INT line restarts the debouncing
+	if (signal_pending(SIGNAL_PLAT_I2C))
+		stable = 0;
+	else if (!stable)
+		return 0;
+
+	if (!readInputs(&chs)) {
+		// Restart the debouncing from the active channels
+		bouncing = activeChs.active;
+		stable = 1;
+		return 0;
+	}
+
+	if (!debounce(chs) || bouncing == activeChs.active)
+		return 0;
+
+	chg->on = bouncing & ~activeChs.active;
+	chg->off = activeChs.active & ~bouncing;
+	activeChs.active = bouncing;
+
+	return 1;
+}
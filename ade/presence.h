@@ -0,0 +1,62 @@
+/**
+ *       @file  presence.h
+ *      @brief  Channels presence tracking
+ *
+ * This tracks the powered-on channels, reported by the PCA9555 inputs. The
+ * expander INT line just flags an update, while the inputs are read later
+ * on by presence_poll(), out of the channels scan, till they are settled.
+ * The debounced bitmap of the active channels is published with a version,
+ * which is incremented at each update.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef ADE_PRESENCE_H_
+#define ADE_PRESENCE_H_
+
+#include <cfg/compiler.h>
+
+#include <drv/i2c.h>
+#include <drv/pca9555.h>
+
+// The time interval [ms] between inputs reads, while they are bouncing
+#define PRESENCE_POLL_MS 10
+// The number of consecutive equal reads of settled inputs
+#define PRESENCE_STABLE_READS 3
+
+/** The active channels */
+typedef struct presence {
+	/** The bitmask of the powered-on channels */
+	uint16_t active;
+} presence_t;
+
+/** The changes of the active channels */
+typedef struct presence_chg {
+	/** The channels newly powered-on */
+	uint16_t on;
+	/** The channels newly powered-off */
+	uint16_t off;
+} presence_chg_t;
+
+extern presence_t activeChs;
+
+void presence_init(I2c *i2c, Pca9555 *pca);
+uint8_t presence_poll(presence_chg_t *chg);
+
+/** @brief Get the bitmask of the (debounced) powered-on channels */
+INLINE uint16_t presence_active(void) {
+	return activeChs.active;
+}
+
+#endif /* end of include guard: ADE_PRESENCE_H_ */
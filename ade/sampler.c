@@ -0,0 +1,249 @@
+/**
+ *       @file  sampler.c
+ *      @brief  Interrupt driven ADE7753 sampling engine
+ *
+ * This provides a non-blocking sampling engine for the ADE7753 meter. The
+ * meter is configured in line cycle accumulation mode and the end of each
+ * accumulation is notified by the ADE IRQ signal. Completed samples are
+ * queued and consumed by the control loop without blocking.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "sampler.h"
+
+#include "control.h"
+#include "line.h"
+#include "perf.h"
+#include "signals.h"
+#include "timestamp.h"
+
+#include <cpu/power.h>
+#include <drv/meter_ade7753.h>
+#include <drv/timer.h>
+
+#include <avr/io.h>
+
+/* Define logging settings (for cfg/log.h module). */
+#define LOG_LEVEL   CONTROL_LOG_LEVEL
+#define LOG_FORMAT  CONTROL_LOG_FORMAT
+#include <cfg/log.h>
+
+#define DB2(x)
+//#define DB2(x) x
+
+/** @brief The sampling engine states */
+typedef enum sampler_states {
+	SMP_IDLE = 0,
+	// Waiting for the analog front-end to settle after a channel switch
+	SMP_SETTLE,
+	// Waiting for the accumulation to be returned
+	SMP_SAMPLE,
+} sampler_states_t;
+
+// The current sampling engine state
+static sampler_states_t state = SMP_IDLE;
+
+// The channel being sampled, 0xFF if none
+uint8_t sampler_ch = 0xFF;
+
+// The time by which the current accumulation should be completed
+static ticks_t deadline;
+
+// The time by which the (newly selected) channel input has settled
+static tstamp_t settleAt;
+
+// The queue of completed samples
+static sample_t queue[SAMPLER_QUEUE_SIZE];
+static uint8_t qHead = 0;
+static uint8_t qCount = 0;
+
+// An accumulation should complete within a couple of line cycles more than
+// the programmed ones, otherwise we are missing the line voltage (i.e. no
+// zero-crossings) and the sample is collected anyway.
+#define SAMPLER_TIMEOUT_CYCLES (ADE_LINE_CYCLES_SAMPLE_COUNT+2)
+
+//=====[ Channel Selection ]====================================================
+
+static const uint8_t chSelectionMap[] = {
+	0x08, 0x07, 0x06, 0x05, 0x04, 0x03, 0x02, 0x01,
+	0x00, 0x0F, 0x0E, 0x0D, 0x0C, 0x0B, 0x0A, 0x09
+};
+
+// Set an invalid channel to force actual initialization at first call
+static uint8_t amuxCh = 0xFF;
+
+/** @brief Switch the analog MUX, return 1 if the channel has changed */
+static inline uint8_t switchAnalogMux(uint8_t ch) {
+	uint8_t chSel;
+
+	// Avoid unnecessary switch if channel has not changed
+	if (ch == amuxCh)
+		return 0;
+
+	amuxCh = ch;
+	chSel  = (0xF0 & PORTA);
+	chSel |= chSelectionMap[ch];
+	PORTA  = chSel;
+
+	DB2(LOG_INFO("Switch Ch: %d => 0x%02X\r\n",
+				ch, chSelectionMap[ch]));
+
+	return 1;
+}
+
+//=====[ Samples Queue ]========================================================
+
+static void queuePush(uint8_t ch, const meter_sample_t *ms) {
+	sample_t *smp;
+
+	// On overflow, drop the oldest sample
+	if (qCount == SAMPLER_QUEUE_SIZE) {
+		LOG_WARN("Samples queue overflow\r\n");
+		qHead = (qHead + 1) % SAMPLER_QUEUE_SIZE;
+		qCount--;
+	}
+
+	smp = &queue[(qHead + qCount) % SAMPLER_QUEUE_SIZE];
+	smp->ch = ch;
+	smp->Irms = ms->irms;
+	smp->Vrms = ms->vrms;
+	smp->Lae = ms->lae;
+	qCount++;
+}
+
+/**
+ * @brief Get the oldest completed sample
+ *
+ * @return 1 if a sample has been returned, 0 otherwise
+ */
+uint8_t sampler_get(sample_t *smp) {
+	if (!qCount)
+		return 0;
+
+	(*smp) = queue[qHead];
+	qHead = (qHead + 1) % SAMPLER_QUEUE_SIZE;
+	qCount--;
+
+	return 1;
+}
+
+//=====[ Sampling Engine ]======================================================
+
+static void armAccumulation(void) {
+	uint32_t timeout = (uint32_t)line_period() * SAMPLER_TIMEOUT_CYCLES;
+
+	meter_ade7753_armLCEA(ADE_LINE_CYCLES_SAMPLE_COUNT);
+	deadline = timer_clock() + us_to_ticks(timeout);
+	signal_enable(SIGNAL_ADE_IRQ);
+}
+
+/**
+ * @brief Start the acquisition of a new sample on the specified channel
+ *
+ * If the channel has changed, the meter is reset and the accumulation is
+ * started only once the settling time of the new input has elapsed, thus
+ * the first accumulation is already a valid sample. The accumulation is
+ * armed just before a line crossing, which starts it, thus the settling
+ * time is not extended by waiting the crossing.
+ * This returns immediately, so that the settling time could overlap with the
+ * processing of the previous sample.
+ */
+void sampler_start(uint8_t ch) {
+
+	sampler_ch = ch;
+
+	if (switchAnalogMux(ch)) {
+		meter_ade7753_reset();
+		settleAt = timestamp_us() + ADE_ARM_LEAD_US +
+			(uint32_t)line_period() * ADE_AMUX_SETTLE_CYCLES;
+		settleAt = line_nextCrossing(settleAt) - ADE_ARM_LEAD_US;
+		state = SMP_SETTLE;
+		return;
+	}
+
+	state = SMP_SAMPLE;
+	armAccumulation();
+}
+
+/** @brief Abort any acquisition in progress */
+void sampler_stop(void) {
+	signal_disable(SIGNAL_ADE_IRQ);
+	state = SMP_IDLE;
+	sampler_ch = 0xFF;
+}
+
+/**
+ * @brief Update the sampling engine status
+ *
+ * This must be called periodically, it never blocks: the meter is accessed
+ * only once an accumulation has been completed, as notified by the IRQ line.
+ */
+void sampler_poll(void) {
+	meter_sample_t ms;
+
+	if (state == SMP_IDLE)
+		return;
+
+	// Start the accumulation once the input has settled
+	if (state == SMP_SETTLE) {
+		if (!timestamp_expired(settleAt))
+			return;
+		state = SMP_SAMPLE;
+		armAccumulation();
+		return;
+	}
+
+	// Check for the end of the accumulation, the IRQ line is active low
+	if (!signal_pending(SIGNAL_ADE_IRQ) ||
+			signal_status(SIGNAL_ADE_IRQ)) {
+		if ((long)(timer_clock() - deadline) < 0)
+			return;
+		DB2(LOG_WARN("CH[%02hd] accumulation timeout\r\n", sampler_ch+1));
+		PERF_COUNT(PERF_SMP_TIMEOUT);
+	}
+
+	// Read the measures, which also releases the IRQ line
+	PERF_START(readAt);
+	meter_ade7753_readSample(&ms);
+	PERF_STOP(PERF_SAMPLE, readAt);
+
+	// Track the line period, measured over the last cycle
+	line_measure(ms.period);
+
+	queuePush(sampler_ch, &ms);
+	sampler_stop();
+}
+
+/**
+ * @brief Blocking acquisition of a sample on the specified channel
+ */
+void sampler_read(uint8_t ch, sample_t *smp) {
+
+	// Drop any pending sample
+	while (sampler_get(smp))
+		;
+
+	sampler_start(ch);
+	while (!sampler_get(smp)) {
+		sampler_poll();
+		cpu_relax();
+	}
+}
+
+void sampler_init(void) {
+	qHead = 0;
+	qCount = 0;
+	sampler_stop();
+}
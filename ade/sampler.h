@@ -0,0 +1,61 @@
+/**
+ *       @file  sampler.h
+ *      @brief  Interrupt driven ADE7753 sampling engine
+ *
+ * This provides a non-blocking sampling engine for the ADE7753 meter. The
+ * meter is configured in line cycle accumulation mode and the end of each
+ * accumulation is notified by the ADE IRQ signal. Completed samples are
+ * queued and consumed by the control loop without blocking.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef ADE_SAMPLER_H_
+#define ADE_SAMPLER_H_
+
+#include <cfg/compiler.h>
+
+// The number of completed samples which could be queued
+#define SAMPLER_QUEUE_SIZE 4
+
+/** A completed channel sample */
+typedef struct sample {
+	uint8_t  ch;
+	uint32_t Irms;
+	uint32_t Vrms;
+	int32_t  Lae;
+} sample_t;
+
+void sampler_init(void);
+void sampler_start(uint8_t ch);
+void sampler_stop(void);
+void sampler_poll(void);
+uint8_t sampler_get(sample_t *smp);
+void sampler_read(uint8_t ch, sample_t *smp);
+
+extern uint8_t sampler_ch;
+
+// Get the channel currently being sampled
+inline uint8_t sampler_channel(void);
+inline uint8_t sampler_channel(void) {
+	return sampler_ch;
+}
+
+// Verify if an acquisition is in progress
+inline uint8_t sampler_busy(void);
+inline uint8_t sampler_busy(void) {
+	return (sampler_ch != 0xFF);
+}
+
+#endif /* end of include guard: ADE_SAMPLER_H_ */
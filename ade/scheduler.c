@@ -0,0 +1,324 @@
+/**
+ *       @file  scheduler.c
+ *      @brief  Channels scan scheduler
+ *
+ * This provides the policies to select the next channel to be sampled.
+ * Each channel has a weight and a maximum revisit interval; lossy,
+ * uncalibrated and critical channels get boosted without starving the
+ * others.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "scheduler.h"
+
+#include "control.h"
+#include "line.h"
+
+#include <cfg/macros.h>
+#include <drv/timer.h>
+
+// The maximum revisit interval of a not boosted channel [ticks]
+#define SCHED_MAX_REVISIT_TICKS \
+	ms_to_ticks((mtime_t)CONFIG_CONTROL_MAX_REVISIT*1000)
+
+// Boost factors (power of 2) applied to the channel weight
+#define SCHED_BOOST_CRITICAL 1
+#define SCHED_BOOST_CALIB    3
+#define SCHED_BOOST_LOSSY    4
+
+// The switching cost [ms] saved by remaining on the current channel, i.e. the
+// AMUX settling time
+#define SCHED_SWITCH_COST_MS \
+	(((uint32_t)ADE_AMUX_SETTLE_CYCLES*line_period()) / 1000)
+
+// The time [ms] to collect a sample switching from another channel
+#define SCHED_SAMPLE_COST_MS \
+	(((uint32_t)(ADE_LINE_CYCLES_SAMPLE_COUNT+ADE_AMUX_SETTLE_CYCLES) * \
+	  line_period()) / 1000)
+
+// The time of the last sample collected for each channel, or of its
+// activation if not yet sampled since then
+static ticks_t lastVisit[MAX_CHANNELS];
+
+// The weight of each channel
+static uint8_t chWeight[MAX_CHANNELS];
+
+// The maximum revisit interval observed for each channel [ms]
+static uint16_t maxRevisit[MAX_CHANNELS];
+
+// The channels active at the last selection
+static uint16_t activeChs;
+
+// The current scheduling policy
+static const sched_policy_t *policy;
+
+//=====[ Round-Robin ]==========================================================
+
+/**
+ * The original policy: round-robin, focusing just on the lossy channels, if
+ * any, otherwise just on the uncalibrated ones.
+ */
+static uint8_t rr_select(const sched_masks_t *m, uint8_t cur) {
+	uint16_t activeChs = m->active;
+
+	// If some _active_ channels are in fault mode: focus just on them only
+	// This allows to reduce FAULTS DETECTION time perhaps also avoiding channel
+	// switching
+	if (activeChs & m->lossy) {
+		activeChs &= m->lossy;
+		// Remain on current channel if it is _active_ and _faulty_
+		if (activeChs & BV16(cur))
+			return cur;
+		// Switch to the next _active_ abd _faulty_ channel
+		goto select;
+	}
+
+	// If some _active_ channels are in calibration mode: focus just on them only
+	// This allows to reduce CALIBRATION time perhaps also avoiding channel
+	// switching
+	if (activeChs & m->calib) {
+		activeChs &= m->calib;
+		// Remain on current channel if it is _active_ and _uncalibrated_
+		if (activeChs & BV16(cur))
+			return cur;
+		// Switch to the next _active_ abd _uncalibrated_ channel
+		goto select;
+	}
+
+select:
+
+	// Select next active channel (max one single scan)
+	for (uint8_t i = 0; i<MAX_CHANNELS; i++) {
+		cur++;
+		if (cur>15)
+			cur=0;
+		if (BV16(cur) & activeChs)
+			break;
+	}
+
+	return cur;
+}
+
+const sched_policy_t sched_rr = {
+	.select = rr_select,
+};
+
+//=====[ Earliest Deadline First ]==============================================
+
+/** Get the revisit period of the specified channel, before boosts [ticks] */
+static ticks_t edf_nominal(uint8_t ch) {
+	return SCHED_MAX_REVISIT_TICKS / chWeight[ch];
+}
+
+/** Get the revisit period of the specified channel [ticks] */
+static ticks_t edf_period(const sched_masks_t *m, uint8_t ch) {
+	uint16_t weight = chWeight[ch];
+
+	if (m->critical & BV16(ch))
+		weight <<= SCHED_BOOST_CRITICAL;
+	if (m->calib & BV16(ch))
+		weight <<= SCHED_BOOST_CALIB;
+	if (m->lossy & BV16(ch))
+		weight <<= SCHED_BOOST_LOSSY;
+
+	return SCHED_MAX_REVISIT_TICKS / weight;
+}
+
+/**
+ * @brief Verify if a sample of \a ch keeps all the nominal deadlines
+ *
+ * The other active channels, served after this sample in nominal deadline
+ * order, must each complete a sample within its nominal deadline.
+ */
+static uint8_t edf_slack(const sched_masks_t *m, uint8_t ch) {
+	ticks_t cost = ms_to_ticks(SCHED_SAMPLE_COST_MS);
+	ticks_t start = timer_clock() + cost;
+	ticks_t dl, end;
+
+	for (uint8_t i = 0; i < MAX_CHANNELS; ++i) {
+		if (i == ch || !(m->active & BV16(i)))
+			continue;
+
+		// The samples of the channels with an earlier deadline come first
+		dl = lastVisit[i] + edf_nominal(i);
+		end = start;
+		for (uint8_t j = 0; j < MAX_CHANNELS; ++j) {
+			if (j == ch || !(m->active & BV16(j)))
+				continue;
+			if (lastVisit[j] + edf_nominal(j) - dl <= 0)
+				end += cost;
+		}
+
+		if (end - dl > 0)
+			return 0;
+	}
+
+	return 1;
+}
+
+/**
+ * Each channel has a deadline, which is its last visit time plus its
+ * period. The active channel with the earliest deadline is selected, thus
+ * boosted channels are sampled more often. A boosted channel is served only
+ * on the slack of the nominal deadlines, i.e. the ones before the boosts,
+ * otherwise the channel with the earliest nominal deadline is served: each
+ * channel is thus revisited within its nominal period, as long as all the
+ * active channels can be sampled once in the shortest one.
+ */
+static uint8_t edf_select(const sched_masks_t *m, uint8_t cur) {
+	uint8_t best = MAX_CHANNELS;
+	uint8_t late = MAX_CHANNELS;
+	ticks_t bestDl = 0;
+	ticks_t lateDl = 0;
+	ticks_t dl;
+
+	for (uint8_t ch = 0; ch < MAX_CHANNELS; ++ch) {
+		if (!(m->active & BV16(ch)))
+			continue;
+
+		dl = lastVisit[ch] + edf_nominal(ch);
+		if (late == MAX_CHANNELS || (dl - lateDl) < 0) {
+			late = ch;
+			lateDl = dl;
+		}
+
+		dl = lastVisit[ch] + edf_period(m, ch);
+		// Remaining on the current channel saves the AMUX settling
+		if (ch == cur)
+			dl -= ms_to_ticks(SCHED_SWITCH_COST_MS);
+
+		if (best == MAX_CHANNELS || (dl - bestDl) < 0) {
+			best = ch;
+			bestDl = dl;
+		}
+	}
+
+	// A boosted deadline earlier than the nominal ones
+	if (best != late && !edf_slack(m, best))
+		return late;
+	return best;
+}
+
+const sched_policy_t sched_edf = {
+	.select = edf_select,
+};
+
+//=====[ Scheduler Interface ]==================================================
+
+void sched_setPolicy(const sched_policy_t *p) {
+	policy = p;
+}
+
+/**
+ * @brief Set the weight of the specified channel
+ *
+ * The EDF policy samples a channel \a weight times more often than the
+ * maximum revisit interval, before its boosts. This is kept till the next
+ * reboot.
+ */
+void sched_setWeight(uint8_t ch, uint8_t weight) {
+	if (ch >= MAX_CHANNELS || !weight)
+		return;
+	chWeight[ch] = weight;
+}
+
+/** @brief Get the weight of the specified channel */
+uint8_t sched_weight(uint8_t ch) {
+	return chWeight[ch];
+}
+
+/**
+ * @brief Select the next channel to sample
+ *
+ * @param masks the status of channels, at least one must be active
+ * @param cur the channel currently selected
+ */
+uint8_t sched_next(const sched_masks_t *masks, uint8_t cur) {
+	uint16_t started = masks->active & ~activeChs;
+	ticks_t now = timer_clock();
+
+	// The revisit interval of a channel starts when it becomes active
+	for (uint8_t ch = 0; started; ++ch, started >>= 1) {
+		if (started & BV16(0))
+			lastVisit[ch] = now;
+	}
+	activeChs = masks->active;
+
+	return policy->select(masks, cur);
+}
+
+/**
+ * @brief Get the interval [ms] since the last visit of the specified channel
+ *
+ * The interval saturates to SCHED_REVISIT_MAX.
+ */
+static uint16_t sched_elapsed(uint8_t ch, ticks_t now) {
+	mtime_t elapsed = ticks_to_ms(now - lastVisit[ch]);
+
+	if (elapsed > SCHED_REVISIT_MAX)
+		return SCHED_REVISIT_MAX;
+	return elapsed;
+}
+
+/** @brief Account for a new sample collected on the specified channel */
+void sched_visited(uint8_t ch) {
+	ticks_t now = timer_clock();
+	uint16_t elapsed;
+
+	// Keep track of the worst revisit latency
+	elapsed = sched_elapsed(ch, now);
+	if (elapsed > maxRevisit[ch])
+		maxRevisit[ch] = elapsed;
+
+	lastVisit[ch] = now;
+}
+
+/**
+ * @brief Get the worst revisit latency [ms] of the specified channel
+ *
+ * The interval since the last visit is accounted as well, while the channel
+ * is active, thus a channel not being revisited is reported as such. The
+ * latency saturates to SCHED_REVISIT_MAX.
+ */
+uint16_t sched_maxRevisit(uint8_t ch) {
+	uint16_t elapsed;
+
+	if (!(activeChs & BV16(ch)))
+		return maxRevisit[ch];
+
+	elapsed = sched_elapsed(ch, timer_clock());
+	return MAX(maxRevisit[ch], elapsed);
+}
+
+/** @brief Restart the tracking of the worst revisit latencies */
+void sched_resetStats(void) {
+	for (uint8_t ch = 0; ch < MAX_CHANNELS; ++ch)
+		maxRevisit[ch] = 0;
+}
+
+void sched_init(void) {
+	for (uint8_t ch = 0; ch < MAX_CHANNELS; ++ch) {
+		lastVisit[ch] = 0;
+		chWeight[ch] = SCHED_WEIGHT_DEFAULT;
+	}
+	activeChs = 0;
+	sched_resetStats();
+
+#if CONFIG_CONTROL_SCHED == SCHED_EDF
+	sched_setPolicy(&sched_edf);
+#else
+	sched_setPolicy(&sched_rr);
+#endif
+}
@@ -0,0 +1,72 @@
+/**
+ *       @file  scheduler.h
+ *      @brief  Channels scan scheduler
+ *
+ * This provides the policies to select the next channel to be sampled.
+ * Each channel has a weight and a maximum revisit interval; lossy,
+ * uncalibrated and critical channels get boosted without starving the
+ * others.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef ADE_SCHEDULER_H_
+#define ADE_SCHEDULER_H_
+
+#include <cfg/compiler.h>
+
+/**
+ * \name Scheduling policies
+ * $WIZ$ sched_policy = "SCHED_RR", "SCHED_EDF"
+ * @{
+ */
+// Round-robin, focusing just on lossy (or uncalibrated) channels if any
+#define SCHED_RR   0
+// Earliest deadline first, with per channel weights
+#define SCHED_EDF  1
+/*@}*/
+
+// The default channel weight
+#define SCHED_WEIGHT_DEFAULT 1
+
+// The worst revisit latency [ms] reported, longer ones saturate to it
+#define SCHED_REVISIT_MAX 0xFFFF
+
+/** The channels status used for scheduling decisions */
+typedef struct sched_masks {
+	uint16_t active;
+	uint16_t lossy;
+	uint16_t calib;
+	uint16_t critical;
+} sched_masks_t;
+
+/** A scheduling policy */
+typedef struct sched_policy {
+	/** Return the next channel to sample, among the active ones */
+	uint8_t (*select)(const sched_masks_t *masks, uint8_t cur);
+} sched_policy_t;
+
+extern const sched_policy_t sched_rr;
+extern const sched_policy_t sched_edf;
+
+void sched_init(void);
+void sched_setPolicy(const sched_policy_t *policy);
+void sched_setWeight(uint8_t ch, uint8_t weight);
+uint8_t sched_weight(uint8_t ch);
+uint8_t sched_next(const sched_masks_t *masks, uint8_t cur);
+void sched_visited(uint8_t ch);
+uint16_t sched_maxRevisit(uint8_t ch);
+void sched_resetStats(void);
+
+#endif /* end of include guard: ADE_SCHEDULER_H_ */
@@ -31,14 +31,6 @@
 #define LOG_FORMAT  SIG_LOG_FORMAT
 #include <cfg/log.h>
 
-// Forward declarations
-void intr_ade_zx(uint8_t level);
-void intr_ade_irq(uint8_t level);
-void intr_rtc_irq(uint8_t level);
-void intr_unit_irq(uint8_t level);
-void intr_plat_button(uint8_t level);
-void intr_plat_i2c(uint8_t level);
-
 // The mask of enabled Interrupt pins on PORTC
 static const uint8_t portc_mask = 0xFC;
 // The mask of pulled-up Interrupt pins on PORTC
@@ -46,22 +38,42 @@ static const uint8_t portc_pullups = 0x7C;
 // The mask of (default) enabled Interrupt pins on PORTC
 static const uint8_t signals_enabled = 0x3C;
 // The bit values on PORTC
-uint8_t signals_status = 0x00;
+volatile uint8_t signals_status = 0x00;
 // The mask of signals which are pedning (waiting to be processed)
-uint8_t signals_pending = 0x00;
+volatile uint8_t signals_pending = 0x00;
 
 #define PORTC_READ (portc_mask & PINC)
 
-#define SET_SIGNAL(NUM)\
-	(signals_pending |= BV8(SIGNAL_##NUM))
+// The coalescing policy of the signals on PORTC, starting from PC2
+static const uint8_t signals_policy[] = {
+	SIGNAL_COALESCE,				// PC2 - I2C Interrupt
+	SIGNAL_EDGES,					// PC3 - User Button
+	SIGNAL_RISING,					// PC4 - RCT Unit Fault
+	SIGNAL_COALESCE|SIGNAL_ONESHOT,	// PC5 - RTC Interrupt
+	SIGNAL_COALESCE|SIGNAL_ONESHOT,	// PC6 - ADE Interrupt
+	SIGNAL_RISING|SIGNAL_ONESHOT,	// PC7 - ADE Zero Crossing
+};
+
+#define SIGNALS_QUEUE_MASK (CONFIG_SIG_QUEUE_SIZE-1)
+STATIC_ASSERT(!(CONFIG_SIG_QUEUE_SIZE & SIGNALS_QUEUE_MASK));
 
-#define SET_AND_DISABLE(NUM)\
-	signals_pending |= BV8(SIGNAL_##NUM);\
-	PCMSK2 &= ~BV8(SIGNAL_##NUM)
+// The queued edges, written by the interrupt handler at the head and read
+// by the main loop at the tail: each index is written by just one of them
+static signal_evt_t queue[CONFIG_SIG_QUEUE_SIZE];
+static volatile uint8_t qHead = 0;
+static volatile uint8_t qTail = 0;
+// The edges dropped since the queue was full
+static volatile uint8_t qOverruns = 0;
 
 
 //----- Signals utility functions
 
+// The external definitions, used where the functions are not inlined
+extern inline uint8_t signal_pending(uint8_t sig);
+extern inline uint8_t signal_status(uint8_t sig);
+extern inline void signal_enable(uint8_t sig);
+extern inline void signal_disable(uint8_t sig);
+
 // Wait for the specified signal
 void signal_wait(uint8_t sig) {
 	signal_enable(sig);
@@ -75,6 +87,37 @@ void signal_wait(uint8_t sig) {
 	}
 }
 
+/**
+ * @brief Get the oldest queued edge
+ *
+ * @return 1 if \a evt has been filled, 0 if the queue is empty
+ */
+uint8_t signal_next(signal_evt_t *evt) {
+	uint8_t tail = qTail;
+
+	if (tail == qHead)
+		return 0;
+
+	*evt = queue[tail];
+	// Release the slot just once copied
+	MEMORY_BARRIER;
+	qTail = (tail + 1) & SIGNALS_QUEUE_MASK;
+
+	return 1;
+}
+
+/** @brief Get the number of edges dropped since the last call */
+uint8_t signal_overruns(void) {
+	uint8_t count;
+
+	ATOMIC(
+		count = qOverruns;
+		qOverruns = 0;
+	);
+
+	return count;
+}
+
 //----- Setup interrupt controller
 void signals_init(void) {
 
@@ -92,44 +135,33 @@ void signals_init(void) {
 }
 
 //----- Interrupt handlers
-void intr_ade_zx(uint8_t level) {
-//PINA = 0x80;
-	(void)level;
-	SET_AND_DISABLE(ADE_ZX);
-}
-
-void intr_ade_irq(uint8_t level) {
-	(void)level;
-	SET_AND_DISABLE(ADE_IRQ);
-}
-
-void intr_rtc_irq(uint8_t level) {
-	(void)level;
-	SET_AND_DISABLE(RTC_IRQ);
-}
 
-void intr_unit_irq(uint8_t level) {
-//PINA = 0x40;
-	(void)level;
-	SET_AND_DISABLE(UNIT_IRQ);
-}
+/** @brief Queue an edge of the \a sig signal */
+static inline void pushEdge(uint8_t sig, uint8_t level, tstamp_t at) {
+	uint8_t head = qHead;
+	uint8_t next = (head + 1) & SIGNALS_QUEUE_MASK;
+	signal_evt_t *evt;
 
-void intr_plat_button(uint8_t level) {
-//PINA = 0x20;
-	(void)level;
-	SET_SIGNAL(PLAT_BUTTON);
-}
+	if (next == qTail) {
+		if (qOverruns != UINT8_MAX)
+			++qOverruns;
+		return;
+	}
 
-void intr_plat_i2c(uint8_t level) {
-//PINA = 0x10;
-	(void)level;
-	SET_SIGNAL(PLAT_I2C);
+	evt = &queue[head];
+	evt->sig = sig;
+	evt->level = level;
+	evt->at = at;
+	// Publish the slot just once filled
+	MEMORY_BARRIER;
+	qHead = next;
 }
 
 
 #if CONFIG_SIG_TESTING
 # warning SIGNALS TESTING ENABLED
 void sigTesting() {
+	signal_evt_t evt;
 
 	LOG_INFO(".:: External Interrupt Testing\r\n");
 
@@ -138,45 +170,47 @@ void sigTesting() {
 		DELAY(1000);
 
 		LOG_INFO("PINC: 0x%02X\r\n", PINC);
-		if (signal_pending(SIGNAL_PLAT_BUTTON)) {
-			LOG_INFO("EVT: Button [%hd]\r\n",
-					signal_status(SIGNAL_PLAT_BUTTON));
-		}
-		if (signal_pending(SIGNAL_UNIT_IRQ)) {
-			LOG_INFO("EVT: RCT Unit Fault [%hd]\r\n",
-					signal_status(SIGNAL_UNIT_IRQ));
+		while (signal_next(&evt)) {
+			LOG_INFO("EVT: PC%hd [%hd] @%lu\r\n",
+					evt.sig, evt.level, evt.at);
 		}
+		if (signal_overruns())
+			LOG_INFO("EVT: Overruns\r\n");
 	}
 }
 #endif
 
-typedef void (*intrHandler_t)(uint8_t level);
-
-// Interrupt handlers on PORTC
-intrHandler_t intrTable[] = {
-	intr_plat_i2c, 			// PC2 - I2C Interrupt
-	intr_plat_button,		// PC3 - User Button
-	intr_unit_irq,			// PC4 - RCT Unit Fault
-	intr_rtc_irq,			// PC5 - RTC Interrupt
-	intr_ade_irq,			// PC6 - ADE Interrupt
-	intr_ade_zx				// PC7 - ADE Zero Crossing
-};
-
 //----- Low-level Interrupt handler
 DECLARE_ISR_CONTEXT_SWITCH(PCINT2_vect) {
+	tstamp_t at = timestamp_us();
 	uint8_t portc_levels = PORTC_READ;
 	uint8_t portc_changed;
-
-	// Getting changes bits
-	portc_changed = (signals_status ^ portc_levels);
-
-	// Calling handler of changed signals
-	for (uint8_t sig = 0x04, i = 0; sig; sig<<=1, i++) {
-		if (portc_changed & sig)
-			(*intrTable[i])(portc_levels);
+	uint8_t policy;
+	uint8_t level;
+
+	// Getting changes bits of enabled signals
+	portc_changed = (signals_status ^ portc_levels) & PCMSK2;
+
+	// Serving changed signals according to their policy
+	for (uint8_t sig = SIGNAL_PLAT_I2C; sig < 8; sig++) {
+		if (!(portc_changed & BV8(sig)))
+			continue;
+
+		policy = signals_policy[sig - SIGNAL_PLAT_I2C];
+		level = (portc_levels & BV8(sig)) ? 1 : 0;
+
+		if (policy & (level ? SIGNAL_RISING : SIGNAL_FALLING))
+			pushEdge(sig, level, at);
+		else if (policy & SIGNAL_EDGES)
+			// Not queued edge, not served
+			continue;
+		else
+			signals_pending |= BV8(sig);
+
+		if (policy & SIGNAL_ONESHOT)
+			PCMSK2 &= ~BV8(sig);
 	}
 
 	signals_status = portc_levels;
 
 }
-
@@ -3,6 +3,9 @@
  *      @brief  Interrupts handlers for external signal management
  *
  * This provides a set of utility function to handle external interrupts.
+ * Each signal has a coalescing policy: its edges are either queued, with
+ * their level and timestamp, into a ring filled by the interrupt handler
+ * and drained by the main loop, or just flagged as pending.
  *
  *     @author  Patrick Bellasi (derkling), derkling@google.com
  *
@@ -21,8 +24,11 @@
 #ifndef ADE_SIGNALS_H_
 #define ADE_SIGNALS_H_
 
+#include "timestamp.h"
+
 #include <cfg/macros.h>
 #include <cfg/cfg_sig.h>
+#include <cpu/irq.h>
 #include <avr/io.h>
 
 #define SIGNAL_ADE_ZX 		7
@@ -32,19 +38,47 @@
 #define SIGNAL_PLAT_BUTTON 	3
 #define SIGNAL_PLAT_I2C		2
 
+/**
+ * \name Signals coalescing policies
+ * @{
+ */
+// All the edges are coalesced into a pending flag
+#define SIGNAL_COALESCE  0x00
+// The rising edges are queued
+#define SIGNAL_RISING    0x01
+// The falling edges are queued
+#define SIGNAL_FALLING   0x02
+// All the edges are queued
+#define SIGNAL_EDGES     (SIGNAL_RISING|SIGNAL_FALLING)
+// The signal is disabled by its first served edge, till enabled again
+#define SIGNAL_ONESHOT   0x04
+/*@}*/
+
+/** A signal edge */
+typedef struct signal_evt {
+	/** The signal, i.e. the PORTC pin */
+	uint8_t sig;
+	/** The pin level after the edge */
+	uint8_t level;
+	/** The timestamp of the edge [us] */
+	tstamp_t at;
+} signal_evt_t;
+
 // The signal flag for each pin on PORTC
-extern uint8_t signals_pending;
-extern uint8_t signals_status;
+extern volatile uint8_t signals_pending;
+extern volatile uint8_t signals_status;
 
-// Verify if a signal has been set
+// Verify if a signal has been set, clearing it
 inline uint8_t signal_pending(uint8_t sig);
 inline uint8_t signal_pending(uint8_t sig) {
-	uint8_t result = (signals_pending & BV8(sig));
-	if (result) {
+	uint8_t result;
+
+	ATOMIC(
+		result = (signals_pending & BV8(sig));
 		signals_pending &= ~BV8(sig);
-		return 1;
-	}
-	return 0;
+	);
+
+	return result ? 1 : 0;
 }
 
 // Get the value of the PIN
@@ -58,16 +92,21 @@ inline uint8_t signal_status(uint8_t sig) {
 // Enable the specified signal
 inline void signal_enable(uint8_t sig);
 inline void signal_enable(uint8_t sig) {
-	// Reset signal flag
-	signals_pending &= ~BV8(sig);
-	// Enable signal interrupt
-	PCMSK2 |= BV8(sig);
+	ATOMIC(
+		// Reset signal flag
+		signals_pending &= ~BV8(sig);
+		// Edges are detected from the current level
+		signals_status &= ~BV8(sig);
+		signals_status |= (PINC & BV8(sig));
+		// Enable signal interrupt
+		PCMSK2 |= BV8(sig);
+	);
 }
 
 // Disable the specified signal
 inline void signal_disable(uint8_t sig);
 inline void signal_disable(uint8_t sig) {
-	PCMSK2 &= ~BV8(sig);
+	ATOMIC(PCMSK2 &= ~BV8(sig));
 }
 
 #if CONFIG_SIG_TESTING
@@ -78,6 +117,8 @@ void sigTesting(void);
 
 void signals_init(void);
 void signal_wait(uint8_t sig);
+uint8_t signal_next(signal_evt_t *evt);
+uint8_t signal_overruns(void);
 
 
 #endif /* end of include guard: ADE_SIGNALS_H_ */
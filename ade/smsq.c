@@ -0,0 +1,342 @@
+/**
+ *       @file  smsq.c
+ *      @brief  Outgoing SMS notification queue
+ *
+ * This provides a bounded queue of outgoing SMS which are delivered in
+ * background by a cooperative state machine. Each step of the state machine
+ * requires at most one modem command, thus the control loop is never blocked
+ * while waiting for network availability or retrying a failed delivery.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "smsq.h"
+
+#include "command.h"
+#include "eeprom.h"
+#include "gsm.h"
+#include "perf.h"
+#include "text.h"
+
+#include <cfg/macros.h>
+#include <drv/timer.h>
+
+#include <string.h> // strncpy
+
+/* Define logging settings (for cfg/log.h module). */
+#define LOG_LEVEL   GSM_LOG_LEVEL
+#define LOG_FORMAT  GSM_LOG_FORMAT
+#include <cfg/log.h>
+
+// The destination mask bit for the explicit destination number
+#define SMSQ_DEST_TO BV8(7)
+
+// The maximum delay [s] between two delivery attempts
+#define SMSQ_BACKOFF_MAX 600
+
+// The number of network failures before resetting the modem
+#define SMSQ_RESET_FAILURES 10
+
+/** @brief The delivery state machine states */
+typedef enum smsq_states {
+	SMSQ_IDLE = 0,
+	// Waiting for the retry of a failed attempt
+	SMSQ_BACKOFF,
+	// Checking for network registration
+	SMSQ_NETWORK,
+	// Checking for signal quality
+	SMSQ_SIGNAL,
+	// Sending to the next destination
+	SMSQ_SEND,
+} smsq_states_t;
+
+/** @brief A queued message */
+typedef struct smsq_msg {
+	// The destinations still to be served: a bitmask of EEPROM destinations
+	// (bit 0 for the first one) and SMSQ_DEST_TO for the explicit number
+	uint8_t pending;
+	// The failed attempts on the current destination
+	uint8_t tries;
+	// The explicit destination number
+	char to[16];
+	char text[CMD_BUFFER_SIZE];
+} smsq_msg_t;
+
+// A notification must fit the queue, since it is retried till queued
+STATIC_ASSERT(CONFIG_GSM_SMSQ_SIZE >= CONFIG_GSM_SMS_SEGMENTS);
+
+static smsq_msg_t queue[CONFIG_GSM_SMSQ_SIZE];
+static uint8_t qHead = 0;
+static uint8_t qCount = 0;
+
+// The current delivery state
+static smsq_states_t state = SMSQ_IDLE;
+
+// The time of the next delivery attempt
+static ticks_t retryAt;
+
+// The consecutive network failures
+static uint8_t netFailures = 0;
+
+//=====[ Queue Management ]=====================================================
+
+/** @brief Get the end of the segment of a long message starting at \a text */
+static const char *segmentEnd(const char *text) {
+	const char *end = text;
+	const char *line = NULL;
+
+	for ( ; *end && end - text < SMSQ_SEGMENT_TEXT; ++end) {
+		if (*end == '\n')
+			line = end + 1;
+	}
+
+	// Split on lines, unless it wastes most of the segment
+	if (*end && line && line - text > SMSQ_SEGMENT_TEXT/2)
+		return line;
+	return end;
+}
+
+/**
+ * @brief Queue a message, segmented into more SMS if it does not fit one
+ *
+ * Segments are numbered, e.g. "(1/2) ", and all of them are queued or
+ * none is.
+ *
+ * @return OK if the message has been queued, ERROR if the queue is full
+ */
+static int8_t queueText(const char *text, uint8_t pending, const char *to) {
+	const char *seg, *end;
+	uint8_t segs = 1;
+	smsq_msg_t *m;
+	text_t t;
+
+	if (strlen(text) > CMD_BUFFER_SIZE-1) {
+		segs = 0;
+		for (seg = text; *seg; seg = segmentEnd(seg))
+			++segs;
+		// Exceeding text is truncated by the last segment
+		segs = MIN(segs, (uint8_t)CONFIG_GSM_SMS_SEGMENTS);
+	}
+
+	if (qCount + segs > CONFIG_GSM_SMSQ_SIZE)
+		return ERROR;
+
+	for (uint8_t i = 1; i <= segs; ++i) {
+		m = &queue[(qHead + qCount) % CONFIG_GSM_SMSQ_SIZE];
+		m->pending = pending;
+		m->tries = 0;
+		strncpy(m->to, to, sizeof(m->to)-1);
+		m->to[sizeof(m->to)-1] = '\0';
+
+		text_init(&t, m->text, CMD_BUFFER_SIZE);
+		if (segs == 1) {
+			text_str(&t, text);
+		} else {
+			text_char(&t, '(');
+			text_uint(&t, i, 0, 0);
+			text_char(&t, '/');
+			text_uint(&t, segs, 0, 0);
+			text_lit(&t, ") ");
+			end = (i < segs) ? segmentEnd(text) : text + strlen(text);
+			while (text < end)
+				text_char(&t, *text++);
+		}
+
+		qCount++;
+	}
+
+	return OK;
+}
+
+static void queuePop(void) {
+	qHead = (qHead + 1) % CONFIG_GSM_SMSQ_SIZE;
+	qCount--;
+}
+
+/**
+ * @brief Queue a message for the specified destination number
+ *
+ * @return OK if the message has been queued, ERROR otherwise
+ */
+int8_t smsq_send(const char *to, const char *text) {
+
+	if (!to || !to[0])
+		return ERROR;
+
+	if (queueText(text, SMSQ_DEST_TO, to) != OK) {
+		LOG_ERR("SMS queue full, dropping message\r\n");
+		PERF_COUNT(PERF_SMS_DROPPED);
+		return ERROR;
+	}
+
+	LOG_INFO("SMS queued for %s [%d]\r\n", to, qCount);
+	return OK;
+}
+
+/**
+ * @brief Queue a message for all the enabled destinations
+ *
+ * The message is not dropped when the queue is full: the caller keeps it
+ * and retries, e.g. after the next smsq_poll().
+ *
+ * @return OK if the message has been queued, ERROR if the queue is full
+ */
+int8_t smsq_broadcast(const char *text) {
+	char dst[MAX_SMS_NUM];
+	uint8_t pending = 0;
+
+	for (uint8_t idx = 1; idx <= MAX_SMS_DEST; ++idx) {
+		ee_getSmsDest(idx, dst, MAX_SMS_NUM);
+		// Jump disabled destination numbers
+		if (dst[0] != '+')
+			continue;
+		pending |= BV8(idx-1);
+	}
+
+	if (!pending)
+		return OK;
+
+	if (queueText(text, pending, "") != OK)
+		return ERROR;
+
+	LOG_INFO("SMS queued for 0x%02X [%d]\r\n", pending, qCount);
+	return OK;
+}
+
+/** @brief Get the number of messages still to be delivered */
+uint8_t smsq_pending(void) {
+	return qCount;
+}
+
+//=====[ Delivery State Machine ]===============================================
+
+static void backoff(uint8_t failures) {
+	uint16_t delay = CONFIG_GSM_SMSQ_BACKOFF;
+
+	while (--failures && delay < SMSQ_BACKOFF_MAX)
+		delay <<= 1;
+	if (delay > SMSQ_BACKOFF_MAX)
+		delay = SMSQ_BACKOFF_MAX;
+
+	LOG_WARN("Retrying SMS in %us\r\n", delay);
+	retryAt = timer_clock() + ms_to_ticks((mtime_t)delay*1000);
+	state = SMSQ_BACKOFF;
+}
+
+/**
+ * Network failures do not depend on the destination, thus they do not
+ * consume the destination attempts: the delivery is retried until the
+ * network is back, resetting the modem once in a while.
+ */
+static void networkFailure(void) {
+	if (++netFailures < SMSQ_RESET_FAILURES) {
+		backoff(netFailures);
+		return;
+	}
+
+	// Reset the modem and check again the network straight away
+	gsmPowerOn();
+	netFailures = 0;
+	state = SMSQ_NETWORK;
+}
+
+static void sendNext(smsq_msg_t *m) {
+	char dst[MAX_SMS_NUM];
+	const char *to = m->to;
+	uint8_t dest = 0;
+	int8_t result;
+
+	// Get the next destination to serve
+	while (!(m->pending & BV8(dest)))
+		dest++;
+
+	if (dest < MAX_SMS_DEST) {
+		ee_getSmsDest(dest+1, dst, MAX_SMS_NUM);
+		to = dst;
+		// Jump destinations disabled in the meantime
+		if (dst[0] != '+')
+			goto done;
+	}
+
+	LOG_INFO("Sending SMS to %s (%d)\r\n", to, m->tries+1);
+	result = gsmSMSSend(to, m->text);
+	if (result == OK)
+		goto done;
+
+	LOG_WARN("SMS to %s failed (%d)\r\n", to, result);
+	if (++m->tries < CONFIG_GSM_SMSQ_RETRIES) {
+		backoff(m->tries);
+		return;
+	}
+	LOG_ERR("Dropping SMS to %s\r\n", to);
+
+done:
+	m->pending &= ~BV8(dest);
+	m->tries = 0;
+	if (!m->pending)
+		queuePop();
+	state = SMSQ_IDLE;
+}
+
+/**
+ * @brief Update the delivery of queued messages
+ *
+ * This must be called periodically, each call runs at most one modem
+ * command.
+ */
+void smsq_poll(void) {
+
+	if (!qCount) {
+		state = SMSQ_IDLE;
+		return;
+	}
+
+	switch (state) {
+	case SMSQ_BACKOFF:
+		if ((long)(timer_clock() - retryAt) < 0)
+			return;
+		/* Fall through */
+	case SMSQ_IDLE:
+		state = SMSQ_NETWORK;
+		/* Fall through */
+	case SMSQ_NETWORK:
+		if (gsmRegisterNetwork() != OK) {
+			LOG_WARN("Network not available\r\n");
+			networkFailure();
+			return;
+		}
+		state = SMSQ_SIGNAL;
+		return;
+	case SMSQ_SIGNAL:
+		if (gsmUpdateCSQ() != OK ||
+				gsmCSQ() == 99 || gsmCSQ() == 0) {
+			LOG_WARN("Low network signal [%d]\r\n", gsmCSQ());
+			networkFailure();
+			return;
+		}
+		netFailures = 0;
+		state = SMSQ_SEND;
+		return;
+	case SMSQ_SEND:
+		sendNext(&queue[qHead]);
+		return;
+	}
+}
+
+void smsq_init(void) {
+	qHead = 0;
+	qCount = 0;
+	netFailures = 0;
+	state = SMSQ_IDLE;
+}
@@ -0,0 +1,50 @@
+/**
+ *       @file  smsq.h
+ *      @brief  Outgoing SMS notification queue
+ *
+ * This provides a bounded queue of outgoing SMS which are delivered in
+ * background by a cooperative state machine. Each step of the state machine
+ * requires at most one modem command, thus the control loop is never blocked
+ * while waiting for network availability or retrying a failed delivery.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef ADE_SMSQ_H_
+#define ADE_SMSQ_H_
+
+#include "command.h"
+
+#include "cfg/cfg_gsm.h"
+
+#include <cfg/compiler.h>
+
+// The time interval [ms] for the outgoing SMS queue handling
+#define SMSQ_POLL_MS 1000
+
+// The segments of a message longer than an SMS are prefixed by "(N/M) "
+#define SMSQ_SEGMENT_PREFIX 6
+#define SMSQ_SEGMENT_TEXT (CMD_BUFFER_SIZE-1-SMSQ_SEGMENT_PREFIX)
+
+// The longest message which could be queued
+#define SMSQ_TEXT_MAX ((CONFIG_GSM_SMS_SEGMENTS > 1) ? \
+		CONFIG_GSM_SMS_SEGMENTS*SMSQ_SEGMENT_TEXT : CMD_BUFFER_SIZE-1)
+
+void smsq_init(void);
+int8_t smsq_send(const char *to, const char *text);
+int8_t smsq_broadcast(const char *text);
+void smsq_poll(void);
+uint8_t smsq_pending(void);
+
+#endif /* end of include guard: ADE_SMSQ_H_ */
@@ -0,0 +1,173 @@
+/**
+ *       @file  smstok.c
+ *      @brief  SMS commands tokenizer
+ *
+ * The SMS text is tokenized as it is received: commands are split on ';'
+ * and on line breaks, leading spaces are dropped and the command name is
+ * lowercased. The resulting commands are stored '\0' separated, ready to be
+ * parsed. Commands not fitting the buffer are dropped, rather than being
+ * truncated.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "gsm.h"
+
+#include <cfg/compiler.h>
+
+#include <avr/pgmspace.h>
+
+/* Define logging settings (for cfg/log.h module). */
+#define LOG_LEVEL   GSM_LOG_LEVEL
+#define LOG_FORMAT  GSM_LOG_FORMAT
+#include <cfg/log.h>
+
+// Tokenizer character classes
+enum {
+	TC_SEP = 0,	// ';', '\r', '\n'
+	TC_SPACE,	// ' ', '\t'
+	TC_DOLLAR,	// '$'
+	TC_COLON,	// ':'
+	TC_UPPER,	// 'A'..'Z'
+	TC_OTHER,
+	TC_COUNT,
+};
+
+// Tokenizer states
+enum {
+	// Beginning of the text
+	TS_START = 0,
+	// Skipping a "$...:" text prefix
+	TS_PREFIX,
+	// Skipping separators before a command
+	TS_SKIP,
+	// Command name
+	TS_NAME,
+	// Command arguments
+	TS_ARGS,
+	TS_COUNT,
+};
+
+// Tokenizer actions
+#define TA_DROP  0
+#define TA_STORE 1
+#define TA_LOWER 2
+#define TA_END   3
+
+#define TOK(STATE, ACTION) (((STATE) << 2) | (ACTION))
+
+static const uint8_t PROGMEM smsTokTable[TS_COUNT][TC_COUNT] = {
+	[TS_START] = {
+		TOK(TS_SKIP,   TA_DROP),  TOK(TS_SKIP,   TA_DROP),
+		TOK(TS_PREFIX, TA_DROP),  TOK(TS_NAME,   TA_STORE),
+		TOK(TS_NAME,   TA_LOWER), TOK(TS_NAME,   TA_STORE),
+	},
+	[TS_PREFIX] = {
+		TOK(TS_PREFIX, TA_DROP),  TOK(TS_PREFIX, TA_DROP),
+		TOK(TS_PREFIX, TA_DROP),  TOK(TS_SKIP,   TA_DROP),
+		TOK(TS_PREFIX, TA_DROP),  TOK(TS_PREFIX, TA_DROP),
+	},
+	[TS_SKIP] = {
+		TOK(TS_SKIP,   TA_DROP),  TOK(TS_SKIP,   TA_DROP),
+		TOK(TS_NAME,   TA_STORE), TOK(TS_NAME,   TA_STORE),
+		TOK(TS_NAME,   TA_LOWER), TOK(TS_NAME,   TA_STORE),
+	},
+	[TS_NAME] = {
+		TOK(TS_SKIP,   TA_END),   TOK(TS_ARGS,   TA_STORE),
+		TOK(TS_NAME,   TA_STORE), TOK(TS_NAME,   TA_STORE),
+		TOK(TS_NAME,   TA_LOWER), TOK(TS_NAME,   TA_STORE),
+	},
+	[TS_ARGS] = {
+		TOK(TS_SKIP,   TA_END),   TOK(TS_ARGS,   TA_STORE),
+		TOK(TS_ARGS,   TA_STORE), TOK(TS_ARGS,   TA_STORE),
+		TOK(TS_ARGS,   TA_STORE), TOK(TS_ARGS,   TA_STORE),
+	},
+};
+
+static inline uint8_t _gsmSMSTokClass(char c) {
+	switch (c) {
+	case ';':
+	case '\r':
+	case '\n':
+		return TC_SEP;
+	case ' ':
+	case '\t':
+		return TC_SPACE;
+	case '$':
+		return TC_DOLLAR;
+	case ':':
+		return TC_COLON;
+	}
+	if (c >= 'A' && c <= 'Z')
+		return TC_UPPER;
+	return TC_OTHER;
+}
+
+void gsmSMSTokInit(gsmSMSTok_t *tok, char *buf, uint8_t size) {
+	ASSERT(size);
+	tok->buf = buf;
+	tok->size = size;
+	tok->len = 0;
+	tok->mark = 0;
+	tok->count = 0;
+	tok->state = TS_START;
+	tok->overflow = 0;
+}
+
+static void _gsmSMSTokCommand(gsmSMSTok_t *tok) {
+
+	// Drop commands not fitting the buffer
+	if (tok->overflow || tok->len == tok->size) {
+		LOG_WARN("SMS command too long\n");
+		tok->len = tok->mark;
+		tok->overflow = 0;
+		return;
+	}
+
+	tok->buf[tok->len++] = '\0';
+	tok->mark = tok->len;
+	tok->count++;
+}
+
+/** @brief Process the next character of an SMS text */
+void gsmSMSTokPut(gsmSMSTok_t *tok, char c) {
+	uint8_t next;
+
+	next = pgm_read_byte(&smsTokTable[tok->state][_gsmSMSTokClass(c)]);
+	tok->state = next >> 2;
+
+	switch (next & 0x3) {
+	case TA_LOWER:
+		c += 'a'-'A';
+		/* Fall through */
+	case TA_STORE:
+		// Keep room for the command terminator
+		if (tok->len >= tok->size-1) {
+			tok->overflow = 1;
+			return;
+		}
+		tok->buf[tok->len++] = c;
+		return;
+	case TA_END:
+		_gsmSMSTokCommand(tok);
+		return;
+	}
+}
+
+/** @brief Complete the tokenization of an SMS text */
+void gsmSMSTokEnd(gsmSMSTok_t *tok) {
+	if (tok->state == TS_NAME || tok->state == TS_ARGS)
+		_gsmSMSTokCommand(tok);
+	tok->state = TS_START;
+}
@@ -0,0 +1,105 @@
+/**
+ *       @file  stack.c
+ *      @brief  Stacks low-water marks
+ *
+ * The stacks are assumed to grow downward, i.e. the deepest bytes are the
+ * ones closest to the stack limit.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "stack.h"
+
+/** The low-water mark of a stack */
+typedef struct stack_mark {
+	/** The stack limit, i.e. its lowest address, NULL if not tracked */
+	const uint8_t *base;
+	/** The deepest byte used so far */
+	const uint8_t *low;
+	/** The next byte to check */
+	const uint8_t *next;
+	/** The pattern of the bytes never used */
+	uint8_t fill;
+} stack_mark_t;
+
+static stack_mark_t marks[STACKS];
+
+// The names of the stacks, in stack_ids_t order
+static const char *stackNames[STACKS] = {
+	"Main", "GSM", "CMD",
+};
+
+/**
+ * @brief Track the stack of \a size bytes from the \a base limit
+ *
+ * The unused bytes of the stack must be already filled by \a fill.
+ */
+void stack_add(uint8_t id, const void *base, size_t size, uint8_t fill) {
+	stack_mark_t *m = &marks[id];
+
+	m->base = (const uint8_t *)base;
+	m->low = m->base + size;
+	m->next = m->base;
+	m->fill = fill;
+}
+
+/**
+ * @brief Go on scanning a stack for its low-water mark
+ *
+ * @return 1 if a new low-water mark has been found, 0 otherwise
+ */
+uint8_t stack_scan(uint8_t id) {
+	stack_mark_t *m = &marks[id];
+	const uint8_t *end = m->next + STACK_SCAN_BYTES;
+
+	if (!m->base)
+		return 0;
+
+	if (end > m->low)
+		end = m->low;
+
+	for ( ; m->next < end; ++m->next) {
+		if (*m->next == m->fill)
+			continue;
+
+		// The bytes below have been checked by this scan
+		m->low = m->next;
+		m->next = m->base;
+		return 1;
+	}
+
+	// The low-water mark reached, restart from the limit
+	if (m->next == m->low)
+		m->next = m->base;
+
+	return 0;
+}
+
+/** @brief Get the minimum free bytes of a stack, so far */
+size_t stack_minFree(uint8_t id) {
+	return marks[id].low - marks[id].base;
+}
+
+/** @brief Append the minimum free bytes of the tracked stacks */
+void stack_format(text_t *t) {
+	text_lit(t, "Stack liberi:");
+	for (uint8_t i = 0; i < STACKS; ++i) {
+		if (!marks[i].base)
+			continue;
+		text_char(t, ' ');
+		text_str(t, stackNames[i]);
+		text_char(t, ' ');
+		text_uint(t, stack_minFree(i), 0, 0);
+	}
+}
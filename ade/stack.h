@@ -0,0 +1,60 @@
+/**
+ *       @file  stack.h
+ *      @brief  Stacks low-water marks
+ *
+ * This tracks the deepest byte ever used of the firmware stacks, which are
+ * filled by a known pattern before being used. Each scan checks a bounded
+ * number of bytes, starting from the stack limit up to the current low-water
+ * mark: once a used byte is found that is the new mark, otherwise the scan
+ * restarts from the limit. Thus the main loop could keep the marks updated
+ * at a fixed cost, while the worst-case free stack could be reported anytime.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef ADE_STACK_H_
+#define ADE_STACK_H_
+
+#include "text.h"
+
+#include <cfg/cfg_arch.h>
+
+#include <cfg/compiler.h>
+
+/** @brief The tracked stacks */
+typedef enum stack_ids {
+	// The main stack, i.e. the sampling process and the interrupts
+	STACK_MAIN = 0,
+	// The GSM process
+	STACK_GSM,
+	// The console process
+	STACK_CMD,
+
+	STACKS,
+} stack_ids_t;
+
+// The bytes checked by each scan
+#if (ARCH & ARCH_EMUL)
+// The host stacks of the processes are KERN_MINSTACKSIZE large
+# define STACK_SCAN_BYTES 2048
+#else
+# define STACK_SCAN_BYTES 32
+#endif
+
+void stack_add(uint8_t id, const void *base, size_t size, uint8_t fill);
+uint8_t stack_scan(uint8_t id);
+size_t stack_minFree(uint8_t id);
+void stack_format(text_t *t);
+
+#endif /* end of include guard: ADE_STACK_H_ */
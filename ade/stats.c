@@ -0,0 +1,106 @@
+/**
+ *       @file  stats.c
+ *      @brief  Streaming load statistics
+ *
+ * This provides a compact online estimator of the mean, the noise and the
+ * peaks of a load signal. The mean and the noise, i.e. the mean absolute
+ * deviation from the mean, are exponentially weighted moving averages
+ * computed by integer arithmetic only. The first samples are averaged
+ * uniformly, thus the estimates are meaningful as soon as the window is
+ * filled.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "stats.h"
+
+/**
+ * @brief Move \a avg toward \a x by 1/count of the difference
+ *
+ * Once the window has been filled this is a shift, before it is the
+ * cumulative average of the samples seen so far.
+ */
+static inline uint32_t average(uint32_t avg, uint32_t x, uint8_t count) {
+	uint32_t delta;
+
+	if (x >= avg) {
+		delta = x - avg;
+		if (count >= STATS_WINDOW)
+			return avg + (delta >> CONFIG_CONTROL_STATS_SHIFT);
+		return avg + (delta / count);
+	}
+
+	delta = avg - x;
+	if (count >= STATS_WINDOW)
+		return avg - (delta >> CONFIG_CONTROL_STATS_SHIFT);
+	return avg - (delta / count);
+}
+
+/** @brief Restart the statistics from scratch */
+void stats_reset(stats_t *s) {
+	s->mean = 0;
+	s->dev = 0;
+#if CONFIG_CONTROL_STATS_PEAKS
+	s->min = 0xFFFFFFFF;
+	s->max = 0;
+#endif
+	s->count = 0;
+}
+
+/**
+ * @brief Restart the averages from the sample \a x, e.g. on a signal step
+ *
+ * The noise is kept, but it is averaged again over the next window.
+ */
+void stats_restart(stats_t *s, uint32_t x) {
+	s->mean = x;
+	s->count = 1;
+}
+
+/** @brief Account a new sample */
+void stats_update(stats_t *s, uint32_t x) {
+	uint32_t dev;
+
+#if CONFIG_CONTROL_STATS_PEAKS
+	if (x < s->min)
+		s->min = x;
+	if (x > s->max)
+		s->max = x;
+#endif
+
+	if (s->count < STATS_WINDOW)
+		s->count++;
+
+	// The deviation is measured against the mean before this sample
+	dev = (x >= s->mean) ? (x - s->mean) : (s->mean - x);
+	if (s->count == 1)
+		dev = 0;
+
+	s->mean = average(s->mean, x, s->count);
+	s->dev = average(s->dev, dev, s->count);
+}
+
+/**
+ * @brief Get the noise band of a signal with the specified \a noise
+ *
+ * Variations within this band are considered noise: it is a multiple of the
+ * measured noise, but not lower than \a floor.
+ */
+uint32_t stats_band(uint32_t noise, uint32_t floor) {
+	if (noise > (0xFFFFFFFF / CONFIG_CONTROL_NOISE_FACTOR))
+		return 0xFFFFFFFF;
+	if (noise > (floor / CONFIG_CONTROL_NOISE_FACTOR))
+		return noise * CONFIG_CONTROL_NOISE_FACTOR;
+	return floor;
+}
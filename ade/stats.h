@@ -0,0 +1,62 @@
+/**
+ *       @file  stats.h
+ *      @brief  Streaming load statistics
+ *
+ * This provides a compact online estimator of the mean, the noise and the
+ * peaks of a load signal. The mean and the noise, i.e. the mean absolute
+ * deviation from the mean, are exponentially weighted moving averages
+ * computed by integer arithmetic only. The first samples are averaged
+ * uniformly, thus the estimates are meaningful as soon as the window is
+ * filled.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef ADE_STATS_H_
+#define ADE_STATS_H_
+
+#include "cfg/cfg_control.h"
+
+#include <cfg/compiler.h>
+
+// The number of samples of the moving average window
+#define STATS_WINDOW (1 << CONFIG_CONTROL_STATS_SHIFT)
+
+/** The statistics of a load signal */
+typedef struct stats {
+	/** The (moving) mean */
+	uint32_t mean;
+	/** The (moving) mean absolute deviation */
+	uint32_t dev;
+#if CONFIG_CONTROL_STATS_PEAKS
+	/** The minimum and maximum values */
+	uint32_t min;
+	uint32_t max;
+#endif
+	/** The number of samples, saturated to STATS_WINDOW */
+	uint8_t count;
+} stats_t;
+
+void stats_reset(stats_t *s);
+void stats_restart(stats_t *s, uint32_t x);
+void stats_update(stats_t *s, uint32_t x);
+uint32_t stats_band(uint32_t noise, uint32_t floor);
+
+// Verify if the moving average window has been filled
+inline uint8_t stats_ready(const stats_t *s);
+inline uint8_t stats_ready(const stats_t *s) {
+	return (s->count >= STATS_WINDOW);
+}
+
+#endif /* end of include guard: ADE_STATS_H_ */
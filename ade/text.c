@@ -0,0 +1,116 @@
+/**
+ *       @file  text.c
+ *      @brief  Bounded text builder
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#include "text.h"
+
+// The digits of an uint32_t
+#define TEXT_DIGITS 10
+
+/** @brief Setup a builder of an empty text into \a buf */
+void text_init(text_t *t, char *buf, uint16_t size) {
+	t->buf = buf;
+	t->size = size;
+	text_reset(t);
+}
+
+/** @brief Empty the text */
+void text_reset(text_t *t) {
+	t->len = 0;
+	t->truncated = 0;
+	t->buf[0] = '\0';
+}
+
+/**
+ * @brief Account the \a len chars written at text_end()
+ *
+ * This allows other modules to format directly into the buffer, up to
+ * text_room() chars.
+ */
+void text_commit(text_t *t, uint16_t len) {
+	if (len > text_room(t)) {
+		len = text_room(t);
+		t->truncated = 1;
+	}
+	t->len += len;
+	t->buf[t->len] = '\0';
+}
+
+/** @brief Append a char */
+void text_char(text_t *t, char c) {
+	if (!text_room(t)) {
+		t->truncated = 1;
+		return;
+	}
+	t->buf[t->len++] = c;
+	t->buf[t->len] = '\0';
+}
+
+/** @brief Append a string */
+void text_str(text_t *t, const char *str) {
+	while (*str)
+		text_char(t, *str++);
+}
+
+/** @brief Append a string kept in program memory */
+void text_str_P(text_t *t, const char *str) {
+	char c;
+
+	while ((c = pgm_read8(str++)))
+		text_char(t, c);
+}
+
+/**
+ * @brief Append an unsigned decimal
+ *
+ * @param width the minimum number of chars, padded on the left by \a pad
+ * chars, e.g. '0' or ' '
+ */
+void text_uint(text_t *t, uint32_t val, uint8_t width, char pad) {
+	char digits[TEXT_DIGITS];
+	uint8_t count = 0;
+
+	do {
+		digits[count++] = '0' + (val % 10);
+		val /= 10;
+	} while (val);
+
+	for ( ; width > count; --width)
+		text_char(t, pad);
+	while (count)
+		text_char(t, digits[--count]);
+}
+
+/** @brief Append an hexadecimal of \a digits (uppercase) digits */
+void text_hex(text_t *t, uint32_t val, uint8_t digits) {
+	uint8_t nibble;
+
+	while (digits--) {
+		nibble = (val >> (4 * digits)) & 0xF;
+		text_char(t, (nibble < 10) ? '0' + nibble : 'A' + nibble - 10);
+	}
+}
+
+/** @brief Append the 1-based positions of the bits set, e.g. " 1 3" */
+void text_bits(text_t *t, uint16_t mask) {
+	for (uint8_t pos = 1; mask; ++pos, mask >>= 1) {
+		if (!(mask & 0x1))
+			continue;
+		text_char(t, ' ');
+		text_uint(t, pos, 0, 0);
+	}
+}
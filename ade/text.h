@@ -0,0 +1,79 @@
+/**
+ *       @file  text.h
+ *      @brief  Bounded text builder
+ *
+ * This provides an append-only builder of the texts of command replies and
+ * notifications, into a buffer owned by the caller. The integers emitters
+ * do not use the printf formatter, which is both slow and stack hungry,
+ * while constant strings could be kept in program memory. Text exceeding
+ * the buffer is truncated, and the builder marked as such.
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef ADE_TEXT_H_
+#define ADE_TEXT_H_
+
+#include <cfg/compiler.h>
+#include <cpu/pgm.h> // PSTR
+
+/** A text builder */
+typedef struct text {
+	/** The text buffer, always zero terminated */
+	char *buf;
+	/** The buffer size, including the terminator */
+	uint16_t size;
+	/** The text length */
+	uint16_t len;
+	/** Set once some text has been truncated */
+	uint8_t truncated;
+} text_t;
+
+/** @brief Static initializer of a builder on the \a BUF array */
+#define TEXT_INIT(BUF) { (BUF), sizeof(BUF), 0, 0 }
+
+/** @brief Append a string literal, kept in program memory */
+#define text_lit(T, S) text_str_P((T), PSTR(S))
+
+void text_init(text_t *t, char *buf, uint16_t size);
+void text_reset(text_t *t);
+void text_commit(text_t *t, uint16_t len);
+void text_char(text_t *t, char c);
+void text_str(text_t *t, const char *str);
+void text_str_P(text_t *t, const char *str);
+void text_uint(text_t *t, uint32_t val, uint8_t width, char pad);
+void text_hex(text_t *t, uint32_t val, uint8_t digits);
+void text_bits(text_t *t, uint16_t mask);
+
+/** @brief Get the text length */
+INLINE uint16_t text_len(const text_t *t) {
+	return t->len;
+}
+
+/** @brief Get the text appended since the \a mark length */
+INLINE const char *text_from(const text_t *t, uint16_t mark) {
+	return t->buf + mark;
+}
+
+/** @brief Get the end of the text, to be filled and then committed */
+INLINE char *text_end(const text_t *t) {
+	return t->buf + t->len;
+}
+
+/** @brief Get the number of chars which could still be appended */
+INLINE uint16_t text_room(const text_t *t) {
+	return t->size - 1 - t->len;
+}
+
+#endif /* end of include guard: ADE_TEXT_H_ */
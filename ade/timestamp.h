@@ -0,0 +1,66 @@
+/**
+ *       @file  timestamp.h
+ *      @brief  High resolution timestamps
+ *
+ * This provides microsecond timestamps by combining the system clock ticks
+ * with the hardware high precision timer counter (hptime).
+ *
+ *     @author  Patrick Bellasi (derkling), derkling@google.com
+ *
+ *   @internal
+ *     Created  10/16/2026
+ *    Revision  $Id: doxygen.templates,v 1.3 2010/07/06 09:20:12 mehner Exp $
+ *    Compiler  gcc/g++
+ *     Company  Politecnico di Milano
+ *   Copyright  Copyright (c) 2011, Patrick Bellasi
+ *
+ * This source code is released for free distribution under the terms of the
+ * GNU General Public License as published by the Free Software Foundation.
+ * ============================================================================
+ */
+
+#ifndef ADE_TIMESTAMP_H_
+#define ADE_TIMESTAMP_H_
+
+#include <cfg/cfg_arch.h>
+#include <drv/timer.h>
+#include <cpu/irq.h>
+
+#if (ARCH & ARCH_EMUL)
+// The hosted timer counter is not relative to the last tick
+# include "emul/sim.h"
+# define timer_hw_hpread() sim_hpread()
+#endif
+
+/** A timestamp [us], wrapping every ~71 minutes */
+typedef uint32_t tstamp_t;
+
+/**
+ * Get the current timestamp [us]
+ *
+ * NOTE: if the hptime counter wraps while the timer interrupt is still
+ * pending, the returned value could be up to one tick in the past.
+ */
+INLINE tstamp_t timestamp_us(void) {
+	ticks_t clk;
+	hptime_t hp;
+
+	ATOMIC(
+		clk = timer_clock_unlocked();
+		hp = timer_hw_hpread();
+	);
+
+	return (tstamp_t)ticks_to_us(clk) + hptime_to_us(hp);
+}
+
+/** Get the time elapsed [us] since the \a start timestamp */
+INLINE tstamp_t timestamp_elapsed(tstamp_t start) {
+	return timestamp_us() - start;
+}
+
+/** Verify if the \a deadline timestamp has been reached */
+INLINE uint8_t timestamp_expired(tstamp_t deadline) {
+	return ((int32_t)(timestamp_us() - deadline) >= 0);
+}
+
+#endif /* end of include guard: ADE_TIMESTAMP_H_ */
@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+#
+# Generate the perfect hash table of the console/SMS commands.
+#
+# The commands are the MAKE_CMD() of the specified source, which are hashed
+# by the same function of parser_hash() (bertos/mware/parser.h): a seed is
+# searched for which each command lands in its own slot, thus the parser
+# finds a command with a single hash and name comparison.
+#
+# Usage: cmdhash.py ade/command.c > ade/cmd_hash.h
+#
+# Author: Patrick Bellasi (derkling), derkling@google.com
+#
+
+import re
+import sys
+
+# The MAKE_CMD() of a command source
+CMD_RE = re.compile(r'^MAKE_CMD\(\s*(\w+)\s*,', re.MULTILINE)
+
+# The smallest table, and the biggest one, tried
+MIN_BITS = 5
+MAX_BITS = 8
+
+
+def parser_hash(seed, name):
+	h = 0
+	for c in name.encode('ascii'):
+		h = (h * seed + c) & 0xFFFF
+	return h ^ (h >> 8)
+
+
+def search(names):
+	bits = MIN_BITS
+	while (1 << bits) < len(names):
+		bits += 1
+
+	for bits in range(bits, MAX_BITS + 1):
+		mask = (1 << bits) - 1
+		for seed in range(1, 1 << 16, 2):
+			slots = {}
+			for name in names:
+				slot = parser_hash(seed, name) & mask
+				if slot in slots:
+					break
+				slots[slot] = name
+			else:
+				return seed, mask, slots
+
+	return None
+
+
+def main(argv):
+	if len(argv) != 2:
+		sys.stderr.write('Usage: %s <commands source>\n' % argv[0])
+		return 1
+
+	with open(argv[1]) as src:
+		names = CMD_RE.findall(src.read())
+	if len(names) != len(set(names)):
+		sys.stderr.write('%s: duplicated commands\n' % argv[1])
+		return 1
+
+	found = search(names)
+	if not found:
+		sys.stderr.write('%s: no perfect hash found\n' % argv[1])
+		return 1
+	seed, mask, slots = found
+
+	print('/*')
+	print(' * The perfect hash table of the commands of %s' % argv[1])
+	print(' *')
+	print(' * Generated by ade/tools/cmdhash.py, DO NOT EDIT.')
+	print(' */')
+	print()
+	print('#ifndef CMD_HASH_H')
+	print('#define CMD_HASH_H')
+	print()
+	print('#define CMD_HASH_SEED 0x%04X' % seed)
+	print('#define CMD_HASH_MASK 0x%02X' % mask)
+	print()
+	print('#define CMD_HASH_SLOTS \\')
+	for slot in sorted(slots):
+		print('\tCMD_SLOT(%3d, %s) \\' % (slot, slots[slot]))
+	print('\t/* end of slots */')
+	print()
+	print('#endif /* CMD_HASH_H */')
+
+	return 0
+
+
+if __name__ == '__main__':
+	sys.exit(main(sys.argv))
@@ -0,0 +1,246 @@
+#!/usr/bin/env python3
+#
+# Compute the worst-case stack depth of the firmware entry points.
+#
+# The frame of each function is the one reported by the -fstack-usage option
+# of gcc (the .su files next to the objects), while the call graph is the one
+# of the disassembled firmware image. The depth of a function is its frame,
+# plus the return address, plus the depth of its deepest callee. Tail calls
+# are accounted as calls, i.e. conservatively.
+#
+# The entry points are main(), the processes (the *_proc functions, see
+# proc_new()) and the interrupt handlers, which run on top of any stack.
+# Thus the budget of a stack must cover its entry point plus the deepest
+# interrupt handler, while the stacks of the processes must fit also the
+# context saved by the switch, which is not accounted here.
+#
+# Functions without a frame (e.g. assembly or library ones), dynamic frames,
+# indirect calls and recursions are reported, since their depth is unknown.
+#
+# The callees of the indirect calls of the functions matching a regexp could
+# be specified, either as a list of functions or as a commands table generated
+# by cmdhash.py, whose handlers are called by the command parser. Besides,
+# all the indirect calls could be taken as calling any of the functions
+# matching a regexp, e.g. the methods of the drivers, which are called by
+# inline helpers from everywhere. A budget check fails if indirect calls are
+# still unresolved on the paths of its entry point.
+#
+# Usage: stackusage.py [-d objdump] [-r root]... [-b root=bytes]...
+#                      [-i caller=callee,...|caller=@cmd_hash.h]...
+#                      [-I regexp] <elf> <su files>...
+#
+# Author: Patrick Bellasi (derkling), derkling@google.com
+#
+
+import argparse
+import re
+import subprocess
+import sys
+
+# The return address pushed by a call, 2 bytes on AVRs up to 128KB of flash
+CALL_SIZE = 2
+
+# The entry points, if not specified
+ROOTS_RE = re.compile(r'^(main|\w+_proc|__vector_\d+)$')
+# The interrupt handlers
+ISR_RE = re.compile(r'^__vector_\d+$')
+
+# A function of the disassembly, e.g. "00000ab4 <controlLoop>:"
+FUNC_RE = re.compile(r'^[0-9a-f]+ <([^>]+)>:$')
+# A direct call or jump, e.g. "call 0x1234 ; 0x1234 <foo>" (AVR) or
+# "call 401234 <foo>" (host)
+CALL_RE = re.compile(r'\t(r?call|r?jmp)\s.*<([^>+]+)>\s*$')
+# An indirect call
+ICALL_RE = re.compile(r'\t(e?icall|call\s+\*)')
+# A slot of a commands table, e.g. "CMD_SLOT(  2, vc)" for the cmd_vc()
+# handler
+SLOT_RE = re.compile(r'CMD_SLOT\(\s*\d+,\s*(\w+)\)')
+
+
+def parse_su(paths):
+	frames = {}
+	dynamic = set()
+
+	for path in paths:
+		with open(path) as su:
+			for line in su:
+				# "file.c:line[:col]:function<TAB>size<TAB>qualifiers"
+				where, size, quals = line.rstrip('\n').split('\t')
+				name = where.rsplit(':', 1)[1]
+				# Static functions of different units could share the name
+				frames[name] = max(frames.get(name, 0), int(size))
+				if 'dynamic' in quals and 'bounded' not in quals:
+					dynamic.add(name)
+
+	return frames, dynamic
+
+
+def parse_calls(objdump, elf):
+	calls = {}
+	indirect = set()
+	func = None
+
+	dis = subprocess.run([objdump, '-d', elf], check=True,
+			stdout=subprocess.PIPE, universal_newlines=True).stdout
+	for line in dis.splitlines():
+		m = FUNC_RE.match(line)
+		if m:
+			func = m.group(1)
+			calls.setdefault(func, set())
+			continue
+		if not func:
+			continue
+		if ICALL_RE.search(line):
+			indirect.add(func)
+			continue
+		m = CALL_RE.search(line)
+		if m:
+			callee = m.group(2).split('@')[0]
+			# Skip the branches within the function
+			if callee != func:
+				calls[func].add(callee)
+
+	return calls, indirect
+
+
+def parse_callees(spec):
+	"""Get the callees "f1,f2,...", or the handlers of "@cmd_hash.h"."""
+	if not spec.startswith('@'):
+		return set(spec.split(','))
+	with open(spec[1:]) as table:
+		return set('cmd_' + name for name in SLOT_RE.findall(table.read()))
+
+
+def resolve(calls, indirect, specs, targets):
+	"""Add the callees of the indirect calls, get the unresolved ones."""
+	unresolved = set(indirect)
+
+	for spec in specs:
+		caller, callees = spec.split('=', 1)
+		callees = parse_callees(callees)
+		for f in indirect:
+			if re.fullmatch(caller, f):
+				calls[f].update(callees)
+				unresolved.discard(f)
+
+	if not targets:
+		return unresolved
+
+	targets = re.compile(targets)
+	callees = set(f for f in calls if targets.fullmatch(f))
+	for f in indirect:
+		calls[f].update(callees - {f})
+	return set()
+
+
+class Graph:
+
+	def __init__(self, frames, calls):
+		self.frames = frames
+		self.calls = calls
+		self.depths = {}
+		self.unknown = set()
+		self.recursive = set()
+
+	def depth(self, func, path=()):
+		"""Get the depth, and the deepest call path, of a function."""
+		if func in self.depths:
+			return self.depths[func]
+		if func in path:
+			self.recursive.add(func)
+			return 0, [func]
+		if func not in self.frames:
+			self.unknown.add(func)
+
+		deepest, chain = 0, []
+		for callee in sorted(self.calls.get(func, ())):
+			d, c = self.depth(callee, path + (func,))
+			if d + CALL_SIZE > deepest:
+				deepest, chain = d + CALL_SIZE, c
+
+		self.depths[func] = (self.frames.get(func, 0) + deepest, [func] + chain)
+		return self.depths[func]
+
+	def reach(self, func):
+		"""Get the functions reachable from a function, itself included."""
+		seen, todo = set(), [func]
+		while todo:
+			f = todo.pop()
+			if f not in seen:
+				seen.add(f)
+				todo.extend(self.calls.get(f, ()))
+		return seen
+
+
+def main(argv):
+	global CALL_SIZE
+
+	ap = argparse.ArgumentParser(
+			description='Worst-case stack depth of the firmware entry points')
+	ap.add_argument('-d', '--objdump', default='avr-objdump',
+			help='the objdump of the firmware toolchain')
+	ap.add_argument('-c', '--call-size', type=int, default=CALL_SIZE,
+			help='the bytes pushed by a call [%(default)s]')
+	ap.add_argument('-r', '--root', action='append', default=[],
+			help='an entry point, instead of the default ones')
+	ap.add_argument('-b', '--budget', action='append', default=[],
+			metavar='ROOT=BYTES', help='the stack size of an entry point')
+	ap.add_argument('-i', '--icall', action='append', default=[],
+			metavar='CALLER=CALLEES',
+			help='the callees of the indirect calls of the functions '
+				'matching CALLER, "f1,f2,..." or the handlers of '
+				'"@cmd_hash.h"')
+	ap.add_argument('-I', '--icall-targets', metavar='REGEXP',
+			help='the functions called by all the indirect calls')
+	ap.add_argument('elf')
+	ap.add_argument('su', nargs='+')
+	args = ap.parse_args(argv[1:])
+	CALL_SIZE = args.call_size
+
+	frames, dynamic = parse_su(args.su)
+	calls, indirect = parse_calls(args.objdump, args.elf)
+	indirect = resolve(calls, indirect, args.icall, args.icall_targets)
+	graph = Graph(frames, calls)
+
+	roots = args.root or sorted(f for f in calls if ROOTS_RE.match(f))
+	if not roots:
+		sys.stderr.write('%s: no entry points found\n' % args.elf)
+		return 1
+	budgets = dict(b.split('=') for b in args.budget)
+
+	isrDepth = 0
+	isrReach = set()
+	print('%-24s %6s  %s' % ('Entry point', 'Depth', 'Deepest path'))
+	for root in roots:
+		depth, chain = graph.depth(root)
+		if ISR_RE.match(root):
+			isrDepth = max(isrDepth, depth)
+			isrReach |= graph.reach(root)
+		print('%-24s %6d  %s' % (root, depth, ' > '.join(chain)))
+
+	print('\nInterrupts add up to %d bytes on each stack' % isrDepth)
+
+	over = 0
+	for root, budget in sorted(budgets.items()):
+		depth = graph.depth(root)[0] + isrDepth
+		# The depth is unknown, if indirect calls are on some path
+		unresolved = indirect & (graph.reach(root) | isrReach)
+		print('%-24s %6d of %s bytes%s' % (root, depth, budget,
+			' OVERFLOW' if depth > int(budget) else
+			' UNRESOLVED' if unresolved else ''))
+		over += depth > int(budget) or bool(unresolved)
+
+	# The depths depending on these are underestimated
+	for label, funcs in (
+			('Unknown frames', graph.unknown),
+			('Dynamic frames', dynamic & set(graph.depths)),
+			('Indirect calls', indirect & set(graph.depths)),
+			('Recursions', graph.recursive)):
+		if funcs:
+			print('\n%s: %s' % (label, ', '.join(sorted(funcs))))
+
+	return 1 if over else 0
+
+
+if __name__ == '__main__':
+	sys.exit(main(sys.argv))
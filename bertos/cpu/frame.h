@@ -54,7 +54,7 @@
 	#if CPU_X86_32
 		#define CPU_SAVED_REGS_CNT      2
 	#elif CPU_X86_64
-		#define CPU_SAVED_REGS_CNT      8
+		#define CPU_SAVED_REGS_CNT      6
 	#else
 		#error "unknown CPU"
 	#endif
@@ -265,6 +265,12 @@
  * profile system load with an external strobe, or to save CPU cycles
  * in hosted environments such as emulators.
  */
+#if (ARCH & ARCH_EMUL) && !defined(CPU_IDLE)
+	#include <emul/emul.h> // emul_idle()
+	/* Let the emulator clock run, which the sleeping processes wait for */
+	#define CPU_IDLE emul_idle()
+#endif
+
 #ifndef CPU_IDLE
 	#define CPU_IDLE PAUSE
 #endif /* !CPU_IDLE */
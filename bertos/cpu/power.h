@@ -39,6 +39,7 @@
 
 #include "cfg/cfg_proc.h"
 #include "cfg/cfg_wdt.h"
+#include "cfg/cfg_arch.h"
 
 #include <cfg/compiler.h>
 
@@ -50,6 +51,10 @@
 	#include <drv/wdt.h>
 #endif
 
+#if (ARCH & ARCH_EMUL)
+	#include <emul/emul.h> // emul_idle()
+#endif
+
 /**
  * Let the CPU rest in tight busy loops
  *
@@ -77,6 +82,10 @@ INLINE void cpu_relax(void)
 #if CONFIG_WATCHDOG
 	wdt_reset();
 #endif
+
+#if (ARCH & ARCH_EMUL)
+	emul_idle();
+#endif
 }
 
 /**
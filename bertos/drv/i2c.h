@@ -418,12 +418,15 @@ INLINE void i2c_read(I2c *i2c, void *_buf, size_t count)
 
 /**
  * Return the error condition of the bus and clear errors.
+ * The transfer failed, if any, is aborted as well.
  */
 INLINE int i2c_error(I2c *i2c)
 {
 	ASSERT(i2c);
 	int err = i2c->errors;
 	i2c->errors = 0;
+	if (err)
+		i2c->xfer_size = 0;
 
 	return err;
 }
@@ -57,47 +57,94 @@
 #define LOG_FORMAT  ADE7753_LOG_FORMAT
 #include <cfg/log.h>
 
+#if !CONFIG_TIMER_UDELAY
+	#error "ADE7753 driver requires CONFIG_TIMER_UDELAY"
+#endif
+
 static struct KFile *spi;
 
-static void meter_read(unsigned char addr, unsigned char * data,
+/*
+ * Burst transactions
+ *
+ * The serial interface of the ADE7753 is reset only by a CS rising edge, thus
+ * many register accesses could be performed within the same CS window.
+ * The only timing that the SPI clock does not grant by itself is the t9 delay
+ * between the address byte and the data bytes of a read operation.
+ */
+
+INLINE void meter_xfer_begin(void)
+{
+	ADE7753_CS_LOW();
+}
+
+INLINE void meter_xfer_end(void)
+{
+	// Wait for all the queued bytes being shifted out
+	kfile_flush(spi);
+	ADE7753_CS_HIGH();
+}
+
+static void meter_xfer_read(unsigned char addr, unsigned char *data,
 		unsigned char count)
 {
-	LOG_INFO("%s: @%#02X\n", __func__, addr);
+	kfile_write(spi, &addr, 1);
+	kfile_flush(spi);
+	timer_udelay(ADE7753_READ_DELAY_US);
 
-	ADE7753_CS_LOW();
-	timer_delay(10);
+	kfile_read(spi, data, count);
+}
 
+static void meter_xfer_write(unsigned char addr, const unsigned char *data,
+		unsigned char count)
+{
+	addr |= 0x80;
 	kfile_write(spi, &addr, 1);
-	timer_delay(10);
+	kfile_write(spi, data, count);
+}
 
-	for (int i=0; i<count; i++) { 
-		kfile_read(spi, data+i, 1);
-		timer_delay(10);
-	}
+static void meter_read(unsigned char addr, unsigned char * data,
+		unsigned char count)
+{
+	LOG_INFO("%s: @%#02X\n", __func__, addr);
 
-	ADE7753_CS_HIGH();
-} 
+	meter_xfer_begin();
+	meter_xfer_read(addr, data, count);
+	meter_xfer_end();
+}
 
 static void meter_write(unsigned char addr, unsigned char * data,
 		unsigned char count)
 {
-
 	LOG_INFO("%s: @%#02X\n", __func__, addr);
 
-	ADE7753_CS_LOW();
-	timer_delay(10);
-	
-	addr |= 0x80;
-	kfile_write(spi, &addr, 1);
-	timer_delay(10);
+	meter_xfer_begin();
+	meter_xfer_write(addr, data, count);
+	meter_xfer_end();
+}
 
-	for (int i=0; i<count; i++) { 
-		kfile_write(spi, data+i, 1);
-		timer_delay(10);
+/**
+ * @brief Read a set of registers within a single CS window.
+ *
+ * Registers are returned MSB first, right aligned into \a values.
+ *
+ * @param regs the registers to read
+ * @param count the number of registers to read
+ * @param values where the (unsigned) register values are returned
+ */
+void meter_ade7753_readBurst(const meter_reg_t *regs, uint8_t count,
+		uint32_t *values)
+{
+	unsigned char data[ADE7753_MAX_RX];
+
+	meter_xfer_begin();
+	for (uint8_t r = 0; r < count; r++) {
+		ASSERT(regs[r].size <= ADE7753_MAX_RX);
+		meter_xfer_read(regs[r].addr, data, regs[r].size);
+		values[r] = 0;
+		for (uint8_t i = 0; i < regs[r].size; i++)
+			values[r] = (values[r] << 8) | data[i];
 	}
-
-	ADE7753_CS_HIGH();
-
+	meter_xfer_end();
 }
 
 static void meter_set(uint16_t bits)
@@ -134,12 +181,11 @@ void meter_ade7753_on(void)
 }
 
 void meter_ade7753_conf(meter_conf_t *conf) {
-        meter_read(ADE7753_DIEREV, &(conf->rev), 1);
-        timer_delay(5);
-        meter_read(ADE7753_MODE, conf->mode, 2);
-        timer_delay(5);
-        meter_read(ADE7753_IRQEN, conf->irqs, 2);
-        timer_delay(5);
+	meter_xfer_begin();
+	meter_xfer_read(ADE7753_DIEREV, &(conf->rev), 1);
+	meter_xfer_read(ADE7753_MODE, conf->mode, 2);
+	meter_xfer_read(ADE7753_IRQEN, conf->irqs, 2);
+	meter_xfer_end();
 }
 
 //void meter_ade7753_Irms(unsigned char *sample) {
@@ -154,35 +200,114 @@ void meter_ade7753_Power(unsigned char *sample) {
         meter_read(ADE7753_WAVEFORM, sample, 3);
 }
 
+static const meter_reg_t irms_reg[] = {
+	{ ADE7753_IRMS, 3 },
+	{ ADE7753_VRMS, 3 },
+};
+
 uint32_t meter_ade7753_Irms(void) {
-	unsigned char irms[3];
 	uint32_t irms_value;
 
-    meter_read(0x16, irms, 3);
-	irms_value  = ((uint32_t)irms[0]<<16)
-			+((uint32_t)irms[1]<<8)
-			+(uint32_t)irms[2];
-
-	LOG_INFO("Irms=0x%02X%02X%02X=%08ld\n",
-			irms[0], irms[1], irms[2], irms_value);
+	meter_ade7753_readBurst(irms_reg, 1, &irms_value);
+	LOG_INFO("Irms=%08ld\n", irms_value);
 
 	return irms_value;
 }
 
 uint32_t meter_ade7753_Vrms(void) {
-	unsigned char vrms[3];
 	uint32_t vrms_value;
 
-    meter_read(0x17, vrms, 3);
-	vrms_value  = ((uint32_t)vrms[0]<<16)
-			+((uint32_t)vrms[1]<<8)
-			+(uint32_t)vrms[2];
-
-	LOG_INFO("Vrms=0x%02X%02X%02X=%08ld\n",
-			vrms[0], vrms[1], vrms[2], vrms_value);
+	meter_ade7753_readBurst(irms_reg+1, 1, &vrms_value);
+	LOG_INFO("Vrms=%08ld\n", vrms_value);
 
 	return vrms_value;
 }
+
+/**
+ * @brief Get both Irms and Vrms within a single CS window.
+ */
+void meter_ade7753_IVrms(uint32_t *irms, uint32_t *vrms) {
+	uint32_t rms[2];
+
+	meter_ade7753_readBurst(irms_reg, 2, rms);
+	(*irms) = rms[0];
+	(*vrms) = rms[1];
+
+	LOG_INFO("Irms=%08ld, Vrms=%08ld\n", rms[0], rms[1]);
+}
+/**
+ * @brief Start a Line Cycle Energy Accumulation with CYCEND interrupt.
+ *
+ * The accumulation restarts automatically every \a cycles line cycles, and
+ * at the end of each one the IRQ line is asserted until the interrupt
+ * status is reset, e.g. by meter_ade7753_readSample().
+ *
+ * @param cycles the number of line cycles of each accumulation
+ */
+void meter_ade7753_armLCEA(uint8_t cycles) {
+	unsigned char data[2];
+	uint16_t hc = cycles;
+
+	// Compute the number of half line cycles
+	hc <<= 1;
+
+	meter_xfer_begin();
+
+	// Configure the LINECYC register with the number of half line cycles
+	data[0] = (unsigned char)(hc>>8);
+	data[1] = (unsigned char)(hc & 0xFF);
+	meter_xfer_write(ADE7753_LINECYC, data, 2);
+
+	// Setting Mode register bit 7 (CYCMODE)
+	meter_xfer_read(ADE7753_MODE, data, 2);
+	data[1] |= BV8(ADE7753_CYCMODE);
+	meter_xfer_write(ADE7753_MODE, data, 2);
+
+	// Route just the CYCEND interrupt on the IRQ line
+	data[0] = 0x00;
+	data[1] = BV8(ADE7753_IRQ_CYCEND);
+	meter_xfer_write(ADE7753_IRQEN, data, 2);
+
+	// Release any interrupt already pending
+	meter_xfer_read(ADE7753_RSTSTATUS, data, 2);
+
+	meter_xfer_end();
+
+	LOG_INFO("Arm LCAE [%hd*2 half-cycles]\n", cycles);
+}
+
+static const meter_reg_t sample_regs[] = {
+	{ ADE7753_IRMS,      3 },
+	{ ADE7753_VRMS,      3 },
+	{ ADE7753_LAENERGY,  3 },
+	{ ADE7753_PERIOD,    2 },
+	{ ADE7753_RSTSTATUS, 2 },
+};
+
+/**
+ * @brief Read a complete sample within a single CS window.
+ *
+ * The interrupt status is read last, by RSTSTATUS, thus releasing the IRQ
+ * line only once all the measures have been collected.
+ */
+void meter_ade7753_readSample(meter_sample_t *sample) {
+	uint32_t values[countof(sample_regs)];
+
+	meter_ade7753_readBurst(sample_regs, countof(sample_regs), values);
+
+	sample->irms = values[0];
+	sample->vrms = values[1];
+	// LAENERGY is a 24bit two's complement value
+	sample->lae = (int32_t)values[2];
+	if (values[2] & 0x800000UL)
+		sample->lae |= (int32_t)0xFF000000UL;
+	sample->period = (uint16_t)values[3];
+	sample->status = (uint16_t)values[4];
+
+	LOG_INFO("Irms=%08ld, Vrms=%08ld, LAE=%08ld, S=%#04X\n",
+			sample->irms, sample->vrms, sample->lae, sample->status);
+}
+
 /**
  * @brief Enable Line Cycle Energy Accumulation mode
  *
@@ -218,10 +343,8 @@ static int32_t meter_ade7753_LCAE(void) {
 			+(int32_t)lcae[2];
 
 	// Adjust sign (which is 24bit mod-2 signed)
-	if (lcae_value & 0x008000) {
-		lcae_value &= ~0x008000;
-		lcae_value |=  0x800000;
-	}
+	if (lcae_value & 0x800000L)
+		lcae_value |= (int32_t)0xFF000000UL;
 
 	LOG_INFO("LCAE=0x%02X%02X%02X=%08ld\n",
 			lcae[0], lcae[1], lcae[2], lcae_value);
@@ -245,7 +368,7 @@ int32_t meter_ade7753_getEnergyLCAE(void) {
 	meter_read(0x09, conf, 2);
 
 	// Setting Mode register bit 7 (CYCMODE)
-	conf[0] |= 0x01; 
+	conf[1] |= BV8(ADE7753_CYCMODE);
 	meter_write(0x09, conf, 2);
 
 	// Dump ADE7753 configuration
@@ -289,21 +412,24 @@ void meter_ade7753_reset(void)
 	conf[0] = 0x00;
 	conf[1] = 0x40;
 	meter_write(0x09, conf, 2);
-	timer_delay(1);
+	timer_udelay(ADE7753_SWRST_DELAY_US);
+
+	meter_xfer_begin();
 
 	// Load conf
 	//conf[0] = 0x00;
 	conf[0] = 0x00; // CH2 on waveform register
 	conf[1] = 0x0C;
-	meter_write(0x09, conf, 2);
+	meter_xfer_write(0x09, conf, 2);
 	//      conf[1] = (_BV(SWRST) | _BV(DISCF) | _BV(DISSAG));
 	//      meter_write(MODE, conf, 2);
-	timer_delay(1);
 
 	// Enable all interrupts
 	conf[0] = 0xFF;
 	conf[1] = 0xFF;
-	meter_write(0x0A, conf, 2);
+	meter_xfer_write(0x0A, conf, 2);
+
+	meter_xfer_end();
 
 }
 
@@ -101,10 +101,41 @@
 #define ADE7753_WAVSEL1    0xE
 #define ADE7753_POAM       0xF
 
+/**
+ * \name ADE7753 interrupt status/enable bits
+ * @{
+ */
+#define ADE7753_IRQ_AEHF   0x0
+#define ADE7753_IRQ_SAG    0x1
+#define ADE7753_IRQ_CYCEND 0x2
+#define ADE7753_IRQ_WSMP   0x3
+#define ADE7753_IRQ_ZX     0x4
+#define ADE7753_IRQ_TEMP   0x5
+#define ADE7753_IRQ_RESET  0x6
+#define ADE7753_IRQ_AEOF   0x7
+#define ADE7753_IRQ_ZXTO   0xC
+/*@}*/
+
 #define ADE7753_MAX_TX    4
 #define ADE7753_MAX_RX    4
 #define ADE7753_STARTUP_DELAY 1
 
+/**
+ * \name ADE7753 serial interface timings [us]
+ *
+ * All the other datasheet timings (CS setup/hold, inter-byte gaps) are in the
+ * order of tens of ns, thus they are always granted by the SPI clock itself.
+ * @{
+ */
+/** Minimum time between the end of the address byte and a data read (t9) */
+#define ADE7753_READ_DELAY_US   4
+/** No data transfer should take place for 18us after a software reset */
+#define ADE7753_SWRST_DELAY_US  18
+/*@}*/
+
+/** The PERIOD register resolution [ns], i.e. 8/CLKIN at 3.579545MHz */
+#define ADE7753_PERIOD_LSB_NS 2235
+
 
 //typedef uint32_t ade7753_data_t;
 
@@ -129,6 +160,32 @@ uint32_t meter_ade7753_Irms(void);
 uint32_t meter_ade7753_Vrms(void);
 void meter_ade7753_Power(unsigned char *sample);
 
+/**
+ * A register to be read within a burst transaction
+ */
+typedef struct meter_reg {
+	uint8_t addr; ///< The register address
+	uint8_t size; ///< The register size [bytes], up to 4
+} meter_reg_t;
+
+void meter_ade7753_readBurst(const meter_reg_t *regs, uint8_t count,
+		uint32_t *values);
+void meter_ade7753_IVrms(uint32_t *irms, uint32_t *vrms);
+
+/**
+ * A complete meter sample, as collected at the end of an accumulation
+ */
+typedef struct meter_sample {
+	uint32_t irms;    ///< The IRMS register
+	uint32_t vrms;    ///< The VRMS register
+	int32_t  lae;     ///< The (sign extended) LAENERGY register
+	uint16_t period;  ///< The PERIOD register
+	uint16_t status;  ///< The interrupt status, reset by this read
+} meter_sample_t;
+
+void meter_ade7753_armLCEA(uint8_t cycles);
+void meter_ade7753_readSample(meter_sample_t *sample);
+
 void meter_ade7753_setLCEA(uint8_t cycles);
 int32_t meter_ade7753_getEnergyLCAE(void);
 
@@ -93,8 +93,8 @@ extern Emulator *emul;
 #endif /* __cplusplus */
 
 EXTERN_C void emul_init(int *argc, char *argv[]);
-EXTERN_C void emul_cleanup();
-EXTERN_C void emul_idle();
+EXTERN_C void emul_cleanup(void);
+EXTERN_C void emul_idle(void);
 
 #endif /* EMUL_EMUL_H */
 
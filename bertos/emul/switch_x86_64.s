@@ -45,28 +45,25 @@
  *       current stack frame.
  *
  * asm_switch_context() can be considered as a normal function call, so we need
- * to save all the callee-clobbered registers minus the return registers.
+ * to save just the callee-saved registers: the caller has already saved the
+ * callee-clobbered ones it still needs.
  */
 
 /* void asm_switch_context(void **new_sp [%rdi], void **save_sp [%rsi]) */
 .globl asm_switch_context
 asm_switch_context:
 	pushq	%rbp
-	pushq	%rdi
-	pushq	%rsi
-	pushq	%rcx
-	pushq	%r8
-	pushq	%r9
-	pushq	%r10
-	pushq	%r11
+	pushq	%rbx
+	pushq	%r12
+	pushq	%r13
+	pushq	%r14
+	pushq	%r15
 	movq	%rsp,(%rsi)             /* *save_sp = rsp */
 	movq	(%rdi),%rsp             /* rsp = *new_sp */
-	popq	%r11
-	popq	%r10
-	popq	%r9
-	popq	%r8
-	popq	%rcx
-	popq	%rsi
-	popq	%rdi
+	popq	%r15
+	popq	%r14
+	popq	%r13
+	popq	%r12
+	popq	%rbx
 	popq	%rbp
 	ret
@@ -47,6 +47,11 @@
 // Forward declaration for the user interrupt server routine.
 void timer_isr(int);
 
+/// The high-precision time of the next tick, 0 while on the host clock.
+static hptime_t timer_virtual_next;
+
+#define TIMER_HW_HPTICKS_PER_TICK (TIMER_HW_HPTICKS_PER_SEC / TIMER_TICKS_PER_SEC)
+
 /// HW dependent timer initialization.
 static void timer_hw_init(void)
 {
@@ -64,6 +69,10 @@ static void timer_hw_init(void)
 		sigaction(SIGALRM, &sa, NULL);
 	#endif // CONFIG_KERN_IRQ
 
+	// The virtual clock is run by timer_virtualIdle()
+	if (timer_virtual_next)
+		return;
+
 	// Setup POSIX realtime timer to interrupt every 1/TIMER_TICKS_PER_SEC.
 	static const struct itimerval itv =
 	{
@@ -84,6 +93,54 @@ static void timer_hw_cleanup(void)
 	signal(SIGALRM, SIG_DFL);
 }
 
+/**
+ * Clock the timer by a virtual time, instead of the host interval timer.
+ *
+ * The virtual time advances when the application is idle, jumping to the
+ * next tick (see timer_virtualIdle()), thus long delays elapse instantly and
+ * the timing is deterministic.
+ */
+void timer_setVirtual(void)
+{
+	static const struct itimerval itv =
+	{
+		{ 0, 0 }, /* it_interval */
+		{ 0, 0 }  /* it_value */
+	};
+	setitimer(ITIMER_REAL, &itv, NULL);
+
+	hptime_setVirtual(0);
+	timer_virtual_next = TIMER_HW_HPTICKS_PER_TICK;
+}
+
+/**
+ * Let the virtual clock run, to be called with IRQs enabled by the idle
+ * loops of the application.
+ *
+ * The ticks already elapsed are triggered or, if none, the virtual time
+ * jumps to the next tick.
+ */
+void timer_virtualIdle(void)
+{
+	hptime_t now;
+
+	if (!timer_virtual_next)
+		return;
+
+	now = hptime_get();
+	if (now < timer_virtual_next)
+	{
+		now = timer_virtual_next;
+		hptime_setVirtual(now);
+	}
+
+	while (now >= timer_virtual_next)
+	{
+		timer_virtual_next += TIMER_HW_HPTICKS_PER_TICK;
+		timer_isr(SIGALRM);
+	}
+}
+
 INLINE hptime_t timer_hw_hpread(void)
 {
 	return hptime_get();
@@ -55,4 +55,7 @@
 /// Not needed.
 #define timer_hw_irq() do {} while (0)
 
+void timer_setVirtual(void);
+void timer_virtualIdle(void);
+
 #endif /* DRV_TIMER_POSIX_H */
@@ -34,7 +34,8 @@
  *
  * This file contains the channel protocol parser and
  * the definition of the protocol commands. Commands are defined
- * in a "CmdTemplate" type array, containing:
+ * in a "CmdTemplate" type perfect hash table, in program memory,
+ * containing:
  * - the name of the command,
  * - the arguments it expects to receive,
  * - the output values,
@@ -57,22 +58,24 @@
 
 #include "cfg/cfg_parser.h"
 
+#include <cpu/pgm.h>
 #include <io/kfile.h>
-#include <struct/hashtable.h>
 
 #include <stdlib.h> // atol(), NULL
 #include <string.h> // strchr(), strcmp()
 
+#if CPU_AVR
+	#include <avr/pgmspace.h> // memcpy_P(), strncmp_P()
+	#define pgm_read_ptr(addr) ((const void *)pgm_read16(addr))
+#else
+	#define pgm_read_ptr(addr) (*(const void * const *)(addr))
+#endif
+
 #define ARG_SEP_S " "
 #define ARG_SEP_C ' '
 
-#define MAX_COMMANDS_NUMBER  128  // 64
-
-/// Hashtable hook to extract the key from a command
-static const void* get_key_from_command(const void* cmd, uint8_t* length);
-
-/// Hashtable that handles the commands that can be executed
-DECLARE_HASHTABLE_STATIC(commands, MAX_COMMANDS_NUMBER, get_key_from_command);
+/// Table of the commands that can be executed
+static const struct CmdTable *commands;
 
 
 /**
@@ -112,6 +115,37 @@ static bool get_word(const char **begin, const char **end)
 }
 
 
+/**
+ * \brief Tokenize the command name from a text.
+ *
+ * As get_word(), but the word is hashed while it is scanned.
+ *
+ * \return The slot of the commands table for the word, which is
+ * empty if no word was extracted.
+ */
+static const struct CmdTemplate *get_cmd_word(const char **begin, const char **end)
+{
+	const char *cur = *end;
+	uint16_t seed = commands->seed;
+	uint16_t h = 0;
+
+	while (*cur == ' ' || *cur == '\t')
+		++cur;
+
+	*begin = cur;
+
+	while ((*cur != ' ' && *cur != '\t') && *cur)
+		h = parser_hash(h, seed, *cur++);
+
+	*end = cur;
+
+	if (*end == *begin)
+		return NULL;
+
+	return pgm_read_ptr(&commands->slots[parser_hash_slot(h, commands->mask)]);
+}
+
+
 /**
  * \brief Command arguments parser.
  *
@@ -119,7 +153,7 @@ static bool get_word(const char **begin, const char **end)
  * parses the input string filling the array argv
  * with input parameters of the correct type.
  *
- * \param fmt   Parameters format string.
+ * \param fmt   Parameters format string, in program memory.
  * \param input Input string.
  * \param argv  Array filled with parameters.
  *
@@ -128,14 +162,15 @@ static bool get_word(const char **begin, const char **end)
 static bool parseArgs(const char *fmt, const char *input, parms argv[])
 {
 	const char *begin = input, *end = input;
+	char f;
 
-	while (*fmt)
+	while ((f = pgm_read8(fmt)))
 	{
 		// Extract the argument
 		if (!get_word(&begin, &end))
 			return false;
 
-		switch (*fmt)
+		switch (f)
 		{
 			case 'd':
 				(*argv++).l = atol(begin);
@@ -242,30 +277,40 @@ static int printResult(KFile *ch, const char *fmt, parms result[])
 }
 #endif /* UNUSED_CODE */
 
+/// The longest command name completed for readline, with its terminator
+#define RL_NAME_SIZE 16
+
 /// Hook provided by the parser for matching of command names (TAB completion) for readline
 const char* parser_rl_match(UNUSED_ARG(void *,dummy), const char *word, int word_len)
 {
-	HashIterator cur;
-	HashIterator end = ht_iter_end(&commands);
-	const char *found = NULL;
+	static char rl_name[RL_NAME_SIZE];
+	const struct CmdTemplate *cmdp;
+	const char *name, *found = NULL;
 
-	for (cur = ht_iter_begin(&commands);
-	     !ht_iter_cmp(cur, end);
-	     cur = ht_iter_next(cur))
+	for (uint16_t i = 0; i <= commands->mask; ++i)
 	{
-		const struct CmdTemplate* cmdp = (const struct CmdTemplate*)ht_iter_get(cur);
-		if (strncmp(cmdp->name, word, word_len) == 0)
+		cmdp = pgm_read_ptr(&commands->slots[i]);
+		if (!cmdp)
+			continue;
+
+		name = pgm_read_ptr(&cmdp->name);
+		if (PFUNC(strncmp)(word, name, word_len) == 0)
 		{
 			// If there was another matching word, it means that we have a multiple
 			//  match: then return NULL.
 			if (found)
 				return NULL;
 
-			found = cmdp->name;
+			found = name;
 		}
 	}
 
-	return found;
+	// readline works on RAM strings
+	if (!found || PFUNC(strlen)(found) >= sizeof(rl_name))
+		return NULL;
+	PFUNC(strcpy)(rl_name, found);
+
+	return rl_name;
 }
 
 #if CONFIG_PARSER_USE_ID
@@ -286,119 +331,51 @@ bool parser_get_cmd_id(const char* line, unsigned long* ID)
 }
 #endif
 
-const struct CmdTemplate* parser_get_cmd_template(const char *input)
-{
-//	const struct CmdTemplate *cmdp;
-//	int cmdlen;
-	const char *begin = input, *end = input;
-
-#if CONFIG_PARSER_USE_ID
-	// Skip the ID, and get the command
-	if (!get_word(&begin, &end))
-		return NULL;
-#endif
-	if (!get_word(&begin, &end))
-		return NULL;
-
-	return (const struct CmdTemplate*)ht_find(&commands, begin, end-begin);
-}
-
-static const char *skip_to_params(const char *input, const struct CmdTemplate *cmdp)
+ParseResult parser_parse_cmd(const char* input, struct CmdTemplate* templ, parms args[PARSER_MAX_ARGS])
 {
+	const struct CmdTemplate *cmdp;
 	const char *begin = input, *end = input;
+	size_t len;
 
 #if CONFIG_PARSER_USE_ID
 	// Skip the ID, and get the command
 	if (!get_word(&begin, &end))
-		return NULL;
+		return PARSE_INVALID_CMD;
 #endif
-	if (!get_word(&begin, &end))
-		return NULL;
-
-	ASSERT2(strlen(cmdp->name) == (size_t)(end-begin), "Invalid command template specified");
-	ASSERT2(!strncmp(begin, cmdp->name, end-begin), "Invalid command template specified");
-
-	return end;
-}
-
-bool parser_get_cmd_arguments(const char* input, const struct CmdTemplate* cmdp, parms args[PARSER_MAX_ARGS])
-{
-	input = skip_to_params(input, cmdp);
-	if (!input)
-		return false;
+	cmdp = get_cmd_word(&begin, &end);
+	if (!cmdp)
+		return PARSE_INVALID_CMD;
 
-	args[0].s = cmdp->name;
-	if (!parseArgs(cmdp->arg_fmt, input, args + 1))
-		return false;
+	// The slot holds the only command which could match
+	PFUNC(memcpy)(templ, cmdp, sizeof(*templ));
+	len = end - begin;
+	if (PFUNC(strncmp)(begin, templ->name, len) ||
+			pgm_read8(templ->name + len))
+		return PARSE_INVALID_CMD;
 
-	return true;
-}
+	args[0].s = begin;
+	if (!parseArgs(templ->arg_fmt, end, args + 1))
+		return PARSE_INVALID_ARG;
 
-static const void* get_key_from_command(const void* cmd, uint8_t* length)
-{
-	const struct CmdTemplate* c = cmd;
-	*length = strlen(c->name);
-	return c->name;
+	return PARSE_OK;
 }
 
 bool parser_process_line(const char* input)
 {
-	const struct CmdTemplate *cmdp;
+	struct CmdTemplate templ;
 	parms args[PARSER_MAX_ARGS];
 
-	cmdp = parser_get_cmd_template(input);
-	if (!cmdp)
-		return false;
-
-	if (!parser_get_cmd_arguments(input, cmdp, args))
+	if (parser_parse_cmd(input, &templ, args) != PARSE_OK)
 		return false;
 
-	if (!parser_execute_cmd(cmdp, args))
+	if (!parser_execute_cmd(&templ, args))
 		return false;
 
 	return true;
 }
 
-void parser_register_cmd(const struct CmdTemplate* cmd)
-{
-	ht_insert(&commands, cmd);
-}
-
-#if CONFIG_INTERNAL_COMMANDS
-#warning FIXME:This code use boost lib, if you compile with internal command you must fix it.
-static ResultCode cmd_help(void)
+void parser_init(const struct CmdTable *table)
 {
-#ifdef _DEBUG
-
-	// FIXME: There is no way at the moment to access the serial port. Dump
-	//  this through JTAG for now
-	for (HashIterator iter = ht_iter_begin(&commands);
-		!ht_iter_cmp(iter, ht_iter_end(&commands));
-		iter = ht_iter_next(iter))
-	{
-		struct CmdTemplate* cmd = (struct CmdTemplate*)ht_iter_get(iter);
-		kprintf("%-20s", cmd->name);
-		for (unsigned j = 0; cmd->arg_fmt[j]; ++j)
-			kprintf("%c ", 'a' + j);
-		kprintf("\r\n");
-	}
-#endif
-
-	return RC_OK;
-}
-
-#include "cmd_hunk.h"
-DECLARE_CMD_HUNK(help, (NIL), (NIL));
-
-#endif // CONFIG_INTERNAL_COMMANDS
-
-
-void parser_init(void)
-{
-	// Initialize the hashtable used to store the command description
-	ht_init(&commands);
-
-#if CONFIG_INTERNAL_COMMANDS
-	parser_register_cmd(&CMD_HUNK_TEMPLATE(help));
-#endif
+	// The commands are looked up in place, thus nothing is registered
+	commands = table;
 }
@@ -38,7 +38,7 @@
  *
  * $WIZ$ module_name = "parser"
  * $WIZ$ module_configuration = "bertos/cfg/cfg_parser.h"
- * $WIZ$ module_depends = "kfile", "hashtable"
+ * $WIZ$ module_depends = "kfile"
  */
 
 
@@ -75,8 +75,9 @@ typedef ResultCode (*CmdFuncPtr)(parms args_results[]);
  *  d - a long integer, in decimal format
  *  s - a var string (in RAM)
  *
- * \note To create and fill an instance for this function, it is strongly
- * advised to use \c DECLARE_CMD_HUNK (cmd_hunk.h).
+ * \note Templates, and their strings, are stored in program memory.
+ * To create and fill an instance for this function, it is strongly
+ * advised to use \c MAKE_CMD (cmd_ctor.h).
  */
 struct CmdTemplate
 {
@@ -88,20 +89,50 @@ struct CmdTemplate
 };
 
 /**
- * Initialize the parser module
- *
- * \note This function must be called before any other function in this module
+ * A perfect hash table of commands, in program memory.
+ * Each command is stored in the slot selected by parser_hash() of its name,
+ * thus the table is generated at build time, e.g. by ade/tools/cmdhash.py.
+ */
+struct CmdTable
+{
+	const struct CmdTemplate * const *slots; ///< Commands, NULL if empty
+	uint16_t seed;                           ///< The hash seed
+	uint8_t  mask;                           ///< The number of slots, minus 1
+};
+
+/**
+ * Results of the command parsing
  */
-void parser_init(void);
+typedef enum
+{
+	PARSE_OK          = 0,  ///< Command and arguments parsed.
+	PARSE_INVALID_CMD = -1, ///< Command not found.
+	PARSE_INVALID_ARG = -2  ///< Command arguments not valid.
+} ParseResult;
+
+/**
+ * Update the hash of a command name with its next character \a c.
+ * The hash starts from 0, and the table slot is parser_hash_slot() of it.
+ */
+INLINE uint16_t parser_hash(uint16_t h, uint16_t seed, char c)
+{
+	return h * seed + (uint8_t)c;
+}
 
+/** Get the table slot of a command name hashed to \a h */
+INLINE uint8_t parser_hash_slot(uint16_t h, uint8_t mask)
+{
+	return (h ^ (h >> 8)) & mask;
+}
 
 /**
- * Register a new command into the parser
+ * Initialize the parser module
  *
- * \param cmd Command template describing the command
+ * \param table The table of the commands to be parsed
  *
+ * \note This function must be called before any other function in this module
  */
-void parser_register_cmd(const struct CmdTemplate* cmd);
+void parser_init(const struct CmdTable *table);
 
 
 /**
@@ -110,6 +141,10 @@ void parser_register_cmd(const struct CmdTemplate* cmd);
  *
  * \note This is meant to be used with mware/readline.c. See the
  * documentation there for a description of this hook.
+ *
+ * \return The name of the matching command, copied in RAM since the
+ * templates are in program memory, or NULL if the word matches none or
+ * more commands. The copy is overwritten by the following call.
  */
 const char* parser_rl_match(void* dummy, const char* word, int word_len);
 
@@ -143,32 +178,20 @@ INLINE bool parser_execute_cmd(const struct CmdTemplate* templ, parms args[PARSE
 
 
 /**
- * Find the template for the command contained in the text line.
- * The template can be used to tokenize the command and interpret
- * it.
- *
- * This function can be used to find out which command is contained
- * in a given text line without parsing all the parameters and
- * executing it.
- *
- * \param line Text line to be processed (ASCIIZ)
- *
- * \return The command template associated with the command contained
- * in the line, or NULL if the command is invalid.
- */
-const struct CmdTemplate* parser_get_cmd_template(const char* line);
-
-
-/**
- * Extract the arguments for the command contained in the text line.
+ * Find the command contained in the text line, and extract its arguments.
+ * The line is tokenized in a single pass: the command name is hashed while
+ * it is scanned, thus it is looked up by a single comparison, then the
+ * arguments are parsed from where the name ends.
  *
  * \param line Text line to be processed (ASCIIZ)
- * \param templ Command template for this line
- * \param args Will contain the extracted parameters
+ * \param templ Will contain a (RAM) copy of the command template, whose
+ * strings are still in program memory
+ * \param args Will contain the extracted parameters, while args[0] points
+ * to the command name within the line
  *
- * \return True if everything OK, false in case of parsing error.
+ * \return PARSE_OK if everything OK, the parsing error otherwise
  */
-bool parser_get_cmd_arguments(const char* line, const struct CmdTemplate* templ, parms args[PARSER_MAX_ARGS]);
+ParseResult parser_parse_cmd(const char* line, struct CmdTemplate* templ, parms args[PARSER_MAX_ARGS]);
 
 
 /**
@@ -79,6 +79,14 @@ extern "C" {
  */
 extern hptime_t hptime_get(void);
 
+#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__))
+/**
+ * Switch to a virtual time, set to \a now, which advances just by one tick
+ * at each reading and by subsequent calls of this function.
+ */
+extern void hptime_setVirtual(hptime_t now);
+#endif
+
 #ifdef __cplusplus
 }
 #endif /* __cplusplus */
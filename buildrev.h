@@ -0,0 +1,2 @@
+#define VERS_BUILD 149
+#define VERS_HOST  "vm"